@@ -25,48 +25,6 @@ void initNeuronGrid(CellularAutomata::Grid2D &grid, mt19937 &gen) {
     }
 }
 
-// Function to add random activity in the grid
-void addRandomActivity(CellularAutomata::Grid2D &grid, mt19937 &gen, int activityRate) {
-    uniform_int_distribution<> dis(0, 100); // Distribution for random activity decision
-    uniform_int_distribution<> stateDis(1, 3); // Random state between ACTIVE_1 and ACTIVE_3
-
-    // Iterate through each cell and randomly activate some based on the activity rate
-    for (auto &row : grid) {
-        for (auto &cell : row) {
-            if (dis(gen) < activityRate) {
-                cell = stateDis(gen);
-            }
-        }
-    }
-}
-
-// Function to apply weighted firing rules based on current state, active neighbors, and randomness
-int weightedFiringRule(int currentState, int activeNeighborCount, mt19937 &gen, int step) {
-    uniform_int_distribution<> randomChoice(0, 1); // Binary random choice
-
-    // Switch statement for different cell states
-    switch (currentState) {
-        case CellularAutomata::ACTIVE_1:
-            // Randomness added to the majority rule
-            if (randomChoice(gen)) {
-                return CellularAutomata::MajorityRule(activeNeighborCount);
-            }
-            break;
-        case CellularAutomata::ACTIVE_2:
-            // Randomness and periodic change added to the totalistic rule
-            if (randomChoice(gen) || step % 5 == 0) {
-                return CellularAutomata::TotalisticRule(activeNeighborCount);
-            }
-            break;
-        case CellularAutomata::ACTIVE_3:
-            // Random deactivation or transition to a lower active state
-            return randomChoice(gen) ? CellularAutomata::INACTIVE : CellularAutomata::ACTIVE_2;
-        default:
-            break;
-    }
-    return currentState;
-}
-
 // Main function
 int main() {
     int grid_size = 10; // Size of the grid
@@ -76,28 +34,28 @@ int main() {
     // Initialize the grid with random values
     ca.Initialize2D([&gen](CellularAutomata::Grid2D& grid){ initNeuronGrid(grid, gen); });
 
-    // Simulation loop for 20 steps
-    for (int step = 0; step < 20; ++step) {
-        auto gridState = ca.GetGrid2D(); // Get the current state of the grid
+    // Firing, relaying and refractory transitions with a coin flip each, relays forced every 5th step and
+    // 5% spontaneous activity every 3rd step (see NeuronModel.h); the library steps it in its own kernel.
+    // Note: the firing rule used to run on the randomly activated state; it now runs on the cell's previous
+    // state and the random activation overwrites its result, so an activated cell is printed as activated.
+    NeuronModel model;
+    const std::uint64_t seed = gen(); // seed of the per-cell random streams
 
-        // Add random activity every third step
-        if (step % 3 == 0) {
-            addRandomActivity(gridState, gen, 5); // 5% chance of activating a cell
-        }
+    // The library counts active and changed cells while it steps (see StepStats.h), no extra scan of the grid
+    ca.SetInstrumentation(true);
 
-        // Iterate through each cell to apply the firing rule
-        for (int i = 0; i < grid_size; ++i) {
-            for (int j = 0; j < grid_size; ++j) {
-                int activeNeighbors = ca.GetNeighbors2D(i, j); // Get count of active neighbors
-                gridState[i][j] = weightedFiringRule(gridState[i][j], activeNeighbors, gen, step); // Apply the firing rule
-            }
-        }
+    // Simulation loop for 20 steps
+    for (int step = 0; step < 20; ++step) {
+        ca.StepNeuron(model, seed, step);
 
-        // Update the grid with the new state
-        ca.UpdateGrid2D(gridState);
-        cout << "Grid state after step " << step << ":\n";
-        ca.Print(); // Print the current state of the grid
+        const StepStats &stats = ca.GetStepStats();
+        cout << "Grid state after step " << step << " (" << stats.population << " active, " << stats.cells_changed
+             << " changed):\n";
+        cout << ca.Print(); // Print the current state of the grid
     }
 
+    const StepStats &totals = ca.GetTotalStats();
+    cout << "Stepping took " << totals.total_seconds * 1e3 << " ms, printing " << totals.io_seconds * 1e3 << " ms\n";
+
     return 0;
 }
@@ -0,0 +1,88 @@
+// Include/AsyncTrajectoryWriter.h
+#pragma once                     // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef ASYNC_TRAJECTORY_WRITER_H // Include guard (if ASYNC_TRAJECTORY_WRITER_H not included yet define it and continue)
+#define ASYNC_TRAJECTORY_WRITER_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Trajectory.h"
+
+// AsyncTrajectoryWriter - writes a trajectory file from a background thread, so recording a run costs the
+// stepping thread one copy of the grid per frame instead of the encoding and the disk writes.
+// WriteFrame copies the grid into one of queue_frames buffers allocated up front and hands it to the writer
+// thread, which encodes it with a TrajectoryWriter (same file format, any encoding) and gives the buffer
+// back. Buffers are recycled, so steady-state recording does not allocate; WriteFrame only waits when every
+// buffer is still queued, that is when the disk (or the encoder) cannot keep up with the simulation.
+// Frames are written in the order they were handed in. An error on the writer thread (a failed write, a
+// state BitPacked cannot store) stops the writing; it is rethrown by the next WriteFrame, Flush or Close.
+// Memory use is queue_frames * cells * sizeof(int) on top of the TrajectoryWriter's buffer.
+// Meant to be fed by one thread.
+class AsyncTrajectoryWriter
+{
+public:
+    static const int DEFAULT_QUEUE_FRAMES = 4;
+
+    AsyncTrajectoryWriter(const std::string &path, const TrajectoryInfo &info, int queue_frames = DEFAULT_QUEUE_FRAMES,
+                          std::size_t buffer_bytes = TrajectoryWriter::DEFAULT_BUFFER_BYTES);
+    ~AsyncTrajectoryWriter();
+
+    AsyncTrajectoryWriter(const AsyncTrajectoryWriter &) = delete;
+    AsyncTrajectoryWriter &operator=(const AsyncTrajectoryWriter &) = delete;
+
+    const TrajectoryInfo &info() const { return writer_.info(); }
+
+    // Queue one generation; a shape that does not match the header throws std::invalid_argument right away.
+    void WriteFrame(const std::vector<int> &grid, long long generation);
+    void WriteFrame(const FlatGrid2D &grid, long long generation);
+    void WriteFrame(const FlatGrid3D &grid, long long generation);
+    // The current grid of `ca`, whatever its dimension.
+    void WriteFrame(const CellularAutomata &ca, long long generation);
+
+    // Frames handed in so far (written or still queued).
+    long long FrameCount() const { return frames_; }
+    // How often WriteFrame had to wait for a free buffer, and for how long in total.
+    long long StallCount() const { return stalls_; }
+    double StallSeconds() const { return stall_seconds_; }
+
+    // Waits until every queued frame is written and pushes the data to the operating system.
+    void Flush();
+    // Writes the remaining frames, stops the writer thread and closes the file.
+    void Close();
+
+private:
+    struct Slot
+    {
+        std::vector<int> cells; // info().CellCount() cells in row-major order
+        long long generation;
+    };
+
+    TrajectoryWriter writer_;         // used by the writer thread only, except while the queue is idle
+    std::vector<Slot> slots_;
+    std::vector<int> free_slots_;     // buffers WriteFrame can fill
+    std::deque<int> queued_;          // filled buffers in frame order
+    std::mutex mutex_;                // protects the fields below and the two lists above
+    std::condition_variable work_;    // signals the writer thread: a frame was queued or Close was called
+    std::condition_variable space_;   // signals WriteFrame and Flush: a buffer was given back
+    bool busy_;                       // the writer thread is encoding a frame
+    bool stopping_;
+    bool closed_;
+    std::exception_ptr error_;        // first error of the writer thread
+    long long frames_;
+    long long stalls_;
+    double stall_seconds_;
+    std::thread thread_;
+
+    void CheckShape(int layers, int rows, int cols) const;
+    int AcquireSlot();
+    void Submit(int slot, long long generation);
+    void WaitIdle(std::unique_lock<std::mutex> &lock);
+    void WriterLoop();
+};
+
+#endif // ASYNC_TRAJECTORY_WRITER_H - marks the end of the header guard conditional
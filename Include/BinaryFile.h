@@ -0,0 +1,63 @@
+// Include/BinaryFile.h
+#pragma once          // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef BINARY_FILE_H // Include guard (if BINARY_FILE_H not included yet define it and continue)
+#define BINARY_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Pieces shared by the binary file formats of the library (Trajectory.h, Checkpoint.h): the byte-order mark
+// and padding of their headers, the read-only file mapping their readers decode in place, flushing a file to
+// the disk, and closing a writer from its destructor.
+namespace ca_detail
+{
+    // Written in the byte order of the writing machine; a reader on a machine with the other order sees
+    // 0x04030201 and refuses the file.
+    const std::uint32_t BYTE_ORDER_MARK = 0x01020304u;
+
+    inline std::size_t RoundUp(std::size_t value, std::size_t multiple) { return (value + multiple - 1) / multiple * multiple; }
+
+    // MappedFile - a whole file, read-only. On POSIX systems the file is mapped into memory, so opening it
+    // costs nothing until pages are touched; elsewhere, or when mmap fails, it is read into an owned buffer.
+    // Errors throw std::runtime_error naming the kind of file ("trajectory", "checkpoint") and the path.
+    class MappedFile
+    {
+    public:
+        MappedFile(const std::string &path, const char *kind);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const unsigned char *data() const { return data_; }
+        std::size_t size() const { return size_; }
+
+    private:
+        const unsigned char *data_;
+        std::size_t size_;
+        bool mapped_;                      // data_ comes from mmap (otherwise from owned_)
+        std::vector<unsigned char> owned_;
+    };
+
+    // Flushes `file` and, on POSIX systems, waits until its contents are on the disk; false on failure.
+    bool SyncFile(std::FILE *file);
+
+    // Close() for the destructors of the writers: a destructor must not throw, so errors are dropped here;
+    // callers that need to see write errors call Close() directly.
+    template <typename Writer>
+    void CloseQuietly(Writer &writer)
+    {
+        try
+        {
+            writer.Close();
+        }
+        catch (...)
+        {
+        }
+    }
+} // namespace ca_detail
+
+#endif // BINARY_FILE_H - marks the end of the header guard conditional
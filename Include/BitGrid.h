@@ -0,0 +1,71 @@
+// Include/BitGrid.h
+#pragma once     // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef BIT_GRID_H // Include guard (if BIT_GRID_H not included yet define it and continue)
+#define BIT_GRID_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CellularAutomata.h"
+
+// BitGrid2D - a 2D automaton for binary (0/1) states that packs 64 cells into every uint64_t.
+// Rules such as majorityRule2D, parityRule and totalisticRule only ever produce 0 or 1, so storing each cell
+// in an int wastes 31 of its 32 bits. Here a row is a run of 64-bit words (cell j is bit j % 64 of word j / 64)
+// and one generation is computed with bit-sliced full adders: the eight (or four) neighbor words are added
+// bit-plane by bit-plane, so every logical instruction updates 64 cells at once. Memory use is 1/32 of
+// CellularAutomata, which is what makes 65536 x 65536 grids fit in RAM (2 x 512 MB for both buffers).
+// Boundary conditions follow the 2D semantics of CellularAutomata: Periodic wraps around, and for Fixed and
+// NoBoundary cells outside the grid count as 0.
+class BitGrid2D
+{
+public:
+    using Word = std::uint64_t;
+    static const int BITS_PER_WORD = 64;
+
+    BitGrid2D(int rows, int cols, BoundaryCondition bc, NeighborhoodType nt);
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int wordsPerRow() const { return words_per_row_; }
+    BoundaryCondition boundaryCondition() const { return boundary_condition_; }
+    NeighborhoodType neighborhoodType() const { return neighborhood_type_; }
+
+    // Single cell access (slow path, meant for initialization and inspection).
+    int Get(int i, int j) const { return static_cast<int>((Row(i)[j / BITS_PER_WORD] >> (j % BITS_PER_WORD)) & 1u); }
+    void Set(int i, int j, int value);
+
+    // Packed words of row i; bits past the last column are always 0.
+    const Word *Row(int i) const { return cells_.data() + static_cast<std::size_t>(i) * words_per_row_; }
+    Word *Row(int i) { return cells_.data() + static_cast<std::size_t>(i) * words_per_row_; }
+
+    // Conversion from and to the int grids of CellularAutomata (states must be 0 or 1).
+    void FromGrid(const FlatGrid2D &grid);
+    void ToGrid(FlatGrid2D &grid) const;
+
+    // Advances one generation with a two-state rule table whose outputs are 0 or 1
+    // (for example RuleTable::FromFunction(parityRule, 2, nt)). Throws std::invalid_argument otherwise.
+    void Step(const RuleTable &table);
+
+    // Number of cells in state 1.
+    std::size_t Population() const;
+
+    bool operator==(const BitGrid2D &other) const
+    {
+        return rows_ == other.rows_ && cols_ == other.cols_ && cells_ == other.cells_;
+    }
+    bool operator!=(const BitGrid2D &other) const { return !(*this == other); }
+
+private:
+    int rows_;          // number of rows
+    int cols_;          // number of columns
+    int words_per_row_; // ceil(cols_ / 64)
+    BoundaryCondition boundary_condition_;
+    NeighborhoodType neighborhood_type_;
+    std::vector<Word> cells_; // front buffer, rows_ x words_per_row_ words
+    std::vector<Word> next_;  // back buffer, swapped with cells_ after every Step
+
+    // Mask of the valid bits in the last word of a row.
+    Word LastWordMask() const;
+};
+
+#endif // BIT_GRID_H - marks the end of the header guard conditional
@@ -4,10 +4,19 @@
 //- to prevent multiple inclusions of the header file during compilation.
 #define CELL_AUT_H // header guard (proceed with including the header content )
 
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <functional>
+#include <memory>
 #include <random>
+#include <type_traits>
+#include "FlatGrid.h"
+#include "SimdKernels.h"
+#include "CounterRng.h"
+#include "NeighborCounts.h"
+#include "StepStats.h"
 using namespace std;
 // Enum declarations -> enumaration used to represent a set of configuration for the CA library
 // Name constant rather than generic numbers were use to make the code more readable and understandable.
@@ -16,7 +25,8 @@ using namespace std;
 enum class GridDimension
 {
     OneD,
-    TwoD
+    TwoD,
+    ThreeD
 };
 
 // Enumeration class declaration for boundary conditions of the CA
@@ -24,16 +34,44 @@ enum class BoundaryCondition
 {
     Fixed,
     Periodic,
-    NoBoundary
+    NoBoundary // cells outside the grid count as 0 (see SparseGrid2D for a plane without edges)
 };
 
 // Enumeration class declaration for neighborhood type of the CA
+// In 3D, Moore means the 26 cells of the surrounding 3 x 3 x 3 cube and VonNeumann the 6 face neighbors.
 enum class NeighborhoodType
 {
     Moore,
     VonNeumann
 };
 
+// What Run does once cycle detection (SetCycleDetection) has found the period of the grid.
+enum class CycleAction
+{
+    FastForward, // advance only the remaining steps modulo the period: same grid as running every step
+    Stop         // return right away, with the grid at the generation where the cycle was confirmed
+};
+
+// Outcome of the last Run with cycle detection. Generations are counted from the grid Run started with.
+struct CycleInfo
+{
+    bool detected;         // the grid repeated a state within the history window
+    long long transient;   // generations before the grid entered the cycle (-1 when none was detected)
+    long long period;      // length of the cycle, 1 for a fixed point (-1 when none was detected)
+    long long generations; // generations the grid was advanced: the steps asked for, or fewer after Stop
+    long long computed;    // generations actually computed (fast-forwarding skips whole periods)
+
+    CycleInfo() : detected(false), transient(-1), period(-1), generations(0), computed(0) {}
+};
+
+class RuleTable;  // lookup-table rule, declared in RuleTable.h
+class ThreadPool; // persistent worker threads, declared in ThreadPool.h
+class Hashlife;   // memoized quadtree engine, declared in Hashlife.h
+struct NeuronModel; // stochastic neuron rule, declared in NeuronModel.h
+class ConvolutionKernel; // weighted neighborhood of any radius, declared in Convolution.h
+class KernelConvolution; // direct / FFT potential computation, declared in Convolution.h
+enum class ConvolutionMethod; // declared in Convolution.h
+
 // The core of the CA library: the CellularAutomata class.
 // CellularAutomata class declaration
 class CellularAutomata
@@ -46,27 +84,37 @@ public:
     static const int ACTIVE_3 = 3;
 
     // Type aliases for 1D and 2D grids
+    // The 2D grid is a single contiguous row-major buffer (see FlatGrid.h); grid[i][j] and
+    // range-for over rows work the same way they did with the old vector of vectors.
     using Grid1D = std::vector<int>;
-    using Grid2D = std::vector<std::vector<int>>;
+    using Grid2D = FlatGrid2D;
+    using Grid3D = FlatGrid3D; // layers x rows x cols, see FlatGrid.h
 
     // Now declare the UpdateGrid2D method
+    // The cells are copied into the existing front buffer, so no reallocation happens when the shapes match.
     void UpdateGrid2D(const Grid2D& new_grid) {
         if (dimension_ != GridDimension::TwoD)
             throw std::runtime_error("UpdateGrid2D called on a non-2D automaton");
-        grid_2d_ = new_grid;
+        if (new_grid.rows() != grid_2d_.rows() || new_grid.cols() != grid_2d_.cols())
+            throw std::invalid_argument("UpdateGrid2D called with a grid of a different shape");
+        grid_2d_.assign(new_grid);
+        active_all_dirty_ = true;
     }
 
-    // For possible improvements maybe implement a sparse matrix instead of vector of vector for larger operations
+    // NoBoundary grids are still dense rows x cols rectangles; for an unbounded plane whose memory follows the
+    // live region use SparseGrid2D (SparseGrid.h) instead.
 
     // These are rule function types that take in the current state and the number of neighbors and return the new state.
     // they represent the rules that will be used to update the state of a cell based on its current state and the number of neighbors.
     using RuleFunction1D = std::function<int(int, int)>;
     using RuleFunction2D = std::function<int(int, int)>;
+    using RuleFunction3D = std::function<int(int, int)>;
 
     // These are function types that take in a reference to the grid and initialize it.
     // by initilization the grid they set up the initial state of the CA.
     using InitializationFunction1D = std::function<void(Grid1D &)>; // defined as a function pointer (std::function).
     using InitializationFunction2D = std::function<void(Grid2D &)>;
+    using InitializationFunction3D = std::function<void(Grid3D &)>;
 
     // Declaration of the member function to retrieve the 2D grid state, this function will be used by the application
     // to retrieve the current state of the CA for nueron simulation.
@@ -75,7 +123,12 @@ public:
     // Constructor for the CellularAutomata class.
     // It takes in the size of the grid, the grid dimension, the boundary condition, and the neighborhood types and
     // initializes the member variables accordingly and generate an instance of the class CA.
+    // In 1D the grid has size cells, in 2D it is a size x size square and in 3D a size x size x size cube.
     CellularAutomata(int size, GridDimension dimension, BoundaryCondition bc, NeighborhoodType nt);
+    // Rectangular 2D grid of rows x cols cells (for example long thin strips), stepped by the same engine.
+    CellularAutomata(int rows, int cols, BoundaryCondition bc, NeighborhoodType nt);
+    // 3D grid of layers x rows x cols cells.
+    CellularAutomata(int layers, int rows, int cols, BoundaryCondition bc, NeighborhoodType nt);
 
     // Member functions for the CellularAutomata class.
     static int MajorityRule(int activeNeighbors);
@@ -84,23 +137,220 @@ public:
     // These member functions are used to initialize the grid (1D/2D).
     void Initialize1D(const InitializationFunction1D &init_func);
     void Initialize2D(const InitializationFunction2D &init_func);
+    void Initialize3D(const InitializationFunction3D &init_func);
     // These member functions are used to apply the rules to the grid (1D/2D) to update the state of the CA.
     void ApplyRule1D(const RuleFunction1D &rule_func);
     void ApplyRule2D(const RuleFunction2D &rule_func);
+    // 3D: the neighbor sum covers 26 (Moore) or 6 (VonNeumann) cells; the boundary conditions behave as in 2D
+    // (wrapped copies for Periodic, zeros beyond the faces for Fixed and NoBoundary).
+    void ApplyRule3D(const RuleFunction3D &rule_func);
+    // Same with a table built for RuleTable::NeighborCount3D(nt) neighbors; states outside of the table throw
+    // std::out_of_range and leave the grid untouched.
+    void ApplyRule3D(const RuleTable &table);
+
+    // Compile-time specialized stepping (defined in StepEngine.h).
+    // Step<BC, NT>(rule) advances the 2D grid one generation with the boundary condition, neighborhood and
+    // rule all known to the compiler, so the neighbor loop is unrolled and the rule is inlined.
+    // BC and NT must match the configuration given to the constructor.
+    // Step(rule) chooses the instantiation from the runtime configuration once per generation, and also steps
+    // 3D automata.
+    template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+    void Step(Rule &&rule);
+    template <typename Rule>
+    void Step(Rule &&rule);
+
+    // Stochastic stepping (defined in StepEngine.h).
+    // StepStochastic(seed, step, rule) advances the 2D grid one generation with a rule that also receives the
+    // random stream of the cell: rule(neighbor sum, current state, CellRandom &random) (see CounterRng.h).
+    // The stream is a function of (seed, step, row * cols + col) only, so the result does not depend on the
+    // thread count or the order of the cells, and the same seed and step always give the same generation.
+    // Pass the step number (for example the loop counter) so every generation draws fresh numbers.
+    // Sparse activity mode is bypassed: a stochastic rule can change cells whose neighborhood did not change.
+    template <typename Rule>
+    void StepStochastic(std::uint64_t seed, std::uint64_t step, Rule &&rule);
+
+    // Neighbor histogram stepping (defined in StepEngine.h, see NeighborCounts.h).
+    // StepCounts(rule) advances the 2D grid one generation with rule(const NeighborCounts &counts, int state):
+    // counts[s] is the number of neighbors in state s and counts.Active() the number in any state but 0, the
+    // inputs multi-state rules usually want instead of the neighbor sum. The histograms of a row are computed
+    // in one vectorized pass (AVX2, selected by SetSimdLevel). Periodic grids wrap; beyond the edges of a Fixed
+    // grid the cells count as state 0 and beyond those of a NoBoundary grid they do not count at all (so
+    // counts.Total() is smaller there). States must lie in 0 .. NeighborCounts::MAX_STATES - 1: otherwise
+    // std::out_of_range is thrown and the grid is left untouched. StepCounts(seed, step, rule) is the stochastic
+    // variant, rule(counts, state, CellRandom &random), with the random streams of StepStochastic.
+    template <typename Rule>
+    void StepCounts(Rule &&rule);
+    template <typename Rule>
+    void StepCounts(std::uint64_t seed, std::uint64_t step, Rule &&rule);
+
+    // Advances the 2D grid one generation of the neuron model (see NeuronModel.h) with the random streams of
+    // (seed, step), exactly like StepCounts(seed, step, NeuronRule(model, step)) but with a dedicated
+    // kernel that draws the random numbers and applies the transitions eight cells at a time (AVX2, selected by
+    // SetSimdLevel). Row bands are spread across the thread pool; the result is the same for every thread count
+    // and instruction set. Throws std::invalid_argument for an invalid model.
+    void StepNeuron(const NeuronModel &model, std::uint64_t seed, std::uint64_t step);
+
+    // Weighted neighborhoods (see Convolution.h; StepKernel is defined in StepEngine.h).
+    // StepKernel(kernel, rule) advances the 2D grid one generation with the potential of every cell, the
+    // kernel-weighted sum of the states within the kernel radius, in place of the neighbor sum:
+    // rule(double potential, int current state) -> new state, for example a LeniaRule. The boundary condition
+    // applies as in the other steps; the neighborhood type given to the constructor is not used. Small kernels
+    // are summed directly and large ones convolved with an FFT, whichever is estimated to be cheaper (see
+    // SetConvolutionMethod), with the work spread across the thread pool. Throws std::runtime_error on
+    // automata that are not 2D.
+    template <typename Rule>
+    void StepKernel(const ConvolutionKernel &kernel, Rule &&rule);
+    // The potentials StepKernel hands to the rule for the current grid, rows x cols values row by row.
+    void ComputePotential(const ConvolutionKernel &kernel, std::vector<double> &potential);
+    // Forces the direct or the FFT path for StepKernel and ComputePotential (ConvolutionMethod::Auto by default).
+    void SetConvolutionMethod(ConvolutionMethod method);
+    ConvolutionMethod GetConvolutionMethod() const { return convolution_method_; }
+
+    // Temporal blocking (defined in StepEngine.h).
+    // Run(steps, rule) advances the 2D grid `steps` generations and leaves exactly the grid that `steps` calls
+    // of ApplyRule2D(rule) would. Instead of streaming the whole grid through memory once per generation, the
+    // grid is cut into tiles and each tile is advanced several generations while it sits in the L2 cache.
+    // Every tile is loaded with a margin of one extra cell per generation, so tiles never need each other's
+    // intermediate states (the margins are recomputed redundantly). Use it for long runs where only the final
+    // state, or every n-th state, is needed. rule can be a function, lambda or functor like in Step, or a
+    // RuleTable, which is then applied with the vectorized kernels; with a RuleTable a state the table does
+    // not cover throws std::out_of_range and leaves the grid at the last completed block of generations.
+    template <typename Rule>
+    void Run(int steps, Rule &&rule);
 
-    // This is the display function which prints the current state of the CA to the standard output/terminal
+    // Tile shape (in cells) and number of generations per tile pass used by Run. Wide tiles keep the inner
+    // loops long; larger depths save more memory traffic but recompute wider margins. depth 1 turns tiling off.
+    void SetTemporalBlocking(int tile_rows, int tile_cols, int depth);
+    int GetTemporalTileRows() const { return temporal_tile_rows_; }
+    int GetTemporalTileCols() const { return temporal_tile_cols_; }
+    int GetTemporalDepth() const { return temporal_depth_; }
+
+    // Cycle detection for Run. Many runs settle into a fixed point or a short cycle after a few dozen generations
+    // and would then recompute the same states until the end. With detection on, Run advances one generation at a
+    // time (no temporal blocking) and keeps a 64-bit hash of the grid, the sum over the cells of the state times a
+    // random key per cell, which is updated from the differences to the previous generation (unchanged cells add
+    // nothing). The hashes of the last `history` generations are kept; when the hash of the new grid matches one of
+    // them, the grid is copied and compared cell by cell one period later, so a hash collision never stops a run.
+    // Once the cycle is confirmed Run applies `action`. GetCycleInfo() reports the transient length, the period and
+    // how many generations were computed. Cycles longer than `history` generations are not detected.
+    // The rule must be a pure function of (neighbor sum, state): FastForward skips generations and Stop returns
+    // early on the assumption that a repeated grid repeats its future, which a rule with mutable state of its own
+    // (a counter, a random generator) breaks.
+    // Without active region tracking the hash update is one more pass over both buffers per generation, so a grid
+    // that never settles runs about half as fast as without detection; with tracking (SetActiveRegionTracking) only
+    // the tiles the step changed are read. Throws std::invalid_argument for a history below 1.
+    void SetCycleDetection(bool enabled, int history = DEFAULT_CYCLE_HISTORY, CycleAction action = CycleAction::FastForward);
+    bool GetCycleDetection() const { return cycle_detection_; }
+    const CycleInfo &GetCycleInfo() const { return cycle_info_; }
+
+    // Advances the 2D grid `steps` generations with the Hashlife engine (see Hashlife.h), which memoizes the
+    // evolution of every distinct block of cells and jumps 2^k generations at a time. Meant for runs of
+    // millions of generations with binary rules: the grid must be Periodic with a power-of-two size, hold only
+    // states 0 and 1, and the table must be a two-state table with outputs 0 or 1. Throws
+    // std::invalid_argument otherwise. The engine and its memoized results are kept between calls with the
+    // same table, so advancing in chunks (to take snapshots) stays cheap.
+    void RunHashlife(long long steps, const RuleTable &table);
+
+    // Sparse activity mode for ApplyRule2D and Step.
+    // The grid is divided into tile x tile blocks and only "dirty" tiles, the ones in which a cell changed in
+    // the previous step or that touch such a tile, are recomputed. A tile whose cells and neighbors did not
+    // change would produce exactly the same cells again, so skipping it gives the same grid as a full sweep.
+    // When more than half of the tiles are dirty the whole grid is swept at once instead.
+    // The tracking assumes the same rule is applied every step: call MarkAllActive() after switching rules.
+    void SetActiveRegionTracking(bool enabled, int tile = DEFAULT_ACTIVE_TILE);
+    bool GetActiveRegionTracking() const { return active_tracking_; }
+    void MarkAllActive() { active_all_dirty_ = true; }
+    // Tiles recomputed by the last step taken in sparse activity mode, out of GetActiveTileCount().
+    long long GetTilesProcessed() const { return tiles_processed_; }
+    long long GetActiveTileCount() const;
+
+    // Applies a tabulated rule (see RuleTable.h) to the 2D grid with the vectorized kernels in SimdKernels.h.
+    // Produces exactly the same grid as ApplyRule2D with the function the table was built from.
+    // Throws std::out_of_range (and leaves the grid untouched) if a cell holds a state outside of the table.
+    void ApplyRule2D(const RuleTable &table);
+
+    // Applies a tabulated rule to the 1D grid (for example RuleTable::Majority1D() or a table read with
+    // RuleTable::FromString(text, RuleTable::NEIGHBOR_COUNT_1D)). Same result as ApplyRule1D with the function
+    // the table was built from; throws std::out_of_range (grid untouched) for states outside of the table.
+    void ApplyRule1D(const RuleTable &table);
+
+    // Chooses the instruction set used by the table-driven kernels. Levels the CPU does not support are
+    // lowered to the best supported one; SimdLevel::Scalar forces the portable path.
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetSimdLevel() const { return simd_level_; }
+
+    // Number of threads used by ApplyRule1D, ApplyRule2D and Step. The grid is split into contiguous row bands
+    // (index ranges in 1D), one per thread, processed by a thread pool that lives as long as the automaton.
+    // 1 (the default) keeps everything on the calling thread and 0 means one thread per hardware thread.
+    // The results are identical for every thread count, but rule functions are then called from several
+    // threads at once and must not modify shared state. Small grids are always stepped serially.
+    void SetThreadCount(int threads);
+    int GetThreadCount() const;
+
+    // Instrumentation (see StepStats.h).
+    // With instrumentation enabled every stepping call (ApplyRule1D/2D/3D, Step, StepStochastic, StepCounts,
+    // StepNeuron, StepKernel, Run, RunHashlife) records where its wall time went and, with count_cells, how many
+    // cells changed, the population of active cells and the histogram of states, so applications do not have to
+    // scan the grid themselves after every step. The record of the last call is available from GetStepStats()
+    // and is passed to the step callback, if one is set, right after the call. Disabled (the default), the
+    // stepping engines only test one flag per call. Counting costs one extra pass over the grid per call
+    // (count_seconds shows how much); timing alone adds a few clock reads.
+    void SetInstrumentation(bool enabled, bool count_cells = true);
+    bool GetInstrumentation() const { return instrumented_; }
+    void SetStepCallback(const std::function<void(const StepStats &)> &callback) { step_callback_ = callback; }
+    const StepStats &GetStepStats() const { return step_stats_; }
+    const StepStats &GetTotalStats() const { return total_stats_; }
+    // Clears the last record and the totals.
+    void ResetStats();
+    // Adds time spent writing this automaton out to the io_seconds of the next record. Print and the trajectory
+    // writers report their own time; applications can add other output (ignored while disabled).
+    void AddIOTime(double seconds) const;
+    // IOTimer - charges the time from its construction to its destruction to AddIOTime of `ca`; output
+    // functions put one at their top. Reads no clock while instrumentation is off.
+    class IOTimer
+    {
+    public:
+        explicit IOTimer(const CellularAutomata &ca)
+            : ca_(ca), timed_(ca.instrumented_),
+              start_(timed_ ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+        {
+        }
+        ~IOTimer()
+        {
+            if (timed_)
+                ca_.AddIOTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count());
+        }
+        IOTimer(const IOTimer &) = delete;
+        IOTimer &operator=(const IOTimer &) = delete;
+
+    private:
+        const CellularAutomata &ca_;
+        bool timed_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // Text form of the current state: every cell followed by a space, one line per row, and in 3D an empty line
+    // after every layer (the layout Utils/Data/testgraphing.py reads). Rows are formatted in bulk into a buffer,
+    // so even grids of millions of cells take milliseconds. Print() returns the text; Print(out) writes it to
+    // `out` in large blocks without building the whole string (use std::cout << ca.Print() for the terminal).
     std::string Print() const;
+    void Print(std::ostream &out) const;
 
     // Public method to calculate the number of active neighbors for a 1D cell
     int GetNeighbors1D(int index) const {
         return CalculateNeighbors1D(index);
     }
 
-    // Public method to calculate the number of active neighbors for a 2D cell
+    // Public method to calculate the neighbor sum (the sum of the neighbor states) for a 2D cell; it is the
+    // number of active neighbors only when the states are 0 and 1 (see GetNeighborCounts2D otherwise).
     int GetNeighbors2D(int i, int j) const {
         return CalculateNeighbors2D(i, j);
     }
 
+    // Histogram of the neighbor states of a 2D cell, as StepCounts hands it to the rule (computed cell by cell
+    // with explicit boundary checks, for tests and for single cells).
+    NeighborCounts GetNeighborCounts2D(int i, int j) const;
+
 
     // Method to get the internal state (grid) of the CellularAutomata
     const Grid2D& GetGrid2D() const{
@@ -111,6 +361,7 @@ public:
         return grid_1d_;
     }
 
+    // number of cells in 1D, number of rows in 2D and 3D (the side length for squares and cubes)
     int getSize() const{
         return size_;
     }
@@ -119,9 +370,31 @@ public:
         return CalculateNeighbors2D(i , j);
     }
 
+    // Public method to calculate the neighbor sum of a 3D cell (layer k, row i, column j)
+    int GetNeighbors3D(int k, int i, int j) const {
+        return CalculateNeighbors3D(k, i, j);
+    }
+
+    const Grid3D& GetGrid3D() const{
+        return grid_3d_;
+    }
+
+    // Configuration given to the constructor.
+    GridDimension GetDimension() const { return dimension_; }
+    BoundaryCondition GetBoundaryCondition() const { return boundary_condition_; }
+    NeighborhoodType GetNeighborhoodType() const { return neighborhood_type_; }
+
+    // Shape of the grid: a 1D grid is one row of getCols() cells, a 2D grid has one layer.
+    int getRows() const { return rows_; }
+    int getCols() const { return cols_; }
+    int getLayers() const { return layers_; }
+
 private: // private members of the CellularAutomata class that will not be accesible outside of the class.
     // represent the size of the grid in 1D it is number of cells and in 2D it is number of rows and columns.
     int size_;
+    int rows_;   // rows of the 2D/3D grid (1 in 1D)
+    int cols_;   // columns of the 2D/3D grid (number of cells in 1D)
+    int layers_; // layers of the 3D grid (1 in 1D and 2D)
     // A variable that stores the dimensionality of the grid (1D/2D) as defined by the enum class GridDimension.
     GridDimension dimension_;
     // The variable that holds the type of boundary condition as defined by the enum class BoundaryCondition.
@@ -130,10 +403,14 @@ private: // private members of the CellularAutomata class that will not be acces
     NeighborhoodType neighborhood_type_;
     // The data structures that store the current state of the CA in the grid
     Grid1D grid_1d_; // standard vector (AKA dynamic array) that contains 1D state of the CA
-    Grid2D grid_2d_; // A vector of vectors from the standard library that contains 2D state of the CA
+    Grid1D next_grid_1d_; // back buffer for ApplyRule1D, swapped with grid_1d_ after every step
+    Grid2D grid_2d_; // front buffer: contiguous row-major grid that contains the current 2D state of the CA
+    Grid2D next_grid_2d_; // back buffer: ApplyRule2D writes the next generation here, then the two are swapped
+    Grid3D grid_3d_;      // front buffer of the 3D state, with a one-cell halo like grid_2d_
+    Grid3D next_grid_3d_; // back buffer of the 3D state
 
     // vectors are used to store the state of the CA because they automatically resize and dynamically manage
-    // own memory. The also handle their own resizing.
+    // own memory. The two 2D buffers are allocated once in the constructor and only exchange pointers afterwards.
 
     // These are private member functions that are used to calculate the number of neighbors for a given cell
     // CalculateNeighbors1D(int index) const - calculate the number of active neighbors around a given 1D grid
@@ -143,6 +420,194 @@ private: // private members of the CellularAutomata class that will not be acces
 
     // CalculateNeighbors2D(int i, int j) const - calculate the number of active neighbors around a given 2D grid
     int CalculateNeighbors2D(int i, int j) const;
+
+    // CalculateNeighbors3D(int k, int i, int j) const - reference neighbor sum of a 3D cell with explicit boundary checks
+    int CalculateNeighbors3D(int k, int i, int j) const;
+
+    // Appends the text of the grid to `text`; with `out` set, text is written out and cleared whenever it grows
+    // past a block, which bounds the memory used by Print(out).
+    void FormatText(std::string &text, std::ostream *out) const;
+
+    // Every public constructor ends up here with the full shape of the grid.
+    CellularAutomata(GridDimension dimension, int layers, int rows, int cols, BoundaryCondition bc, NeighborhoodType nt);
+
+    // Pointer to the StepRuleFunction instantiation matching boundary_condition_ and neighborhood_type_.
+    // It is chosen once in the constructor so ApplyRule2D never has to switch on the configuration.
+    using StepFunction2D = void (CellularAutomata::*)(const RuleFunction2D &);
+    StepFunction2D step_2d_;
+
+    // Instruction set used by ApplyRule2D(const RuleTable &), detected at construction.
+    SimdLevel simd_level_;
+
+    // Fills the halo of the front 2D buffer for boundary_condition_ (see StepEngine.h).
+    void FillHalo2D();
+    // The same for neighbor histograms: NoBoundary halo cells are -1, which counts in no state.
+    void FillCountHalo2D();
+
+    // Worker threads (null while stepping serially). A copy of the automaton starts its own pool of the same
+    // size the first time it steps in parallel, so copies never queue behind each other.
+    std::shared_ptr<ThreadPool> pool_;
+
+    // Hashlife engine used by RunHashlife (null until the first call). Like the convolution engine, a copy
+    // makes its own engine on first use instead of advancing a shared quadtree from two threads.
+    std::shared_ptr<Hashlife> hashlife_;
+
+    // Convolution engine of StepKernel (null until the first call; a copy of the automaton makes its own on
+    // first use, so copies can step in parallel), the method it uses and the buffer of potentials.
+    std::shared_ptr<KernelConvolution> convolution_;
+    ConvolutionMethod convolution_method_;
+    std::vector<double> potential_;
+
+    // Grids with fewer cells than this are not worth splitting across threads.
+    static const long long PARALLEL_MIN_CELLS = 16384;
+
+    // Calls body(begin, end) over [0, rows) split into bands across the thread pool, or once on the calling
+    // thread for small grids or when no pool is set up. cols is only used to estimate the amount of work.
+    void RunRowBands(int rows, int cols, const std::function<void(int, int)> &body);
+
+    // Tiling used by Run (see SetTemporalBlocking). The default tile plus its margins, in both buffers,
+    // takes about 340 KB, which fits the L2 cache of current CPUs.
+    static const int DEFAULT_TEMPORAL_TILE_ROWS = 64;
+    static const int DEFAULT_TEMPORAL_TILE_COLS = 512;
+    static const int DEFAULT_TEMPORAL_DEPTH = 8;
+    int temporal_tile_rows_;
+    int temporal_tile_cols_;
+    int temporal_depth_;
+
+    // Sparse activity mode (see SetActiveRegionTracking).
+    static const int DEFAULT_ACTIVE_TILE = 32;
+    bool active_tracking_;
+    int active_tile_;
+    bool active_all_dirty_;                    // every tile must be recomputed (grid changed from outside, rule switch)
+    std::vector<unsigned char> active_tiles_;  // 1 for the tiles the next step recomputes
+    std::vector<unsigned char> changed_tiles_; // 1 for the tiles whose cells changed in the last step
+    long long tiles_processed_;
+
+    // Cycle detection state (see SetCycleDetection). The hash ring holds the hash of generation g at
+    // g % cycle_history_; a candidate period found in the ring is confirmed against cycle_grid_.
+    static const int DEFAULT_CYCLE_HISTORY = 256;
+    bool cycle_detection_;
+    int cycle_history_;
+    CycleAction cycle_action_;
+    CycleInfo cycle_info_;
+    std::uint64_t grid_hash_;              // hash of grid_2d_
+    std::vector<std::uint64_t> cycle_hashes_;
+    std::vector<std::uint64_t> cycle_column_keys_; // hash key of every column
+    Grid2D cycle_grid_;                    // the grid at cycle_candidate_, for the exact comparison
+    long long cycle_candidate_;            // generation at which a repeated hash was seen (-1 when none)
+    long long cycle_candidate_period_;
+
+    // Run with cycle detection: the number of generations the grid was advanced.
+    template <typename Rule>
+    long long RunDetectingCycles(int steps, Rule &rule);
+    // Hash of the whole 2D grid, and the update of grid_hash_ from the cells that differ between the new
+    // front buffer and the old one (the back buffer after the swap).
+    std::uint64_t HashGrid2D();
+    void UpdateGridHash2D();
+    // Starts a search from the current grid (generation 0), and records generation `generation` after a
+    // step; true once a cycle is confirmed (cycle_info_ then holds its transient and period).
+    void BeginCycleSearch();
+    bool RecordCycleGeneration(long long generation);
+
+    // Instrumentation state (see SetInstrumentation). step_open_ is set while an instrumented stepping call
+    // is running; nested public calls (ApplyRule3D calling Step, Run stepping with ApplyRule2D) join the
+    // record of the outermost call.
+    using StepClock = std::chrono::steady_clock;
+    bool instrumented_;
+    bool count_cells_;
+    bool step_open_;
+    StepClock::time_point step_start_;
+    StepClock::time_point phase_start_;
+    StepStats step_stats_;
+    StepStats total_stats_;
+    mutable double pending_io_seconds_;
+    std::function<void(const StepStats &)> step_callback_;
+
+    // Scope of one stepping call: opens the record when instrumentation is on and no call is open yet, and
+    // closes it in Finish(generations). A call that throws leaves no record.
+    class StepScope
+    {
+    public:
+        explicit StepScope(CellularAutomata &ca) : ca_(ca), open_(ca.instrumented_ && !ca.step_open_)
+        {
+            if (open_)
+                ca_.OpenStepStats();
+        }
+        ~StepScope()
+        {
+            if (open_)
+                ca_.step_open_ = false;
+        }
+        // previous_kept: the back buffer holds the generation before the last one (false for engines such as
+        // Hashlife that write the grid directly), so a single step can count its changed cells against it.
+        void Finish(long long generations, bool previous_kept = true)
+        {
+            if (open_)
+                ca_.CloseStepStats(generations, previous_kept);
+            open_ = false;
+        }
+
+    private:
+        CellularAutomata &ca_;
+        bool open_;
+    };
+
+    // Ends the current phase of an open record and adds its time to the field (no-op otherwise).
+    void EndPhase(double StepStats::*phase)
+    {
+        if (step_open_)
+            RecordPhase(phase);
+    }
+    // Ends a sweep that interleaved neighbor passes and rule evaluation and splits its wall time in the ratio
+    // of the per-row times measured inside it.
+    void EndSplitPhase(long long neighbor_nanoseconds, long long rule_nanoseconds);
+    void OpenStepStats();
+    void RecordPhase(double StepStats::*phase);
+    void CloseStepStats(long long generations, bool previous_kept);
+    // Fills the counters of step_stats_ from the front buffer (and the back buffer, for cells_changed).
+    void CountCells(bool compare_previous);
+
+    // Selects step_2d_ from the runtime boundary condition and neighborhood type.
+    static StepFunction2D SelectStepFunction2D(BoundaryCondition bc, NeighborhoodType nt);
+
+    // Templated stepping helpers (defined in StepEngine.h).
+    template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+    void StepUnchecked(Rule &rule);
+    template <BoundaryCondition BC, NeighborhoodType NT>
+    void StepRuleFunction(const RuleFunction2D &rule_func);
+    template <bool Stochastic, typename Rule>
+    void StepCountsUnchecked(std::uint64_t seed, std::uint64_t step, Rule &rule);
+    template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+    void StepStochasticUnchecked(std::uint64_t seed, std::uint64_t step, Rule &rule);
+    template <typename Rule>
+    void RunRule(int steps, Rule &rule, std::false_type is_table);
+    void RunRule(int steps, const RuleTable &table, std::true_type is_table);
+    template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+    void RunUnchecked(int steps, Rule &rule);
+    template <BoundaryCondition BC, typename Sweep>
+    bool RunTemporalBlock(int depth, Sweep &sweep);
+    template <typename Sweep>
+    bool StepActiveTiles(Sweep &sweep);
+    template <typename Rule>
+    void Sweep3D(Rule &rule);
+    template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+    void Sweep3DUnchecked(Rule &rule);
+    // Marks the tiles the next sparse step has to recompute: the changed tiles and their eight neighbors.
+    void UpdateActiveTiles(int tile_rows, int tile_cols);
 };
 
+// Rule functions provided by the library (defined in src/cellular_automata.cpp).
+// Each takes the neighbor count first and the current state (or neighbor average) second.
+int majorityRule2D(int neighbors, double avg, int i, int j, int gridSize);
+int totalisticRule(int neighbors, double avg);
+int parityRule(int neighbors, int currentState);
+int totalisticRule_1D(int neighbors, int currentState);
+int majorityRule_1D(int neighbors, int currentState);
+
+// The definitions of RuleTable and of the member templates above live in their own headers.
+#include "RuleTable.h"
+#include "StepEngine.h"
+#include "NeuronModel.h"
+#include "Convolution.h"
+
 #endif // CELL_AUT_H - marks the end of the header guard conditional
@@ -0,0 +1,160 @@
+// Include/Checkpoint.h
+#pragma once         // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef CHECKPOINT_H // Include guard (if CHECKPOINT_H not included yet define it and continue)
+#define CHECKPOINT_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BinaryFile.h"
+#include "CellularAutomata.h"
+
+// Checkpoint files: everything needed to resume a run exactly where it stopped, so a preempted job restarts
+// from its last checkpoint instead of from generation 0.
+//
+// The automaton itself keeps no step counter and no random generator: the stochastic steps (StepStochastic,
+// StepCounts, StepNeuron) draw from CellRandom(seed, step, cell), a counter-based stream, so the seed and the
+// number of the next step are the whole random state. A checkpoint therefore stores the grid and its
+// configuration next to a CheckpointState the caller fills in: the step counter, the seed, the rule table
+// (when the run uses one) and any bytes of its own (for example a std::mt19937 written with operator<<).
+// Stepping a restored automaton with the restored state gives the same grids, bit for bit, as the run that
+// wrote the checkpoint would have.
+//
+// Layout (values in the byte order of the machine that wrote the file, checked by a byte-order mark):
+//   header   "CACKPT01", byte-order mark 0x01020304, version, header size, dimension, boundary condition,
+//            neighborhood type, layers, rows, cols, rule states, rule maximum sum, extra length, step, seed,
+//            cell bytes, checksum; then the rule table entries (32-bit ints, row-major by state) and the extra
+//            bytes; padded to a multiple of 64 bytes
+//   cells    the grid as 32-bit ints in row-major order (layer by layer in 3D)
+// The checksum covers the header (with the checksum field taken as zero) and the cells.
+// The cells start on a 64-byte boundary of the file, so a reader maps the file and copies the grid straight
+// out of the mapping. Files are written under a temporary name and renamed over the previous checkpoint once
+// complete, so a job killed while writing still leaves the previous checkpoint intact.
+
+// What the caller needs to continue a run, stored next to the grid.
+struct CheckpointState
+{
+    std::uint64_t step; // number of the next step (generations completed so far)
+    std::uint64_t seed; // CellRandom seed of the stochastic steps
+    RuleTable rule;     // the run's rule table; empty (numStates() == 0) for runs stepped with rule functions
+    std::string extra;  // free bytes for the application, stored as they are
+
+    CheckpointState() : step(0), seed(0) {}
+};
+
+// Writes a checkpoint of `ca` and `state` to path (through path + ".tmp" and a rename) before returning.
+// Errors throw std::runtime_error; the previous file at path is then left as it was.
+void WriteCheckpoint(const std::string &path, const CellularAutomata &ca, const CheckpointState &state);
+
+// CheckpointWriter - writes checkpoints from a background thread, so a checkpoint costs the stepping thread
+// one copy of the grid instead of the checksum and the disk writes.
+// Save copies the grid into a snapshot buffer and returns; the writer thread writes the snapshot to path. When
+// the previous snapshot has not been picked up yet (the disk is slower than the checkpoint interval) it is
+// replaced by the newer one, so Save never waits for the disk and only the latest state is kept. An error on
+// the writer thread stops the writing and is rethrown by the next Save, Wait or Close.
+// Meant to be fed by one thread.
+class CheckpointWriter
+{
+public:
+    explicit CheckpointWriter(const std::string &path);
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter &) = delete;
+    CheckpointWriter &operator=(const CheckpointWriter &) = delete;
+
+    const std::string &path() const { return path_; }
+
+    // Snapshot of the current grid of `ca` and of `state`, written in the background.
+    void Save(const CellularAutomata &ca, const CheckpointState &state);
+
+    // Checkpoints written to disk so far, and snapshots replaced by a newer one before they were written.
+    long long WrittenCount() const;
+    long long SkippedCount() const;
+
+    // Waits until the last snapshot handed to Save is on disk.
+    void Wait();
+    // Writes the last snapshot and stops the writer thread.
+    void Close();
+
+    // Everything about the automaton that goes into a checkpoint (shared with WriteCheckpoint).
+    struct Snapshot
+    {
+        GridDimension dimension;
+        BoundaryCondition boundary;
+        NeighborhoodType neighborhood;
+        int layers, rows, cols;
+        CheckpointState state;
+        std::vector<int> cells; // row-major, layer by layer in 3D
+
+        void Capture(const CellularAutomata &ca, const CheckpointState &run_state);
+        void Write(const std::string &path) const;
+    };
+
+private:
+    std::string path_;
+    Snapshot pending_;                // filled by Save, taken by the writer thread
+    Snapshot writing_;                // used by the writer thread only
+    bool has_pending_;
+    bool busy_;                       // the writer thread is writing writing_
+    bool stopping_;
+    bool closed_;
+    std::exception_ptr error_;        // first error of the writer thread
+    long long written_;
+    long long skipped_;
+    mutable std::mutex mutex_;        // protects every field above except writing_
+    std::condition_variable work_;    // signals the writer thread: a snapshot is pending or Close was called
+    std::condition_variable idle_;    // signals Wait: a snapshot was written
+    std::thread thread_;
+
+    void WriterLoop();
+};
+
+// CheckpointReader - maps a checkpoint file into memory (on POSIX systems; elsewhere it is read once) and
+// restores automata from it. The header, the size and the checksum of the file are checked when the file is
+// opened; files that are not complete checkpoints throw std::runtime_error.
+class CheckpointReader
+{
+public:
+    explicit CheckpointReader(const std::string &path);
+
+    CheckpointReader(const CheckpointReader &) = delete;
+    CheckpointReader &operator=(const CheckpointReader &) = delete;
+
+    GridDimension GetDimension() const { return dimension_; }
+    BoundaryCondition GetBoundaryCondition() const { return boundary_; }
+    NeighborhoodType GetNeighborhoodType() const { return neighborhood_; }
+    int getLayers() const { return layers_; }
+    int getRows() const { return rows_; }
+    int getCols() const { return cols_; }
+    const CheckpointState &state() const { return state_; }
+
+    // The cells in row-major order, inside the mapping (valid while the reader lives).
+    const int *cells() const { return cells_; }
+    long long CellCount() const { return static_cast<long long>(layers_) * rows_ * cols_; }
+
+    // Copies the grid into `ca`, which must have the dimension, shape, boundary condition and neighborhood
+    // type of the checkpoint (std::invalid_argument otherwise).
+    void Restore(CellularAutomata &ca) const;
+    // A new automaton with the configuration and grid of the checkpoint.
+    CellularAutomata CreateAutomaton() const;
+
+private:
+    GridDimension dimension_;
+    BoundaryCondition boundary_;
+    NeighborhoodType neighborhood_;
+    int layers_, rows_, cols_;
+    CheckpointState state_;
+    ca_detail::MappedFile file_;
+    const unsigned char *data_;       // the whole file (file_.data())
+    std::size_t size_;
+    const int *cells_;
+
+    void Decode();
+};
+
+#endif // CHECKPOINT_H - marks the end of the header guard conditional
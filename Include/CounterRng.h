@@ -0,0 +1,99 @@
+// Include/CounterRng.h
+#pragma once        // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef COUNTER_RNG_H // Include guard (if COUNTER_RNG_H not included yet define it and continue)
+#define COUNTER_RNG_H
+
+#include <cstdint>
+
+// Counter-based random numbers for stochastic rules.
+// A sequential generator such as std::mt19937 has to be advanced in one fixed order, so a stochastic rule that
+// draws from it while stepping makes the result depend on the traversal order and cannot be split across
+// threads. A counter-based generator is instead a pure function: random bits = f(key, counter). Every cell
+// gets its own counter from (cell index, step), so its draws do not depend on which thread computes it or on
+// the order of the cells, and any run can be reproduced from its seed.
+
+// Philox4x32-10 (Salmon, Moraes, Dror and Shaw, "Parallel random numbers: as easy as 1, 2, 3", SC 2011):
+// ten rounds of 32 x 32 -> 64-bit multiplications mixing a 128-bit counter under a 64-bit key. Passes
+// BigCrush, needs no state, and produces the same output as the Random123 reference implementation.
+struct Philox4x32
+{
+    // Encrypts `counter` (four words) under `key` (two words) in place.
+    static void Generate(std::uint32_t counter[4], const std::uint32_t key[2])
+    {
+        std::uint32_t k0 = key[0], k1 = key[1];
+        for (int round = 0; round < 10; ++round)
+        {
+            const std::uint64_t p0 = static_cast<std::uint64_t>(0xD2511F53u) * counter[0];
+            const std::uint64_t p1 = static_cast<std::uint64_t>(0xCD9E8D57u) * counter[2];
+            const std::uint32_t c1 = counter[1], c3 = counter[3];
+            counter[0] = static_cast<std::uint32_t>(p1 >> 32) ^ c1 ^ k0;
+            counter[1] = static_cast<std::uint32_t>(p1);
+            counter[2] = static_cast<std::uint32_t>(p0 >> 32) ^ c3 ^ k1;
+            counter[3] = static_cast<std::uint32_t>(p0);
+            k0 += 0x9E3779B9u; // key schedule: golden ratio and sqrt(3) - 1 Weyl increments
+            k1 += 0xBB67AE85u;
+        }
+    }
+};
+
+// CellRandom - the random stream of one cell in one step, handed to stochastic rules.
+// Word n of the stream is word n % 4 of Philox4x32(counter = {cell low, cell high, step, n / 4},
+// key = seed), so the stream of (seed, step, cell) is fixed no matter how or where the cell is computed.
+// Blocks are generated on first use, so a cell whose rule draws nothing costs nothing, unless the sweep
+// already computed the first block of a whole row with a vector kernel (ca_detail::PhiloxFirstBlocks).
+// Steps are taken modulo 2^32.
+class CellRandom
+{
+public:
+    CellRandom(std::uint64_t seed, std::uint64_t step, std::uint64_t cell)
+        : seed_lo_(static_cast<std::uint32_t>(seed)), seed_hi_(static_cast<std::uint32_t>(seed >> 32)),
+          cell_lo_(static_cast<std::uint32_t>(cell)), cell_hi_(static_cast<std::uint32_t>(cell >> 32)),
+          step_(static_cast<std::uint32_t>(step)), next_(0), ready_(0)
+    {
+    }
+
+    // Same stream, with block 0 already computed (the four words Philox gives for this seed, step and cell).
+    CellRandom(std::uint64_t seed, std::uint64_t step, std::uint64_t cell, const std::uint32_t first_block[4])
+        : CellRandom(seed, step, cell)
+    {
+        block_[0] = first_block[0];
+        block_[1] = first_block[1];
+        block_[2] = first_block[2];
+        block_[3] = first_block[3];
+        ready_ = 1;
+    }
+
+    // The next 32 random bits of the stream.
+    std::uint32_t Next()
+    {
+        const std::uint32_t block = next_ >> 2;
+        if (ready_ != block + 1)
+        {
+            block_[0] = cell_lo_;
+            block_[1] = cell_hi_;
+            block_[2] = step_;
+            block_[3] = block;
+            const std::uint32_t key[2] = {seed_lo_, seed_hi_};
+            Philox4x32::Generate(block_, key);
+            ready_ = block + 1;
+        }
+        return block_[next_++ & 3u];
+    }
+
+    // Uniform in [0, 1), with 32 bits of resolution.
+    double Uniform() { return Next() * (1.0 / 4294967296.0); }
+
+    // True with probability p (0 never, 1 always).
+    bool Chance(double p) { return Uniform() < p; }
+
+    // Uniform integer in [0, n) for n >= 1, by multiply-and-shift (the bias is below n / 2^32).
+    int Below(int n) { return static_cast<int>((static_cast<std::uint64_t>(Next()) * static_cast<std::uint32_t>(n)) >> 32); }
+
+private:
+    std::uint32_t seed_lo_, seed_hi_, cell_lo_, cell_hi_, step_;
+    std::uint32_t next_;     // index of the next word of the stream
+    std::uint32_t ready_;    // 1 + index of the block held in block_ (0: none yet)
+    std::uint32_t block_[4];
+};
+
+#endif // COUNTER_RNG_H - marks the end of the header guard conditional
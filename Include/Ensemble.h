@@ -0,0 +1,159 @@
+// Include/Ensemble.h
+#pragma once      // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef ENSEMBLE_H // Include guard (if ENSEMBLE_H not included yet define it and continue)
+#define ENSEMBLE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "CellularAutomata.h"
+
+// Ensemble2D - many independent grids of the same shape, stepped together.
+// Parameter sweeps run thousands of small automata (10 x 10 to 64 x 64 neuron grids). As separate
+// CellularAutomata objects every one of them pays the per-step overhead (dispatch, halo fill, thread pool
+// round trip) for a few hundred cells, and the vector kernels never get a full row to work on. An ensemble
+// stores the members in groups of LANES (eight, one AVX2 register of ints) interleaved cell by cell:
+//     cell (i, j) of members 8 g .. 8 g + 7 are eight consecutive ints
+// so one vector load picks up the same cell of eight members, the neighbor sums of eight grids come out of
+// the same additions, and the neuron kernel draws the random numbers of eight members at once, each under
+// its own seed and with its own model parameters. Threads split the (group, row) pairs of all groups into
+// contiguous bands. Every member behaves exactly like a CellularAutomata of its shape with the same boundary
+// condition and neighborhood type: Step(rule) gives the grids ApplyRule2D(rule) would, and StepNeuron the
+// grids of CellularAutomata::StepNeuron with the member's model and seed.
+// The last group is padded with members that stay INACTIVE.
+class Ensemble2D
+{
+public:
+    static const int LANES = 8;
+
+    // init(member, grid) fills the rows x cols grid of one member (all cells start INACTIVE).
+    using InitializationFunction = std::function<void(int member, FlatGrid2D &grid)>;
+
+    // Throws std::invalid_argument for a negative member count or grid shape.
+    Ensemble2D(int members, int rows, int cols, BoundaryCondition bc, NeighborhoodType nt);
+
+    int size() const { return members_; }
+    int getRows() const { return rows_; }
+    int getCols() const { return cols_; }
+    BoundaryCondition GetBoundaryCondition() const { return boundary_condition_; }
+    NeighborhoodType GetNeighborhoodType() const { return neighborhood_type_; }
+
+    // Calls init_func for every member and stores the grids it fills in.
+    void Initialize(const InitializationFunction &init_func);
+    // Copies the grid of one member in or out (the shape must be rows x cols; std::out_of_range for a member
+    // outside of the ensemble, std::invalid_argument for the wrong shape).
+    void SetMember(int member, const FlatGrid2D &grid);
+    FlatGrid2D GetMember(int member) const;
+    int GetCell(int member, int i, int j) const { return cells_[CellIndex(member / LANES, i, j) + member % LANES]; }
+    // Cells of the member in a state other than 0 (INACTIVE).
+    long long Population(int member) const;
+
+    // One generation of every member with rule(neighbor sum, current state), like ApplyRule2D.
+    template <typename Rule>
+    void Step(Rule &&rule);
+    // The same with the member index first, rule(member, neighbor sum, current state), for per-member rule
+    // parameters.
+    template <typename Rule>
+    void StepMembers(Rule &&rule);
+
+    // One generation of the neuron model (see NeuronModel.h). models holds one model per member, or a single
+    // model shared by all of them; seeds holds the CellRandom seed of every member. Member m ends up exactly
+    // where CellularAutomata::StepNeuron(models[m], seeds[m], step) would take its grid. Eight members per
+    // iteration with AVX2 (see SetSimdLevel). Throws std::invalid_argument for the wrong number of models or
+    // seeds, or an invalid model.
+    void StepNeuron(const std::vector<NeuronModel> &models, const std::vector<std::uint64_t> &seeds, std::uint64_t step);
+
+    // Instruction set and thread count, as for CellularAutomata.
+    void SetSimdLevel(SimdLevel level);
+    SimdLevel GetSimdLevel() const { return simd_level_; }
+    void SetThreadCount(int threads);
+    int GetThreadCount() const;
+
+private:
+    int members_;
+    int groups_; // members_ / LANES rounded up
+    int rows_;
+    int cols_;
+    BoundaryCondition boundary_condition_;
+    NeighborhoodType neighborhood_type_;
+    SimdLevel simd_level_;
+
+    // Every group is a (rows + 2) x (cols + 2) block of cells with a one-cell halo, LANES ints per cell.
+    std::ptrdiff_t row_stride_;   // ints from one row of a group to the next
+    std::ptrdiff_t group_stride_; // ints from one group to the next
+    std::vector<int, AlignedAllocator<int>> cells_;      // current generation
+    std::vector<int, AlignedAllocator<int>> next_cells_; // next generation, swapped in after every step
+
+    std::shared_ptr<ThreadPool> pool_; // a copy of the ensemble starts its own pool on first parallel use
+
+    // Ensembles with fewer cells than this are stepped on the calling thread.
+    static const long long PARALLEL_MIN_CELLS = 16384;
+
+    // Index of lane 0 of cell (i, j) of a group; i and j may be -1 or rows / cols (the halo).
+    std::size_t CellIndex(int group, int i, int j) const
+    {
+        return static_cast<std::size_t>(group) * group_stride_ + (i + 1) * row_stride_ + static_cast<std::ptrdiff_t>(j + 1) * LANES;
+    }
+    void CheckMember(int member) const;
+    // Copies the wrapped edges into the halo of every group (Periodic); other halos stay 0.
+    void FillHalo();
+    // Calls body(begin, end) over bands of [0, count), in parallel when the ensemble is large enough.
+    void RunBands(int count, const std::function<void(int, int)> &body);
+};
+
+namespace ca_detail
+{
+    // Neighbor sums of the LANES members at one cell of an ensemble group: mid points at lane 0 of the cell,
+    // row_stride is the distance between rows. Plain loops over the lanes, which the compiler vectorizes.
+    inline void EnsembleNeighborSums(const int *mid, std::ptrdiff_t row_stride, bool moore, int *sums)
+    {
+        const int lanes = Ensemble2D::LANES;
+        const int *up = mid - row_stride;
+        const int *down = mid + row_stride;
+        for (int l = 0; l < lanes; ++l)
+            sums[l] = up[l] + mid[l - lanes] + mid[l + lanes] + down[l];
+        if (moore)
+            for (int l = 0; l < lanes; ++l)
+                sums[l] += up[l - lanes] + up[l + lanes] + down[l - lanes] + down[l + lanes];
+    }
+} // namespace ca_detail
+
+// Step(rule)
+// the member index is simply dropped.
+template <typename Rule>
+void Ensemble2D::Step(Rule &&rule)
+{
+    StepMembers([&rule](int, int sum, int state) { return rule(sum, state); });
+}
+
+// StepMembers(rule)
+// halo fill, then every (group, row) pair: the neighbor sums of a cell's eight members at once, then the rule
+// for each member that exists (padding lanes keep their 0).
+template <typename Rule>
+void Ensemble2D::StepMembers(Rule &&rule)
+{
+    FillHalo();
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    RunBands(groups_ * rows_, [&](int begin, int end) {
+        int sums[LANES];
+        for (int n = begin; n < end; ++n)
+        {
+            const int group = n / rows_, i = n % rows_;
+            const int first = group * LANES, lanes = std::min(LANES, members_ - first);
+            const int *mid = cells_.data() + CellIndex(group, i, 0);
+            int *out = next_cells_.data() + CellIndex(group, i, 0);
+            for (int j = 0; j < cols_; ++j, mid += LANES, out += LANES)
+            {
+                ca_detail::EnsembleNeighborSums(mid, row_stride_, moore, sums);
+                for (int l = 0; l < lanes; ++l)
+                    out[l] = rule(first + l, sums[l], mid[l]);
+            }
+        }
+    });
+    cells_.swap(next_cells_);
+}
+
+#endif // ENSEMBLE_H - marks the end of the header guard conditional
@@ -0,0 +1,360 @@
+// Include/FlatGrid.h
+#pragma once      // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef FLAT_GRID_H // Include guard (if FLAT_GRID_H not included yet define it and continue)
+#define FLAT_GRID_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Storage used by the CellularAutomata class for its 2D and 3D grids.
+// Instead of a vector of vectors (one heap allocation per row) every cell lives in a single
+// contiguous, cache-line aligned, row-major buffer. Rows are exposed through lightweight
+// views so code written against the old std::vector<std::vector<int>> layout
+// (grid[i][j], grid.size(), for (auto &row : grid) for (auto &cell : row)) still compiles.
+
+// Alignment (in bytes) of every grid buffer: one cache line, which is also wide enough for AVX loads.
+static const std::size_t GRID_ALIGNMENT = 64;
+
+// Minimal C++11 allocator that hands out memory aligned to Align bytes.
+// It is used as the allocator of the std::vector that backs FlatGrid2D so copies, moves
+// and swaps keep their usual std::vector semantics.
+template <typename T, std::size_t Align = GRID_ALIGNMENT>
+class AlignedAllocator
+{
+public:
+    using value_type = T;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() noexcept {}
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        if (n == 0)
+            return nullptr;
+        // over-allocate by Align bytes and remember the original pointer just before the aligned block
+        void *raw = std::malloc(n * sizeof(T) + Align + sizeof(void *));
+        if (raw == nullptr)
+            throw std::bad_alloc();
+        std::size_t addr = reinterpret_cast<std::size_t>(raw) + sizeof(void *);
+        std::size_t aligned = (addr + Align - 1) & ~(Align - 1);
+        reinterpret_cast<void **>(aligned)[-1] = raw;
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *p, std::size_t) noexcept
+    {
+        if (p != nullptr)
+            std::free(reinterpret_cast<void **>(p)[-1]);
+    }
+};
+
+template <typename T, typename U, std::size_t Align>
+bool operator==(const AlignedAllocator<T, Align> &, const AlignedAllocator<U, Align> &) { return true; }
+template <typename T, typename U, std::size_t Align>
+bool operator!=(const AlignedAllocator<T, Align> &, const AlignedAllocator<U, Align> &) { return false; }
+
+// RowView - a non-owning view (pointer + length) of one row of a FlatGrid2D.
+// T is int for a mutable row and const int for a read-only row.
+template <typename T>
+class RowView
+{
+public:
+    RowView() : data_(nullptr), size_(0) {}
+    RowView(T *data, int size) : data_(data), size_(size) {}
+
+    T &operator[](int j) const { return data_[j]; }
+    T *begin() const { return data_; }
+    T *end() const { return data_ + size_; }
+    T *data() const { return data_; }
+    int size() const { return size_; }
+
+private:
+    T *data_;  // first cell of the row
+    int size_; // number of cells (columns) in the row
+};
+
+// RowIterator - walks the rows of a FlatGrid2D.
+// It keeps the current RowView as a member so that `for (auto &row : grid)` can bind a reference to it.
+template <typename T>
+class RowIterator
+{
+public:
+    RowIterator(T *row, int cols, std::ptrdiff_t stride) : view_(row, cols), stride_(stride) {}
+
+    RowView<T> &operator*() { return view_; }
+    RowView<T> *operator->() { return &view_; }
+    RowIterator &operator++()
+    {
+        view_ = RowView<T>(view_.data() + stride_, view_.size());
+        return *this;
+    }
+    bool operator==(const RowIterator &other) const { return view_.data() == other.view_.data(); }
+    bool operator!=(const RowIterator &other) const { return view_.data() != other.view_.data(); }
+
+private:
+    RowView<T> view_;       // view of the row the iterator currently points at
+    std::ptrdiff_t stride_; // distance (in cells) between the first cells of two consecutive rows
+};
+
+// FlatGrid2D - a rows x cols grid of ints stored contiguously in row-major order.
+// Cell (i, j) lives at data()[i * stride() + j].
+// A grid can optionally be surrounded by a halo (ghost ring) of `halo` cells on every side. The halo is part
+// of the same buffer, so data()[(i) * stride() + (j)] is also valid for -halo <= i < rows + halo and
+// -halo <= j < cols + halo. The stepping engine fills the halo according to the boundary condition and then
+// sweeps every cell with the same branch-free stencil. Grids with a halo pad the left side and the stride
+// to a multiple of the alignment, so the first cell of every row stays cache-line aligned.
+class FlatGrid2D
+{
+public:
+    using value_type = int;
+    using Row = RowView<int>;
+    using ConstRow = RowView<const int>;
+    using iterator = RowIterator<int>;
+    using const_iterator = RowIterator<const int>;
+
+    FlatGrid2D() : rows_(0), cols_(0), halo_(0), stride_(0), origin_(0) {}
+    FlatGrid2D(int rows, int cols, int value = 0, int halo = 0)
+        : rows_(rows), cols_(cols), halo_(halo), stride_(cols), origin_(0)
+    {
+        if (rows < 0 || cols < 0 || halo < 0)
+            throw std::invalid_argument("FlatGrid2D dimensions must be non-negative");
+        if (halo > 0)
+        {
+            const std::ptrdiff_t lanes = static_cast<std::ptrdiff_t>(GRID_ALIGNMENT / sizeof(int));
+            std::ptrdiff_t left = RoundUp(halo, lanes);          // left padding keeps column 0 aligned
+            stride_ = RoundUp(left + cols + halo, lanes);         // row length including both halo sides
+            origin_ = static_cast<std::size_t>(halo * stride_ + left);
+        }
+        cells_.assign(static_cast<std::size_t>(rows + 2 * halo) * stride_, 0);
+        fill(value);
+    }
+
+    // Builds a flat grid from the old nested-vector layout (all rows must have the same length).
+    explicit FlatGrid2D(const std::vector<std::vector<int>> &nested)
+        : FlatGrid2D(static_cast<int>(nested.size()), nested.empty() ? 0 : static_cast<int>(nested[0].size()))
+    {
+        for (int i = 0; i < rows_; ++i)
+        {
+            if (static_cast<int>(nested[i].size()) != cols_)
+                throw std::invalid_argument("FlatGrid2D requires all rows to have the same length");
+            std::copy(nested[i].begin(), nested[i].end(), (*this)[i].begin());
+        }
+    }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int halo() const { return halo_; }
+    std::ptrdiff_t stride() const { return stride_; }
+    // Number of rows, kept so code written for the nested-vector layout (grid.size()) keeps working.
+    std::size_t size() const { return static_cast<std::size_t>(rows_); }
+    std::size_t cellCount() const { return static_cast<std::size_t>(rows_) * cols_; }
+    bool empty() const { return rows_ == 0 || cols_ == 0; }
+    // True when the cells are stored back to back with no halo or padding (stride() == cols()).
+    bool isPacked() const { return stride_ == cols_; }
+
+    // Pointer to cell (0, 0); negative offsets reach into the halo.
+    int *data() { return cells_.data() + origin_; }
+    const int *data() const { return cells_.data() + origin_; }
+
+    Row operator[](int i) { return Row(data() + i * stride_, cols_); }
+    ConstRow operator[](int i) const { return ConstRow(data() + i * stride_, cols_); }
+
+    int &at(int i, int j) { return data()[i * stride_ + j]; }
+    int at(int i, int j) const { return data()[i * stride_ + j]; }
+
+    iterator begin() { return iterator(data(), cols_, stride_); }
+    iterator end() { return iterator(data() + rows_ * stride_, cols_, stride_); }
+    const_iterator begin() const { return const_iterator(data(), cols_, stride_); }
+    const_iterator end() const { return const_iterator(data() + rows_ * stride_, cols_, stride_); }
+
+    // Sets every cell to value without reallocating (the halo is left alone).
+    void fill(int value)
+    {
+        if (isPacked())
+            std::fill(cells_.begin(), cells_.end(), value);
+        else
+            for (int i = 0; i < rows_; ++i)
+                std::fill(data() + i * stride_, data() + i * stride_ + cols_, value);
+    }
+
+    // Copies the cells of other into this grid, reusing the existing allocation when the shapes match.
+    // Only rows and columns have to agree; the halo of this grid is kept.
+    void assign(const FlatGrid2D &other)
+    {
+        if (other.rows_ != rows_ || other.cols_ != cols_)
+            *this = other;
+        else if (other.halo_ == halo_)
+            std::copy(other.cells_.begin(), other.cells_.end(), cells_.begin());
+        else
+            for (int i = 0; i < rows_; ++i)
+                std::copy(other[i].begin(), other[i].end(), (*this)[i].begin());
+    }
+
+    // Exchanges the buffers of two grids in O(1); used to flip the front/back buffers after every step.
+    void swap(FlatGrid2D &other) noexcept
+    {
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(halo_, other.halo_);
+        std::swap(stride_, other.stride_);
+        std::swap(origin_, other.origin_);
+        cells_.swap(other.cells_);
+    }
+
+    // Two grids are equal when they have the same shape and the same cells (halo contents are ignored).
+    bool operator==(const FlatGrid2D &other) const
+    {
+        if (rows_ != other.rows_ || cols_ != other.cols_)
+            return false;
+        for (int i = 0; i < rows_; ++i)
+            if (!std::equal((*this)[i].begin(), (*this)[i].end(), other[i].begin()))
+                return false;
+        return true;
+    }
+    bool operator!=(const FlatGrid2D &other) const { return !(*this == other); }
+
+private:
+    static std::ptrdiff_t RoundUp(std::ptrdiff_t value, std::ptrdiff_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    int rows_;              // number of rows in the grid
+    int cols_;              // number of columns in the grid
+    int halo_;              // width of the ghost ring around the grid (0 = no halo)
+    std::ptrdiff_t stride_; // distance (in cells) between the first cells of two consecutive rows
+    std::size_t origin_;    // offset of cell (0, 0) inside cells_
+    std::vector<int, AlignedAllocator<int>> cells_; // the single contiguous buffer holding every cell (and the halo)
+};
+
+inline void swap(FlatGrid2D &a, FlatGrid2D &b) noexcept { a.swap(b); }
+
+// FlatGrid3D - a layers x rows x cols volume of ints in one contiguous buffer, layer after layer, each layer
+// laid out like a FlatGrid2D. Cell (k, i, j) lives at data()[k * layerStride() + i * stride() + j].
+// With a halo, every layer has the same padded rows and aligned stride as a FlatGrid2D, and `halo` extra
+// layers sit before the first and after the last layer, so the 3D stepping engine can read all 26 neighbors
+// of any cell without range checks.
+class FlatGrid3D
+{
+public:
+    using value_type = int;
+    using Row = RowView<int>;
+    using ConstRow = RowView<const int>;
+
+    FlatGrid3D() : layers_(0), rows_(0), cols_(0), halo_(0), stride_(0), layer_stride_(0), origin_(0) {}
+    FlatGrid3D(int layers, int rows, int cols, int value = 0, int halo = 0)
+        : layers_(layers), rows_(rows), cols_(cols), halo_(halo), stride_(cols), layer_stride_(0), origin_(0)
+    {
+        if (layers < 0 || rows < 0 || cols < 0 || halo < 0)
+            throw std::invalid_argument("FlatGrid3D dimensions must be non-negative");
+        std::ptrdiff_t left = 0;
+        if (halo > 0)
+        {
+            const std::ptrdiff_t lanes = static_cast<std::ptrdiff_t>(GRID_ALIGNMENT / sizeof(int));
+            left = RoundUp(halo, lanes);                  // left padding keeps column 0 aligned
+            stride_ = RoundUp(left + cols + halo, lanes); // row length including both halo sides
+        }
+        layer_stride_ = static_cast<std::ptrdiff_t>(rows + 2 * halo) * stride_;
+        origin_ = static_cast<std::size_t>(halo * layer_stride_ + halo * stride_ + left);
+        cells_.assign(static_cast<std::size_t>(layers + 2 * halo) * layer_stride_, 0);
+        fill(value);
+    }
+
+    int layers() const { return layers_; }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int halo() const { return halo_; }
+    std::ptrdiff_t stride() const { return stride_; }
+    std::ptrdiff_t layerStride() const { return layer_stride_; }
+    std::size_t cellCount() const { return static_cast<std::size_t>(layers_) * rows_ * cols_; }
+    bool empty() const { return layers_ == 0 || rows_ == 0 || cols_ == 0; }
+
+    // Pointer to cell (0, 0, 0); negative offsets reach into the halo.
+    int *data() { return cells_.data() + origin_; }
+    const int *data() const { return cells_.data() + origin_; }
+
+    int &at(int k, int i, int j) { return data()[k * layer_stride_ + i * stride_ + j]; }
+    int at(int k, int i, int j) const { return data()[k * layer_stride_ + i * stride_ + j]; }
+
+    // Row i of layer k.
+    Row row(int k, int i) { return Row(data() + k * layer_stride_ + i * stride_, cols_); }
+    ConstRow row(int k, int i) const { return ConstRow(data() + k * layer_stride_ + i * stride_, cols_); }
+
+    // Sets every cell to value without reallocating (the halo is left alone).
+    void fill(int value)
+    {
+        for (int k = 0; k < layers_; ++k)
+            for (int i = 0; i < rows_; ++i)
+                std::fill(row(k, i).begin(), row(k, i).end(), value);
+    }
+
+    // Copies the cells of other into this grid, reusing the existing allocation when the shapes match.
+    void assign(const FlatGrid3D &other)
+    {
+        if (other.layers_ != layers_ || other.rows_ != rows_ || other.cols_ != cols_)
+            *this = other;
+        else if (other.halo_ == halo_)
+            std::copy(other.cells_.begin(), other.cells_.end(), cells_.begin());
+        else
+            for (int k = 0; k < layers_; ++k)
+                for (int i = 0; i < rows_; ++i)
+                    std::copy(other.row(k, i).begin(), other.row(k, i).end(), row(k, i).begin());
+    }
+
+    // Exchanges the buffers of two grids in O(1) (front/back buffer flip).
+    void swap(FlatGrid3D &other) noexcept
+    {
+        std::swap(layers_, other.layers_);
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(halo_, other.halo_);
+        std::swap(stride_, other.stride_);
+        std::swap(layer_stride_, other.layer_stride_);
+        std::swap(origin_, other.origin_);
+        cells_.swap(other.cells_);
+    }
+
+    // Same shape and same cells (halo contents are ignored).
+    bool operator==(const FlatGrid3D &other) const
+    {
+        if (layers_ != other.layers_ || rows_ != other.rows_ || cols_ != other.cols_)
+            return false;
+        for (int k = 0; k < layers_; ++k)
+            for (int i = 0; i < rows_; ++i)
+                if (!std::equal(row(k, i).begin(), row(k, i).end(), other.row(k, i).begin()))
+                    return false;
+        return true;
+    }
+    bool operator!=(const FlatGrid3D &other) const { return !(*this == other); }
+
+private:
+    static std::ptrdiff_t RoundUp(std::ptrdiff_t value, std::ptrdiff_t multiple)
+    {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    int layers_;                  // number of layers (depth of the volume)
+    int rows_;                    // number of rows in every layer
+    int cols_;                    // number of columns in every row
+    int halo_;                    // width of the ghost shell around the volume (0 = no halo)
+    std::ptrdiff_t stride_;       // distance (in cells) between the first cells of two consecutive rows
+    std::ptrdiff_t layer_stride_; // distance (in cells) between the first cells of two consecutive layers
+    std::size_t origin_;          // offset of cell (0, 0, 0) inside cells_
+    std::vector<int, AlignedAllocator<int>> cells_;
+};
+
+inline void swap(FlatGrid3D &a, FlatGrid3D &b) noexcept { a.swap(b); }
+
+#endif // FLAT_GRID_H - marks the end of the header guard conditional
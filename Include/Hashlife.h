@@ -0,0 +1,138 @@
+// Include/Hashlife.h
+#pragma once      // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef HASHLIFE_H // Include guard (if HASHLIFE_H not included yet define it and continue)
+#define HASHLIFE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+#include "CellularAutomata.h"
+
+// Hashlife - long-horizon evolution of binary (0/1) rules with a hash-consed quadtree.
+// The grid is stored as a quadtree of "macro-cells": a node of level k is a 2^k x 2^k square made of four
+// level k - 1 children, and identical squares are stored only once (hash-consing). For every node the engine
+// remembers the center half of the square 2^j generations later, so a pattern that repeats itself in space
+// or time (oscillators, gliders, periodic backgrounds) is computed once and then reused. Advance can jump
+// millions of generations in a handful of lookups, which is what makes runs of repetitive patterns fast.
+// Chaotic patterns gain nothing from memoization and are stepped faster by CellularAutomata::Run; the
+// smallest blocks (up to 32 x 32) are computed directly on bitmaps to keep that case reasonable.
+//
+// Two kinds of space are supported:
+//  - an unbounded plane (torus_size 0), only for rules where an empty neighborhood stays empty (no B0),
+//    since otherwise the infinite empty background would change;
+//  - a torus whose size is a power of two, which is the Periodic boundary condition of CellularAutomata.
+//    Any rule works there, including parityRule (which turns empty regions on).
+// The rule is a two-state RuleTable with outputs 0 or 1 for the Moore or von Neumann neighborhood.
+class Hashlife
+{
+public:
+    // torus_size 0 means the unbounded plane; otherwise the torus is torus_size x torus_size cells and
+    // torus_size must be a power of two. Throws std::invalid_argument for unsupported rules or sizes.
+    Hashlife(const RuleTable &table, NeighborhoodType nt, int torus_size = 0);
+
+    Hashlife(const Hashlife &) = delete;
+    Hashlife &operator=(const Hashlife &) = delete;
+
+    const RuleTable &table() const { return table_; }
+    NeighborhoodType neighborhoodType() const { return neighborhood_type_; }
+    int torusSize() const { return torus_size_; }
+
+    // Single cell access. On the torus coordinates are taken modulo the size; on the plane any 64-bit
+    // coordinate is valid (the tree grows to cover it).
+    int GetCell(long long row, long long col) const;
+    void SetCell(long long row, long long col, int state);
+
+    // Copies an int grid (states 0 or 1) into the cells starting at (row0, col0), or the cells starting at
+    // (row0, col0) into an int grid of the same shape as `grid`.
+    void LoadGrid(const FlatGrid2D &grid, long long row0 = 0, long long col0 = 0);
+    void StoreGrid(FlatGrid2D &grid, long long row0 = 0, long long col0 = 0) const;
+
+    // Removes every live cell (the generation counter is kept).
+    void Clear();
+
+    // Advances the pattern by `generations` (any non-negative number) in jumps of powers of two.
+    void Advance(long long generations);
+
+    long long Generation() const { return generation_; }
+    long long Population() const;
+
+    // Number of distinct nodes currently stored. When it exceeds the limit after a jump, the memoized
+    // results are dropped and only the nodes of the current pattern are kept.
+    std::size_t NodeCount() const { return nodes_.size(); }
+    void SetNodeLimit(std::size_t limit) { node_limit_ = limit; }
+
+private:
+    struct Node
+    {
+        const Node *nw, *ne, *sw, *se; // quadrants (null for the two level 0 leaves)
+        int level;                     // the node covers 2^level x 2^level cells
+        long long population;          // number of live cells
+        mutable const Node *result;    // center after 2^(level - 2) generations, once computed
+        std::uint64_t bits;            // levels 1 to 3: the cells as a bitmap, bit r * side + c is cell (r, c)
+    };
+
+    struct ChildrenKey
+    {
+        const Node *child[4];
+        bool operator==(const ChildrenKey &other) const
+        {
+            return child[0] == other.child[0] && child[1] == other.child[1] && child[2] == other.child[2] && child[3] == other.child[3];
+        }
+    };
+    struct ChildrenHash
+    {
+        std::size_t operator()(const ChildrenKey &key) const;
+    };
+    struct StepKey
+    {
+        const Node *node;
+        int step_log2;
+        bool operator==(const StepKey &other) const { return node == other.node && step_log2 == other.step_log2; }
+    };
+    struct StepHash
+    {
+        std::size_t operator()(const StepKey &key) const;
+    };
+
+    RuleTable table_;
+    NeighborhoodType neighborhood_type_;
+    int torus_size_;
+    long long generation_;
+    std::size_t node_limit_;
+
+    Node leaves_[2];                                          // level 0: dead and alive cell
+    std::deque<Node> nodes_;                                  // every node of level >= 1 (stable addresses)
+    std::unordered_map<ChildrenKey, const Node *, ChildrenHash> index_; // hash-consing table
+    std::unordered_map<StepKey, const Node *, StepHash> slow_results_;  // results for steps below full speed
+    std::vector<const Node *> empty_;                         // empty_[k] = the all-dead node of level k
+    std::vector<unsigned char> base_results_;                 // 4 x 4 block -> 2 x 2 center after one generation
+    std::vector<const Node *> level2_by_bits_;                // level 2 nodes indexed by their 16-bit bitmap
+    unsigned birth_, survive_;                                // bit k set: count k turns a dead / keeps a live cell on
+    const Node *root_;                                        // the pattern (one period on the torus)
+    long long origin_;                                        // plane: coordinate of the root's top left cell
+
+    const Node *Join(const Node *nw, const Node *ne, const Node *sw, const Node *se);
+    const Node *Empty(int level);
+    const Node *Center(const Node *node);
+    const Node *Expand(const Node *node);
+    const Node *Result(const Node *node, int step_log2);
+    const Node *BaseResult(const Node *node);
+    const Node *LeafResult(const Node *node, int step_log2);
+    const Node *FromBits(std::uint64_t bits, int level);
+    const Node *FromRows(const std::uint64_t *rows, int top, int left, int level);
+    void GatherBits(const Node *node, int top, int left, std::uint64_t *rows) const;
+    const Node *SetInNode(const Node *node, long long row, long long col, int state);
+    int GetInNode(const Node *node, long long row, long long col) const;
+    const Node *Build(const FlatGrid2D &grid, const Node *old, long long top, long long left, long long row0, long long col0);
+    const Node *CopyInto(const Node *node, std::unordered_map<const Node *, const Node *> &copied);
+    void StoreNode(const Node *node, long long top, long long left, FlatGrid2D &grid, long long row0, long long col0) const;
+    void Collect();
+    void AdvanceTorus(int step_log2);
+    void AdvancePlane(int step_log2);
+    bool Contains(long long row, long long col) const;
+    long long Wrap(long long index) const { return ((index % torus_size_) + torus_size_) % torus_size_; }
+};
+
+#endif // HASHLIFE_H - marks the end of the header guard conditional
@@ -0,0 +1,57 @@
+// Include/NeighborCounts.h
+#pragma once            // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef NEIGHBOR_COUNTS_H // Include guard (if NEIGHBOR_COUNTS_H not included yet define it and continue)
+#define NEIGHBOR_COUNTS_H
+
+#include <cstdint>
+
+// NeighborCounts - how many neighbors of a cell are in each state (a histogram of the neighbor states).
+// The neighbor sum used by Step and ApplyRule2D adds up state values, which is the number of active neighbors
+// only for binary grids: in a multi-state grid an ACTIVE_3 neighbor adds 3. Multi-state rules usually need
+// "how many neighbors are active" or "how many are in state s" instead, which is what this holds.
+// The histogram is packed four bits per state into one 32-bit word (states 0 .. MAX_STATES - 1; a Moore
+// neighborhood has at most 8 neighbors, which fits in four bits). A neighbor in state s then contributes
+// 1 << (4 s), so the histogram of a cell is simply the sum of its neighbors' contributions and is computed
+// with the same shifted-row additions (and vector kernels) as a plain neighbor sum.
+class NeighborCounts
+{
+public:
+    static const int MAX_STATES = 8;
+    static const int BITS_PER_STATE = 4;
+
+    NeighborCounts() : packed_(0) {}
+    explicit NeighborCounts(std::uint32_t packed) : packed_(packed) {}
+
+    // The contribution of one neighbor in `state` (0 for states outside of the histogram).
+    static std::uint32_t Encode(int state)
+    {
+        return static_cast<unsigned>(state) < static_cast<unsigned>(MAX_STATES) ? 1u << (BITS_PER_STATE * state) : 0u;
+    }
+
+    // Number of neighbors in `state` (0 .. MAX_STATES - 1).
+    int operator[](int state) const { return static_cast<int>((packed_ >> (BITS_PER_STATE * state)) & 15u); }
+    int Count(int state) const { return (*this)[state]; }
+
+    // Number of neighbors that exist: 8 or 4 inside the grid, fewer at the edges of a NoBoundary grid.
+    // (Adding up all nibbles with one multiplication is exact because the total never exceeds 15.)
+    int Total() const { return static_cast<int>((packed_ * 0x11111111u) >> 28); }
+    // Number of neighbors in any state other than 0 (INACTIVE).
+    int Active() const { return Total() - (*this)[0]; }
+    // The neighbor sum of the state values, as Step would compute it.
+    int Sum() const
+    {
+        int sum = 0;
+        for (int state = 1; state < MAX_STATES; ++state)
+            sum += state * (*this)[state];
+        return sum;
+    }
+
+    std::uint32_t packed() const { return packed_; }
+    bool operator==(const NeighborCounts &other) const { return packed_ == other.packed_; }
+    bool operator!=(const NeighborCounts &other) const { return packed_ != other.packed_; }
+
+private:
+    std::uint32_t packed_;
+};
+
+#endif // NEIGHBOR_COUNTS_H - marks the end of the header guard conditional
@@ -0,0 +1,108 @@
+// Include/NeuronModel.h
+#pragma once          // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef NEURON_MODEL_H // Include guard (if NEURON_MODEL_H not included yet define it and continue)
+#define NEURON_MODEL_H
+
+#include <cstdint>
+#include "CellularAutomata.h"
+#include "CounterRng.h"
+
+// NeuronModel - the stochastic neuron network of Application/neuron2neuron as a built-in rule.
+// Cells are INACTIVE, ACTIVE_1 (firing), ACTIVE_2 (relaying) or ACTIVE_3 (refractory); `active` is the number
+// of neighbors in any active state (see NeighborCounts.h), so an ACTIVE_3 neighbor counts once, not three
+// times as in the neighbor sum. In every step:
+//   ACTIVE_1  with fire_probability fires through CellularAutomata::MajorityRule(active), otherwise stays
+//   ACTIVE_2  with relay_probability (always on steps that are a multiple of relay_period) relays through
+//             CellularAutomata::TotalisticRule(active), otherwise stays
+//   ACTIVE_3  recovers to INACTIVE with recovery_probability, otherwise drops back to ACTIVE_2
+//   INACTIVE  and any other state stay as they are
+// and then, on steps that are a multiple of spontaneous_period, every cell becomes a random active state
+// (ACTIVE_1, ACTIVE_2 or ACTIVE_3, equally likely) with probability spontaneous_rate.
+// Spontaneous activity is applied after the transition and replaces its result. The original application
+// injected it first and ran the transition on the injected state (an injected ACTIVE_3 could recover to
+// INACTIVE in the same step); here the transition runs on the old state and the injected state overwrites its
+// result. In both, neighbors are counted on the grid before the injection, so an injected cell first acts on
+// its neighbors in the next step. Folding it into the one per-cell draw lets a step run as a single sweep.
+// CellularAutomata::StepNeuron runs it inside the stepping engine, vectorized when AVX2 is available.
+struct NeuronModel
+{
+    double fire_probability;
+    double relay_probability;
+    int relay_period;           // 0: never forced
+    double recovery_probability;
+    double spontaneous_rate;
+    int spontaneous_period;     // 0: no spontaneous activity
+
+    // The parameters of Application/neuron2neuron: every choice a coin flip, relays forced every 5th step and
+    // 5% spontaneous activity every 3rd step.
+    NeuronModel();
+
+    // Throws std::invalid_argument for probabilities outside [0, 1] or negative periods.
+    void Validate() const;
+};
+
+// NeuronRule - one step of a NeuronModel for a single cell, rule(neighbor counts, state, random): the reference
+// that the StepNeuron kernel reproduces. Every cell uses the first three words of its CellRandom stream: word 0
+// for its transition, word 1 for spontaneous activity and word 2 for the active state it jumps to. Cells that
+// cannot change (inactive ones on steps without spontaneous activity) draw nothing, so quiet regions cost no
+// random numbers. A probability p is applied as "word < ceil(p * 2^32)", so the vectorized kernel
+// (ca_detail::SweepNeuron2D) makes exactly the same choices.
+class NeuronRule
+{
+public:
+    NeuronRule(const NeuronModel &model, std::uint64_t step);
+
+    int operator()(const NeighborCounts &counts, int state, CellRandom &random) const
+    {
+        return Draw(counts.Active(), state, random);
+    }
+
+    // The same with the number of active neighbors given directly.
+    int Draw(int active, int state, CellRandom &random) const
+    {
+        if (spontaneous_ == 0 && (state < CellularAutomata::ACTIVE_1 || state > CellularAutomata::ACTIVE_3))
+            return state; // nothing to draw, and no random block to generate
+        const std::uint32_t transition = random.Next();
+        const std::uint32_t spontaneous = random.Next();
+        const std::uint32_t choice = random.Next();
+        return Apply(active, state, transition, spontaneous, choice);
+    }
+
+    int Apply(int active, int state, std::uint32_t transition, std::uint32_t spontaneous, std::uint32_t choice) const
+    {
+        int next = state;
+        switch (state)
+        {
+        case CellularAutomata::ACTIVE_1:
+            if (transition < fire_)
+                next = CellularAutomata::MajorityRule(active);
+            break;
+        case CellularAutomata::ACTIVE_2:
+            if (transition < relay_)
+                next = CellularAutomata::TotalisticRule(active);
+            break;
+        case CellularAutomata::ACTIVE_3:
+            next = (transition < recover_) ? CellularAutomata::INACTIVE : CellularAutomata::ACTIVE_2;
+            break;
+        default:
+            break;
+        }
+        if (spontaneous < spontaneous_)
+            next = CellularAutomata::ACTIVE_1 + static_cast<int>((static_cast<std::uint64_t>(choice) * 3) >> 32);
+        return next;
+    }
+
+    // Thresholds for the draws: a 32-bit word w passes when w < threshold (0: never, 2^32: always).
+    std::uint64_t fireThreshold() const { return fire_; }
+    std::uint64_t relayThreshold() const { return relay_; }
+    std::uint64_t recoverThreshold() const { return recover_; }
+    std::uint64_t spontaneousThreshold() const { return spontaneous_; }
+
+    // ceil(p * 2^32), clamped to [0, 2^32].
+    static std::uint64_t Threshold(double p);
+
+private:
+    std::uint64_t fire_, relay_, recover_, spontaneous_; // for this step (forced relays and inactive periods folded in)
+};
+
+#endif // NEURON_MODEL_H - marks the end of the header guard conditional
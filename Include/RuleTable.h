@@ -0,0 +1,113 @@
+// Include/RuleTable.h
+#pragma once        // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef RULE_TABLE_H // Include guard (if RULE_TABLE_H not included yet define it and continue)
+#define RULE_TABLE_H
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "CellularAutomata.h"
+
+// RuleTable - a rule stored as a lookup table indexed by (current state, neighbor sum).
+// Any rule of the form new_state = rule(neighbors, current_state) with a finite number of states can be
+// tabulated once and then evaluated with a single load per cell, which is what lets the vectorized kernels
+// (see SimdKernels.h) apply it to a whole row segment at a time.
+// Entry (state, sum) lives at table()[state * sumsPerState() + sum].
+// Tables can be written as text (ToString) and read back (FromString), so a rule can be stored in an
+// experiment configuration: two-state rules use the usual life-like notation ("B3/S23"), anything else a
+// full listing of the table ("table:<states>:<max sum>:<entries>").
+class RuleTable
+{
+public:
+    RuleTable() : num_states_(0), max_sum_(-1) {}
+
+    // Builds an all-zero table for states 0 .. numStates - 1 and neighbor sums 0 .. maxSum.
+    RuleTable(int numStates, int maxSum)
+        : num_states_(numStates), max_sum_(maxSum),
+          table_(static_cast<std::size_t>(numStates) * (maxSum + 1), 0)
+    {
+        if (numStates < 1 || maxSum < 0)
+            throw std::invalid_argument("RuleTable needs at least one state and a non-negative maximum sum");
+    }
+
+    // Tabulates rule(neighbors, state) for every reachable (state, sum) pair of the given neighborhood.
+    // The rule must be deterministic (same inputs, same output) and must map states 0 .. numStates - 1 back
+    // into that range; otherwise std::invalid_argument is thrown.
+    static RuleTable FromFunction(const std::function<int(int, int)> &rule, int numStates, NeighborhoodType nt)
+    {
+        return FromFunction(rule, numStates, NeighborCount(nt));
+    }
+
+    // Same for any number of neighbors (2 for the 1D automaton).
+    static RuleTable FromFunction(const std::function<int(int, int)> &rule, int numStates, int neighborCount)
+    {
+        RuleTable table(numStates, neighborCount * (numStates - 1));
+        for (int state = 0; state < numStates; ++state)
+        {
+            for (int sum = 0; sum <= table.max_sum_; ++sum)
+            {
+                int next = rule(sum, state);
+                if (next < 0 || next >= numStates)
+                    throw std::invalid_argument("rule produces a state outside of the table's range");
+                table.Set(state, sum, next);
+            }
+        }
+        return table;
+    }
+
+    // Life-like rule from birth/survival notation, e.g. "B3/S23" (Conway's Game of Life) or "B36/S23".
+    // The B and S parts may come in either order and in lower case; the old survival/birth form "23/3" is
+    // accepted as well. A full table listing produced by ToString is also understood, in which case
+    // neighborCount is only used to check that the table covers the neighborhood.
+    // Throws std::invalid_argument on malformed text or on counts larger than neighborCount.
+    static RuleTable FromString(const std::string &text, int neighborCount);
+    static RuleTable FromString(const std::string &text, NeighborhoodType nt) { return FromString(text, NeighborCount(nt)); }
+
+    // Text form accepted by FromString: "B.../S..." for tables with two states whose entries are all 0 or 1
+    // (and at most 9 neighbors), otherwise "table:<states>:<max sum>:<comma separated entries>".
+    std::string ToString() const;
+
+    // The rules provided by the library (see CellularAutomata.h) as tables.
+    static RuleTable Parity(NeighborhoodType nt);        // parityRule
+    static RuleTable Totalistic(NeighborhoodType nt);    // totalisticRule
+    static RuleTable Majority2D(NeighborhoodType nt);    // majorityRule2D
+    static RuleTable Majority1D();                       // majorityRule_1D, for ApplyRule1D
+    static RuleTable Totalistic1D();                     // totalisticRule_1D, for ApplyRule1D
+
+    // Number of neighbors the 2D neighborhood types look at.
+    static int NeighborCount(NeighborhoodType nt) { return nt == NeighborhoodType::Moore ? 8 : 4; }
+    // Number of neighbors of a cell in a 3D automaton (26 or 6).
+    static int NeighborCount3D(NeighborhoodType nt) { return nt == NeighborhoodType::Moore ? 26 : 6; }
+
+    // Number of neighbors of a cell in the 1D automaton.
+    static const int NEIGHBOR_COUNT_1D = 2;
+
+    int numStates() const { return num_states_; }
+    int maxSum() const { return max_sum_; }
+    int sumsPerState() const { return max_sum_ + 1; }
+    const int *table() const { return table_.data(); }
+
+    int Get(int state, int sum) const { return table_[state * sumsPerState() + sum]; }
+    void Set(int state, int sum, int next) { table_[state * sumsPerState() + sum] = next; }
+
+    // Same argument order as the RuleFunction2D callbacks, so a table can be passed to Step(rule) as well.
+    int operator()(int neighbors, int state) const { return Get(state, neighbors); }
+
+    // True when the table covers every neighbor sum the neighborhood type can produce for its states.
+    bool Covers(NeighborhoodType nt) const { return Covers(NeighborCount(nt)); }
+    bool Covers(int neighborCount) const { return max_sum_ >= neighborCount * (num_states_ - 1); }
+
+    bool operator==(const RuleTable &other) const
+    {
+        return num_states_ == other.num_states_ && max_sum_ == other.max_sum_ && table_ == other.table_;
+    }
+    bool operator!=(const RuleTable &other) const { return !(*this == other); }
+
+private:
+    int num_states_;        // states are 0 .. num_states_ - 1
+    int max_sum_;           // largest neighbor sum in the table
+    std::vector<int> table_; // num_states_ x (max_sum_ + 1) entries, row-major by state
+};
+
+#endif // RULE_TABLE_H - marks the end of the header guard conditional
@@ -0,0 +1,104 @@
+// Include/SimdKernels.h
+#pragma once          // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef SIMD_KERNELS_H // Include guard (if SIMD_KERNELS_H not included yet define it and continue)
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Vectorized neighbor counting and table lookup for 2D grids (implemented in src/simd_kernels.cpp).
+// The kernels compute the neighbor sums of a whole row segment at once with shifted loads of the rows
+// above, at and below the current one (the 3 x 3 block for Moore, the 5-point cross for von Neumann),
+// then look the new states up in a RuleTable. The instruction set is picked at runtime, and there is
+// always a scalar fallback, so the library still runs on any CPU (and on non-x86 machines).
+
+// Instruction sets the kernels can use, from slowest to fastest.
+enum class SimdLevel
+{
+    Scalar,
+    SSE41,
+    AVX2
+};
+
+// Best instruction set supported by the CPU running the program.
+SimdLevel DetectSimdLevel();
+
+// Human readable name of a SimdLevel ("scalar", "sse4.1", "avx2").
+const char *SimdLevelName(SimdLevel level);
+
+class NeuronRule; // declared in NeuronModel.h
+
+namespace ca_detail
+{
+    // Everything a table-driven sweep needs. The current grid must have a filled one-cell halo.
+    struct TableSweep2D
+    {
+        const int *current;    // cell (0, 0) of the current generation
+        int *next;             // cell (0, 0) of the next generation
+        std::ptrdiff_t stride; // row stride shared by both grids
+        int cols;              // number of columns
+        bool moore;            // Moore (8 neighbors) or von Neumann (4 neighbors)
+        const int *table;      // RuleTable entries, table[state * sums_per_state + sum]
+        int num_states;        // valid states are 0 .. num_states - 1
+        int sums_per_state;    // RuleTable::sumsPerState()
+    };
+
+    // Computes rows [row_begin, row_end) of the next generation.
+    // Returns false if a cell held a state outside of the table (the output of that cell is unspecified).
+    bool SweepTable2D(const TableSweep2D &sweep, SimdLevel level, int row_begin, int row_end);
+
+    // Everything a NeuronModel sweep needs (see NeuronModel.h). The current grid must have a filled one-cell halo.
+    struct NeuronSweep2D
+    {
+        const int *current;     // cell (0, 0) of the current generation
+        int *next;              // cell (0, 0) of the next generation
+        std::ptrdiff_t stride;  // row stride shared by both grids
+        int cols;               // number of columns
+        bool moore;             // Moore (8 neighbors) or von Neumann (4 neighbors)
+        const NeuronRule *rule; // the model for this step
+        std::uint64_t seed;     // CellRandom seed and step; cell (i, j) uses stream i * cols + j
+        std::uint64_t step;
+    };
+
+    // Computes rows [row_begin, row_end) of the next generation; eight cells (random numbers included) per
+    // iteration with AVX2, otherwise one cell at a time through NeuronRule.
+    void SweepNeuron2D(const NeuronSweep2D &sweep, SimdLevel level, int row_begin, int row_end);
+
+    // The neuron sweep of an Ensemble2D (see Ensemble.h): groups of LANES members interleaved cell by cell,
+    // each group a (rows + 2) x (cols + 2) block of cells with a filled one-cell halo.
+    struct EnsembleNeuronSweep
+    {
+        const int *current;          // lane 0 of cell (0, 0) of group 0, current generation
+        int *next;                   // the same in the next generation
+        std::ptrdiff_t row_stride;   // ints between rows of a group
+        std::ptrdiff_t group_stride; // ints between groups
+        int rows, cols;
+        int members;                 // lanes of the last group beyond this are padding and stay 0
+        bool moore;
+        const NeuronRule *rules;     // the model of every member for this step
+        const std::uint64_t *seeds;  // the CellRandom seed of every member; cell (i, j) uses stream i * cols + j
+        std::uint64_t step;
+    };
+
+    // Computes the (group, row) pairs n = group * rows + row in [begin, end); with AVX2 the eight members of a
+    // group are the eight lanes (per-lane Philox keys and thresholds), otherwise member by member through
+    // NeuronRule.
+    void SweepEnsembleNeuron(const EnsembleNeuronSweep &sweep, SimdLevel level, int begin, int end);
+
+    // Packed neighbor histograms (see NeighborCounts.h) of the cols cells starting at `row` into out[0 .. cols).
+    // The grid must have a filled one-cell halo; halo cells holding a state outside of the histogram (such as
+    // -1) count in no state. Returns false if a cell of the row itself holds such a state (out is then
+    // unspecified). AVX2 encodes and adds eight cells per iteration with variable shifts; SSE4.1 has no
+    // variable shift and uses the scalar loop.
+    bool CountNeighborStates2D(const int *row, std::ptrdiff_t stride, int cols, bool moore, std::uint32_t *out,
+                               SimdLevel level);
+
+    // Block 0 of the CellRandom streams of cells first_cell .. first_cell + count - 1 (see CounterRng.h), eight
+    // cells per AVX2 iteration; the words of cell n go to out[4 * n] .. out[4 * n + 3].
+    // Returns false, without writing anything, when `level` has no vector kernel for it: generating the blocks
+    // one by one up front would then only cost time for cells whose rule draws nothing.
+    bool PhiloxFirstBlocks(std::uint64_t seed, std::uint64_t step, std::uint64_t first_cell, int count, std::uint32_t *out,
+                           SimdLevel level);
+} // namespace ca_detail
+
+#endif // SIMD_KERNELS_H - marks the end of the header guard conditional
@@ -0,0 +1,134 @@
+// Include/SparseGrid.h
+#pragma once        // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef SPARSE_GRID_H // Include guard (if SPARSE_GRID_H not included yet define it and continue)
+#define SPARSE_GRID_H
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "CellularAutomata.h"
+
+// SparseGrid2D - a truly unbounded 2D automaton whose memory follows the live region.
+// With BoundaryCondition::NoBoundary, CellularAutomata clips everything to its size x size square, so growing
+// patterns are cut off unless an enormous, mostly empty grid is allocated up front. SparseGrid2D instead keeps
+// a hash map of CHUNK x CHUNK blocks of cells: a block is allocated when a cell in it becomes non-zero and
+// freed as soon as all of its cells are 0 again. Any state values are allowed (not only 0/1).
+// The plane outside the stored blocks is state 0, so rules must keep an empty neighborhood empty:
+// rule(0, 0) has to be 0 (otherwise Step throws std::invalid_argument). Rules are called as in
+// CellularAutomata: rule(neighbor sum, current state), and the Moore / von Neumann neighborhoods are the same.
+class SparseGrid2D
+{
+public:
+    static const int CHUNK = 64;              // cells per block side
+    static const int STRIDE = CHUNK + 2;      // blocks are stored with a one-cell halo on every side
+
+    explicit SparseGrid2D(NeighborhoodType nt);
+
+    NeighborhoodType neighborhoodType() const { return neighborhood_type_; }
+
+    // Single cell access; any 64-bit coordinate is valid.
+    int Get(long long row, long long col) const;
+    void Set(long long row, long long col, int value);
+
+    // Copies the cells of `grid` to the plane starting at (row0, col0), or the window of the plane starting at
+    // (row0, col0) into `grid` (its shape is kept).
+    void LoadGrid(const FlatGrid2D &grid, long long row0 = 0, long long col0 = 0);
+    void StoreGrid(FlatGrid2D &grid, long long row0 = 0, long long col0 = 0) const;
+
+    // Removes every cell (the generation counter is kept).
+    void Clear();
+
+    // Advances one generation. Only the stored blocks, and the neighbors of blocks with live cells on the
+    // shared edge, are computed. rule can be a function, lambda, functor or RuleTable, as in Step.
+    template <typename Rule>
+    void Step(Rule &&rule);
+
+    long long Generation() const { return generation_; }
+    // Number of non-zero cells.
+    long long Population() const;
+    // Number of allocated blocks (memory use is about ChunkCount() * STRIDE * STRIDE ints).
+    std::size_t ChunkCount() const { return chunks_.size(); }
+    // Smallest rectangle holding every non-zero cell; false when the plane is empty.
+    bool Bounds(long long &min_row, long long &min_col, long long &max_row, long long &max_col) const;
+
+    // Number of threads used by Step (blocks are spread across a thread pool); 0 means one per hardware thread.
+    void SetThreadCount(int threads);
+    int GetThreadCount() const;
+
+private:
+    struct Chunk
+    {
+        std::vector<int> cells; // STRIDE x STRIDE, interior cell (r, c) at (r + 1) * STRIDE + c + 1
+        long long population;   // non-zero interior cells
+        int *origin() { return cells.data() + STRIDE + 1; }
+        const int *origin() const { return cells.data() + STRIDE + 1; }
+    };
+
+    struct ChunkKey
+    {
+        long long row, col; // block coordinates: cell (row * CHUNK, col * CHUNK) is the block's top left cell
+        bool operator==(const ChunkKey &other) const { return row == other.row && col == other.col; }
+    };
+    struct ChunkHash
+    {
+        std::size_t operator()(const ChunkKey &key) const;
+    };
+
+    // One block to compute in the current step.
+    struct WorkItem
+    {
+        ChunkKey key;
+        const Chunk *current;
+        std::unique_ptr<Chunk> next;
+    };
+
+    using ChunkMap = std::unordered_map<ChunkKey, std::unique_ptr<Chunk>, ChunkHash>;
+
+    NeighborhoodType neighborhood_type_;
+    long long generation_;
+    ChunkMap chunks_;
+    std::vector<std::unique_ptr<Chunk>> free_chunks_; // recycled blocks, so steady state runs do not allocate
+    std::vector<WorkItem> work_;
+    std::shared_ptr<ThreadPool> pool_;
+
+    static long long FloorDiv(long long value) { return value >= 0 ? value / CHUNK : -((-value + CHUNK - 1) / CHUNK); }
+    std::unique_ptr<Chunk> AcquireChunk();
+    void ReleaseChunk(std::unique_ptr<Chunk> chunk);
+    static long long CountLive(const Chunk &chunk);
+
+    // Step phases shared by every rule type: add the blocks live cells can spread into and fill all halos;
+    // run body over the work items (in parallel when a pool is set up); keep the non-empty results.
+    void PrepareStep();
+    void RunWork(const std::function<void(int, int)> &body);
+    void FinishStep();
+};
+
+// Step(rule)
+// the rule is inlined into the sweep of every block (see ca_detail::Sweep2DRows in StepEngine.h).
+template <typename Rule>
+void SparseGrid2D::Step(Rule &&rule)
+{
+    if (rule(0, 0) != 0)
+    {
+        throw std::invalid_argument("SparseGrid2D needs a rule that keeps empty regions empty (rule(0, 0) == 0)");
+    }
+    PrepareStep();
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    RunWork([&](int begin, int end) {
+        for (int k = begin; k < end; ++k)
+        {
+            WorkItem &item = work_[k];
+            if (moore)
+                ca_detail::Sweep2DRows<NeighborhoodType::Moore>(item.current->origin(), item.next->origin(), STRIDE, CHUNK, rule, 0, CHUNK);
+            else
+                ca_detail::Sweep2DRows<NeighborhoodType::VonNeumann>(item.current->origin(), item.next->origin(), STRIDE, CHUNK, rule, 0, CHUNK);
+            item.next->population = CountLive(*item.next);
+        }
+    });
+    FinishStep();
+}
+
+#endif // SPARSE_GRID_H - marks the end of the header guard conditional
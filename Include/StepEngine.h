@@ -0,0 +1,983 @@
+// Include/StepEngine.h
+#pragma once        // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef STEP_ENGINE_H // Include guard (if STEP_ENGINE_H not included yet define it and continue)
+#define STEP_ENGINE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "CellularAutomata.h"
+
+// Compile-time specialized stepping engine for the CellularAutomata class.
+// The boundary condition, the neighborhood type and the rule are template parameters, so the
+// compiler generates one loop per combination with the neighbor offsets unrolled and the rule call
+// inlined (when it is a lambda or functor). CellularAutomata::ApplyRule2D picks the matching
+// instantiation once in the constructor.
+// Boundaries never reach the hot loop: before each sweep the one-cell halo around the grid is filled
+// for the boundary condition (wrapped copies for Periodic, zeros for Fixed/NoBoundary), and then every
+// cell is updated with the same branch-free stencil.
+
+namespace ca_detail
+{
+    // Boundary2D<BC>::FillHalo writes the ghost ring around a grid so that every cell, including the ones on
+    // the edges, can read its neighbors without any range checks. Only O(rows + cols) cells are touched.
+    template <BoundaryCondition BC>
+    struct Boundary2D;
+
+    // Periodic: the halo holds wrapped copies of the opposite edges (torus), corners included.
+    template <>
+    struct Boundary2D<BoundaryCondition::Periodic>
+    {
+        static void FillHalo(FlatGrid2D &grid)
+        {
+            const int rows = grid.rows(), cols = grid.cols(), halo = grid.halo();
+            const std::ptrdiff_t stride = grid.stride();
+            int *cells = grid.data();
+            if (rows == 0 || cols == 0)
+                return;
+            // left and right halo columns of every interior row
+            for (int i = 0; i < rows; ++i)
+            {
+                int *row = cells + i * stride;
+                for (int h = 1; h <= halo; ++h)
+                {
+                    row[-h] = row[Wrap(-h, cols)];
+                    row[cols - 1 + h] = row[Wrap(cols - 1 + h, cols)];
+                }
+            }
+            // top and bottom halo rows are copies of whole (already padded) rows from the other side
+            const int width = cols + 2 * halo;
+            for (int h = 1; h <= halo; ++h)
+            {
+                std::copy(cells + Wrap(-h, rows) * stride - halo, cells + Wrap(-h, rows) * stride - halo + width,
+                          cells - h * stride - halo);
+                std::copy(cells + Wrap(rows - 1 + h, rows) * stride - halo,
+                          cells + Wrap(rows - 1 + h, rows) * stride - halo + width,
+                          cells + (rows - 1 + h) * stride - halo);
+            }
+        }
+
+        static int Wrap(int index, int size) { return ((index % size) + size) % size; }
+    };
+
+    // Constant halo: in 2D, cells beyond the edges never contribute to the neighbor count, for both Fixed and
+    // NoBoundary, so the ghost ring is simply zero.
+    struct ZeroHalo2D
+    {
+        static void FillHalo(FlatGrid2D &grid) { FillHaloWith(grid, 0); }
+
+        // the ghost ring set to `value` (-1 marks absent neighbors for StepCounts)
+        static void FillHaloWith(FlatGrid2D &grid, int value)
+        {
+            const int rows = grid.rows(), cols = grid.cols(), halo = grid.halo();
+            const std::ptrdiff_t stride = grid.stride();
+            int *cells = grid.data();
+            const int width = cols + 2 * halo;
+            for (int h = 1; h <= halo; ++h)
+            {
+                std::fill(cells - h * stride - halo, cells - h * stride - halo + width, value);
+                std::fill(cells + (rows - 1 + h) * stride - halo, cells + (rows - 1 + h) * stride - halo + width, value);
+            }
+            for (int i = 0; i < rows; ++i)
+            {
+                std::fill(cells + i * stride - halo, cells + i * stride, value);
+                std::fill(cells + i * stride + cols, cells + i * stride + cols + halo, value);
+            }
+        }
+    };
+
+    template <>
+    struct Boundary2D<BoundaryCondition::Fixed> : ZeroHalo2D
+    {
+    };
+
+    template <>
+    struct Boundary2D<BoundaryCondition::NoBoundary> : ZeroHalo2D
+    {
+    };
+
+    // Neighborhood2D<NT>::Sum adds up the neighbors of the cell at `center` (the center cell is excluded).
+    // The grid must have a filled halo of at least one cell, so no neighbor is ever out of range.
+    template <NeighborhoodType NT>
+    struct Neighborhood2D;
+
+    // Von Neumann: the four direct neighbors.
+    template <>
+    struct Neighborhood2D<NeighborhoodType::VonNeumann>
+    {
+        static int Sum(const int *center, std::ptrdiff_t stride)
+        {
+            return center[-stride] + center[-1] + center[1] + center[stride];
+        }
+    };
+
+    // Moore: all eight surrounding cells.
+    template <>
+    struct Neighborhood2D<NeighborhoodType::Moore>
+    {
+        static int Sum(const int *center, std::ptrdiff_t stride)
+        {
+            const int *up = center - stride;
+            const int *down = center + stride;
+            return up[-1] + up[0] + up[1] + center[-1] + center[1] + down[-1] + down[0] + down[1];
+        }
+    };
+
+    // Sweep2DRows - computes rows [row_begin, row_end) of one generation:
+    // next(i, j) = rule(neighbors(i, j), current(i, j)).
+    // `current` must have its halo filled for the boundary condition; the loop itself has no boundary checks.
+    // Different row ranges can be computed by different threads at the same time.
+    template <NeighborhoodType NT, typename Rule>
+    void Sweep2DRows(const int *current, int *next, std::ptrdiff_t stride, int cols, Rule &rule, int row_begin, int row_end)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            const int *row = current + i * stride;
+            int *out = next + i * stride;
+            for (int j = 0; j < cols; ++j)
+            {
+                out[j] = rule(Neighborhood2D<NT>::Sum(row + j, stride), row[j]);
+            }
+        }
+    }
+
+    // Sweep2DRowsStochastic - Sweep2DRows for rules that draw random numbers:
+    // next(i, j) = rule(neighbors(i, j), current(i, j), random stream of (seed, step, i * cols + j)).
+    // When `level` has a vector Philox kernel, block 0 of every stream of a row is generated up front into
+    // `scratch` (4 * cols words); the streams are the same either way.
+    template <NeighborhoodType NT, typename Rule>
+    void Sweep2DRowsStochastic(const int *current, int *next, std::ptrdiff_t stride, int cols, Rule &rule, int row_begin, int row_end,
+                               std::uint64_t seed, std::uint64_t step, SimdLevel level, std::uint32_t *scratch)
+    {
+        for (int i = row_begin; i < row_end; ++i)
+        {
+            const int *row = current + i * stride;
+            int *out = next + i * stride;
+            const std::uint64_t first = static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(cols);
+            if (PhiloxFirstBlocks(seed, step, first, cols, scratch, level))
+            {
+                for (int j = 0; j < cols; ++j)
+                {
+                    CellRandom random(seed, step, first + j, scratch + 4 * j);
+                    out[j] = rule(Neighborhood2D<NT>::Sum(row + j, stride), row[j], random);
+                }
+                continue;
+            }
+            for (int j = 0; j < cols; ++j)
+            {
+                CellRandom random(seed, step, first + j);
+                out[j] = rule(Neighborhood2D<NT>::Sum(row + j, stride), row[j], random);
+            }
+        }
+    }
+
+    // CountsRow<Stochastic>::Apply - next(j) = rule(counts(j), current(j)) over one row whose packed neighbor
+    // histograms are in `counts`; the stochastic variant also hands over the random stream of cell (i, j),
+    // with block 0 precomputed as in Sweep2DRowsStochastic.
+    template <bool Stochastic>
+    struct CountsRow;
+
+    template <>
+    struct CountsRow<false>
+    {
+        template <typename Rule>
+        static void Apply(Rule &rule, const std::uint32_t *counts, const int *row, int *out, int cols, int,
+                          std::uint64_t, std::uint64_t, SimdLevel, std::uint32_t *)
+        {
+            for (int j = 0; j < cols; ++j)
+                out[j] = rule(NeighborCounts(counts[j]), row[j]);
+        }
+    };
+
+    template <>
+    struct CountsRow<true>
+    {
+        template <typename Rule>
+        static void Apply(Rule &rule, const std::uint32_t *counts, const int *row, int *out, int cols, int i,
+                          std::uint64_t seed, std::uint64_t step, SimdLevel level, std::uint32_t *scratch)
+        {
+            const std::uint64_t first = static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(cols);
+            if (PhiloxFirstBlocks(seed, step, first, cols, scratch, level))
+            {
+                for (int j = 0; j < cols; ++j)
+                {
+                    CellRandom random(seed, step, first + j, scratch + 4 * j);
+                    out[j] = rule(NeighborCounts(counts[j]), row[j], random);
+                }
+                return;
+            }
+            for (int j = 0; j < cols; ++j)
+            {
+                CellRandom random(seed, step, first + j);
+                out[j] = rule(NeighborCounts(counts[j]), row[j], random);
+            }
+        }
+    };
+
+    // Sweep2D - computes one whole generation on the calling thread.
+    template <NeighborhoodType NT, typename Rule>
+    void Sweep2D(const int *current, int *next, std::ptrdiff_t stride, int rows, int cols, Rule &rule)
+    {
+        Sweep2DRows<NT>(current, next, stride, cols, rule, 0, rows);
+    }
+
+    // LoadTile - copies the h x w block whose top left cell is (row0, col0) into a tile buffer, where the block
+    // may stick out of the grid on any side. For a periodic grid the outside cells are wrapped copies; otherwise
+    // they are 0, which is what the 2D Fixed and NoBoundary conditions see beyond the edges.
+    inline void LoadTile(const int *grid, std::ptrdiff_t stride, int rows, int cols, bool periodic,
+                         int row0, int col0, int h, int w, int *tile, std::ptrdiff_t tile_stride)
+    {
+        for (int r = 0; r < h; ++r)
+        {
+            int *out = tile + r * tile_stride;
+            int i = row0 + r;
+            if (periodic)
+            {
+                i = Boundary2D<BoundaryCondition::Periodic>::Wrap(i, rows);
+            }
+            else if (i < 0 || i >= rows)
+            {
+                std::fill(out, out + w, 0);
+                continue;
+            }
+            const int *row = grid + i * stride;
+            int c = 0;
+            while (c < w)
+            {
+                int j = col0 + c;
+                if (periodic)
+                {
+                    j = Boundary2D<BoundaryCondition::Periodic>::Wrap(j, cols);
+                }
+                else if (j < 0 || j >= cols)
+                {
+                    // run of outside cells up to the next edge of the grid (or the end of the block)
+                    int run = (j < 0) ? std::min(-j, w - c) : w - c;
+                    std::fill(out + c, out + c + run, 0);
+                    c += run;
+                    continue;
+                }
+                int run = std::min(w - c, cols - j); // contiguous cells until the right edge of the grid
+                std::copy(row + j, row + j + run, out + c);
+                c += run;
+            }
+        }
+    }
+
+    // Boundary3D<BC>::FillHalo - the 3D counterpart of Boundary2D: writes the ghost shell around a volume so
+    // every cell can read its 26 neighbors without range checks (wrapped copies for Periodic, zeros otherwise).
+    template <BoundaryCondition BC>
+    struct Boundary3D;
+
+    template <>
+    struct Boundary3D<BoundaryCondition::Periodic>
+    {
+        static void FillHalo(FlatGrid3D &grid)
+        {
+            const int layers = grid.layers(), rows = grid.rows(), cols = grid.cols(), halo = grid.halo();
+            const std::ptrdiff_t stride = grid.stride(), layer_stride = grid.layerStride();
+            if (grid.empty())
+                return;
+            const int width = cols + 2 * halo;
+            for (int k = 0; k < layers; ++k)
+            {
+                // inside each layer: the same torus wrap as in 2D
+                int *cells = grid.data() + k * layer_stride;
+                for (int i = 0; i < rows; ++i)
+                {
+                    int *row = cells + i * stride;
+                    for (int h = 1; h <= halo; ++h)
+                    {
+                        row[-h] = row[Wrap(-h, cols)];
+                        row[cols - 1 + h] = row[Wrap(cols - 1 + h, cols)];
+                    }
+                }
+                for (int h = 1; h <= halo; ++h)
+                {
+                    const int *top = cells + Wrap(-h, rows) * stride - halo;
+                    const int *bottom = cells + Wrap(rows - 1 + h, rows) * stride - halo;
+                    std::copy(top, top + width, cells - h * stride - halo);
+                    std::copy(bottom, bottom + width, cells + (rows - 1 + h) * stride - halo);
+                }
+            }
+            // halo layers are copies of whole padded layers from the other side
+            for (int h = 1; h <= halo; ++h)
+            {
+                const int targets[2] = {-h, layers - 1 + h};
+                for (int target : targets)
+                {
+                    const int *source = grid.data() + Wrap(target, layers) * layer_stride;
+                    int *out = grid.data() + target * layer_stride;
+                    for (int i = -halo; i < rows + halo; ++i)
+                        std::copy(source + i * stride - halo, source + i * stride - halo + width, out + i * stride - halo);
+                }
+            }
+        }
+
+        static int Wrap(int index, int size) { return ((index % size) + size) % size; }
+    };
+
+    // Constant halo: as in 2D, Fixed and NoBoundary both see zeros beyond the faces of the volume.
+    struct ZeroHalo3D
+    {
+        static void FillHalo(FlatGrid3D &grid)
+        {
+            const int layers = grid.layers(), rows = grid.rows(), cols = grid.cols(), halo = grid.halo();
+            const std::ptrdiff_t stride = grid.stride(), layer_stride = grid.layerStride();
+            const int width = cols + 2 * halo;
+            for (int k = -halo; k < layers + halo; ++k)
+            {
+                int *cells = grid.data() + k * layer_stride;
+                const bool halo_layer = (k < 0 || k >= layers);
+                for (int i = -halo; i < rows + halo; ++i)
+                {
+                    int *row = cells + i * stride;
+                    if (halo_layer || i < 0 || i >= rows)
+                    {
+                        std::fill(row - halo, row - halo + width, 0);
+                    }
+                    else
+                    {
+                        std::fill(row - halo, row, 0);
+                        std::fill(row + cols, row + cols + halo, 0);
+                    }
+                }
+            }
+        }
+    };
+
+    template <>
+    struct Boundary3D<BoundaryCondition::Fixed> : ZeroHalo3D
+    {
+    };
+
+    template <>
+    struct Boundary3D<BoundaryCondition::NoBoundary> : ZeroHalo3D
+    {
+    };
+
+    // Neighborhood3D<NT>::SweepRow computes one row of a 3D generation: out[j] = rule(neighbors, row[j]).
+    // `scratch` holds at least cols + 2 ints.
+    template <NeighborhoodType NT>
+    struct Neighborhood3D;
+
+    // Von Neumann: the six face neighbors.
+    template <>
+    struct Neighborhood3D<NeighborhoodType::VonNeumann>
+    {
+        template <typename Rule>
+        static void SweepRow(const int *row, int *out, std::ptrdiff_t layer_stride, std::ptrdiff_t stride, int cols, Rule &rule, int *)
+        {
+            for (int j = 0; j < cols; ++j)
+            {
+                const int *c = row + j;
+                int sum = c[-1] + c[1] + c[-stride] + c[stride] + c[-layer_stride] + c[layer_stride];
+                out[j] = rule(sum, c[0]);
+            }
+        }
+    };
+
+    // Moore: all 26 cells of the surrounding 3 x 3 x 3 cube. The 9 cells above, below and beside each column
+    // position are added once into scratch, and every cell then sums three neighboring columns, which takes
+    // 9 loads per cell instead of 26.
+    template <>
+    struct Neighborhood3D<NeighborhoodType::Moore>
+    {
+        template <typename Rule>
+        static void SweepRow(const int *row, int *out, std::ptrdiff_t layer_stride, std::ptrdiff_t stride, int cols, Rule &rule, int *scratch)
+        {
+            const int *above = row - layer_stride, *below = row + layer_stride;
+            for (int j = -1; j <= cols; ++j)
+            {
+                scratch[j + 1] = above[j - stride] + above[j] + above[j + stride] +
+                                 row[j - stride] + row[j] + row[j + stride] +
+                                 below[j - stride] + below[j] + below[j + stride];
+            }
+            for (int j = 0; j < cols; ++j)
+            {
+                out[j] = rule(scratch[j] + scratch[j + 1] + scratch[j + 2] - row[j], row[j]);
+            }
+        }
+    };
+
+    // Sweep3DLayers - computes layers [layer_begin, layer_end) of one 3D generation. `current` must have its
+    // halo filled; different layer ranges can be computed by different threads at the same time.
+    template <NeighborhoodType NT, typename Rule>
+    void Sweep3DLayers(const int *current, int *next, std::ptrdiff_t layer_stride, std::ptrdiff_t stride, int rows, int cols,
+                       Rule &rule, int layer_begin, int layer_end)
+    {
+        std::vector<int> scratch(static_cast<std::size_t>(cols) + 2);
+        for (int k = layer_begin; k < layer_end; ++k)
+        {
+            for (int i = 0; i < rows; ++i)
+            {
+                const std::ptrdiff_t offset = k * layer_stride + i * stride;
+                Neighborhood3D<NT>::SweepRow(current + offset, next + offset, layer_stride, stride, cols, rule, scratch.data());
+            }
+        }
+    }
+} // namespace ca_detail
+
+// Step<BC, NT>(rule)
+// advances the 2D grid by one generation with the boundary condition and neighborhood fixed at compile time.
+// BC and NT have to match the configuration the automaton was constructed with.
+template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+void CellularAutomata::Step(Rule &&rule)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("Step called on a non-2D automaton");
+    }
+    if (BC != boundary_condition_ || NT != neighborhood_type_)
+    {
+        throw std::runtime_error("Step instantiated for a different boundary condition or neighborhood type");
+    }
+    StepScope scope(*this);
+    StepUnchecked<BC, NT>(rule);
+    scope.Finish(1);
+}
+
+// Step(rule)
+// same as above but picks the instantiation from the runtime configuration (one switch per generation, not per cell).
+template <typename Rule>
+void CellularAutomata::Step(Rule &&rule)
+{
+    if (dimension_ == GridDimension::OneD)
+    {
+        throw std::runtime_error("Step called on a 1D automaton");
+    }
+    StepScope scope(*this);
+    if (dimension_ == GridDimension::ThreeD)
+    {
+        Sweep3D(rule);
+        grid_3d_.swap(next_grid_3d_);
+        EndPhase(&StepStats::swap_seconds);
+        scope.Finish(1);
+        return;
+    }
+    switch (boundary_condition_)
+    {
+    case BoundaryCondition::Periodic:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            StepUnchecked<BoundaryCondition::Periodic, NeighborhoodType::Moore>(rule);
+        else
+            StepUnchecked<BoundaryCondition::Periodic, NeighborhoodType::VonNeumann>(rule);
+        break;
+    case BoundaryCondition::Fixed:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            StepUnchecked<BoundaryCondition::Fixed, NeighborhoodType::Moore>(rule);
+        else
+            StepUnchecked<BoundaryCondition::Fixed, NeighborhoodType::VonNeumann>(rule);
+        break;
+    case BoundaryCondition::NoBoundary:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            StepUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::Moore>(rule);
+        else
+            StepUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann>(rule);
+        break;
+    }
+    scope.Finish(1);
+}
+
+// StepUnchecked<BC, NT>(rule)
+// the shared body: fill the halo of the front buffer for the boundary condition, sweep the front buffer into
+// the back buffer (in row bands across the thread pool when SetThreadCount was used), then swap them.
+template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+void CellularAutomata::StepUnchecked(Rule &rule)
+{
+    if (active_tracking_)
+    {
+        auto sweep = [&rule](const int *current, int *next, std::ptrdiff_t stride, int cols, int row_begin, int row_end) {
+            ca_detail::Sweep2DRows<NT>(current, next, stride, cols, rule, row_begin, row_end);
+            return true;
+        };
+        StepActiveTiles(sweep);
+        return;
+    }
+    ca_detail::Boundary2D<BC>::FillHalo(grid_2d_);
+    EndPhase(&StepStats::neighbor_seconds);
+    const int *current = grid_2d_.data();
+    int *next = next_grid_2d_.data();
+    const std::ptrdiff_t stride = grid_2d_.stride();
+    const int cols = grid_2d_.cols();
+    RunRowBands(grid_2d_.rows(), cols, [&](int begin, int end) {
+        ca_detail::Sweep2DRows<NT>(current, next, stride, cols, rule, begin, end);
+    });
+    EndPhase(&StepStats::rule_seconds);
+    grid_2d_.swap(next_grid_2d_); // flip front and back buffers, only the buffer pointers are exchanged
+    EndPhase(&StepStats::swap_seconds);
+}
+
+// StepRuleFunction<BC, NT>
+// non-template entry point stored in step_2d_ by the constructor so ApplyRule2D dispatches through a
+// single member function pointer instead of re-checking the configuration for every neighbor.
+template <BoundaryCondition BC, NeighborhoodType NT>
+void CellularAutomata::StepRuleFunction(const RuleFunction2D &rule_func)
+{
+    StepUnchecked<BC, NT>(rule_func);
+}
+
+// StepStochastic(seed, step, rule)
+// the runtime switch of Step(rule), for rules that take a CellRandom as third argument.
+template <typename Rule>
+void CellularAutomata::StepStochastic(std::uint64_t seed, std::uint64_t step, Rule &&rule)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("StepStochastic called on a non-2D automaton");
+    }
+    StepScope scope(*this);
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    switch (boundary_condition_)
+    {
+    case BoundaryCondition::Periodic:
+        if (moore)
+            StepStochasticUnchecked<BoundaryCondition::Periodic, NeighborhoodType::Moore>(seed, step, rule);
+        else
+            StepStochasticUnchecked<BoundaryCondition::Periodic, NeighborhoodType::VonNeumann>(seed, step, rule);
+        break;
+    case BoundaryCondition::Fixed:
+        if (moore)
+            StepStochasticUnchecked<BoundaryCondition::Fixed, NeighborhoodType::Moore>(seed, step, rule);
+        else
+            StepStochasticUnchecked<BoundaryCondition::Fixed, NeighborhoodType::VonNeumann>(seed, step, rule);
+        break;
+    case BoundaryCondition::NoBoundary:
+        if (moore)
+            StepStochasticUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::Moore>(seed, step, rule);
+        else
+            StepStochasticUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann>(seed, step, rule);
+        break;
+    }
+    scope.Finish(1);
+}
+
+// StepStochasticUnchecked<BC, NT>(seed, step, rule)
+// same structure as StepUnchecked, always over the whole grid; the row bands draw from disjoint cell streams.
+// The first random block of each row is precomputed with the instruction set chosen by SetSimdLevel.
+template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+void CellularAutomata::StepStochasticUnchecked(std::uint64_t seed, std::uint64_t step, Rule &rule)
+{
+    ca_detail::Boundary2D<BC>::FillHalo(grid_2d_);
+    EndPhase(&StepStats::neighbor_seconds);
+    const int *current = grid_2d_.data();
+    int *next = next_grid_2d_.data();
+    const std::ptrdiff_t stride = grid_2d_.stride();
+    const int cols = grid_2d_.cols();
+    const SimdLevel level = simd_level_;
+    RunRowBands(grid_2d_.rows(), cols, [&](int begin, int end) {
+        std::vector<std::uint32_t> scratch(4 * static_cast<std::size_t>(cols));
+        ca_detail::Sweep2DRowsStochastic<NT>(current, next, stride, cols, rule, begin, end, seed, step, level, scratch.data());
+    });
+    EndPhase(&StepStats::rule_seconds);
+    grid_2d_.swap(next_grid_2d_);
+    active_all_dirty_ = true; // the sparse activity bookkeeping does not know which cells changed
+    EndPhase(&StepStats::swap_seconds);
+}
+
+// StepCounts(rule), StepCounts(seed, step, rule)
+// both go through StepCountsUnchecked; only the call of the rule differs.
+template <typename Rule>
+void CellularAutomata::StepCounts(Rule &&rule)
+{
+    StepCountsUnchecked<false>(0, 0, rule);
+}
+
+template <typename Rule>
+void CellularAutomata::StepCounts(std::uint64_t seed, std::uint64_t step, Rule &&rule)
+{
+    StepCountsUnchecked<true>(seed, step, rule);
+}
+
+// StepCountsUnchecked<Stochastic>(seed, step, rule)
+// per row: one vectorized pass for the histograms into a band-local buffer, then the rule over it. A state
+// outside of the histogram stops the band; the buffers are only swapped when every row was valid.
+template <bool Stochastic, typename Rule>
+void CellularAutomata::StepCountsUnchecked(std::uint64_t seed, std::uint64_t step, Rule &rule)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("StepCounts called on a non-2D automaton");
+    }
+    StepScope scope(*this);
+    FillCountHalo2D();
+    EndPhase(&StepStats::neighbor_seconds);
+    const int *current = grid_2d_.data();
+    int *next = next_grid_2d_.data();
+    const std::ptrdiff_t stride = grid_2d_.stride();
+    const int cols = grid_2d_.cols();
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    const SimdLevel level = simd_level_;
+    std::atomic<bool> valid(true);
+    // instrumented: per-row clock reads to split the sweep between histograms and rule
+    const bool timed = step_open_;
+    std::atomic<long long> count_nanoseconds(0), rule_nanoseconds(0);
+    RunRowBands(grid_2d_.rows(), cols, [&](int begin, int end) {
+        std::vector<std::uint32_t> counts(cols);
+        std::vector<std::uint32_t> scratch(Stochastic ? 4 * static_cast<std::size_t>(cols) : 0);
+        StepClock::duration count_time(0), rule_time(0);
+        for (int i = begin; i < end; ++i)
+        {
+            const int *row = current + i * stride;
+            const StepClock::time_point t0 = timed ? StepClock::now() : StepClock::time_point();
+            if (!ca_detail::CountNeighborStates2D(row, stride, cols, moore, counts.data(), level))
+            {
+                valid = false;
+                return;
+            }
+            const StepClock::time_point t1 = timed ? StepClock::now() : StepClock::time_point();
+            ca_detail::CountsRow<Stochastic>::Apply(rule, counts.data(), row, next + i * stride, cols, i, seed, step,
+                                                    level, scratch.data());
+            if (timed)
+            {
+                const StepClock::time_point t2 = StepClock::now();
+                count_time += t1 - t0;
+                rule_time += t2 - t1;
+            }
+        }
+        if (timed)
+        {
+            count_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(count_time).count();
+            rule_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(rule_time).count();
+        }
+    });
+    if (!valid)
+    {
+        throw std::out_of_range("Grid holds a state outside of the neighbor histogram");
+    }
+    EndSplitPhase(count_nanoseconds, rule_nanoseconds);
+    grid_2d_.swap(next_grid_2d_);
+    active_all_dirty_ = true; // the sparse activity bookkeeping is only kept by Step and ApplyRule2D
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
+}
+
+// StepKernel(kernel, rule)
+// the potentials of the whole grid first, then one pass of the rule over them in row bands.
+template <typename Rule>
+void CellularAutomata::StepKernel(const ConvolutionKernel &kernel, Rule &&rule)
+{
+    StepScope scope(*this);
+    ComputePotential(kernel, potential_);
+    EndPhase(&StepStats::neighbor_seconds);
+    const double *potential = potential_.data();
+    const int cols = grid_2d_.cols();
+    RunRowBands(grid_2d_.rows(), cols, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            const int *current = grid_2d_.data() + i * grid_2d_.stride();
+            int *next = next_grid_2d_.data() + i * next_grid_2d_.stride();
+            const double *p = potential + static_cast<std::size_t>(i) * cols;
+            for (int j = 0; j < cols; ++j)
+                next[j] = rule(p[j], current[j]);
+        }
+    });
+    EndPhase(&StepStats::rule_seconds);
+    grid_2d_.swap(next_grid_2d_);
+    active_all_dirty_ = true; // the sparse activity tiles assume a radius-1 neighborhood
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
+}
+
+// Sweep3D(rule)
+// writes the next 3D generation into the back buffer (the caller swaps): one runtime switch, then the halo
+// fill and the layer sweep are specialized for the configuration.
+template <typename Rule>
+void CellularAutomata::Sweep3D(Rule &rule)
+{
+    switch (boundary_condition_)
+    {
+    case BoundaryCondition::Periodic:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            Sweep3DUnchecked<BoundaryCondition::Periodic, NeighborhoodType::Moore>(rule);
+        else
+            Sweep3DUnchecked<BoundaryCondition::Periodic, NeighborhoodType::VonNeumann>(rule);
+        break;
+    case BoundaryCondition::Fixed:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            Sweep3DUnchecked<BoundaryCondition::Fixed, NeighborhoodType::Moore>(rule);
+        else
+            Sweep3DUnchecked<BoundaryCondition::Fixed, NeighborhoodType::VonNeumann>(rule);
+        break;
+    case BoundaryCondition::NoBoundary:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            Sweep3DUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::Moore>(rule);
+        else
+            Sweep3DUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann>(rule);
+        break;
+    }
+}
+
+// Sweep3DUnchecked<BC, NT>(rule)
+// fills the halo of the front 3D buffer and sweeps it into the back buffer in bands of layers.
+template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+void CellularAutomata::Sweep3DUnchecked(Rule &rule)
+{
+    ca_detail::Boundary3D<BC>::FillHalo(grid_3d_);
+    EndPhase(&StepStats::neighbor_seconds);
+    const int *current = grid_3d_.data();
+    int *next = next_grid_3d_.data();
+    const std::ptrdiff_t stride = grid_3d_.stride(), layer_stride = grid_3d_.layerStride();
+    const int rows = grid_3d_.rows(), cols = grid_3d_.cols();
+    RunRowBands(grid_3d_.layers(), rows * cols, [&](int begin, int end) {
+        ca_detail::Sweep3DLayers<NT>(current, next, layer_stride, stride, rows, cols, rule, begin, end);
+    });
+    EndPhase(&StepStats::rule_seconds);
+}
+
+// Run(steps, rule)
+// picks the tiled driver for functions/functors or for RuleTables (tag dispatch, so a non-const RuleTable
+// argument still reaches the vectorized table path).
+template <typename Rule>
+void CellularAutomata::Run(int steps, Rule &&rule)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("Run called on a non-2D automaton");
+    }
+    if (steps < 0)
+    {
+        throw std::invalid_argument("Run needs a non-negative number of steps");
+    }
+    StepScope scope(*this);
+    if (cycle_detection_)
+    {
+        scope.Finish(RunDetectingCycles(steps, rule));
+        return;
+    }
+    RunRule(steps, rule, std::is_same<typename std::decay<Rule>::type, RuleTable>());
+    scope.Finish(steps);
+}
+
+// RunDetectingCycles(steps, rule)
+// one generation at a time through RunRule (so rule tables keep their vectorized kernels), recording every
+// generation until a cycle is confirmed. Then either the remaining steps modulo the period are run, which
+// leaves the grid `steps` generations would, or (Stop) the call returns with the grid where it is.
+template <typename Rule>
+long long CellularAutomata::RunDetectingCycles(int steps, Rule &rule)
+{
+    typedef std::is_same<typename std::decay<Rule>::type, RuleTable> is_table;
+    BeginCycleSearch();
+    long long generation = 0, computed = 0;
+    while (generation < steps)
+    {
+        RunRule(1, rule, is_table());
+        ++generation;
+        ++computed;
+        if (!RecordCycleGeneration(generation))
+            continue;
+        if (cycle_action_ == CycleAction::FastForward)
+        {
+            const int skip = static_cast<int>((steps - generation) % cycle_info_.period);
+            RunRule(skip, rule, is_table());
+            computed += skip;
+            generation = steps;
+        }
+        break;
+    }
+    cycle_info_.generations = generation;
+    cycle_info_.computed = computed;
+    return generation;
+}
+
+// RunRule
+// function/functor rules: one runtime switch per call, then everything below is specialized.
+template <typename Rule>
+void CellularAutomata::RunRule(int steps, Rule &rule, std::false_type)
+{
+    switch (boundary_condition_)
+    {
+    case BoundaryCondition::Periodic:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            RunUnchecked<BoundaryCondition::Periodic, NeighborhoodType::Moore>(steps, rule);
+        else
+            RunUnchecked<BoundaryCondition::Periodic, NeighborhoodType::VonNeumann>(steps, rule);
+        break;
+    case BoundaryCondition::Fixed:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            RunUnchecked<BoundaryCondition::Fixed, NeighborhoodType::Moore>(steps, rule);
+        else
+            RunUnchecked<BoundaryCondition::Fixed, NeighborhoodType::VonNeumann>(steps, rule);
+        break;
+    case BoundaryCondition::NoBoundary:
+        if (neighborhood_type_ == NeighborhoodType::Moore)
+            RunUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::Moore>(steps, rule);
+        else
+            RunUnchecked<BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann>(steps, rule);
+        break;
+    }
+}
+
+// RunUnchecked<BC, NT>(steps, rule)
+// advances the grid in blocks of temporal_depth_ generations. Grids that fit in a single tile are already
+// cache resident, so they (and the last single generation of a run) are stepped one generation at a time.
+template <BoundaryCondition BC, NeighborhoodType NT, typename Rule>
+void CellularAutomata::RunUnchecked(int steps, Rule &rule)
+{
+    const bool single_tile = grid_2d_.rows() <= temporal_tile_rows_ && grid_2d_.cols() <= temporal_tile_cols_;
+    auto sweep = [&rule](const int *current, int *next, std::ptrdiff_t stride, int cols, int row_begin, int row_end) {
+        ca_detail::Sweep2DRows<NT>(current, next, stride, cols, rule, row_begin, row_end);
+        return true;
+    };
+    while (steps > 0)
+    {
+        int depth = std::min(steps, temporal_depth_);
+        if (depth < 2 || single_tile)
+        {
+            StepUnchecked<BC, NT>(rule);
+            --steps;
+            continue;
+        }
+        RunTemporalBlock<BC>(depth, sweep);
+        steps -= depth;
+    }
+}
+
+// RunTemporalBlock<BC>(depth, sweep)
+// advances the whole grid `depth` generations, tile by tile (rows of tiles are split across the thread pool).
+// A tile of th x tw cells is loaded with a margin of `depth` cells on every side; generation g is then computed
+// on the block shrunk by g cells per side, so after `depth` generations exactly the tile itself is valid.
+// Outside a non-periodic grid the tile buffers hold 0 and are never written, which reproduces the zero halo.
+// sweep(current, next, stride, cols, row_begin, row_end) computes a rectangle and returns false when it met a
+// state it cannot handle; the grid is then left unchanged and false is returned.
+template <BoundaryCondition BC, typename Sweep>
+bool CellularAutomata::RunTemporalBlock(int depth, Sweep &sweep)
+{
+    const bool periodic = (BC == BoundaryCondition::Periodic);
+    const int rows = grid_2d_.rows(), cols = grid_2d_.cols();
+    const int tile_h = temporal_tile_rows_, tile_w = temporal_tile_cols_;
+    const int tile_rows = (rows + tile_h - 1) / tile_h, tile_cols = (cols + tile_w - 1) / tile_w;
+    const std::ptrdiff_t stride = grid_2d_.stride();
+    const std::ptrdiff_t width = tile_w + 2 * depth; // row stride of the tile buffers
+    const std::ptrdiff_t height = tile_h + 2 * depth;
+    const int *source = grid_2d_.data();
+    int *target = next_grid_2d_.data();
+    std::atomic<bool> valid(true);
+
+    RunRowBands(tile_rows, tile_h * cols, [&](int band_begin, int band_end) {
+        std::vector<int, AlignedAllocator<int>> front(width * height), back(width * height);
+        for (int tr = band_begin; tr < band_end; ++tr)
+        {
+            for (int tc = 0; tc < tile_cols; ++tc)
+            {
+                const int i0 = tr * tile_h, j0 = tc * tile_w;
+                const int th = std::min(tile_h, rows - i0), tw = std::min(tile_w, cols - j0);
+                const int row0 = i0 - depth, col0 = j0 - depth; // grid coordinates of the block's top left cell
+                const int h = th + 2 * depth, w = tw + 2 * depth;
+                ca_detail::LoadTile(source, stride, rows, cols, periodic, row0, col0, h, w, front.data(), width);
+                if (!periodic && (row0 < 0 || col0 < 0 || row0 + h > rows || col0 + w > cols))
+                {
+                    std::fill(back.begin(), back.end(), 0); // outside cells of the second buffer must be 0 as well
+                }
+
+                int *current = front.data(), *next = back.data();
+                for (int g = 1; g <= depth; ++g)
+                {
+                    int r_begin = g, r_end = h - g, c_begin = g, c_end = w - g;
+                    if (!periodic)
+                    {
+                        // never compute cells outside the grid, they stay 0
+                        r_begin = std::max(r_begin, -row0);
+                        r_end = std::min(r_end, rows - row0);
+                        c_begin = std::max(c_begin, -col0);
+                        c_end = std::min(c_end, cols - col0);
+                    }
+                    if (!sweep(current + c_begin, next + c_begin, width, c_end - c_begin, r_begin, r_end))
+                        valid = false;
+                    std::swap(current, next);
+                }
+
+                for (int r = 0; r < th; ++r)
+                {
+                    const int *in = current + (depth + r) * width + depth;
+                    std::copy(in, in + tw, target + (i0 + r) * stride + j0);
+                }
+            }
+        }
+    });
+    if (!valid)
+    {
+        return false;
+    }
+    EndPhase(&StepStats::rule_seconds); // loading the tiles and their margins included
+    grid_2d_.swap(next_grid_2d_);
+    active_all_dirty_ = true; // the back buffer is several generations old now
+    EndPhase(&StepStats::swap_seconds);
+    return true;
+}
+
+// StepActiveTiles(sweep)
+// one generation in sparse activity mode. Tiles that are not dirty are skipped entirely: their cells did not
+// change in the last step, so the back buffer still holds the same values as the front buffer there and the
+// swap keeps them. Every recomputed tile is compared with its old cells to find the tiles that changed.
+// sweep has the same meaning as in RunTemporalBlock; on failure the grid is left unchanged and false is returned.
+template <typename Sweep>
+bool CellularAutomata::StepActiveTiles(Sweep &sweep)
+{
+    const int rows = grid_2d_.rows(), cols = grid_2d_.cols(), tile = active_tile_;
+    const int tile_rows = (rows + tile - 1) / tile, tile_cols = (cols + tile - 1) / tile;
+    const std::size_t tile_count = static_cast<std::size_t>(tile_rows) * tile_cols;
+    if (active_tiles_.size() != tile_count)
+    {
+        active_tiles_.assign(tile_count, 1);
+        changed_tiles_.assign(tile_count, 0);
+        active_all_dirty_ = true;
+    }
+    if (active_all_dirty_)
+    {
+        std::fill(active_tiles_.begin(), active_tiles_.end(), 1);
+    }
+    long long active = 0;
+    for (unsigned char flag : active_tiles_)
+        active += flag;
+    const bool dense = (active * 2 > static_cast<long long>(tile_count)); // sweep whole rows instead of tiles
+
+    FillHalo2D();
+    EndPhase(&StepStats::neighbor_seconds);
+    const int *current = grid_2d_.data();
+    int *next = next_grid_2d_.data();
+    const std::ptrdiff_t stride = grid_2d_.stride();
+    std::atomic<bool> valid(true);
+    RunRowBands(tile_rows, tile * cols, [&](int band_begin, int band_end) {
+        for (int tr = band_begin; tr < band_end; ++tr)
+        {
+            const int i0 = tr * tile, i1 = std::min(rows, i0 + tile);
+            if (dense && !sweep(current, next, stride, cols, i0, i1))
+                valid = false;
+            for (int tc = 0; tc < tile_cols; ++tc)
+            {
+                const std::size_t index = static_cast<std::size_t>(tr) * tile_cols + tc;
+                const int j0 = tc * tile, width = std::min(cols, j0 + tile) - j0;
+                if (!dense && !active_tiles_[index])
+                {
+                    changed_tiles_[index] = 0;
+                    continue;
+                }
+                if (!dense && !sweep(current + j0, next + j0, stride, width, i0, i1))
+                    valid = false;
+                unsigned char changed = 0;
+                for (int i = i0; i < i1 && !changed; ++i)
+                    changed = !std::equal(current + i * stride + j0, current + i * stride + j0 + width, next + i * stride + j0);
+                changed_tiles_[index] = changed;
+            }
+        }
+    });
+    tiles_processed_ = dense ? static_cast<long long>(tile_count) : active;
+    EndPhase(&StepStats::rule_seconds); // the comparisons that find the changed tiles included
+    if (!valid)
+    {
+        active_all_dirty_ = true; // parts of the back buffer were overwritten
+        return false;
+    }
+    UpdateActiveTiles(tile_rows, tile_cols);
+    grid_2d_.swap(next_grid_2d_);
+    active_all_dirty_ = false;
+    EndPhase(&StepStats::swap_seconds);
+    return true;
+}
+
+#endif // STEP_ENGINE_H - marks the end of the header guard conditional
@@ -0,0 +1,56 @@
+// Include/StepStats.h
+#pragma once        // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef STEP_STATS_H // Include guard (if STEP_STATS_H not included yet define it and continue)
+#define STEP_STATS_H
+
+#include <vector>
+
+// StepStats - what one stepping call of an instrumented CellularAutomata did (see SetInstrumentation).
+// The wall time of the call is split into phases:
+//   neighbor_seconds  filling the halo for the boundary condition, plus the separate neighbor passes of
+//                     StepCounts (the histograms) and StepKernel (the potentials)
+//   rule_seconds      the sweep that applies the rule. Most engines (ApplyRule1D/2D/3D, Step, StepStochastic,
+//                     StepNeuron, Run, RunHashlife) add up the neighbors inside that sweep, one cell at a time,
+//                     so their neighbor counting is included here; StepCounts times the two per row and splits
+//                     its sweep between neighbor_seconds and rule_seconds accordingly
+//   swap_seconds      exchanging the front and back buffers, and the sparse activity bookkeeping
+//   count_seconds     the pass that fills the counters below (0 when counting is off), and the grid hashing
+//                     of Run with cycle detection
+// total_seconds is the whole call, including validation and dispatch that belong to none of the phases.
+// io_seconds is the time spent in Print and in trajectory writers since the previous call; it is not part
+// of total_seconds. The counters describe the grid after the call:
+//   cells_changed     cells whose state differs from the previous generation (-1 when the call advanced more
+//                     than one generation, used an engine that does not keep the previous generation around
+//                     (RunHashlife), or counting is off)
+//   population        cells in a state other than 0 (INACTIVE)
+//   histogram         histogram[s] is the number of cells in state s, up to the highest state present below
+//                     HISTOGRAM_STATES; cells in states outside of 0 .. HISTOGRAM_STATES - 1 are other_states
+// The totals (GetTotalStats) add up the times, calls, generations and changed cells of every call since the
+// instrumentation was enabled or reset, and keep the population and histogram of the last call.
+struct StepStats
+{
+    static const int HISTOGRAM_STATES = 256;
+
+    long long calls;       // stepping calls covered: 1 for the record of a single call
+    long long generations; // generations advanced (1 per step, more for Run and RunHashlife)
+
+    double neighbor_seconds;
+    double rule_seconds;
+    double swap_seconds;
+    double count_seconds;
+    double io_seconds;
+    double total_seconds;
+
+    long long cells_changed;
+    long long population;
+    long long other_states;
+    std::vector<long long> histogram;
+
+    StepStats()
+        : calls(0), generations(0), neighbor_seconds(0.0), rule_seconds(0.0), swap_seconds(0.0), count_seconds(0.0),
+          io_seconds(0.0), total_seconds(0.0), cells_changed(-1), population(-1), other_states(0)
+    {
+    }
+};
+
+#endif // STEP_STATS_H - marks the end of the header guard conditional
@@ -0,0 +1,57 @@
+// Include/ThreadPool.h
+#pragma once       // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef THREAD_POOL_H // Include guard (if THREAD_POOL_H not included yet define it and continue)
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ThreadPool - a fixed set of worker threads that stay alive between generations.
+// Each generation of a cellular automaton reads the old grid and writes the new one, so the rows can be
+// split into independent bands. ParallelFor hands one contiguous band to every thread (the calling thread
+// works on the first band itself) and returns once all bands are done. Starting threads once instead of
+// once per step keeps the per-generation overhead to two condition variable round trips.
+class ThreadPool
+{
+public:
+    using BandFunction = std::function<void(int begin, int end)>;
+
+    // threads is the total number of threads that work on a ParallelFor, including the caller (at least 1).
+    explicit ThreadPool(int threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Splits [0, count) into size() contiguous bands of nearly equal length and runs body(begin, end) on each,
+    // in parallel. Blocks until every band has finished; an exception thrown by a band is rethrown here.
+    // Calls from different threads are serialized.
+    void ParallelFor(int count, const BandFunction &body);
+
+    // Number of hardware threads (at least 1).
+    static int HardwareThreads();
+
+private:
+    void WorkerLoop(int index);
+    void RunBand(int index);
+
+    std::vector<std::thread> workers_;
+    std::mutex submit_mutex_;       // serializes ParallelFor calls
+    std::mutex mutex_;              // protects the fields below
+    std::condition_variable start_; // signals workers that a new job is available
+    std::condition_variable done_;  // signals the caller that the last band finished
+    const BandFunction *body_;      // job of the current ParallelFor call
+    int count_;                     // range of the current job
+    unsigned long generation_;      // incremented for every job, so workers can tell new jobs apart
+    int pending_;                   // worker bands of the current job that have not finished yet
+    bool stopping_;                 // set by the destructor
+    std::exception_ptr error_;      // first exception thrown by a band
+};
+
+#endif // THREAD_POOL_H - marks the end of the header guard conditional
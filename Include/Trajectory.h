@@ -0,0 +1,199 @@
+// Include/Trajectory.h
+#pragma once         // A preprocessor directive to prevent multiple inclusions of the header file during compilation.
+#ifndef TRAJECTORY_H // Include guard (if TRAJECTORY_H not included yet define it and continue)
+#define TRAJECTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "BinaryFile.h"
+#include "CellularAutomata.h"
+
+// Binary trajectory files: a sequence of generations of one automaton, written far faster than the
+// whitespace-separated text of the test harness and readable without parsing.
+//
+// Layout (all values in the byte order of the machine that wrote the file, checked by a byte-order mark):
+//   header   "CATRAJ01", byte-order mark 0x01020304, version, header size, dimension, boundary condition,
+//            neighborhood type, encoding, layers, rows, cols, frame size, rule text length, keyframe
+//            interval, rule text; padded to a multiple of 64 bytes
+//   frames   Raw and BitPacked: one fixed-size record per generation, the 64-bit generation number followed
+//            by the cells in row-major order (layer by layer in 3D), either as 32-bit ints (Raw) or as one
+//            bit per cell (BitPacked, bit n of the payload is cell n, least significant bit first), padded
+//            to 8 bytes. Frame n starts at header size + n * frame size.
+//            Delta: variable-size records, the generation number, a 32-bit kind (0 keyframe, 1 delta) and the
+//            32-bit payload size, then the payload padded to 8 bytes. The payload run-length codes the XOR of
+//            the cells with the previous frame (with an all-zero frame for keyframes), so the runs of zeros
+//            are the unchanged cells. Runs are a sequence of (zero run length, literal count, literals...) with
+//            every number written as a LEB128 varint.
+// The number of frames follows from the file size, so a run that was interrupted still leaves a readable file.
+// Utils/Data/testgraphing.py has the matching numpy reader; Include/AsyncTrajectoryWriter.h writes the same
+// files from a background thread.
+
+// How the cells of a frame are stored.
+enum class TrajectoryEncoding
+{
+    Raw,       // 32-bit ints, any state
+    BitPacked, // one bit per cell, only for states 0 and 1 (32x smaller than Raw)
+    Delta      // keyframe every keyframe_interval frames, run-length coded XOR deltas in between, any state
+};
+
+// Everything the header records about the automaton.
+struct TrajectoryInfo
+{
+    GridDimension dimension;
+    BoundaryCondition boundary;
+    NeighborhoodType neighborhood;
+    TrajectoryEncoding encoding;
+    int layers, rows, cols; // 1 x 1 x cells in 1D, 1 x rows x cols in 2D
+    std::string rule;       // free text, for example RuleTable::ToString()
+    int keyframe_interval;  // Delta: a keyframe every this many frames (reading frame n decodes at most this many frames)
+
+    static const int DEFAULT_KEYFRAME_INTERVAL = 64;
+
+    // The shape and configuration of `ca`.
+    static TrajectoryInfo From(const CellularAutomata &ca, TrajectoryEncoding encoding = TrajectoryEncoding::Raw,
+                               const std::string &rule = std::string());
+
+    long long CellCount() const { return static_cast<long long>(layers) * rows * cols; }
+    // Size in bytes of one frame record (generation number, cells and padding); 0 for Delta, whose records
+    // vary in size.
+    std::size_t FrameBytes() const;
+};
+
+// TrajectoryWriter - appends frames to a trajectory file through a large in-memory buffer, so the file
+// receives a few big writes instead of one small write per cell. Frames must match the shape in the header.
+// With the Delta encoding it is a recorder: only the cells that changed since the previous frame are stored
+// between keyframes, which usually makes the file an order of magnitude smaller than Raw.
+// The file is complete after Close() (or the destructor); errors throw std::runtime_error.
+class TrajectoryWriter
+{
+public:
+    static const std::size_t DEFAULT_BUFFER_BYTES = std::size_t(4) << 20;
+
+    TrajectoryWriter(const std::string &path, const TrajectoryInfo &info, std::size_t buffer_bytes = DEFAULT_BUFFER_BYTES);
+    ~TrajectoryWriter();
+
+    TrajectoryWriter(const TrajectoryWriter &) = delete;
+    TrajectoryWriter &operator=(const TrajectoryWriter &) = delete;
+
+    const TrajectoryInfo &info() const { return info_; }
+
+    // Append one generation. With BitPacked a state other than 0 or 1 throws std::invalid_argument before
+    // anything of the frame is written.
+    void WriteFrame(const std::vector<int> &grid, long long generation);
+    void WriteFrame(const FlatGrid2D &grid, long long generation);
+    void WriteFrame(const FlatGrid3D &grid, long long generation);
+    // The current grid of `ca`, whatever its dimension.
+    void WriteFrame(const CellularAutomata &ca, long long generation);
+    // A frame already packed in row-major order: info().CellCount() cells (layer by layer in 3D).
+    void WriteCells(const int *cells, long long generation);
+
+    long long FrameCount() const { return frames_; }
+    // Bytes of the file so far, header included.
+    long long BytesWritten() const { return bytes_written_; }
+    // Pushes the buffered frames to the operating system.
+    void Flush();
+    void Close();
+
+private:
+    TrajectoryInfo info_;
+    std::FILE *file_;
+    std::vector<unsigned char> buffer_;
+    std::size_t used_;
+    long long frames_;
+    std::uint64_t pending_bits_; // BitPacked: cells not yet written out as whole bytes
+    int pending_count_;
+    std::size_t payload_written_;
+    long long bytes_written_;
+    long long generation_;                   // Delta: generation of the frame being written
+    std::vector<int> previous_;              // Delta: cells of the last frame (all zero before a keyframe)
+    std::vector<unsigned char> encoded_;     // Delta: payload of the frame being written
+    std::size_t cursor_;                     // Delta: cells of the frame seen so far
+    std::size_t run_unchanged_;              // Delta: current run of unchanged cells
+    std::vector<std::uint32_t> run_literals_; // Delta: XOR of the changed cells that follow it
+
+    void CheckShape(int layers, int rows, int cols) const;
+    void Put(const void *data, std::size_t bytes);
+    void BeginFrame(long long generation);
+    void PutRow(const int *cells, int count);
+    void EndFrame();
+    void PutDeltaRow(const int *cells, std::size_t count);
+    void FlushRun();
+};
+
+// TrajectoryFrame - a zero-copy view of one frame inside a TrajectoryReader (valid while the reader lives).
+// Delta frames have to be decoded: their view points at the reader's decoded copy, which the next call to
+// Frame or ReadFrame on the same reader replaces.
+class TrajectoryFrame
+{
+public:
+    TrajectoryFrame(const unsigned char *record, const TrajectoryInfo &info);
+    TrajectoryFrame(long long generation, const int *cells, const TrajectoryInfo &info);
+
+    long long generation() const { return generation_; }
+    long long cellCount() const { return cell_count_; }
+    // Raw and Delta frames: pointer to the cells in row-major order; null for BitPacked frames.
+    const int *cells() const { return raw_ ? reinterpret_cast<const int *>(payload_) : nullptr; }
+    // The packed bits of a BitPacked frame (or the bytes of the ints of a Raw frame).
+    const unsigned char *payload() const { return payload_; }
+
+    // Cell n in row-major order, cell (i, j) of a 2D frame and cell (k, i, j) of a 3D frame.
+    int Get(long long index) const
+    {
+        return raw_ ? cells()[index] : (payload_[index >> 3] >> (index & 7)) & 1;
+    }
+    int At(int i, int j) const { return Get(static_cast<long long>(i) * cols_ + j); }
+    int At(int k, int i, int j) const { return Get((static_cast<long long>(k) * rows_ + i) * cols_ + j); }
+
+private:
+    const unsigned char *payload_;
+    long long generation_;
+    long long cell_count_;
+    int rows_, cols_;
+    bool raw_;
+};
+
+// TrajectoryReader - maps a trajectory file into memory (on POSIX systems; elsewhere it is read once) and
+// hands out frames without copying. Throws std::runtime_error for files that are not trajectories.
+// Delta files are indexed when they are opened; frame n is decoded from the nearest keyframe before it (or
+// from the previously decoded frame when reading forward). A reader is not meant to be shared by threads.
+class TrajectoryReader
+{
+public:
+    explicit TrajectoryReader(const std::string &path);
+
+    TrajectoryReader(const TrajectoryReader &) = delete;
+    TrajectoryReader &operator=(const TrajectoryReader &) = delete;
+
+    const TrajectoryInfo &info() const { return info_; }
+    long long FrameCount() const { return frames_; }
+
+    // Throws std::out_of_range for an index outside [0, FrameCount()).
+    TrajectoryFrame Frame(long long index) const;
+
+    // Copies frame `index` into a grid of the header's shape (the grid is resized when it differs).
+    void ReadFrame(long long index, std::vector<int> &grid) const;
+    void ReadFrame(long long index, FlatGrid2D &grid) const;
+    void ReadFrame(long long index, FlatGrid3D &grid) const;
+
+private:
+    TrajectoryInfo info_;
+    ca_detail::MappedFile file_;
+    const unsigned char *data_;           // the whole file (file_.data())
+    std::size_t size_;
+    std::size_t header_bytes_;
+    long long frames_;
+    std::vector<std::size_t> offsets_;   // Delta: start of every record
+    std::vector<long long> keyframes_;   // Delta: indices of the keyframes, ascending
+    mutable std::vector<int> decoded_;   // Delta: cells of frame decoded_index_
+    mutable long long decoded_index_;
+
+    void IndexDeltaRecords();
+    void DecodeFrame(long long index) const;
+
+    void UnpackRow(const TrajectoryFrame &frame, long long first, int count, int *out) const;
+};
+
+#endif // TRAJECTORY_H - marks the end of the header guard conditional
@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../Include/CellularAutomata.h"
+#include "../Include/ThreadPool.h"
+using namespace std;
+
+// Stepping throughput benchmark: cells updated per second for ApplyRule1D, ApplyRule2D (rule functions and
+// rule tables) and StepNeuron, over grid sizes, boundary conditions, neighborhood types and rules.
+// Every configuration is warmed up, then timed over several repetitions of enough steps to last at least
+// --min-rep-ms; the best and the median time per step are reported as CSV or JSON. With --baseline, the
+// results are compared against an earlier CSV run and configurations that got slower than the tolerance are
+// listed (exit code 2), so the benchmark can guard library upgrades.
+//
+//   bench_stepping [--sizes 64,256,1024,4096,16384] [--engines ApplyRule1D,ApplyRule2D,RuleTable2D,StepNeuron]
+//                  [--rules majority,totalistic,parity] [--boundaries fixed,periodic,noboundary]
+//                  [--neighborhoods moore,vonneumann] [--threads 1] [--simd scalar|sse4.1|avx2]
+//                  [--warmup 1] [--reps 5] [--min-rep-ms 20] [--format csv|json] [--output file]
+//                  [--baseline file.csv] [--tolerance 0.15] [--quick]
+
+struct Options
+{
+    vector<int> sizes = {64, 256, 1024, 4096, 16384};
+    vector<string> engines = {"ApplyRule1D", "ApplyRule2D", "RuleTable2D", "StepNeuron"};
+    vector<string> rules = {"majority", "totalistic", "parity"};
+    vector<string> boundaries = {"fixed", "periodic", "noboundary"};
+    vector<string> neighborhoods = {"moore", "vonneumann"};
+    int threads = 1;
+    string simd = SimdLevelName(DetectSimdLevel());
+    int warmup = 1;     // repetitions run before timing
+    int reps = 5;       // timed repetitions
+    double min_rep_ms = 20.0;
+    string format = "csv";
+    string output;      // empty: standard output
+    string baseline;    // earlier CSV results to compare against
+    double tolerance = 0.15;
+};
+
+struct Result
+{
+    string engine, rule, boundary, neighborhood, simd;
+    int dimension, rows, cols, threads, steps_per_rep, warmup, reps;
+    double best_seconds, median_seconds; // per step
+
+    double cells() const { return static_cast<double>(rows) * cols; }
+    double cellsPerSecond() const { return cells() / median_seconds; }
+    // identifies the configuration across runs
+    string key() const
+    {
+        ostringstream out;
+        out << engine << ',' << rule << ',' << rows << ',' << cols << ',' << boundary << ',' << neighborhood << ','
+            << threads << ',' << simd;
+        return out.str();
+    }
+};
+
+vector<string> splitList(const string &text)
+{
+    vector<string> items;
+    stringstream in(text);
+    string item;
+    while (getline(in, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+void usage()
+{
+    cerr << "usage: bench_stepping [--sizes list] [--engines list] [--rules list] [--boundaries list]\n"
+            "                      [--neighborhoods list] [--threads n] [--simd scalar|sse4.1|avx2] [--warmup n]\n"
+            "                      [--reps n] [--min-rep-ms ms] [--format csv|json] [--output file]\n"
+            "                      [--baseline file.csv] [--tolerance fraction] [--quick]\n"
+            "lists are comma separated; engines: ApplyRule1D, ApplyRule2D, RuleTable2D, StepNeuron;\n"
+            "rules: majority, totalistic, parity (StepNeuron always runs the neuron model)\n";
+}
+
+Options parseOptions(int argc, char **argv)
+{
+    Options options;
+    for (int k = 1; k < argc; ++k)
+    {
+        const string arg = argv[k];
+        if (arg == "--quick")
+        {
+            options.sizes = {64, 256};
+            options.reps = 2;
+            options.min_rep_ms = 2.0;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h")
+        {
+            usage();
+            exit(0);
+        }
+        static const char *const VALUED[] = {"--sizes", "--engines", "--rules", "--boundaries", "--neighborhoods",
+                                             "--threads", "--simd", "--warmup", "--reps", "--min-rep-ms", "--format",
+                                             "--output", "--baseline", "--tolerance"};
+        if (find(begin(VALUED), end(VALUED), arg) == end(VALUED))
+            throw invalid_argument("unknown option " + arg);
+        if (k + 1 >= argc)
+            throw invalid_argument("missing value for " + arg);
+        const string value = argv[++k];
+        if (arg == "--sizes")
+        {
+            options.sizes.clear();
+            for (const string &size : splitList(value))
+                options.sizes.push_back(stoi(size));
+        }
+        else if (arg == "--engines")
+            options.engines = splitList(value);
+        else if (arg == "--rules")
+            options.rules = splitList(value);
+        else if (arg == "--boundaries")
+            options.boundaries = splitList(value);
+        else if (arg == "--neighborhoods")
+            options.neighborhoods = splitList(value);
+        else if (arg == "--threads")
+            options.threads = stoi(value);
+        else if (arg == "--simd")
+            options.simd = value;
+        else if (arg == "--warmup")
+            options.warmup = stoi(value);
+        else if (arg == "--reps")
+            options.reps = stoi(value);
+        else if (arg == "--min-rep-ms")
+            options.min_rep_ms = stod(value);
+        else if (arg == "--format")
+            options.format = value;
+        else if (arg == "--output")
+            options.output = value;
+        else if (arg == "--baseline")
+            options.baseline = value;
+        else if (arg == "--tolerance")
+            options.tolerance = stod(value);
+    }
+    if (options.reps < 1 || options.warmup < 0 || options.threads < 0 || options.min_rep_ms < 0)
+        throw invalid_argument("--reps must be at least 1, --warmup, --threads and --min-rep-ms non-negative");
+    if (options.format != "csv" && options.format != "json")
+        throw invalid_argument("--format must be csv or json");
+    return options;
+}
+
+BoundaryCondition parseBoundary(const string &name)
+{
+    if (name == "fixed")
+        return BoundaryCondition::Fixed;
+    if (name == "periodic")
+        return BoundaryCondition::Periodic;
+    if (name == "noboundary")
+        return BoundaryCondition::NoBoundary;
+    throw invalid_argument("unknown boundary condition " + name);
+}
+
+NeighborhoodType parseNeighborhood(const string &name)
+{
+    if (name == "moore")
+        return NeighborhoodType::Moore;
+    if (name == "vonneumann")
+        return NeighborhoodType::VonNeumann;
+    throw invalid_argument("unknown neighborhood type " + name);
+}
+
+SimdLevel parseSimd(const string &name)
+{
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2})
+        if (name == SimdLevelName(level))
+            return level;
+    throw invalid_argument("unknown SIMD level " + name);
+}
+
+// the rule functions of the library, as test_cellular_automata.cpp applies them
+int majorityRule2DAdapter(int neighbors, int currentState)
+{
+    return majorityRule2D(neighbors, currentState, 0, 0, 0);
+}
+
+CellularAutomata::RuleFunction1D rule1D(const string &name)
+{
+    if (name == "majority")
+        return majorityRule_1D;
+    if (name == "totalistic")
+        return totalisticRule_1D;
+    if (name == "parity")
+        return parityRule;
+    throw invalid_argument("unknown rule " + name);
+}
+
+CellularAutomata::RuleFunction2D rule2D(const string &name)
+{
+    if (name == "majority")
+        return majorityRule2DAdapter;
+    if (name == "totalistic")
+        return totalisticRule;
+    if (name == "parity")
+        return parityRule;
+    throw invalid_argument("unknown rule " + name);
+}
+
+RuleTable table2D(const string &name, NeighborhoodType nt)
+{
+    if (name == "majority")
+        return RuleTable::Majority2D(nt);
+    if (name == "totalistic")
+        return RuleTable::Totalistic(nt);
+    if (name == "parity")
+        return RuleTable::Parity(nt);
+    throw invalid_argument("unknown rule " + name);
+}
+
+// Times `step` (one generation per call): doubles the steps per repetition until one lasts min_rep_ms, runs
+// the warmup repetitions, then keeps the time per step of every timed repetition.
+template <typename Step>
+void timeSteps(const Options &options, Step &&step, Result &result)
+{
+    typedef chrono::steady_clock Clock;
+    auto run = [&step](int steps) {
+        Clock::time_point start = Clock::now();
+        for (int k = 0; k < steps; ++k)
+            step();
+        return chrono::duration<double>(Clock::now() - start).count();
+    };
+    int steps = 1;
+    while (run(steps) * 1000.0 < options.min_rep_ms && steps < (1 << 20))
+        steps *= 2;
+    for (int k = 0; k < options.warmup; ++k)
+        run(steps);
+    vector<double> per_step;
+    for (int k = 0; k < options.reps; ++k)
+        per_step.push_back(run(steps) / steps);
+    sort(per_step.begin(), per_step.end());
+    result.steps_per_rep = steps;
+    result.warmup = options.warmup;
+    result.reps = options.reps;
+    result.best_seconds = per_step.front();
+    result.median_seconds = (per_step.size() % 2 == 1) ? per_step[per_step.size() / 2]
+                                                      : 0.5 * (per_step[per_step.size() / 2 - 1] + per_step[per_step.size() / 2]);
+}
+
+// random initial states: 0/1 for the binary rules, mostly inactive neurons for the neuron model
+void initialize(CellularAutomata &ca, bool neurons)
+{
+    mt19937 gen(12345);
+    auto draw = [&gen, neurons]() { return neurons ? ((gen() % 10 < 7) ? 0 : 1 + static_cast<int>(gen() % 3)) : static_cast<int>(gen() & 1); };
+    if (ca.GetDimension() == GridDimension::OneD)
+        ca.Initialize1D([&draw](CellularAutomata::Grid1D &grid) {
+            for (int &cell : grid)
+                cell = draw();
+        });
+    else
+        ca.Initialize2D([&draw](CellularAutomata::Grid2D &grid) {
+            for (auto &row : grid)
+                for (int &cell : row)
+                    cell = draw();
+        });
+}
+
+Result runOne(const Options &options, const string &engine, const string &rule, int size, const string &boundary,
+              const string &neighborhood)
+{
+    const bool one_d = (engine == "ApplyRule1D");
+    const BoundaryCondition bc = parseBoundary(boundary);
+    const NeighborhoodType nt = parseNeighborhood(neighborhood);
+    CellularAutomata ca(size, one_d ? GridDimension::OneD : GridDimension::TwoD, bc, nt);
+    ca.SetThreadCount(options.threads);
+    ca.SetSimdLevel(parseSimd(options.simd));
+    initialize(ca, engine == "StepNeuron");
+
+    Result result;
+    result.engine = engine;
+    result.rule = rule;
+    result.boundary = boundary;
+    result.neighborhood = one_d ? "-" : neighborhood;
+    result.simd = SimdLevelName(ca.GetSimdLevel());
+    result.dimension = one_d ? 1 : 2;
+    result.rows = one_d ? 1 : size;
+    result.cols = size;
+    result.threads = ca.GetThreadCount();
+
+    if (engine == "ApplyRule1D")
+    {
+        const CellularAutomata::RuleFunction1D function = rule1D(rule);
+        timeSteps(options, [&]() { ca.ApplyRule1D(function); }, result);
+    }
+    else if (engine == "ApplyRule2D")
+    {
+        const CellularAutomata::RuleFunction2D function = rule2D(rule);
+        timeSteps(options, [&]() { ca.ApplyRule2D(function); }, result);
+    }
+    else if (engine == "RuleTable2D")
+    {
+        const RuleTable table = table2D(rule, nt);
+        timeSteps(options, [&]() { ca.ApplyRule2D(table); }, result);
+    }
+    else if (engine == "StepNeuron")
+    {
+        const NeuronModel model;
+        std::uint64_t step = 0;
+        timeSteps(options, [&]() { ca.StepNeuron(model, 2024, step++); }, result);
+    }
+    else
+    {
+        throw invalid_argument("unknown engine " + engine);
+    }
+    return result;
+}
+
+const char *CSV_HEADER = "engine,rule,dimension,rows,cols,cells,boundary,neighborhood,threads,simd,steps_per_rep,"
+                         "warmup_reps,reps,best_seconds,median_seconds,cells_per_second";
+
+void writeCsv(ostream &out, const vector<Result> &results)
+{
+    out << CSV_HEADER << '\n' << setprecision(6);
+    for (const Result &r : results)
+        out << r.engine << ',' << r.rule << ',' << r.dimension << ',' << r.rows << ',' << r.cols << ','
+            << static_cast<long long>(r.cells()) << ',' << r.boundary << ',' << r.neighborhood << ',' << r.threads << ','
+            << r.simd << ',' << r.steps_per_rep << ',' << r.warmup << ',' << r.reps << ',' << r.best_seconds << ','
+            << r.median_seconds << ',' << r.cellsPerSecond() << '\n';
+}
+
+void writeJson(ostream &out, const vector<Result> &results)
+{
+    out << setprecision(6) << "{\n  \"benchmark\": \"bench_stepping\",\n  \"detected_simd\": \""
+        << SimdLevelName(DetectSimdLevel()) << "\",\n  \"hardware_threads\": " << ThreadPool::HardwareThreads()
+        << ",\n  \"results\": [";
+    for (size_t k = 0; k < results.size(); ++k)
+    {
+        const Result &r = results[k];
+        out << (k ? "," : "") << "\n    {\"engine\": \"" << r.engine << "\", \"rule\": \"" << r.rule
+            << "\", \"dimension\": " << r.dimension << ", \"rows\": " << r.rows << ", \"cols\": " << r.cols
+            << ", \"cells\": " << static_cast<long long>(r.cells()) << ", \"boundary\": \"" << r.boundary
+            << "\", \"neighborhood\": \"" << r.neighborhood << "\", \"threads\": " << r.threads << ", \"simd\": \""
+            << r.simd << "\", \"steps_per_rep\": " << r.steps_per_rep << ", \"warmup_reps\": " << r.warmup
+            << ", \"reps\": " << r.reps << ", \"best_seconds\": " << r.best_seconds << ", \"median_seconds\": "
+            << r.median_seconds << ", \"cells_per_second\": " << r.cellsPerSecond() << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+// cells_per_second of every configuration in an earlier CSV run, by Result::key
+map<string, double> readBaseline(const string &path)
+{
+    ifstream in(path);
+    if (!in)
+        throw runtime_error("cannot open baseline " + path);
+    string line;
+    if (!getline(in, line) || line != CSV_HEADER)
+        throw runtime_error("baseline " + path + " is not a bench_stepping CSV file");
+    map<string, double> rates;
+    while (getline(in, line))
+    {
+        vector<string> f = splitList(line);
+        if (f.size() != 16)
+            continue;
+        // engine,rule,rows,cols,boundary,neighborhood,threads,simd as in Result::key
+        rates[f[0] + ',' + f[1] + ',' + f[3] + ',' + f[4] + ',' + f[6] + ',' + f[7] + ',' + f[8] + ',' + f[9]] = stod(f[15]);
+    }
+    return rates;
+}
+
+// lists the configurations that lost more than the tolerance; returns how many did
+int compareBaseline(const Options &options, const vector<Result> &results)
+{
+    const map<string, double> baseline = readBaseline(options.baseline);
+    int regressions = 0, compared = 0;
+    for (const Result &r : results)
+    {
+        auto found = baseline.find(r.key());
+        if (found == baseline.end())
+            continue;
+        ++compared;
+        const double ratio = r.cellsPerSecond() / found->second;
+        if (ratio < 1.0 - options.tolerance)
+        {
+            ++regressions;
+            cerr << "REGRESSION " << r.key() << ": " << setprecision(3) << found->second << " -> " << r.cellsPerSecond()
+                 << " cells/s (" << fixed << setprecision(1) << (ratio - 1.0) * 100.0 << "%)" << defaultfloat
+                 << setprecision(6) << endl;
+        }
+    }
+    cerr << compared << " configurations compared with " << options.baseline << ", " << regressions
+         << " slower by more than " << options.tolerance * 100.0 << "%" << endl;
+    return regressions;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    try
+    {
+        options = parseOptions(argc, argv);
+    }
+    catch (const exception &error)
+    {
+        cerr << error.what() << endl;
+        usage();
+        return 1;
+    }
+
+    vector<Result> results;
+    try
+    {
+        for (const string &engine : options.engines)
+        {
+            const bool one_d = (engine == "ApplyRule1D");
+            const vector<string> rules = (engine == "StepNeuron") ? vector<string>(1, "neuron") : options.rules;
+            // the 1D neighborhood does not depend on the neighborhood type
+            const vector<string> neighborhoods = one_d ? vector<string>(1, "moore") : options.neighborhoods;
+            for (int size : options.sizes)
+                for (const string &boundary : options.boundaries)
+                    for (const string &neighborhood : neighborhoods)
+                        for (const string &rule : rules)
+                        {
+                            results.push_back(runOne(options, engine, rule, size, boundary, neighborhood));
+                            const Result &r = results.back();
+                            cerr << r.engine << ' ' << r.rule << ' ' << r.rows << 'x' << r.cols << ' ' << r.boundary << ' '
+                                 << r.neighborhood << ": " << setprecision(3) << r.cellsPerSecond() / 1e6 << " Mcells/s" << endl;
+                        }
+        }
+    }
+    catch (const exception &error)
+    {
+        cerr << error.what() << endl;
+        return 1;
+    }
+
+    ofstream file;
+    if (!options.output.empty())
+    {
+        file.open(options.output);
+        if (!file)
+        {
+            cerr << "cannot write " << options.output << endl;
+            return 1;
+        }
+    }
+    ostream &out = options.output.empty() ? cout : file;
+    if (options.format == "json")
+        writeJson(out, results);
+    else
+        writeCsv(out, results);
+
+    if (!options.baseline.empty())
+    {
+        try
+        {
+            return compareBaseline(options, results) > 0 ? 2 : 0;
+        }
+        catch (const exception &error)
+        {
+            cerr << error.what() << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
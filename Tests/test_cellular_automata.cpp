@@ -4,7 +4,6 @@
 #include <sstream> // print to a string stream and use your -ostream and pipe to a text file.
 #include <fstream> // read from a file.
 #include "../Include/CellularAutomata.h"
-#include "../src/cellular_automata.cpp"
 using namespace std; // allows the use of std namespace without prefixing (i.e std::vector -> vector)
 
 // Initialize a 1D grid with random values
@@ -320,7 +319,7 @@ int main()
 
     // Print the final state
     cout << "Results of 2D , Periodic, and Moore (majority): " << endl;
-    ca2D.Print();
+    cout << ca2D.Print();
     cout << endl
          << endl
          << endl;
@@ -349,7 +348,7 @@ int main()
 
     // Printing out the final state
     cout << "Results of 2D, NoBoundary, and Moore (majority): " << endl;
-    ca2d_2.Print(); // formatted output >> printing to a string.
+    cout << ca2d_2.Print(); // formatted output >> printing to a string.
     cout << endl
          << endl
          << endl;
@@ -364,7 +363,7 @@ int main()
 
     // Printing out the final state
     cout << "Results of 2D, Periodic, and Moore (totalistic): " << endl;
-    ca2d_3.Print();
+    cout << ca2d_3.Print();
     cout << endl
          << endl
          << endl;
@@ -379,7 +378,7 @@ int main()
 
     // Printing out the final state
     cout << "Results of 2D, Fixed, and Moore (totalistic): " << endl;
-    ca2d_4.Print();
+    cout << ca2d_4.Print();
     cout << endl
          << endl
          << endl;
@@ -394,7 +393,7 @@ int main()
 
     // Printing out the final state
     cout << "Results of 2D, NoBoundary, and Moore (totalistic): " << endl;
-    ca2d_5.Print();
+    cout << ca2d_5.Print();
     cout << endl
          << endl
          << endl;
@@ -409,7 +408,7 @@ int main()
 
     // Priting out the final state
     cout << "Results of 2D, Periodic, and Moore (parity): " << endl;
-    ca2d_6.Print();
+    cout << ca2d_6.Print();
     cout << endl
          << endl
          << endl;
@@ -424,7 +423,7 @@ int main()
 
     // Priting out the final state
     cout << "Results of 2D, Fixed, and Moore (parity): " << endl;
-    ca2d_7.Print();
+    cout << ca2d_7.Print();
     cout << endl
          << endl
          << endl;
@@ -439,7 +438,7 @@ int main()
 
     // Priting out the final state
     cout << "Results of 2D, NoBoundary, and Moore (parity): " << endl;
-    ca2d_8.Print();
+    cout << ca2d_8.Print();
     cout << endl
          << endl
          << endl;
@@ -454,7 +453,7 @@ int main()
     CellularAutomata ca2DVN1(10, GridDimension::TwoD, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
     ca2DVN1.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, Fixed, and VN (majorityRule): " << endl;
-    ca2DVN1.Print(); // Printing out the final state
+    cout << ca2DVN1.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -465,7 +464,7 @@ int main()
     CellularAutomata ca2DVN2(10, GridDimension::TwoD, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
     ca2DVN2.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, Fixed, and VN (parityRule): " << endl;
-    ca2DVN2.Print(); // Printing out the final state
+    cout << ca2DVN2.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -476,7 +475,7 @@ int main()
     CellularAutomata ca2DVN3(10, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::VonNeumann);
     ca2DVN3.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, Periodic, and VN (parityRule): " << endl;
-    ca2DVN3.Print(); // Printing out the final state
+    cout << ca2DVN3.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -487,7 +486,7 @@ int main()
     CellularAutomata ca2DVN4(10, GridDimension::TwoD, BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann);
     ca2DVN4.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, NoBoundary, and VN (parityRule): " << endl;
-    ca2DVN4.Print(); // Printing out the final state
+    cout << ca2DVN4.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -498,7 +497,7 @@ int main()
     CellularAutomata ca2DVN5(10, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::VonNeumann);
     ca2DVN5.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, Periodic, and VN (majorityyRule): " << endl;
-    ca2DVN5.Print(); // Printing out the final state
+    cout << ca2DVN5.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -509,7 +508,7 @@ int main()
     CellularAutomata ca2DVN6(10, GridDimension::TwoD, BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann);
     ca2DVN6.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, NoBoundary, and VN (majorityyRule): " << endl;
-    ca2DVN6.Print(); // Printing out the final state
+    cout << ca2DVN6.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -520,7 +519,7 @@ int main()
     CellularAutomata ca2DVN7(10, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::VonNeumann);
     ca2DVN7.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, Periodic, and VN (totalisticRule): " << endl;
-    ca2DVN7.Print(); // Printing out the final state
+    cout << ca2DVN7.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -531,7 +530,7 @@ int main()
     CellularAutomata ca2DVN8(10, GridDimension::TwoD, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
     ca2DVN8.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, Fixed, and VN (totalisticRule): " << endl;
-    ca2DVN8.Print(); // Printing out the final state
+    cout << ca2DVN8.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -542,7 +541,7 @@ int main()
     CellularAutomata ca2DVN9(10, GridDimension::TwoD, BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann);
     ca2DVN9.Initialize2D(initGrid2D); // Initializing the grid
     cout << "Results of 2D, NoBoundary, and VN (totalisticRule): " << endl;
-    ca2DVN9.Print(); // Printing out the final state
+    cout << ca2DVN9.Print(); // Printing out the final state
     cout << endl
          << endl
          << endl;
@@ -556,7 +555,7 @@ int main()
     ca1D_periodic_moore.Initialize1D(initGrid1D);
     ca1D_periodic_moore.ApplyRule1D(rule1DExample);
     cout << "1D, Periodic, Moore: " << endl;
-    ca1D_periodic_moore.Print();
+    cout << ca1D_periodic_moore.Print();
     cout << endl
          << endl;
 
@@ -565,7 +564,7 @@ int main()
     ca1D_fixed_moore.Initialize1D(initGrid1D);
     ca1D_fixed_moore.ApplyRule1D(rule1DExample);
     cout << "1D, Fixed, Moore: " << endl;
-    ca1D_fixed_moore.Print();
+    cout << ca1D_fixed_moore.Print();
     cout << endl
          << endl;
 
@@ -574,7 +573,7 @@ int main()
     ca1D_noboundary_moore.Initialize1D(initGrid1D);
     ca1D_noboundary_moore.ApplyRule1D(rule1DExample);
     cout << "1D, NoBoundary, Moore: " << endl;
-    ca1D_noboundary_moore.Print();
+    cout << ca1D_noboundary_moore.Print();
     cout << endl
          << endl;
 
@@ -583,7 +582,7 @@ int main()
     ca1D_periodic_vn.Initialize1D(initGrid1D);
     ca1D_periodic_vn.ApplyRule1D(parityRule);
     cout << "1D, Periodic, VN (parityRule): " << endl;
-    ca1D_periodic_vn.Print();
+    cout << ca1D_periodic_vn.Print();
     cout << endl
          << endl;
     string filename10 = "../Utils/Data/1D_Periodic_VN_parity.txt";
@@ -594,7 +593,7 @@ int main()
     ca1D_fixed_vn.Initialize1D(initGrid1D);
     ca1D_fixed_vn.ApplyRule1D(parityRule);
     cout << "1D, Fixed, VN (parityRule): " << endl;
-    ca1D_fixed_vn.Print();
+    cout << ca1D_fixed_vn.Print();
     cout << endl
          << endl;
     string filename11 = "../Utils/Data/1D_Fixed_VN_parity.txt";
@@ -605,7 +604,7 @@ int main()
     ca1D_nobound_vn.Initialize1D(initGrid1D);
     ca1D_nobound_vn.ApplyRule1D(parityRule);
     cout << "1D, NoBoundary, VN (parityRule): " << endl;
-    ca1D_nobound_vn.Print();
+    cout << ca1D_nobound_vn.Print();
     cout << endl
          << endl;
     string filename12 = "../Utils/Data/1D_NoBoundary_VN_parity.txt";
@@ -616,7 +615,7 @@ int main()
     ca1D_periodic_vn2.Initialize1D(initGrid1D);
     ca1D_periodic_vn2.ApplyRule1D(totalisticRule_1D);
     cout << "1D, Periodic, VN (totalisticRule_1D): " << endl;
-    ca1D_periodic_vn2.Print();
+    cout << ca1D_periodic_vn2.Print();
     cout << endl
          << endl;
     string filename13 = "../Utils/Data/1D_Periodic_VN_totalistic.txt";
@@ -627,7 +626,7 @@ int main()
     ca1D_fixed_vn2.Initialize1D(initGrid1D);
     ca1D_fixed_vn2.ApplyRule1D(totalisticRule_1D);
     cout << "1D, Fixed, VN (totalisticRule_1D): " << endl;
-    ca1D_fixed_vn2.Print();
+    cout << ca1D_fixed_vn2.Print();
     cout << endl
          << endl;
     string filename14 = "../Utils/Data/1D_Fixed_VN_totalistic.txt";
@@ -638,7 +637,7 @@ int main()
     ca1D_nobound_vn2.Initialize1D(initGrid1D);
     ca1D_nobound_vn2.ApplyRule1D(totalisticRule_1D);
     cout << "1D, NoBoundary, VN (totalisticRule_1D): " << endl;
-    ca1D_nobound_vn2.Print();
+    cout << ca1D_nobound_vn2.Print();
     cout << endl
          << endl;
     string filename15 = "../Utils/Data/1D_NoBoundary_VN_totalistic.txt";
@@ -649,7 +648,7 @@ int main()
     ca1D_periodic_vn3.Initialize1D(initGrid1D);
     ca1D_periodic_vn3.ApplyRule1D(majorityRule_1D);
     cout << "1D, Periodic, VN (majorityRule_1D): " << endl;
-    ca1D_periodic_vn3.Print();
+    cout << ca1D_periodic_vn3.Print();
     cout << endl
          << endl;
     string filename16 = "../Utils/Data/1D_Periodic_VN_majority.txt";
@@ -660,7 +659,7 @@ int main()
     ca1D_fixed_vn3.Initialize1D(initGrid1D);
     ca1D_fixed_vn3.ApplyRule1D(majorityRule_1D);
     cout << "1D, Fixed, VN (majorityRule_1D): " << endl;
-    ca1D_fixed_vn3.Print();
+    cout << ca1D_fixed_vn3.Print();
     cout << endl
          << endl;
     string filename17 = "../Utils/Data/1D_Fixed_VN_majority.txt";
@@ -671,7 +670,7 @@ int main()
     ca1D_nobound_vn3.Initialize1D(initGrid1D);
     ca1D_nobound_vn3.ApplyRule1D(majorityRule_1D);
     cout << "1D, NoBoundary, VN (majorityRule_1D): " << endl;
-    ca1D_nobound_vn3.Print();
+    cout << ca1D_nobound_vn3.Print();
     cout << endl
          << endl;
     string filename18 = "../Utils/Data/1D_NoBoundary_VN_majority.txt";
@@ -0,0 +1,1949 @@
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../Include/CellularAutomata.h"
+#include "../Include/BitGrid.h"
+#include "../Include/Hashlife.h"
+#include "../Include/SparseGrid.h"
+#include "../Include/Trajectory.h"
+#include "../Include/AsyncTrajectoryWriter.h"
+#include "../Include/Ensemble.h"
+#include "../Include/Checkpoint.h"
+using namespace std;
+
+// Checks that the fast stepping paths (compile-time specialized Step, halo sweep and the table-driven
+// SIMD kernels at every instruction set level) produce exactly the same grids as ApplyRule2D with the
+// rule functions used in test_cellular_automata.cpp, for every boundary condition and neighborhood type.
+// The bit-packed BitGrid2D engine, multi-threaded stepping, temporally blocked Run, the sparse activity mode
+// and the Hashlife engine are checked against the same reference.
+
+static const BoundaryCondition boundaries[] = {BoundaryCondition::Fixed, BoundaryCondition::Periodic, BoundaryCondition::NoBoundary};
+static const NeighborhoodType neighborhoods[] = {NeighborhoodType::Moore, NeighborhoodType::VonNeumann};
+static const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2};
+static const int sizes[] = {1, 2, 3, 7, 10, 17, 33, 64};
+
+// true when f() throws an E; any other exception propagates and fails the test
+template <typename E, typename F>
+bool throwsAs(F f)
+{
+    try
+    {
+        f();
+    }
+    catch (const E &)
+    {
+        return true;
+    }
+    return false;
+}
+
+// the 2D rules exercised by test_cellular_automata.cpp
+int majorityRule2DAdapter(int neighbors, int currentState)
+{
+    return majorityRule2D(neighbors, currentState, 0, 0, 0);
+}
+
+struct NamedRule
+{
+    string name;
+    CellularAutomata::RuleFunction2D rule;
+};
+
+// Fills a 2D grid with random 0/1 states from a fixed seed
+void initRandom(CellularAutomata &ca, unsigned seed)
+{
+    mt19937 gen(seed);
+    ca.Initialize2D([&gen](CellularAutomata::Grid2D &grid) {
+        for (auto &row : grid)
+            for (auto &cell : row)
+                cell = static_cast<int>(gen() % 2);
+    });
+}
+
+// Runs the reference path and one fast path side by side for a few generations and compares every grid
+void testTableMatchesReference(const NamedRule &named, BoundaryCondition bc, NeighborhoodType nt, int size, SimdLevel level)
+{
+    CellularAutomata reference(size, GridDimension::TwoD, bc, nt);
+    CellularAutomata fast(size, GridDimension::TwoD, bc, nt);
+    CellularAutomata stepped(size, GridDimension::TwoD, bc, nt);
+    unsigned seed = static_cast<unsigned>(size * 131 + static_cast<int>(bc) * 7 + static_cast<int>(nt));
+    initRandom(reference, seed);
+    initRandom(fast, seed);
+    initRandom(stepped, seed);
+    fast.SetSimdLevel(level);
+    RuleTable table = RuleTable::FromFunction(named.rule, 2, nt);
+
+    for (int generation = 0; generation < 6; ++generation)
+    {
+        reference.ApplyRule2D(named.rule);
+        fast.ApplyRule2D(table);
+        stepped.Step(table);
+        if (reference.GetGrid2D() != fast.GetGrid2D() || reference.GetGrid2D() != stepped.GetGrid2D())
+        {
+            cerr << "Mismatch for " << named.name << " size " << size << " level " << SimdLevelName(level)
+                 << " generation " << generation << endl;
+            assert(false);
+        }
+    }
+}
+
+// The bit-sliced engine must agree with the int engine, including across partially used 64-bit words
+void testBitGridMatchesReference(const NamedRule &named, BoundaryCondition bc, NeighborhoodType nt, int rows, int cols)
+{
+    mt19937 gen(static_cast<unsigned>(rows * 31 + cols));
+    CellularAutomata::Grid2D start(rows, cols);
+    for (auto &row : start)
+        for (auto &cell : row)
+            cell = static_cast<int>(gen() % 2);
+    BitGrid2D bits(rows, cols, bc, nt);
+    bits.FromGrid(start);
+    RuleTable table = RuleTable::FromFunction(named.rule, 2, nt);
+    if (rows == cols)
+    {
+        CellularAutomata reference(rows, GridDimension::TwoD, bc, nt);
+        reference.UpdateGrid2D(start);
+        for (int generation = 0; generation < 6; ++generation)
+        {
+            reference.ApplyRule2D(named.rule);
+            bits.Step(table);
+            CellularAutomata::Grid2D unpacked;
+            bits.ToGrid(unpacked);
+            if (unpacked != reference.GetGrid2D())
+            {
+                cerr << "BitGrid2D mismatch for " << named.name << " size " << rows << " generation " << generation << endl;
+                assert(false);
+            }
+        }
+    }
+    else
+    {
+        // the automaton is square, so rectangular grids are compared against the halo sweep on an int grid of the same shape
+        CellularAutomata::Grid2D current(rows, cols, 0, 1), next(rows, cols, 0, 1);
+        current.assign(start);
+        for (int generation = 0; generation < 6; ++generation)
+        {
+            if (bc == BoundaryCondition::Periodic)
+                ca_detail::Boundary2D<BoundaryCondition::Periodic>::FillHalo(current);
+            else
+                ca_detail::Boundary2D<BoundaryCondition::Fixed>::FillHalo(current);
+            if (nt == NeighborhoodType::Moore)
+                ca_detail::Sweep2D<NeighborhoodType::Moore>(current.data(), next.data(), current.stride(), rows, cols, table);
+            else
+                ca_detail::Sweep2D<NeighborhoodType::VonNeumann>(current.data(), next.data(), current.stride(), rows, cols, table);
+            current.swap(next);
+            bits.Step(table);
+            CellularAutomata::Grid2D unpacked;
+            bits.ToGrid(unpacked);
+            assert(unpacked == current);
+        }
+    }
+}
+
+// Stepping in row bands across a thread pool must give exactly the serial result
+void testThreadedMatchesSerial(BoundaryCondition bc, NeighborhoodType nt, int threads)
+{
+    const int size = 203; // above the parallel threshold and not a multiple of any band count
+    CellularAutomata serial(size, GridDimension::TwoD, bc, nt);
+    CellularAutomata threaded(size, GridDimension::TwoD, bc, nt);
+    initRandom(serial, 11);
+    initRandom(threaded, 11);
+    threaded.SetThreadCount(threads);
+    assert(threaded.GetThreadCount() == threads);
+    RuleTable table = RuleTable::FromFunction(parityRule, 2, nt);
+    for (int generation = 0; generation < 4; ++generation)
+    {
+        serial.ApplyRule2D(majorityRule2DAdapter);
+        threaded.ApplyRule2D(majorityRule2DAdapter);
+        assert(serial.GetGrid2D() == threaded.GetGrid2D());
+        serial.ApplyRule2D(table);
+        threaded.ApplyRule2D(table);
+        assert(serial.GetGrid2D() == threaded.GetGrid2D());
+        serial.Step(totalisticRule);
+        threaded.Step(totalisticRule);
+        assert(serial.GetGrid2D() == threaded.GetGrid2D());
+    }
+
+    const int length = 50000;
+    CellularAutomata serial1D(length, GridDimension::OneD, bc, nt);
+    CellularAutomata threaded1D(length, GridDimension::OneD, bc, nt);
+    auto init1D = [](CellularAutomata::Grid1D &grid) {
+        mt19937 gen(5);
+        for (auto &cell : grid)
+            cell = static_cast<int>(gen() % 2);
+    };
+    serial1D.Initialize1D(init1D);
+    threaded1D.Initialize1D(init1D);
+    threaded1D.SetThreadCount(threads);
+    for (int generation = 0; generation < 4; ++generation)
+    {
+        serial1D.ApplyRule1D(majorityRule_1D);
+        threaded1D.ApplyRule1D(majorityRule_1D);
+        assert(serial1D.GetGrid1D() == threaded1D.GetGrid1D());
+    }
+}
+
+// Run(steps, rule) with temporal blocking must give the same grid as ApplyRule2D in a loop, including
+// tiles that do not divide the grid, margins wider than the grid and several threads
+void testRunMatchesStepping(const NamedRule &named, BoundaryCondition bc, NeighborhoodType nt, int size)
+{
+    const int tiles[][2] = {{4, 4}, {3, 16}, {16, 5}, {64, 512}};
+    const int depths[] = {1, 3, 8};
+    const int steps[] = {0, 1, 7, 20};
+    RuleTable table = RuleTable::FromFunction(named.rule, 2, nt);
+    for (const auto &tile : tiles)
+        for (int depth : depths)
+            for (int count : steps)
+            {
+                CellularAutomata reference(size, GridDimension::TwoD, bc, nt);
+                CellularAutomata blocked(size, GridDimension::TwoD, bc, nt);
+                CellularAutomata blocked_table(size, GridDimension::TwoD, bc, nt);
+                unsigned seed = static_cast<unsigned>(size * 17 + tile[0] + tile[1] + depth);
+                initRandom(reference, seed);
+                initRandom(blocked, seed);
+                initRandom(blocked_table, seed);
+                blocked.SetTemporalBlocking(tile[0], tile[1], depth);
+                blocked_table.SetTemporalBlocking(tile[0], tile[1], depth);
+                blocked_table.SetThreadCount(3);
+                for (int generation = 0; generation < count; ++generation)
+                    reference.ApplyRule2D(named.rule);
+                blocked.Run(count, named.rule);
+                blocked_table.Run(count, table);
+                if (reference.GetGrid2D() != blocked.GetGrid2D() || reference.GetGrid2D() != blocked_table.GetGrid2D())
+                {
+                    cerr << "Run mismatch for " << named.name << " size " << size << " tile " << tile[0] << "x" << tile[1] << " depth " << depth
+                         << " steps " << count << endl;
+                    assert(false);
+                }
+            }
+}
+
+// Conway's Game of Life written out as a function, to check the B/S parser against
+int lifeRule(int neighbors, int currentState)
+{
+    return (neighbors == 3 || (currentState == 1 && neighbors == 2)) ? 1 : 0;
+}
+
+// Rule strings, serialization and the built-in tables
+void testRuleTables()
+{
+    RuleTable life = RuleTable::FromFunction(lifeRule, 2, NeighborhoodType::Moore);
+    assert(RuleTable::FromString("B3/S23", NeighborhoodType::Moore) == life);
+    assert(RuleTable::FromString("s23/b3", NeighborhoodType::Moore) == life);
+    assert(RuleTable::FromString("23/3", NeighborhoodType::Moore) == life);
+    assert(life.ToString() == "B3/S23");
+    assert(RuleTable::FromString("B/S", NeighborhoodType::VonNeumann).ToString() == "B/S");
+
+    // every built-in table round-trips through its text form and matches the function it tabulates
+    for (NeighborhoodType nt : neighborhoods)
+    {
+        RuleTable tables[] = {RuleTable::Parity(nt), RuleTable::Totalistic(nt), RuleTable::Majority2D(nt)};
+        for (const RuleTable &table : tables)
+            assert(RuleTable::FromString(table.ToString(), nt) == table);
+        assert(tables[0] == RuleTable::FromFunction(parityRule, 2, nt));
+        assert(tables[1] == RuleTable::FromFunction(totalisticRule, 2, nt));
+        assert(tables[2] == RuleTable::FromFunction(majorityRule2DAdapter, 2, nt));
+    }
+
+    // tables that are not life-like use the full listing
+    RuleTable cyclic = RuleTable::FromFunction([](int neighbors, int state) { return (state + neighbors) % 3; }, 3, NeighborhoodType::VonNeumann);
+    assert(cyclic.ToString().compare(0, 6, "table:") == 0);
+    assert(RuleTable::FromString(cyclic.ToString(), NeighborhoodType::VonNeumann) == cyclic);
+
+    const char *bad[] = {"", "B3", "B3/S23/S1", "B9/S23", "B3/S2x", "B3/23", "B3/B3", "table:2:8:0,1", "table:2:3:0,1,0,1,0,1,0,5"};
+    for (const char *text : bad)
+    {
+        if (!throwsAs<std::invalid_argument>([&] { RuleTable::FromString(text, NeighborhoodType::Moore); }))
+        {
+            cerr << "Rule string \"" << text << "\" was accepted" << endl;
+            assert(false);
+        }
+    }
+
+    // the 1D table path matches ApplyRule1D with the rule functions
+    for (BoundaryCondition bc : boundaries)
+    {
+        CellularAutomata::RuleFunction1D functions[] = {majorityRule_1D, totalisticRule_1D};
+        RuleTable tables[] = {RuleTable::Majority1D(), RuleTable::Totalistic1D()};
+        for (int r = 0; r < 2; ++r)
+        {
+            CellularAutomata reference(101, GridDimension::OneD, bc, NeighborhoodType::Moore);
+            CellularAutomata tabled(101, GridDimension::OneD, bc, NeighborhoodType::Moore);
+            auto init1D = [](CellularAutomata::Grid1D &grid) {
+                mt19937 gen(9);
+                for (auto &cell : grid)
+                    cell = static_cast<int>(gen() % 2);
+            };
+            reference.Initialize1D(init1D);
+            tabled.Initialize1D(init1D);
+            for (int generation = 0; generation < 5; ++generation)
+            {
+                reference.ApplyRule1D(functions[r]);
+                tabled.ApplyRule1D(tables[r]);
+                assert(reference.GetGrid1D() == tabled.GetGrid1D());
+            }
+        }
+    }
+}
+
+// Sparse activity mode must give the same grids as full sweeps, whatever the tile size
+void testActiveRegionMatchesReference(const NamedRule &named, BoundaryCondition bc, NeighborhoodType nt, int size)
+{
+    const int tiles[] = {1, 5, 32};
+    RuleTable table = RuleTable::FromFunction(named.rule, 2, nt);
+    for (int tile : tiles)
+    {
+        CellularAutomata reference(size, GridDimension::TwoD, bc, nt);
+        CellularAutomata sparse(size, GridDimension::TwoD, bc, nt);
+        unsigned seed = static_cast<unsigned>(size + tile);
+        initRandom(reference, seed);
+        initRandom(sparse, seed);
+        sparse.SetActiveRegionTracking(true, tile);
+        sparse.SetThreadCount(tile == 1 ? 3 : 1);
+        for (int generation = 0; generation < 12; ++generation)
+        {
+            reference.ApplyRule2D(named.rule);
+            if (generation % 3 == 0)
+                sparse.ApplyRule2D(named.rule);
+            else if (generation % 3 == 1)
+                sparse.ApplyRule2D(table);
+            else
+                sparse.Step(named.rule);
+            assert(sparse.GetTilesProcessed() <= sparse.GetActiveTileCount());
+            if (reference.GetGrid2D() != sparse.GetGrid2D())
+            {
+                cerr << "Active region mismatch for " << named.name << " size " << size << " tile " << tile
+                     << " generation " << generation << endl;
+                assert(false);
+            }
+        }
+    }
+}
+
+// A glider on an otherwise empty grid only keeps a few tiles busy, and changes made from outside
+// (Initialize2D, switching rules) are picked up
+void testActiveRegionSkipsQuiescentTiles()
+{
+    for (BoundaryCondition bc : boundaries)
+    {
+        const int size = 256;
+        CellularAutomata reference(size, GridDimension::TwoD, bc, NeighborhoodType::Moore);
+        CellularAutomata sparse(size, GridDimension::TwoD, bc, NeighborhoodType::Moore);
+        auto glider = [](CellularAutomata::Grid2D &grid) {
+            grid[1][2] = 1;
+            grid[2][3] = 1;
+            grid[3][1] = grid[3][2] = grid[3][3] = 1;
+        };
+        reference.Initialize2D(glider);
+        sparse.Initialize2D(glider);
+        sparse.SetActiveRegionTracking(true, 16);
+        assert(sparse.GetActiveTileCount() == 256);
+        RuleTable life = RuleTable::FromString("B3/S23", NeighborhoodType::Moore);
+        for (int generation = 0; generation < 200; ++generation)
+        {
+            reference.ApplyRule2D(lifeRule);
+            sparse.ApplyRule2D(life);
+            assert(reference.GetGrid2D() == sparse.GetGrid2D());
+            if (generation == 0)
+                assert(sparse.GetTilesProcessed() == 256); // the first step is always a full sweep
+            else
+                assert(sparse.GetTilesProcessed() <= 16); // at most 2 x 2 changed tiles plus their neighbors
+        }
+
+        // a new pattern written from outside is seen by the next step
+        auto block = [](CellularAutomata::Grid2D &grid) { grid[200][200] = grid[200][201] = grid[201][200] = 1; };
+        reference.Initialize2D(block);
+        sparse.Initialize2D(block);
+        reference.ApplyRule2D(lifeRule);
+        sparse.ApplyRule2D(life);
+        assert(reference.GetGrid2D() == sparse.GetGrid2D());
+
+        // switching rules needs MarkAllActive
+        sparse.MarkAllActive();
+        reference.ApplyRule2D(parityRule);
+        sparse.ApplyRule2D(parityRule);
+        assert(reference.GetGrid2D() == sparse.GetGrid2D());
+        assert(sparse.GetTilesProcessed() == 256);
+    }
+}
+
+// RunHashlife on a periodic grid must match stepping one generation at a time
+void testHashlifeMatchesReference(const NamedRule &named, NeighborhoodType nt, int size)
+{
+    const int steps[] = {0, 1, 2, 3, 5, 17, 100};
+    RuleTable table = RuleTable::FromFunction(named.rule, 2, nt);
+    CellularAutomata reference(size, GridDimension::TwoD, BoundaryCondition::Periodic, nt);
+    CellularAutomata memoized(size, GridDimension::TwoD, BoundaryCondition::Periodic, nt);
+    initRandom(reference, static_cast<unsigned>(size * 3 + 1));
+    initRandom(memoized, static_cast<unsigned>(size * 3 + 1));
+    int generation = 0;
+    for (int count : steps)
+    {
+        for (int k = 0; k < count; ++k)
+            reference.ApplyRule2D(named.rule);
+        memoized.RunHashlife(count, table);
+        generation += count;
+        if (reference.GetGrid2D() != memoized.GetGrid2D())
+        {
+            cerr << "Hashlife mismatch for " << named.name << " size " << size << " generation " << generation << endl;
+            assert(false);
+        }
+    }
+}
+
+// Unbounded plane, long jumps and the cases Hashlife refuses
+void testHashlifePlane()
+{
+    RuleTable life = RuleTable::FromString("B3/S23", NeighborhoodType::Moore);
+
+    // a glider moves one cell diagonally every 4 generations, forever
+    Hashlife plane(life, NeighborhoodType::Moore);
+    const int glider[5][2] = {{0, 1}, {1, 2}, {2, 0}, {2, 1}, {2, 2}};
+    for (const auto &cell : glider)
+        plane.SetCell(cell[0], cell[1], 1);
+    const long long distance = 250000;
+    plane.Advance(4 * distance);
+    assert(plane.Generation() == 4 * distance);
+    assert(plane.Population() == 5);
+    for (const auto &cell : glider)
+        assert(plane.GetCell(cell[0] + distance, cell[1] + distance) == 1);
+
+    // a pattern far from the edges of a periodic grid evolves as on the plane
+    const int size = 64;
+    CellularAutomata reference(size, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    mt19937 gen(21);
+    CellularAutomata::Grid2D soup(16, 16);
+    for (auto &row : soup)
+        for (auto &cell : row)
+            cell = static_cast<int>(gen() % 2);
+    reference.Initialize2D([&soup](CellularAutomata::Grid2D &grid) {
+        for (int i = 0; i < 16; ++i)
+            for (int j = 0; j < 16; ++j)
+                grid[24 + i][24 + j] = soup[i][j];
+    });
+    Hashlife soup_plane(life, NeighborhoodType::Moore);
+    soup_plane.LoadGrid(soup, -1000, 5000);
+    for (int generation = 0; generation < 12; ++generation)
+        reference.ApplyRule2D(life);
+    soup_plane.Advance(12);
+    CellularAutomata::Grid2D window(size, size);
+    soup_plane.StoreGrid(window, -1024, 4976);
+    assert(window == reference.GetGrid2D());
+
+    // long runs in chunks agree with a single long run and with plain stepping
+    CellularAutomata chunked(size, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    CellularAutomata single(size, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    CellularAutomata stepped(size, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(chunked, 5);
+    initRandom(single, 5);
+    initRandom(stepped, 5);
+    for (int chunk = 0; chunk < 10; ++chunk)
+        chunked.RunHashlife(100, life);
+    single.RunHashlife(1000, life);
+    for (int generation = 0; generation < 1000; ++generation)
+        stepped.ApplyRule2D(life);
+    assert(chunked.GetGrid2D() == stepped.GetGrid2D());
+    assert(single.GetGrid2D() == stepped.GetGrid2D());
+    single.RunHashlife(100000000LL, life); // settles into a cycle that is skipped over
+
+    // dropping the memoized results when the node limit is reached does not change the outcome
+    Hashlife small_memory(life, NeighborhoodType::Moore, size);
+    small_memory.SetNodeLimit(2000);
+    CellularAutomata restarted(size, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(restarted, 5);
+    small_memory.LoadGrid(restarted.GetGrid2D());
+    small_memory.Advance(1000);
+    CellularAutomata::Grid2D collected(size, size);
+    small_memory.StoreGrid(collected);
+    assert(collected == stepped.GetGrid2D());
+    long long population = 0;
+    for (const auto &row : stepped.GetGrid2D())
+        for (int cell : row)
+            population += cell;
+    assert(small_memory.Population() == population);
+
+    // unsupported configurations
+    assert(throwsAs<std::invalid_argument>([&] {
+        Hashlife b0(RuleTable::Parity(NeighborhoodType::Moore), NeighborhoodType::Moore);
+    }));
+    assert(throwsAs<std::invalid_argument>([&] {
+        CellularAutomata odd(10, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+        odd.RunHashlife(1, life);
+    }));
+}
+
+// Copies of an automaton step on their own threads without sharing the worker pool or the Hashlife engine
+void testCopiesStepIndependently()
+{
+    RuleTable life = RuleTable::FromString("B3/S23", NeighborhoodType::Moore);
+    CellularAutomata original(256, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(original, 41);
+    original.SetThreadCount(3);
+    original.RunHashlife(4, life); // both engines exist before the copy
+    original.Step(life);
+    CellularAutomata reference = original;
+    reference.SetThreadCount(1);
+    for (int k = 0; k < 10; ++k)
+        reference.Step(life);
+    reference.RunHashlife(37, life);
+
+    vector<CellularAutomata> copies(3, original);
+    vector<std::thread> workers;
+    for (CellularAutomata &copy : copies)
+        workers.emplace_back([&copy, &life]() {
+            for (int k = 0; k < 10; ++k)
+                copy.Step(life);
+            copy.RunHashlife(37, life);
+        });
+    for (std::thread &worker : workers)
+        worker.join();
+    for (const CellularAutomata &copy : copies)
+        assert(copy.GetGrid2D() == reference.GetGrid2D() && copy.GetThreadCount() == 3);
+}
+
+// SparseGrid2D against a NoBoundary grid large enough that the pattern never reaches its edges; the soup is
+// placed across block boundaries (and negative coordinates) on the plane
+void testSparseGridMatchesReference(const NamedRule &named, NeighborhoodType nt, int threads)
+{
+    const int size = 240, soup_size = 24, offset = (size - soup_size) / 2, generations = 40;
+    const long long row0 = -10, col0 = SparseGrid2D::CHUNK - 7;
+    CellularAutomata reference(size, GridDimension::TwoD, BoundaryCondition::NoBoundary, nt);
+    mt19937 gen(17);
+    CellularAutomata::Grid2D soup(soup_size, soup_size);
+    for (auto &row : soup)
+        for (auto &cell : row)
+            cell = static_cast<int>(gen() % 2);
+    reference.Initialize2D([&soup, offset](CellularAutomata::Grid2D &grid) {
+        for (int i = 0; i < soup_size; ++i)
+            for (int j = 0; j < soup_size; ++j)
+                grid[offset + i][offset + j] = soup[i][j];
+    });
+    SparseGrid2D sparse(nt);
+    sparse.SetThreadCount(threads);
+    sparse.LoadGrid(soup, row0, col0);
+    CellularAutomata::Grid2D window(size, size);
+    for (int generation = 1; generation <= generations; ++generation)
+    {
+        reference.ApplyRule2D(named.rule);
+        sparse.Step(named.rule);
+        sparse.StoreGrid(window, row0 - offset, col0 - offset);
+        if (window != reference.GetGrid2D())
+        {
+            cerr << "SparseGrid2D mismatch for " << named.name << " threads " << threads << " generation " << generation << endl;
+            assert(false);
+        }
+    }
+    long long population = 0;
+    for (const auto &row : window)
+        for (int cell : row)
+            population += (cell != 0);
+    assert(sparse.Population() == population);
+    assert(sparse.Generation() == generations);
+}
+
+// Gliders travel without the grid growing, empty blocks are freed and rules that fill the plane are refused
+void testSparseGridUnbounded()
+{
+    RuleTable life = RuleTable::FromString("B3/S23", NeighborhoodType::Moore);
+    SparseGrid2D plane(NeighborhoodType::Moore);
+    const int glider[5][2] = {{0, 1}, {1, 2}, {2, 0}, {2, 1}, {2, 2}};
+    for (const auto &cell : glider)
+        plane.Set(cell[0], cell[1], 1);
+    const int distance = 1000;
+    for (int generation = 0; generation < 4 * distance; ++generation)
+    {
+        plane.Step(life);
+        assert(plane.ChunkCount() <= 4);
+    }
+    assert(plane.Population() == 5);
+    for (const auto &cell : glider)
+        assert(plane.Get(cell[0] + distance, cell[1] + distance) == 1);
+    long long min_row = 0, min_col = 0, max_row = 0, max_col = 0;
+    assert(plane.Bounds(min_row, min_col, max_row, max_col));
+    assert(min_row == distance && min_col == distance && max_row == distance + 2 && max_col == distance + 2);
+
+    // a blinker far out in negative coordinates, then removed cell by cell
+    plane.Clear();
+    assert(plane.ChunkCount() == 0 && !plane.Bounds(min_row, min_col, max_row, max_col));
+    const long long far = -(1LL << 40);
+    for (int k = -1; k <= 1; ++k)
+        plane.Set(far, far + k, 1);
+    plane.Step(life);
+    plane.Step(life);
+    assert(plane.Get(far, far - 1) == 1 && plane.Get(far, far + 1) == 1 && plane.Population() == 3);
+    for (int k = -1; k <= 1; ++k)
+        plane.Set(far, far + k, 0);
+    assert(plane.Population() == 0 && plane.ChunkCount() == 0);
+
+    // multi-state cells: a decaying trail behind live cells, compared with a large fixed grid
+    auto trail = [](int neighbors, int state) { return state == 1 ? 2 : (state == 2 ? 3 : (state == 0 && neighbors == 2 ? 1 : 0)); };
+    NamedRule trail_rule = {"trail", trail};
+    testSparseGridMatchesReference(trail_rule, NeighborhoodType::VonNeumann, 1);
+
+    assert(throwsAs<std::invalid_argument>([&] { plane.Step(RuleTable::Parity(NeighborhoodType::Moore)); }));
+}
+
+// Rectangular grids: every stepping path must agree with the per-cell reference built from GetNeighbors2D
+void testRectangularMatchesReference(const NamedRule &named, BoundaryCondition bc, NeighborhoodType nt, int rows, int cols)
+{
+    CellularAutomata reference(rows, cols, bc, nt);
+    initRandom(reference, 23);
+    assert(reference.getRows() == rows && reference.getCols() == cols);
+    assert(reference.GetGrid2D().rows() == rows && reference.GetGrid2D().cols() == cols);
+    CellularAutomata stepped = reference, tabled = reference, run = reference, threaded = reference;
+    RuleTable table = RuleTable::FromFunction(named.rule, 2, nt);
+    run.SetTemporalBlocking(4, 8, 3);
+    threaded.SetThreadCount(3);
+    const int generations = 6;
+    for (int generation = 1; generation <= generations; ++generation)
+    {
+        CellularAutomata::Grid2D expected(rows, cols);
+        for (int i = 0; i < rows; ++i)
+            for (int j = 0; j < cols; ++j)
+                expected[i][j] = named.rule(reference.GetNeighbors2D(i, j), reference.GetGrid2D()[i][j]);
+        reference.UpdateGrid2D(expected);
+        stepped.ApplyRule2D(named.rule);
+        tabled.ApplyRule2D(table);
+        threaded.Step(named.rule);
+        if (stepped.GetGrid2D() != expected || tabled.GetGrid2D() != expected || threaded.GetGrid2D() != expected)
+        {
+            cerr << "Rectangular mismatch for " << named.name << " " << rows << "x" << cols << " generation " << generation << endl;
+            assert(false);
+        }
+    }
+    run.Run(generations, named.rule);
+    assert(run.GetGrid2D() == reference.GetGrid2D());
+}
+
+// 3D grids: the specialized layer sweep, the table path and threaded stepping against GetNeighbors3D
+void test3DMatchesReference(BoundaryCondition bc, NeighborhoodType nt, int layers, int rows, int cols)
+{
+    // a 3D life-like rule: birth on 4 (or 2 for von Neumann), survival on 3 to 5 (1 to 2)
+    const bool moore = (nt == NeighborhoodType::Moore);
+    auto rule = [moore](int neighbors, int state) {
+        if (state == 0)
+            return neighbors == (moore ? 4 : 2) ? 1 : 0;
+        return (neighbors >= (moore ? 3 : 1) && neighbors <= (moore ? 5 : 2)) ? 1 : 0;
+    };
+    CellularAutomata reference(layers, rows, cols, bc, nt);
+    mt19937 gen(29);
+    reference.Initialize3D([&gen](CellularAutomata::Grid3D &grid) {
+        for (int k = 0; k < grid.layers(); ++k)
+            for (int i = 0; i < grid.rows(); ++i)
+                for (int &cell : grid.row(k, i))
+                    cell = static_cast<int>(gen() % 3 == 0);
+    });
+    assert(reference.getLayers() == layers && reference.getRows() == rows && reference.getCols() == cols);
+    CellularAutomata stepped = reference, tabled = reference, threaded = reference;
+    RuleTable table = RuleTable::FromFunction(rule, 2, RuleTable::NeighborCount3D(nt));
+    threaded.SetThreadCount(3);
+    for (int generation = 1; generation <= 5; ++generation)
+    {
+        CellularAutomata::Grid3D expected(layers, rows, cols);
+        for (int k = 0; k < layers; ++k)
+            for (int i = 0; i < rows; ++i)
+                for (int j = 0; j < cols; ++j)
+                    expected.at(k, i, j) = rule(reference.GetNeighbors3D(k, i, j), reference.GetGrid3D().at(k, i, j));
+        reference.Initialize3D([&expected](CellularAutomata::Grid3D &grid) { grid.assign(expected); });
+        stepped.ApplyRule3D(rule);
+        tabled.ApplyRule3D(table);
+        threaded.Step(rule);
+        if (stepped.GetGrid3D() != expected || tabled.GetGrid3D() != expected || threaded.GetGrid3D() != expected)
+        {
+            cerr << "3D mismatch for " << layers << "x" << rows << "x" << cols << " generation " << generation << endl;
+            assert(false);
+        }
+    }
+}
+
+// Shapes that only exist outside of squares, and the checks that come with them
+void testGridShapes()
+{
+    CellularAutomata cube(4, GridDimension::ThreeD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    assert(cube.getLayers() == 4 && cube.getRows() == 4 && cube.getCols() == 4 && cube.getSize() == 4);
+    CellularAutomata line(9, GridDimension::OneD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    assert(line.getCols() == 9 && line.getRows() == 1 && line.GetGrid1D().size() == 9);
+
+    // a state outside of the table leaves the volume untouched
+    cube.Initialize3D([](CellularAutomata::Grid3D &grid) { grid.at(1, 2, 3) = 1; grid.at(2, 2, 3) = 5; });
+    CellularAutomata::Grid3D before = cube.GetGrid3D();
+    assert(throwsAs<std::out_of_range>([&] {
+        cube.ApplyRule3D(RuleTable::FromFunction(parityRule, 2, RuleTable::NeighborCount3D(NeighborhoodType::Moore)));
+    }) && cube.GetGrid3D() == before);
+
+    // a 2D table does not cover the 26 neighbors of a 3D cell, and 2D-only entry points refuse 3D grids
+    assert(throwsAs<std::invalid_argument>([&] { cube.ApplyRule3D(RuleTable::Parity(NeighborhoodType::Moore)); }));
+    assert(throwsAs<std::runtime_error>([&] { cube.Run(1, parityRule); }));
+
+    // Hashlife needs a square torus
+    assert(throwsAs<std::invalid_argument>([&] {
+        CellularAutomata strip(8, 16, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+        strip.RunHashlife(1, RuleTable::FromString("B3/S23", NeighborhoodType::Moore));
+    }));
+}
+
+// Trajectory files: frames written in both encodings read back unchanged, through the zero-copy views and
+// through ReadFrame, for 1D, rectangular 2D and 3D grids
+void testTrajectoryRoundTrip()
+{
+    const string path = "test_step_engine_trajectory.catraj";
+    CellularAutomata strip(5, 37, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(strip, 31);
+    RuleTable life = RuleTable::FromString("B3/S23", NeighborhoodType::Moore);
+    vector<CellularAutomata::Grid2D> expected;
+    for (TrajectoryEncoding encoding : {TrajectoryEncoding::Raw, TrajectoryEncoding::BitPacked})
+    {
+        CellularAutomata ca = strip;
+        expected.clear();
+        {
+            TrajectoryWriter writer(path, TrajectoryInfo::From(ca, encoding, life.ToString()), 64); // tiny buffer: many flushes
+            for (int generation = 0; generation < 12; ++generation)
+            {
+                writer.WriteFrame(ca, generation * 10);
+                expected.push_back(ca.GetGrid2D());
+                ca.ApplyRule2D(life);
+            }
+            assert(writer.FrameCount() == 12);
+        }
+        TrajectoryReader reader(path);
+        assert(reader.FrameCount() == 12);
+        assert(reader.info().rows == 5 && reader.info().cols == 37 && reader.info().encoding == encoding);
+        assert(reader.info().boundary == BoundaryCondition::Periodic && reader.info().rule == "B3/S23");
+        CellularAutomata::Grid2D grid;
+        for (int n = 0; n < 12; ++n)
+        {
+            TrajectoryFrame frame = reader.Frame(n);
+            assert(frame.generation() == n * 10);
+            for (int i = 0; i < 5; ++i)
+                for (int j = 0; j < 37; ++j)
+                    assert(frame.At(i, j) == expected[n][i][j]);
+            assert((frame.cells() != nullptr) == (encoding == TrajectoryEncoding::Raw));
+            reader.ReadFrame(n, grid);
+            assert(grid == expected[n]);
+        }
+        assert(throwsAs<std::out_of_range>([&] { reader.Frame(12); }));
+    }
+
+    // 1D and 3D grids, and the states a bit-packed file cannot hold
+    CellularAutomata line(100, GridDimension::OneD, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+    line.Initialize1D([](CellularAutomata::Grid1D &cells) { for (size_t k = 0; k < cells.size(); ++k) cells[k] = static_cast<int>(k % 7); });
+    CellularAutomata volume(3, 4, 5, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
+    volume.Initialize3D([](CellularAutomata::Grid3D &grid) { grid.at(2, 3, 4) = 1; grid.at(0, 1, 2) = 1; });
+    {
+        TrajectoryWriter writer(path, TrajectoryInfo::From(line));
+        writer.WriteFrame(line, 0);
+    }
+    {
+        TrajectoryReader reader(path);
+        CellularAutomata::Grid1D cells;
+        reader.ReadFrame(0, cells);
+        assert(cells == line.GetGrid1D() && reader.info().dimension == GridDimension::OneD);
+    }
+    {
+        TrajectoryWriter writer(path, TrajectoryInfo::From(volume, TrajectoryEncoding::BitPacked));
+        writer.WriteFrame(volume, 7);
+        assert(throwsAs<std::invalid_argument>([&] { writer.WriteFrame(line, 8); }));
+    }
+    {
+        TrajectoryReader reader(path);
+        CellularAutomata::Grid3D cells;
+        reader.ReadFrame(0, cells);
+        assert(reader.FrameCount() == 1 && cells == volume.GetGrid3D() && reader.Frame(0).At(2, 3, 4) == 1);
+    }
+    assert(throwsAs<std::invalid_argument>([&] {
+        TrajectoryWriter writer(path, TrajectoryInfo::From(line, TrajectoryEncoding::BitPacked));
+        writer.WriteFrame(line, 0);
+    }));
+
+    // a text file is not a trajectory
+    {
+        std::ofstream text(path.c_str());
+        text << "Iteration 1:\n0 1 0\n";
+    }
+    assert(throwsAs<std::runtime_error>([&] { TrajectoryReader reader(path); }));
+    std::remove(path.c_str());
+}
+
+// Delta trajectories: keyframes plus run-length coded changes read back exactly, in any order, much smaller
+// than raw frames; a file cut off in the middle of a record keeps its complete frames
+void testDeltaTrajectory()
+{
+    const string path = "test_step_engine_delta.catraj";
+    const int size = 96, generations = 150;
+    CellularAutomata ca(size, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    mt19937 gen(37);
+    ca.Initialize2D([&gen](CellularAutomata::Grid2D &grid) {
+        for (int i = 40; i < 56; ++i)
+            for (int j = 40; j < 56; ++j)
+                grid[i][j] = static_cast<int>(gen() % 2) * (1 + static_cast<int>(gen() % 3)); // states 0 to 3
+    });
+    // a multi-state rule: life on "alive" (state > 0), live cells count their age up to 3
+    auto aging = [](int neighbors, int state) { return (neighbors >= 5 && neighbors <= 9) || (state > 0 && neighbors >= 2 && neighbors <= 12) ? min(state + 1, 3) : 0; };
+    TrajectoryInfo info = TrajectoryInfo::From(ca, TrajectoryEncoding::Delta);
+    info.keyframe_interval = 16;
+    vector<CellularAutomata::Grid2D> expected;
+    long long delta_bytes = 0;
+    {
+        TrajectoryWriter writer(path, info);
+        for (int generation = 0; generation < generations; ++generation)
+        {
+            writer.WriteFrame(ca, generation);
+            expected.push_back(ca.GetGrid2D());
+            ca.ApplyRule2D(aging);
+        }
+        writer.Close();
+        delta_bytes = writer.BytesWritten();
+    }
+    const long long raw_bytes = static_cast<long long>(generations) * TrajectoryInfo::From(ca).FrameBytes();
+    assert(delta_bytes * 10 < raw_bytes);
+
+    TrajectoryReader reader(path);
+    assert(reader.FrameCount() == generations && reader.info().keyframe_interval == 16);
+    CellularAutomata::Grid2D grid;
+    const int order[] = {0, 1, 2, 149, 17, 16, 15, 100, 101, 103, 64, 63, 149, 0};
+    for (int n : order)
+    {
+        reader.ReadFrame(n, grid);
+        assert(grid == expected[n]);
+        TrajectoryFrame frame = reader.Frame(n);
+        assert(frame.generation() == n && frame.At(47, 50) == expected[n][47][50]);
+    }
+    for (int n = 0; n < generations; ++n)
+    {
+        reader.ReadFrame(n, grid);
+        assert(grid == expected[n]);
+    }
+
+    // cut the file in the middle of the last record
+    vector<char> bytes;
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(path.c_str(), std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 5));
+    }
+    TrajectoryReader truncated(path);
+    assert(truncated.FrameCount() == generations - 1);
+    truncated.ReadFrame(generations - 2, grid);
+    assert(grid == expected[generations - 2]);
+    std::remove(path.c_str());
+}
+
+static vector<char> readFileBytes(const string &path)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    return vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// The background writer must produce exactly the file of the synchronous one, with any queue depth and encoding,
+// and report errors of the writer thread on a later call
+void testAsyncTrajectoryWriter()
+{
+    const string sync_path = "test_step_engine_sync.catraj", async_path = "test_step_engine_async.catraj";
+    const TrajectoryEncoding encodings[] = {TrajectoryEncoding::Raw, TrajectoryEncoding::BitPacked, TrajectoryEncoding::Delta};
+    for (TrajectoryEncoding encoding : encodings)
+    {
+        for (int queue_frames : {1, 3})
+        {
+            CellularAutomata ca(33, 47, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+            initRandom(ca, 41);
+            CellularAutomata cube(5, 6, 7, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
+            cube.Initialize3D([](CellularAutomata::Grid3D &grid) { grid.at(2, 3, 3) = grid.at(2, 3, 4) = grid.at(1, 3, 3) = 1; });
+            for (CellularAutomata *automaton : {&ca, &cube})
+            {
+                TrajectoryInfo info = TrajectoryInfo::From(*automaton, encoding, "B3/S23");
+                info.keyframe_interval = 4;
+                {
+                    TrajectoryWriter writer(sync_path, info);
+                    AsyncTrajectoryWriter async(async_path, info, queue_frames, 256); // small buffer: many writes
+                    for (int generation = 0; generation < 20; ++generation)
+                    {
+                        writer.WriteFrame(*automaton, generation);
+                        async.WriteFrame(*automaton, generation);
+                        if (automaton == &ca)
+                            ca.ApplyRule2D(lifeRule);
+                        else
+                            cube.ApplyRule3D([](int neighbors, int state) { return (neighbors == 1 || (state == 1 && neighbors == 2)) ? 1 : 0; });
+                        if (generation == 10)
+                            async.Flush();
+                    }
+                    assert(async.FrameCount() == 20);
+                    writer.Close();
+                    async.Close();
+                }
+                assert(readFileBytes(sync_path) == readFileBytes(async_path));
+            }
+        }
+    }
+
+    // wrong shapes are rejected by the calling thread, unstorable states by the writer thread
+    CellularAutomata ca(16, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    AsyncTrajectoryWriter async(async_path, TrajectoryInfo::From(ca, TrajectoryEncoding::BitPacked), 2);
+    assert(throwsAs<std::invalid_argument>([&] { async.WriteFrame(FlatGrid2D(16, 17), 0); }));
+    ca.Initialize2D([](CellularAutomata::Grid2D &grid) { grid[3][4] = 2; });
+    async.WriteFrame(ca, 0);
+    assert(throwsAs<std::invalid_argument>([&] { async.Flush(); }));
+    assert(throwsAs<std::invalid_argument>([&] { async.Close(); }));
+    std::remove(sync_path.c_str());
+    std::remove(async_path.c_str());
+}
+
+// Reference text layout: every cell followed by a space, a newline per row, an empty line after each 3D layer
+static string referencePrint(const CellularAutomata &ca)
+{
+    std::ostringstream ss;
+    if (ca.GetDimension() == GridDimension::OneD)
+    {
+        for (int cell : ca.GetGrid1D())
+            ss << cell << " ";
+        ss << "\n";
+    }
+    for (int k = 0; k < (ca.GetDimension() == GridDimension::ThreeD ? ca.getLayers() : 0); ++k)
+    {
+        for (int i = 0; i < ca.getRows(); ++i)
+        {
+            for (int j = 0; j < ca.getCols(); ++j)
+                ss << ca.GetGrid3D().at(k, i, j) << " ";
+            ss << "\n";
+        }
+        ss << "\n";
+    }
+    for (int i = 0; i < (ca.GetDimension() == GridDimension::TwoD ? ca.getRows() : 0); ++i)
+    {
+        for (int j = 0; j < ca.getCols(); ++j)
+            ss << ca.GetGrid2D()[i][j] << " ";
+        ss << "\n";
+    }
+    return ss.str();
+}
+
+// Print must keep the iostream layout for every dimension and every int value, and Print(out) must match Print()
+void testPrintFormat()
+{
+    const int values[] = {0, 1, 9, 10, 42, 99, 100, 12345, -1, -10, -987654, 2147483647, -2147483647 - 1};
+    const int count = sizeof(values) / sizeof(values[0]);
+    CellularAutomata line(31, GridDimension::OneD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    line.Initialize1D([&](CellularAutomata::Grid1D &grid) {
+        for (size_t n = 0; n < grid.size(); ++n)
+            grid[n] = values[n % count];
+    });
+    CellularAutomata plane(7, 13, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+    plane.Initialize2D([&](CellularAutomata::Grid2D &grid) {
+        for (int i = 0; i < grid.rows(); ++i)
+            for (int j = 0; j < grid.cols(); ++j)
+                grid[i][j] = values[(i * 5 + j) % count];
+    });
+    CellularAutomata cube(3, 4, 5, BoundaryCondition::Periodic, NeighborhoodType::VonNeumann);
+    cube.Initialize3D([&](CellularAutomata::Grid3D &grid) {
+        for (int k = 0; k < grid.layers(); ++k)
+            for (int i = 0; i < grid.rows(); ++i)
+                for (int j = 0; j < grid.cols(); ++j)
+                    grid.at(k, i, j) = values[(k * 7 + i * 3 + j) % count];
+    });
+    CellularAutomata empty(0, 0, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+    for (const CellularAutomata *ca : {&line, &plane, &cube, &empty})
+    {
+        const string text = ca->Print();
+        assert(text == referencePrint(*ca));
+        std::ostringstream out;
+        ca->Print(out);
+        assert(out.str() == text);
+    }
+
+    // large enough for Print(out) to write several blocks
+    CellularAutomata big(700, 800, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(big, 5);
+    big.Initialize2D([](CellularAutomata::Grid2D &grid) { grid[3][5] = 123; grid[699][799] = -4; });
+    std::ostringstream out;
+    big.Print(out);
+    assert(out.str() == big.Print() && big.Print() == referencePrint(big));
+}
+
+// Philox must match the Random123 known-answer vectors, and stochastic steps must be reproducible, independent
+// of the thread count, and equal to drawing from CellRandom(seed, step, i * cols + j) cell by cell
+void testStochasticStep()
+{
+    std::uint32_t counter[4] = {0x243f6a88u, 0x85a308d3u, 0x13198a2eu, 0x03707344u};
+    const std::uint32_t key[2] = {0xa4093822u, 0x299f31d0u};
+    Philox4x32::Generate(counter, key);
+    assert(counter[0] == 0xd16cfe09u && counter[1] == 0x94fdccebu && counter[2] == 0x5001e420u && counter[3] == 0x24126ea1u);
+    std::uint32_t zeros[4] = {0, 0, 0, 0};
+    const std::uint32_t zero_key[2] = {0, 0};
+    Philox4x32::Generate(zeros, zero_key);
+    assert(zeros[0] == 0x6627e8d5u && zeros[1] == 0xe169c58du && zeros[2] == 0xbc57ac4cu && zeros[3] == 0x9b00dbd8u);
+
+    // the vector kernel gives the same blocks as the scalar streams, also where the low counter word wraps
+    vector<std::uint32_t> blocks(4 * 45);
+    if (ca_detail::PhiloxFirstBlocks(77, 3, 0xFFFFFFEEULL, 45, blocks.data(), SimdLevel::AVX2))
+    {
+        for (int n = 0; n < 45; ++n)
+        {
+            CellRandom random(77, 3, 0xFFFFFFEEULL + n);
+            for (int w = 0; w < 4; ++w)
+                assert(blocks[4 * n + w] == random.Next());
+        }
+    }
+    assert(!ca_detail::PhiloxFirstBlocks(77, 3, 0, 45, blocks.data(), SimdLevel::Scalar));
+
+    // a noisy, multi-state rule that draws a varying number of words per cell (more than one Philox block)
+    auto noisy = [](int neighbors, int state, CellRandom &random) {
+        if (state == 0)
+            return random.Chance(0.02 + 0.01 * neighbors) ? 1 + random.Below(3) : 0;
+        int draws = state * 3;
+        unsigned mixed = 0;
+        for (int k = 0; k < draws; ++k)
+            mixed ^= random.Next();
+        return (mixed & 3u) == 0 ? 0 : state;
+    };
+    const std::uint64_t seed = 0x123456789abcdefULL;
+    for (BoundaryCondition bc : boundaries)
+    {
+        for (NeighborhoodType nt : neighborhoods)
+        {
+            CellularAutomata serial(45, 71, bc, nt);
+            initRandom(serial, 19);
+            serial.SetSimdLevel(SimdLevel::Scalar);
+            CellularAutomata reference = serial;
+            for (int step = 0; step < 6; ++step)
+            {
+                CellularAutomata::Grid2D next(reference.getRows(), reference.getCols());
+                for (int i = 0; i < reference.getRows(); ++i)
+                {
+                    for (int j = 0; j < reference.getCols(); ++j)
+                    {
+                        CellRandom random(seed, step, static_cast<std::uint64_t>(i) * reference.getCols() + j);
+                        next[i][j] = noisy(reference.GetNeighbors2D(i, j), reference.GetGrid2D()[i][j], random);
+                    }
+                }
+                reference.UpdateGrid2D(next);
+                serial.StepStochastic(seed, step, noisy);
+            }
+            assert(serial.GetGrid2D() == reference.GetGrid2D());
+
+            for (int threads : {2, 3, 5})
+            {
+                CellularAutomata threaded(45, 71, bc, nt);
+                initRandom(threaded, 19);
+                threaded.SetThreadCount(threads);
+                threaded.SetActiveRegionTracking(true, 8); // bypassed by stochastic steps
+                threaded.SetSimdLevel(levels[threads % 3]);
+                for (int step = 0; step < 6; ++step)
+                    threaded.StepStochastic(seed, step, noisy);
+                assert(threaded.GetGrid2D() == serial.GetGrid2D());
+            }
+        }
+    }
+
+    // the draws are uniform and change with the seed and the step
+    CellularAutomata coin(256, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    auto flip = [](int, int, CellRandom &random) { return random.Chance(0.3) ? 1 : 0; };
+    coin.StepStochastic(1, 0, flip);
+    CellularAutomata::Grid2D first = coin.GetGrid2D();
+    long long ones = 0;
+    for (int i = 0; i < 256; ++i)
+        for (int j = 0; j < 256; ++j)
+            ones += first[i][j];
+    assert(ones > 0.29 * 65536 && ones < 0.31 * 65536);
+    coin.StepStochastic(1, 1, flip);
+    assert(coin.GetGrid2D() != first);
+    coin.StepStochastic(2, 0, flip);
+    assert(coin.GetGrid2D() != first);
+    coin.StepStochastic(1, 0, flip);
+    assert(coin.GetGrid2D() == first);
+}
+
+// StepNeuron must give exactly the grid of StepCounts with NeuronRule, for every configuration, thread count
+// and instruction set (rows of 8k + 5 cells also exercise the scalar tail of the vector kernel)
+void testNeuronModel()
+{
+    NeuronModel model;
+    model.relay_probability = 0.3;
+    model.spontaneous_rate = 0.08;
+    const std::uint64_t seed = 2024;
+    auto initNeurons = [](CellularAutomata &ca) {
+        mt19937 gen(11);
+        ca.Initialize2D([&gen](CellularAutomata::Grid2D &grid) {
+            for (int i = 0; i < grid.rows(); ++i)
+                for (int j = 0; j < grid.cols(); ++j)
+                    grid[i][j] = (gen() % 10 < 6) ? 0 : 1 + static_cast<int>(gen() % 3);
+        });
+    };
+    for (BoundaryCondition bc : boundaries)
+    {
+        for (NeighborhoodType nt : neighborhoods)
+        {
+            CellularAutomata reference(37, 53, bc, nt);
+            initNeurons(reference);
+            for (int step = 0; step < 16; ++step)
+                reference.StepCounts(seed, step, NeuronRule(model, step));
+            for (SimdLevel level : levels)
+            {
+                for (int threads : {1, 4})
+                {
+                    CellularAutomata ca(37, 53, bc, nt);
+                    initNeurons(ca);
+                    ca.SetSimdLevel(level);
+                    ca.SetThreadCount(threads);
+                    for (int step = 0; step < 16; ++step)
+                        ca.StepNeuron(model, seed, step);
+                    assert(ca.GetGrid2D() == reference.GetGrid2D());
+                }
+            }
+        }
+    }
+
+    // certain transitions: everything fires and recovers, nothing is spontaneous
+    NeuronModel certain;
+    certain.fire_probability = 1.0;
+    certain.relay_probability = 0.0;
+    certain.relay_period = 0;
+    certain.recovery_probability = 1.0;
+    certain.spontaneous_period = 0;
+    CellularAutomata ca(9, 17, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+    ca.Initialize2D([](CellularAutomata::Grid2D &grid) {
+        grid[4][8] = CellularAutomata::ACTIVE_1;
+        grid[1][1] = CellularAutomata::ACTIVE_2;
+        grid[7][15] = CellularAutomata::ACTIVE_3;
+    });
+    ca.StepNeuron(certain, seed, 0);
+    for (int i = 0; i < 9; ++i)
+        for (int j = 0; j < 17; ++j)
+            assert(ca.GetGrid2D()[i][j] == (i == 1 && j == 1 ? CellularAutomata::ACTIVE_2 : 0));
+
+    assert(throwsAs<std::invalid_argument>([&] {
+        certain.fire_probability = 1.5;
+        ca.StepNeuron(certain, seed, 1);
+    }));
+}
+
+// StepCounts must hand every rule the histogram GetNeighborCounts2D computes cell by cell, for every
+// configuration, instruction set and thread count, and reject states the histogram cannot hold
+void testNeighborCounts()
+{
+    auto mixed = [](const NeighborCounts &counts, int state) {
+        return (3 * counts.Active() + counts[2] + 5 * counts[7] + counts.Sum() + counts.Total() + state) % 8;
+    };
+    const int shapes[][2] = {{1, 1}, {3, 5}, {17, 33}, {40, 64}};
+    for (BoundaryCondition bc : boundaries)
+    {
+        for (NeighborhoodType nt : neighborhoods)
+        {
+            for (const auto &shape : shapes)
+            {
+                CellularAutomata reference(shape[0], shape[1], bc, nt);
+                mt19937 gen(shape[0] * 100 + shape[1]);
+                reference.Initialize2D([&gen](CellularAutomata::Grid2D &grid) {
+                    for (auto &row : grid)
+                        for (auto &cell : row)
+                            cell = static_cast<int>(gen() % NeighborCounts::MAX_STATES);
+                });
+                const int full = (nt == NeighborhoodType::Moore) ? 8 : 4;
+                for (SimdLevel level : levels)
+                {
+                    for (int threads : {1, 4})
+                    {
+                        CellularAutomata ca(reference);
+                        CellularAutomata expected(reference);
+                        ca.SetSimdLevel(level);
+                        ca.SetThreadCount(threads);
+                        for (int step = 0; step < 3; ++step)
+                        {
+                            CellularAutomata::Grid2D next = expected.GetGrid2D();
+                            for (int i = 0; i < shape[0]; ++i)
+                                for (int j = 0; j < shape[1]; ++j)
+                                {
+                                    const NeighborCounts counts = expected.GetNeighborCounts2D(i, j);
+                                    if (bc != BoundaryCondition::NoBoundary)
+                                        assert(counts.Total() == full);
+                                    if (bc != BoundaryCondition::Periodic || (shape[0] > 2 && shape[1] > 2))
+                                        assert(counts.Sum() == expected.GetNeighbors2D(i, j));
+                                    next[i][j] = mixed(counts, expected.GetGrid2D()[i][j]);
+                                }
+                            expected.UpdateGrid2D(next);
+                            ca.StepCounts(mixed);
+                            assert(ca.GetGrid2D() == expected.GetGrid2D());
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // an ACTIVE_3 neighbor is one active neighbor, not three
+    CellularAutomata ca(3, 3, BoundaryCondition::NoBoundary, NeighborhoodType::Moore);
+    ca.Initialize2D([](CellularAutomata::Grid2D &grid) {
+        grid[0][0] = CellularAutomata::ACTIVE_3;
+        grid[0][1] = CellularAutomata::ACTIVE_1;
+    });
+    const NeighborCounts center = ca.GetNeighborCounts2D(1, 1);
+    assert(center.Active() == 2 && center[CellularAutomata::ACTIVE_3] == 1 && center.Sum() == 4 && center.Total() == 8);
+    assert(ca.GetNeighborCounts2D(0, 0).Total() == 3 && ca.GetNeighborCounts2D(0, 0).Active() == 1);
+
+    // the stochastic variant draws the same streams as StepStochastic
+    auto noisy = [](const NeighborCounts &counts, int state, CellRandom &random) {
+        return (counts.Active() + state + static_cast<int>(random.Next() % 3)) % 4;
+    };
+    CellularAutomata serial(29, 41, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    serial.Initialize2D([](CellularAutomata::Grid2D &grid) {
+        for (int i = 0; i < grid.rows(); ++i)
+            for (int j = 0; j < grid.cols(); ++j)
+                grid[i][j] = (i * 5 + j * 3) % 4;
+    });
+    CellularAutomata threaded(serial);
+    threaded.SetThreadCount(4);
+    for (int step = 0; step < 5; ++step)
+    {
+        CellularAutomata::Grid2D next = serial.GetGrid2D();
+        for (int i = 0; i < 29; ++i)
+            for (int j = 0; j < 41; ++j)
+            {
+                CellRandom random(77, step, static_cast<std::uint64_t>(i) * 41 + j);
+                next[i][j] = noisy(serial.GetNeighborCounts2D(i, j), serial.GetGrid2D()[i][j], random);
+            }
+        serial.StepCounts(77, step, noisy);
+        threaded.StepCounts(77, step, noisy);
+        assert(serial.GetGrid2D() == next && threaded.GetGrid2D() == next);
+    }
+
+    // states outside 0 .. 7 are rejected and leave the grid untouched
+    for (int bad : {NeighborCounts::MAX_STATES, -1})
+    {
+        for (SimdLevel level : levels)
+        {
+            CellularAutomata grid(9, 21, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+            grid.Initialize2D([bad](CellularAutomata::Grid2D &g) { g[4][17] = bad; });
+            grid.SetSimdLevel(level);
+            const CellularAutomata::Grid2D before = grid.GetGrid2D();
+            assert(throwsAs<std::out_of_range>([&] { grid.StepCounts(mixed); }) && grid.GetGrid2D() == before);
+        }
+    }
+}
+
+// potential of cell (i, j) summed cell by cell, with the boundary handled by explicit checks
+double referencePotential(const FlatGrid2D &grid, bool periodic, const ConvolutionKernel &kernel, int i, int j)
+{
+    const int r = kernel.radius(), rows = grid.rows(), cols = grid.cols();
+    double sum = 0.0;
+    for (int di = -r; di <= r; ++di)
+        for (int dj = -r; dj <= r; ++dj)
+        {
+            int y = i + di, x = j + dj;
+            if (periodic)
+            {
+                y = ((y % rows) + rows) % rows;
+                x = ((x % cols) + cols) % cols;
+            }
+            else if (y < 0 || y >= rows || x < 0 || x >= cols)
+                continue;
+            sum += kernel.weight(di, dj) * grid[y][x];
+        }
+    return sum;
+}
+
+void testKernelNeighborhoods()
+{
+    auto initRandom = [](CellularAutomata &ca, int states, unsigned seed) {
+        mt19937 gen(seed);
+        ca.Initialize2D([&](CellularAutomata::Grid2D &grid) {
+            for (int i = 0; i < grid.rows(); ++i)
+                for (int j = 0; j < grid.cols(); ++j)
+                    grid[i][j] = static_cast<int>(gen() % states);
+        });
+    };
+    const ConvolutionMethod methods[] = {ConvolutionMethod::Direct, ConvolutionMethod::FFT};
+
+    // Box(1) is the Moore neighborhood: StepKernel with integer potentials must reproduce Step exactly
+    auto life = [](int neighbors, int state) { return (neighbors == 3 || (state == 1 && neighbors == 2)) ? 1 : 0; };
+    for (BoundaryCondition bc : boundaries)
+    {
+        CellularAutomata reference(29, 64, bc, NeighborhoodType::Moore);
+        initRandom(reference, 2, 5);
+        for (ConvolutionMethod method : methods)
+        {
+            for (int threads : {1, 4})
+            {
+                CellularAutomata ca(reference);
+                ca.SetConvolutionMethod(method);
+                ca.SetThreadCount(threads);
+                CellularAutomata expected(reference);
+                for (int step = 0; step < 6; ++step)
+                {
+                    expected.Step(life);
+                    ca.StepKernel(ConvolutionKernel::Box(1), [&life](double potential, int state) {
+                        return life(static_cast<int>(potential), state);
+                    });
+                    assert(ca.GetGrid2D() == expected.GetGrid2D());
+                }
+            }
+        }
+    }
+
+    // weighted kernels: both paths against the cell-by-cell sum, on padded and unpadded FFT shapes and with
+    // radii larger than the grid
+    const int shapes[][2] = {{37, 53}, {64, 64}, {5, 9}, {1, 16}};
+    for (bool periodic : {false, true})
+    {
+        for (const auto &shape : shapes)
+        {
+            CellularAutomata ca(shape[0], shape[1], periodic ? BoundaryCondition::Periodic : BoundaryCondition::Fixed,
+                                NeighborhoodType::Moore);
+            initRandom(ca, 4, 9);
+            for (int radius : {1, 4, 11})
+            {
+                const ConvolutionKernel kernel = ConvolutionKernel::MexicanHat(radius, 1.0, 2.5, 0.8);
+                vector<double> single;
+                for (ConvolutionMethod method : methods)
+                {
+                    ca.SetConvolutionMethod(method);
+                    vector<double> potential;
+                    ca.SetThreadCount(1);
+                    ca.ComputePotential(kernel, potential);
+                    for (int i = 0; i < shape[0]; ++i)
+                        for (int j = 0; j < shape[1]; ++j)
+                            assert(fabs(potential[i * shape[1] + j] - referencePotential(ca.GetGrid2D(), periodic, kernel, i, j)) < 1e-9);
+                    ca.SetThreadCount(4);
+                    ca.ComputePotential(kernel, single);
+                    assert(single == potential); // same path, same rounding, whatever the thread count
+                }
+            }
+        }
+    }
+
+    // continuous fields go through the same engine
+    vector<double> field(24 * 40), out(field.size()), expected(field.size());
+    for (size_t k = 0; k < field.size(); ++k)
+        field[k] = 0.5 + 0.5 * sin(0.37 * k);
+    const ConvolutionKernel lenia_kernel = ConvolutionKernel::Lenia(7, {0.5, 1.0});
+    KernelConvolution direct(ConvolutionMethod::Direct), fft(ConvolutionMethod::FFT);
+    direct.Convolve(field.data(), 24, 40, true, lenia_kernel, expected.data());
+    fft.Convolve(field.data(), 24, 40, true, lenia_kernel, out.data());
+    assert(direct.LastMethod() == ConvolutionMethod::Direct && fft.LastMethod() == ConvolutionMethod::FFT);
+    for (size_t k = 0; k < field.size(); ++k)
+        assert(fabs(out[k] - expected[k]) < 1e-9);
+    assert(fabs(lenia_kernel.Sum() - 1.0) < 1e-12);
+
+    // Auto keeps small kernels direct and sends large radii to the FFT
+    assert(KernelConvolution::Choose(256, 256, true, ConvolutionKernel::Box(1)) == ConvolutionMethod::Direct);
+    assert(KernelConvolution::Choose(256, 256, true, ConvolutionKernel::Lenia(30)) == ConvolutionMethod::FFT);
+
+    // Lenia steps keep the states within the levels; an empty world stays empty
+    const LeniaRule rule(0.15, 0.015, 0.1, 63);
+    CellularAutomata world(48, 48, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    world.Initialize2D([](CellularAutomata::Grid2D &grid) {
+        for (int i = 16; i < 32; ++i)
+            for (int j = 16; j < 32; ++j)
+                grid[i][j] = (i * 7 + j * 13) % 64;
+    });
+    for (int step = 0; step < 10; ++step)
+        world.StepKernel(ConvolutionKernel::Lenia(13), rule);
+    for (const auto &row : world.GetGrid2D())
+        for (int cell : row)
+            assert(cell >= 0 && cell <= rule.levels());
+    CellularAutomata empty(16, 16, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    empty.StepKernel(ConvolutionKernel::Lenia(5), rule);
+    for (const auto &row : empty.GetGrid2D())
+        for (int cell : row)
+            assert(cell == 0);
+
+    assert(throwsAs<std::invalid_argument>([&] { ConvolutionKernel bad(2, vector<double>(9, 1.0)); }));
+    assert(throwsAs<std::runtime_error>([&] {
+        CellularAutomata volume(4, GridDimension::ThreeD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+        volume.StepKernel(ConvolutionKernel::Box(1), rule);
+    }));
+}
+
+// checks the counters of a record against a direct scan of the grid (and of the grid before the call)
+static void checkCounters(const StepStats &stats, const CellularAutomata::Grid2D &grid, const CellularAutomata::Grid2D *before)
+{
+    vector<long long> histogram;
+    long long changed = 0;
+    for (int i = 0; i < grid.rows(); ++i)
+        for (int j = 0; j < grid.cols(); ++j)
+        {
+            const int state = grid[i][j];
+            if (state >= static_cast<int>(histogram.size()))
+                histogram.resize(state + 1, 0);
+            ++histogram[state];
+            changed += before && (*before)[i][j] != state;
+        }
+    assert(stats.histogram == histogram);
+    assert(stats.population == static_cast<long long>(grid.cellCount()) - (histogram.empty() ? 0 : histogram[0]));
+    assert(stats.other_states == 0);
+    assert(stats.cells_changed == (before ? changed : -1));
+    const double phases = stats.neighbor_seconds + stats.rule_seconds + stats.swap_seconds + stats.count_seconds;
+    assert(stats.neighbor_seconds >= 0 && stats.rule_seconds >= 0 && stats.swap_seconds >= 0 && stats.count_seconds >= 0);
+    assert(phases <= stats.total_seconds + 1e-9);
+}
+
+// instrumented stepping calls report one record per outermost call with the counters of the grid they leave,
+// and the stepping itself is unchanged
+void testInstrumentation()
+{
+    CellularAutomata ca(40, 70, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    CellularAutomata plain(40, 70, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(ca, 21);
+    initRandom(plain, 21);
+    ca.ApplyRule2D(parityRule);
+    assert(ca.GetStepStats().calls == 0 && ca.GetTotalStats().calls == 0); // off by default
+
+    vector<StepStats> seen;
+    ca.SetInstrumentation(true);
+    ca.SetStepCallback([&seen](const StepStats &stats) { seen.push_back(stats); });
+    plain.ApplyRule2D(parityRule);
+    const RuleTable table = RuleTable::Parity(NeighborhoodType::Moore);
+    const NeuronModel model;
+    for (int step = 0; step < 8; ++step)
+    {
+        const CellularAutomata::Grid2D before = ca.GetGrid2D();
+        switch (step)
+        {
+        case 0:
+            ca.ApplyRule2D(parityRule);
+            plain.ApplyRule2D(parityRule);
+            break;
+        case 1:
+            ca.ApplyRule2D(table);
+            plain.ApplyRule2D(table);
+            break;
+        case 2:
+            ca.Step([](int sum, int state) { return (sum == 3 || (sum == 2 && state == 1)) ? 1 : 0; });
+            plain.Step([](int sum, int state) { return (sum == 3 || (sum == 2 && state == 1)) ? 1 : 0; });
+            break;
+        case 3:
+            ca.StepNeuron(model, 5, step);
+            plain.StepNeuron(model, 5, step);
+            break;
+        case 4:
+            ca.StepCounts(5, step, NeuronRule(model, step));
+            plain.StepCounts(5, step, NeuronRule(model, step));
+            assert(ca.GetStepStats().neighbor_seconds > 0 && ca.GetStepStats().rule_seconds > 0);
+            break;
+        case 5:
+            ca.StepKernel(ConvolutionKernel::Box(2), [](double potential, int state) { return potential > 6 ? 0 : state; });
+            plain.StepKernel(ConvolutionKernel::Box(2), [](double potential, int state) { return potential > 6 ? 0 : state; });
+            break;
+        case 6:
+            ca.SetActiveRegionTracking(true, 8);
+            plain.SetActiveRegionTracking(true, 8);
+            ca.ApplyRule2D(majorityRule2DAdapter);
+            plain.ApplyRule2D(majorityRule2DAdapter);
+            break;
+        default:
+            ca.ApplyRule2D(majorityRule2DAdapter);
+            plain.ApplyRule2D(majorityRule2DAdapter);
+            break;
+        }
+        assert(ca.GetGrid2D() == plain.GetGrid2D());
+        assert(static_cast<int>(seen.size()) == step + 1);
+        const StepStats &stats = ca.GetStepStats();
+        assert(stats.calls == 1 && stats.generations == 1 && seen.back().histogram == stats.histogram);
+        checkCounters(stats, ca.GetGrid2D(), &before);
+    }
+
+    // Print and trajectory output are charged to the next record
+    const string text = ca.Print();
+    assert(!text.empty());
+    ca.ApplyRule2D(majorityRule2DAdapter);
+    assert(ca.GetStepStats().io_seconds > 0);
+    ca.ApplyRule2D(majorityRule2DAdapter);
+    assert(ca.GetStepStats().io_seconds == 0);
+
+    // a multi-generation call is one record; Run with a table steps through ApplyRule2D without extra records
+    ca.SetActiveRegionTracking(false);
+    const size_t records = seen.size();
+    initRandom(ca, 22);
+    ca.Run(5, table);
+    assert(seen.size() == records + 1 && ca.GetStepStats().generations == 5);
+    checkCounters(ca.GetStepStats(), ca.GetGrid2D(), nullptr);
+    ca.SetTemporalBlocking(16, 16, 4);
+    ca.Run(9, parityRule);
+    assert(seen.size() == records + 2 && ca.GetStepStats().generations == 9);
+    checkCounters(ca.GetStepStats(), ca.GetGrid2D(), nullptr);
+    const StepStats &totals = ca.GetTotalStats();
+    assert(totals.calls == static_cast<long long>(seen.size()) && totals.generations == 8 + 2 + 5 + 9);
+    assert(totals.histogram == ca.GetStepStats().histogram);
+
+    // a call that throws leaves no record and does not disturb the next one
+    ca.Initialize2D([](CellularAutomata::Grid2D &grid) { grid[3][4] = NeighborCounts::MAX_STATES; });
+    assert(throwsAs<std::out_of_range>([&] {
+        ca.StepCounts([](const NeighborCounts &, int state) { return state; });
+    }) && seen.size() == records + 2);
+    ca.Initialize2D([](CellularAutomata::Grid2D &grid) { grid[3][4] = 300; });
+    ca.ApplyRule2D(parityRule);
+    assert(seen.size() == records + 3 && ca.GetStepStats().cells_changed >= 0);
+
+    // counting off: times only; 1D and 3D automata count their cells as well
+    ca.SetInstrumentation(true, false);
+    assert(ca.GetTotalStats().calls == 0);
+    ca.ApplyRule2D(parityRule);
+    assert(ca.GetStepStats().calls == 1 && ca.GetStepStats().population == -1 && ca.GetStepStats().histogram.empty());
+    ca.SetInstrumentation(false);
+    ca.ApplyRule2D(parityRule);
+    assert(ca.GetStepStats().calls == 0);
+
+    CellularAutomata line(50, GridDimension::OneD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    line.Initialize1D([](CellularAutomata::Grid1D &grid) { grid[10] = grid[11] = 1; grid[30] = 400; });
+    line.SetInstrumentation(true);
+    const CellularAutomata::Grid1D line_before = line.GetGrid1D();
+    line.ApplyRule1D(majorityRule_1D);
+    long long changed = 0, population = 0;
+    for (size_t n = 0; n < line_before.size(); ++n)
+    {
+        changed += line.GetGrid1D()[n] != line_before[n];
+        population += line.GetGrid1D()[n] != 0;
+    }
+    assert(line.GetStepStats().cells_changed == changed && line.GetStepStats().population == population);
+    CellularAutomata cube(4, 5, 6, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
+    cube.Initialize3D([](CellularAutomata::Grid3D &grid) { grid.at(1, 2, 3) = 2; grid.at(3, 4, 5) = 1; });
+    cube.SetInstrumentation(true);
+    cube.ApplyRule3D(parityRule);
+    long long active = 0;
+    for (int k = 0; k < 4; ++k)
+        for (int i = 0; i < 5; ++i)
+            for (int j = 0; j < 6; ++j)
+                active += cube.GetGrid3D().at(k, i, j) != 0;
+    assert(cube.GetStepStats().population == active && cube.GetStepStats().histogram[0] == 120 - active);
+
+    // RunHashlife writes the grid directly, so even a single generation has no previous grid to compare with
+    CellularAutomata torus(16, 16, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(torus, 23);
+    torus.ApplyRule2D(parityRule); // leaves an older generation in the back buffer
+    torus.SetInstrumentation(true);
+    torus.RunHashlife(1, RuleTable::Parity(NeighborhoodType::Moore));
+    assert(torus.GetStepStats().generations == 1);
+    checkCounters(torus.GetStepStats(), torus.GetGrid2D(), nullptr);
+}
+
+// Every ensemble member must step exactly like a CellularAutomata of its own: ApplyRule2D for Step, the
+// member's own rule for StepMembers and StepNeuron with the member's model and seed, for every configuration,
+// instruction set and thread count (13 members leave three padding lanes in the second group)
+void testEnsemble()
+{
+    const int members = 13, rows = 11, cols = 9;
+    auto initMember = [](int member, FlatGrid2D &grid) {
+        mt19937 gen(100 + member);
+        for (int i = 0; i < grid.rows(); ++i)
+            for (int j = 0; j < grid.cols(); ++j)
+                grid.at(i, j) = (gen() % 10 < 6) ? 0 : 1 + static_cast<int>(gen() % 3);
+    };
+    auto initReference = [&](int member, CellularAutomata &ca) {
+        ca.Initialize2D([&](CellularAutomata::Grid2D &grid) { initMember(member, grid); });
+    };
+    vector<NeuronModel> models(members);
+    vector<std::uint64_t> seeds(members);
+    for (int m = 0; m < members; ++m)
+    {
+        models[m].relay_probability = 0.05 * m;
+        models[m].spontaneous_rate = (m % 3 == 0) ? 0.0 : 0.02 * m;
+        seeds[m] = 7919 * m + 1;
+    }
+    // the threshold of member m is m % 4 + 2 live neighbors
+    auto memberRule = [](int member, int sum, int state) { return sum >= member % 4 + 2 ? 1 : (sum == 1 ? 0 : state); };
+
+    for (BoundaryCondition bc : boundaries)
+    {
+        for (NeighborhoodType nt : neighborhoods)
+        {
+            vector<FlatGrid2D> parity, thresholds, neurons;
+            for (int m = 0; m < members; ++m)
+            {
+                CellularAutomata a(rows, cols, bc, nt), b(rows, cols, bc, nt), c(rows, cols, bc, nt);
+                initReference(m, a);
+                initReference(m, b);
+                initReference(m, c);
+                for (int step = 0; step < 6; ++step)
+                {
+                    a.ApplyRule2D(parityRule);
+                    b.ApplyRule2D([m, &memberRule](int sum, int state) { return memberRule(m, sum, state); });
+                    c.StepNeuron(models[m], seeds[m], step);
+                }
+                parity.push_back(a.GetGrid2D());
+                thresholds.push_back(b.GetGrid2D());
+                neurons.push_back(c.GetGrid2D());
+            }
+            for (SimdLevel level : levels)
+            {
+                for (int threads : {1, 3})
+                {
+                    Ensemble2D a(members, rows, cols, bc, nt), b(members, rows, cols, bc, nt), c(members, rows, cols, bc, nt);
+                    for (Ensemble2D *ensemble : {&a, &b, &c})
+                    {
+                        ensemble->SetSimdLevel(level);
+                        ensemble->SetThreadCount(threads);
+                        ensemble->Initialize(initMember);
+                    }
+                    for (int step = 0; step < 6; ++step)
+                    {
+                        a.Step(parityRule);
+                        b.StepMembers(memberRule);
+                        c.StepNeuron(models, seeds, step);
+                    }
+                    for (int m = 0; m < members; ++m)
+                    {
+                        assert(a.GetMember(m) == parity[m]);
+                        assert(b.GetMember(m) == thresholds[m]);
+                        assert(c.GetMember(m) == neurons[m]);
+                    }
+                }
+            }
+        }
+    }
+
+    // a single shared model, member access and argument checks
+    Ensemble2D ensemble(3, 4, 5, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+    FlatGrid2D grid(4, 5);
+    grid.at(2, 3) = CellularAutomata::ACTIVE_1;
+    ensemble.SetMember(1, grid);
+    assert(ensemble.GetCell(1, 2, 3) == CellularAutomata::ACTIVE_1 && ensemble.GetCell(0, 2, 3) == 0);
+    assert(ensemble.Population(1) == 1 && ensemble.Population(2) == 0);
+    ensemble.StepNeuron(vector<NeuronModel>(1), {1, 2, 3}, 0);
+    assert(throwsAs<std::out_of_range>([&] { ensemble.GetMember(3); }));
+    assert(throwsAs<std::invalid_argument>([&] { ensemble.StepNeuron(vector<NeuronModel>(2), {1, 2, 3}, 1); }));
+    assert(throwsAs<std::invalid_argument>([&] { ensemble.SetMember(0, FlatGrid2D(5, 4)); }));
+}
+
+// A run restored from a checkpoint must continue bit-identically: the neuron model resumed halfway from a
+// background checkpoint, 1D and 3D grids, the rule table and extra bytes must all come back, and truncated,
+// damaged or mismatched checkpoints must be rejected
+void testCheckpoint()
+{
+    const string path = "test_step_engine_checkpoint.cackpt";
+    NeuronModel model;
+    model.relay_probability = 0.3;
+    model.spontaneous_rate = 0.05;
+    CellularAutomata uninterrupted(23, 41, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    uninterrupted.Initialize2D([](CellularAutomata::Grid2D &grid) {
+        mt19937 gen(5);
+        for (int i = 0; i < grid.rows(); ++i)
+            for (int j = 0; j < grid.cols(); ++j)
+                grid[i][j] = (gen() % 10 < 6) ? 0 : 1 + static_cast<int>(gen() % 3);
+    });
+    CheckpointState state;
+    state.seed = 0x1234567890abcdefull;
+    state.rule = RuleTable::FromString("B36/S23", NeighborhoodType::Moore);
+    state.extra = string("app\0state", 9);
+    {
+        CheckpointWriter writer(path);
+        for (state.step = 0; state.step < 20; ++state.step)
+        {
+            if (state.step == 10)
+            {
+                writer.Save(uninterrupted, state); // stepping continues while the snapshot is written
+            }
+            uninterrupted.StepNeuron(model, state.seed, state.step);
+        }
+        writer.Close();
+        assert(writer.WrittenCount() + writer.SkippedCount() == 1 && writer.WrittenCount() == 1);
+    }
+    {
+        CheckpointReader reader(path);
+        assert(reader.state().step == 10 && reader.state().seed == state.seed);
+        assert(reader.state().rule == state.rule && reader.state().extra == state.extra);
+        CellularAutomata resumed = reader.CreateAutomaton();
+        for (std::uint64_t step = reader.state().step; step < 20; ++step)
+            resumed.StepNeuron(model, reader.state().seed, step);
+        assert(resumed.GetGrid2D() == uninterrupted.GetGrid2D());
+    }
+
+    // 1D and 3D grids, and a later synchronous checkpoint replacing the earlier one
+    CellularAutomata line(37, GridDimension::OneD, BoundaryCondition::Fixed, NeighborhoodType::VonNeumann);
+    line.Initialize1D([](CellularAutomata::Grid1D &grid) {
+        for (size_t k = 0; k < grid.size(); ++k)
+            grid[k] = static_cast<int>(k % 3 == 0);
+    });
+    CellularAutomata cube(3, 4, 5, BoundaryCondition::NoBoundary, NeighborhoodType::Moore);
+    cube.Initialize3D([](CellularAutomata::Grid3D &grid) {
+        for (int k = 0; k < grid.layers(); ++k)
+            for (int i = 0; i < grid.rows(); ++i)
+                for (int j = 0; j < grid.cols(); ++j)
+                    grid.at(k, i, j) = (k + i * j) % 2;
+    });
+    CheckpointState plain;
+    WriteCheckpoint(path, line, plain);
+    {
+        CheckpointReader reader(path);
+        assert(reader.GetDimension() == GridDimension::OneD && reader.state().rule.numStates() == 0);
+        assert(reader.CreateAutomaton().GetGrid1D() == line.GetGrid1D());
+    }
+    WriteCheckpoint(path, cube, plain);
+    {
+        CheckpointReader reader(path);
+        CellularAutomata restored(3, 4, 5, BoundaryCondition::NoBoundary, NeighborhoodType::Moore);
+        reader.Restore(restored);
+        restored.ApplyRule3D(parityRule);
+        cube.ApplyRule3D(parityRule);
+        assert(restored.GetGrid3D() == cube.GetGrid3D());
+
+        assert(throwsAs<std::invalid_argument>([&] { reader.Restore(line); }));
+    }
+
+    // a damaged cell, a truncated file, a damaged step counter and rule table sizes that would overflow
+    std::vector<char> bytes;
+    {
+        std::ifstream in(path.c_str(), std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    for (int damage = 0; damage < 4; ++damage)
+    {
+        std::vector<char> broken(bytes);
+        if (damage == 0)
+            broken.back() ^= 1;
+        else if (damage == 1)
+            broken.pop_back();
+        else if (damage == 2)
+            broken[56] ^= 1; // lowest byte of the step counter on little-endian machines, some other on the rest
+        else
+            std::fill(broken.begin() + 44, broken.begin() + 52, '\x7f'); // rule states and maximum sum near 2^31
+        {
+            std::ofstream out(path.c_str(), std::ios::binary);
+            out.write(broken.data(), static_cast<std::streamsize>(broken.size()));
+        }
+        assert(throwsAs<std::runtime_error>([&] { CheckpointReader reader(path); }));
+    }
+    std::remove(path.c_str());
+}
+
+// Run with cycle detection must leave exactly the grid of a plain Run (FastForward), or the grid of the
+// generation it reports (Stop), and the transient and period must be those of the first repeated state
+void testCycleDetection(const NamedRule &named, BoundaryCondition bc, NeighborhoodType nt, int size)
+{
+    const int steps = 120;
+    auto init = [size](CellularAutomata &ca) {
+        mt19937 gen(size);
+        ca.Initialize2D([&gen](CellularAutomata::Grid2D &grid) {
+            for (int i = 0; i < grid.rows(); ++i)
+                for (int j = 0; j < grid.cols(); ++j)
+                    grid[i][j] = gen() % 2;
+        });
+    };
+    // every generation, to find the first repeat by brute force
+    CellularAutomata reference(size, size, bc, nt);
+    init(reference);
+    vector<CellularAutomata::Grid2D> states(1, reference.GetGrid2D());
+    long long transient = -1, period = -1;
+    for (int g = 1; g <= steps; ++g)
+    {
+        reference.ApplyRule2D(named.rule);
+        states.push_back(reference.GetGrid2D());
+        for (int s = g - 1; s >= 0 && transient < 0; --s)
+            if (states[s] == states[g])
+            {
+                transient = s;
+                period = g - s;
+            }
+    }
+    const bool confirmable = transient >= 0 && transient + 2 * period <= steps;
+
+    for (CycleAction action : {CycleAction::FastForward, CycleAction::Stop})
+    {
+        for (int variant = 0; variant < 4; ++variant)
+        {
+            const bool table = (variant & 1) != 0, tracking = (variant & 2) != 0; // tracking: hash changed tiles only
+            CellularAutomata ca(size, size, bc, nt);
+            init(ca);
+            ca.SetCycleDetection(true, 64, action);
+            ca.SetTemporalBlocking(16, 16, 4);
+            ca.SetActiveRegionTracking(tracking, 8);
+            if (table)
+                ca.Run(steps, RuleTable::FromFunction(named.rule, 2, nt));
+            else
+                ca.Run(steps, named.rule);
+            const CycleInfo &info = ca.GetCycleInfo();
+            assert(info.detected == (confirmable && period <= 64));
+            if (info.detected)
+            {
+                assert(info.transient == transient && info.period == period);
+                assert(info.computed <= transient + 2 * period + period);
+            }
+            if (action == CycleAction::FastForward)
+            {
+                assert(info.generations == steps && ca.GetGrid2D() == states[steps]);
+            }
+            else
+            {
+                assert(info.generations == (info.detected ? transient + 2 * period : steps));
+                assert(ca.GetGrid2D() == states[info.generations]);
+            }
+        }
+    }
+}
+
+// A blinker has period 2: a history of one generation cannot see it, two can
+void testCycleHistory()
+{
+    RuleTable life = RuleTable::FromString("B3/S23", NeighborhoodType::Moore);
+    for (int history : {1, 2})
+    {
+        CellularAutomata ca(8, 8, BoundaryCondition::Fixed, NeighborhoodType::Moore);
+        ca.Initialize2D([](CellularAutomata::Grid2D &grid) { grid[3][2] = grid[3][3] = grid[3][4] = 1; });
+        ca.SetCycleDetection(true, history);
+        ca.Run(1001, life);
+        assert(ca.GetCycleInfo().detected == (history == 2));
+        assert(ca.GetGrid2D()[2][3] == 1 && ca.GetGrid2D()[3][2] == 0); // odd generation: vertical
+        if (history == 2)
+            assert(ca.GetCycleInfo().transient == 0 && ca.GetCycleInfo().period == 2 && ca.GetCycleInfo().computed == 5);
+    }
+}
+
+// A state that the table does not cover must be reported and must not modify the grid
+void testOutOfRangeStateIsRejected()
+{
+    CellularAutomata ca(20, GridDimension::TwoD, BoundaryCondition::Periodic, NeighborhoodType::Moore);
+    initRandom(ca, 3);
+    ca.Initialize2D([](CellularAutomata::Grid2D &grid) { grid[11][13] = 5; });
+    CellularAutomata::Grid2D before = ca.GetGrid2D();
+    RuleTable table = RuleTable::FromFunction(parityRule, 2, NeighborhoodType::Moore);
+    ca.SetThreadCount(4);
+    for (SimdLevel level : levels)
+    {
+        ca.SetSimdLevel(level);
+        assert(throwsAs<std::out_of_range>([&] { ca.ApplyRule2D(table); }));
+        assert(ca.GetGrid2D() == before);
+    }
+
+    ca.SetTemporalBlocking(8, 8, 4);
+    assert(throwsAs<std::out_of_range>([&] { ca.Run(10, table); }));
+    assert(ca.GetGrid2D() == before);
+
+    ca.SetActiveRegionTracking(true, 4);
+    assert(throwsAs<std::out_of_range>([&] { ca.ApplyRule2D(table); }));
+    assert(ca.GetGrid2D() == before);
+}
+
+int main()
+{
+    vector<NamedRule> rules = {
+        {"majorityRule2D", majorityRule2DAdapter},
+        {"parityRule", parityRule},
+        {"totalisticRule", totalisticRule},
+    };
+
+    cout << "Best SIMD level on this machine: " << SimdLevelName(DetectSimdLevel()) << endl;
+    for (const NamedRule &named : rules)
+        for (BoundaryCondition bc : boundaries)
+            for (NeighborhoodType nt : neighborhoods)
+                for (int size : sizes)
+                    for (SimdLevel level : levels)
+                        testTableMatchesReference(named, bc, nt, size, level);
+    cout << "Table-driven kernels match ApplyRule2D for every rule, boundary and neighborhood" << endl;
+
+    const int bit_shapes[][2] = {{1, 1}, {3, 3}, {10, 10}, {63, 63}, {64, 64}, {65, 65}, {5, 130}, {7, 64}, {9, 200}};
+    for (const NamedRule &named : rules)
+        for (BoundaryCondition bc : boundaries)
+            for (NeighborhoodType nt : neighborhoods)
+                for (const auto &shape : bit_shapes)
+                    testBitGridMatchesReference(named, bc, nt, shape[0], shape[1]);
+    cout << "Bit-packed BitGrid2D matches the int engine" << endl;
+
+    for (BoundaryCondition bc : boundaries)
+        for (NeighborhoodType nt : neighborhoods)
+            for (int threads : {2, 3, 8})
+                testThreadedMatchesSerial(bc, nt, threads);
+    cout << "Multi-threaded stepping matches the serial path" << endl;
+
+    const int run_sizes[] = {1, 5, 37, 130};
+    for (const NamedRule &named : rules)
+        for (BoundaryCondition bc : boundaries)
+            for (NeighborhoodType nt : neighborhoods)
+                for (int size : run_sizes)
+                    testRunMatchesStepping(named, bc, nt, size);
+    cout << "Temporally blocked Run matches stepping one generation at a time" << endl;
+
+    const int active_sizes[] = {1, 7, 64, 100};
+    for (const NamedRule &named : rules)
+        for (BoundaryCondition bc : boundaries)
+            for (NeighborhoodType nt : neighborhoods)
+                for (int size : active_sizes)
+                    testActiveRegionMatchesReference(named, bc, nt, size);
+    testActiveRegionSkipsQuiescentTiles();
+    cout << "Sparse activity mode matches full sweeps and skips quiescent tiles" << endl;
+
+    const int hashlife_sizes[] = {1, 2, 4, 8, 32, 64};
+    for (const NamedRule &named : rules)
+        for (NeighborhoodType nt : neighborhoods)
+            for (int size : hashlife_sizes)
+                testHashlifeMatchesReference(named, nt, size);
+    testHashlifePlane();
+    testCopiesStepIndependently();
+    cout << "Hashlife matches stepping on the torus and the plane" << endl;
+
+    // parityRule turns empty cells on and is covered by testSparseGridUnbounded
+    for (const NamedRule &named : rules)
+        if (named.name != "parityRule")
+            for (NeighborhoodType nt : neighborhoods)
+                for (int threads : {1, 3})
+                    testSparseGridMatchesReference(named, nt, threads);
+    testSparseGridUnbounded();
+    cout << "SparseGrid2D matches a large NoBoundary grid and keeps memory to the live region" << endl;
+
+    const int rect_shapes[][2] = {{1, 7}, {7, 1}, {5, 130}, {64, 3}, {3, 200}};
+    for (const NamedRule &named : rules)
+        for (BoundaryCondition bc : boundaries)
+            for (NeighborhoodType nt : neighborhoods)
+                for (const auto &shape : rect_shapes)
+                    testRectangularMatchesReference(named, bc, nt, shape[0], shape[1]);
+    const int volume_shapes[][3] = {{1, 1, 1}, {3, 4, 5}, {8, 8, 8}, {2, 17, 33}, {5, 1, 40}};
+    for (BoundaryCondition bc : boundaries)
+        for (NeighborhoodType nt : neighborhoods)
+            for (const auto &shape : volume_shapes)
+                test3DMatchesReference(bc, nt, shape[0], shape[1], shape[2]);
+    testGridShapes();
+    cout << "Rectangular and 3D grids match the per-cell references" << endl;
+
+    testRuleTables();
+    cout << "Rule strings, built-in tables and the 1D table path work" << endl;
+
+    testTrajectoryRoundTrip();
+    testDeltaTrajectory();
+    cout << "Trajectory files round-trip raw, bit-packed and delta frames" << endl;
+
+    testAsyncTrajectoryWriter();
+    cout << "Background trajectory writer matches the synchronous writer" << endl;
+
+    testPrintFormat();
+    cout << "Print keeps the text layout for every dimension and value" << endl;
+
+    testStochasticStep();
+    cout << "Stochastic steps are reproducible and independent of the thread count" << endl;
+
+    testNeighborCounts();
+    cout << "Neighbor histograms match the per-cell reference" << endl;
+
+    testNeuronModel();
+    cout << "Neuron model kernel matches the stochastic reference" << endl;
+
+    testKernelNeighborhoods();
+    cout << "Kernel neighborhoods agree on the direct and FFT paths" << endl;
+
+    testOutOfRangeStateIsRejected();
+    cout << "Out of range states are rejected" << endl;
+
+    testInstrumentation();
+    cout << "Instrumented steps report their phases and cell counts" << endl;
+
+    testEnsemble();
+    cout << "Ensemble members step like separate automata" << endl;
+
+    testCheckpoint();
+    cout << "Checkpoints restore runs bit-identically and reject damaged files" << endl;
+
+    for (const NamedRule &named : rules)
+        for (BoundaryCondition bc : boundaries)
+            for (NeighborhoodType nt : neighborhoods)
+                for (int size : {4, 9, 37})
+                    testCycleDetection(named, bc, nt, size);
+    testCycleHistory();
+    cout << "Cycle detection finds the transient and period and keeps Run's result" << endl;
+
+    cout << "All step engine tests passed" << endl;
+    return 0;
+}
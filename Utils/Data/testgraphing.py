@@ -21,6 +21,71 @@ def read_all_iterations_from_file(filename):
             all_iterations.append(np.array(current_grid))
     return all_iterations
 
+# Function to read every frame of a binary trajectory file (written by TrajectoryWriter, see Include/Trajectory.h)
+# The frames are memory-mapped, so nothing is parsed; returns the same list of 2D arrays as the text reader
+# (3D frames keep their layers as the first axis).
+def read_trajectory(filename):
+    header = np.fromfile(filename, dtype=np.uint8, count=64)
+    if header[:8].tobytes() != b"CATRAJ01":
+        raise ValueError(filename + " is not a trajectory file")
+    words = header[8:36].view(np.uint32)  # byte order mark, version, header size, dimension, boundary, neighborhood, encoding
+    if words[0] != 0x01020304:
+        raise ValueError(filename + " was written with a different byte order")
+    header_bytes, dimension, encoding = int(words[2]), int(words[3]), int(words[6])
+    layers, rows, cols = (int(v) for v in header[36:48].view(np.int32))
+    frame_bytes = int(header[48:56].view(np.uint64)[0])
+    cells = layers * rows * cols
+    data = np.memmap(filename, dtype=np.uint8, mode="r", offset=header_bytes)
+    shape = (layers, rows, cols) if dimension == 2 else (rows, cols)  # GridDimension: 0 = 1D, 1 = 2D, 2 = 3D
+    if encoding == 2:
+        return read_delta_frames(data, cells, shape)
+    frames = data[: len(data) // frame_bytes * frame_bytes].reshape(-1, frame_bytes)
+    all_iterations = []
+    for frame in frames:
+        payload = frame[8:]
+        if encoding == 0:  # Raw: 32-bit ints
+            grid = payload[: 4 * cells].view(np.int32)
+        else:              # BitPacked: one bit per cell, least significant bit first
+            grid = np.unpackbits(payload, bitorder="little")[:cells]
+        all_iterations.append(grid.reshape(shape))
+    return all_iterations
+
+# Delta records: generation, kind (0 keyframe, 1 delta), payload size, then (unchanged run, literal count,
+# literals...) varints giving the XOR with the previous frame (an all-zero frame for keyframes)
+def read_delta_frames(data, cells, shape):
+    def varint(buf, pos):
+        value, shift = 0, 0
+        while True:
+            byte = int(buf[pos])
+            pos += 1
+            value |= (byte & 0x7F) << shift
+            shift += 7
+            if byte < 0x80:
+                return value, pos
+    all_iterations = []
+    grid = np.zeros(cells, dtype=np.uint32)
+    offset = 0
+    while len(data) - offset >= 16:
+        kind, size = (int(v) for v in np.frombuffer(data[offset + 8:offset + 16].tobytes(), dtype=np.uint32))
+        end = offset + 16 + (size + 7) // 8 * 8
+        if end > len(data):
+            break  # cut off by an interrupted run
+        payload = bytes(data[offset + 16:offset + 16 + size])
+        if kind == 0:
+            grid[:] = 0
+        pos, cell = 0, 0
+        while cell < cells:
+            unchanged, pos = varint(payload, pos)
+            literals, pos = varint(payload, pos)
+            cell += unchanged
+            for _ in range(literals):
+                value, pos = varint(payload, pos)
+                grid[cell] ^= value
+                cell += 1
+        all_iterations.append(grid.view(np.int32).reshape(shape).copy())
+        offset = end
+    return all_iterations
+
 # Function to convert a grid to an image
 def grid_to_image(grid, cmap):
     fig, ax = plt.subplots()
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "../Include/AsyncTrajectoryWriter.h"
+
+// Constructor
+// opens the file (through the TrajectoryWriter), allocates every buffer and starts the writer thread.
+AsyncTrajectoryWriter::AsyncTrajectoryWriter(const std::string &path, const TrajectoryInfo &info, int queue_frames,
+                                             std::size_t buffer_bytes)
+    : writer_(path, info, buffer_bytes), busy_(false), stopping_(false), closed_(false), frames_(0), stalls_(0),
+      stall_seconds_(0.0)
+{
+    if (queue_frames < 1)
+    {
+        throw std::invalid_argument("AsyncTrajectoryWriter needs at least one frame buffer");
+    }
+    slots_.resize(queue_frames);
+    for (int k = 0; k < queue_frames; ++k)
+    {
+        slots_[k].cells.resize(static_cast<std::size_t>(info.CellCount()));
+        slots_[k].generation = 0;
+        free_slots_.push_back(k);
+    }
+    thread_ = std::thread(&AsyncTrajectoryWriter::WriterLoop, this);
+}
+
+AsyncTrajectoryWriter::~AsyncTrajectoryWriter()
+{
+    ca_detail::CloseQuietly(*this);
+}
+
+void AsyncTrajectoryWriter::CheckShape(int layers, int rows, int cols) const
+{
+    if (closed_)
+    {
+        throw std::runtime_error("Trajectory file is closed");
+    }
+    const TrajectoryInfo &header = writer_.info();
+    if (layers != header.layers || rows != header.rows || cols != header.cols)
+    {
+        throw std::invalid_argument("Frame shape does not match the trajectory header");
+    }
+}
+
+// AcquireSlot
+// a free buffer; waits (and counts the stall) when the writer thread still holds all of them.
+int AsyncTrajectoryWriter::AcquireSlot()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_slots_.empty() && !error_)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        space_.wait(lock, [this] { return !free_slots_.empty() || error_; });
+        ++stalls_;
+        stall_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+    int slot = free_slots_.back();
+    free_slots_.pop_back();
+    return slot;
+}
+
+void AsyncTrajectoryWriter::Submit(int slot, long long generation)
+{
+    slots_[slot].generation = generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.push_back(slot);
+    }
+    work_.notify_one();
+    ++frames_;
+}
+
+void AsyncTrajectoryWriter::WriteFrame(const std::vector<int> &grid, long long generation)
+{
+    CheckShape(1, 1, static_cast<int>(grid.size()));
+    int slot = AcquireSlot();
+    std::copy(grid.begin(), grid.end(), slots_[slot].cells.begin());
+    Submit(slot, generation);
+}
+
+void AsyncTrajectoryWriter::WriteFrame(const FlatGrid2D &grid, long long generation)
+{
+    CheckShape(1, grid.rows(), grid.cols());
+    int slot = AcquireSlot();
+    int *out = slots_[slot].cells.data();
+    if (grid.isPacked())
+        std::copy(grid.data(), grid.data() + grid.cellCount(), out); // one copy for the whole frame
+    else
+        for (int i = 0; i < grid.rows(); ++i, out += grid.cols())
+            std::copy(grid[i].data(), grid[i].data() + grid.cols(), out);
+    Submit(slot, generation);
+}
+
+void AsyncTrajectoryWriter::WriteFrame(const FlatGrid3D &grid, long long generation)
+{
+    CheckShape(grid.layers(), grid.rows(), grid.cols());
+    int slot = AcquireSlot();
+    int *out = slots_[slot].cells.data();
+    for (int k = 0; k < grid.layers(); ++k)
+        for (int i = 0; i < grid.rows(); ++i, out += grid.cols())
+            std::copy(grid.row(k, i).data(), grid.row(k, i).data() + grid.cols(), out);
+    Submit(slot, generation);
+}
+
+void AsyncTrajectoryWriter::WriteFrame(const CellularAutomata &ca, long long generation)
+{
+    CellularAutomata::IOTimer timer(ca);
+    switch (ca.GetDimension())
+    {
+    case GridDimension::OneD:
+        WriteFrame(ca.GetGrid1D(), generation);
+        break;
+    case GridDimension::TwoD:
+        WriteFrame(ca.GetGrid2D(), generation);
+        break;
+    case GridDimension::ThreeD:
+        WriteFrame(ca.GetGrid3D(), generation);
+        break;
+    }
+}
+
+// WaitIdle
+// returns (with the lock held) once the queue is empty and the writer thread is not encoding; until the next
+// Submit, writer_ can then be used from the calling thread.
+void AsyncTrajectoryWriter::WaitIdle(std::unique_lock<std::mutex> &lock)
+{
+    space_.wait(lock, [this] { return queued_.empty() && !busy_; });
+}
+
+void AsyncTrajectoryWriter::Flush()
+{
+    if (closed_)
+    {
+        throw std::runtime_error("Trajectory file is closed");
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    WaitIdle(lock);
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+    writer_.Flush();
+}
+
+// Close
+// the writer thread drains the queue before it exits; the file is closed even after an error, and the first
+// error (of the writer thread or of closing) is rethrown.
+void AsyncTrajectoryWriter::Close()
+{
+    if (closed_)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_.notify_one();
+    thread_.join();
+    closed_ = true;
+    std::exception_ptr error = error_;
+    try
+    {
+        writer_.Close();
+    }
+    catch (...)
+    {
+        if (!error)
+            error = std::current_exception();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+// WriterLoop
+// takes the oldest queued frame, encodes it without holding the lock and gives its buffer back. After an
+// error the remaining frames are dropped (their buffers still go back, so WriteFrame never waits forever).
+void AsyncTrajectoryWriter::WriterLoop()
+{
+    for (;;)
+    {
+        int slot;
+        bool write;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            work_.wait(lock, [this] { return stopping_ || !queued_.empty(); });
+            if (queued_.empty())
+                return; // stopping, and everything is written
+            slot = queued_.front();
+            queued_.pop_front();
+            write = !error_;
+            busy_ = write;
+        }
+
+        if (write)
+        {
+            try
+            {
+                writer_.WriteCells(slots_[slot].cells.data(), slots_[slot].generation);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                error_ = std::current_exception();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            busy_ = false;
+            free_slots_.push_back(slot);
+        }
+        space_.notify_all();
+    }
+}
@@ -0,0 +1,73 @@
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include "../Include/BinaryFile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CA_BINARY_FILE_POSIX 1
+#endif
+
+namespace ca_detail
+{
+    MappedFile::MappedFile(const std::string &path, const char *kind) : data_(nullptr), size_(0), mapped_(false)
+    {
+#ifdef CA_BINARY_FILE_POSIX
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error(std::string("Unable to open ") + kind + " file: " + path);
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error(std::string("Unable to read ") + kind + " file: " + path);
+        }
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ > 0)
+        {
+            void *mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (mapping != MAP_FAILED)
+            {
+                data_ = static_cast<const unsigned char *>(mapping);
+                mapped_ = true;
+            }
+        }
+        ::close(fd); // the mapping stays valid after the descriptor is closed
+#endif
+        if (!mapped_)
+        {
+            std::ifstream in(path.c_str(), std::ios::binary);
+            if (!in)
+            {
+                throw std::runtime_error(std::string("Unable to open ") + kind + " file: " + path);
+            }
+            owned_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+            data_ = owned_.data();
+            size_ = owned_.size();
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+#ifdef CA_BINARY_FILE_POSIX
+        if (mapped_)
+            ::munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+    }
+
+    bool SyncFile(std::FILE *file)
+    {
+        if (std::fflush(file) != 0)
+            return false;
+#ifdef CA_BINARY_FILE_POSIX
+        return ::fsync(::fileno(file)) == 0;
+#else
+        return true;
+#endif
+    }
+} // namespace ca_detail
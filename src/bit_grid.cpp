@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <bitset>
+#include <stdexcept>
+#include <utility>
+#include "../Include/BitGrid.h"
+
+// Out-of-class definition: the constant is bound to a reference (std::min).
+const int BitGrid2D::BITS_PER_WORD;
+
+namespace
+{
+    using Word = BitGrid2D::Word;
+
+    // Adders working on 64 independent cells at once: bit k of every operand belongs to cell k.
+    inline void HalfAdd(Word a, Word b, Word &sum, Word &carry)
+    {
+        sum = a ^ b;
+        carry = a & b;
+    }
+
+    inline void FullAdd(Word a, Word b, Word c, Word &sum, Word &carry)
+    {
+        Word t = a ^ b;
+        sum = t ^ c;
+        carry = (a & b) | (t & c);
+    }
+
+    // Neighbors of one packed row: west holds the left neighbor of every cell, east the right neighbor.
+    struct ShiftedRow
+    {
+        const Word *row;  // packed words of the row (or a row of zeros outside a non-periodic grid)
+        int words;        // words per row
+        int last_bit;     // bit index of the last column inside the last word
+        bool periodic;    // whether the row wraps around horizontally
+
+        Word West(int w) const
+        {
+            Word carry_in = (w > 0) ? row[w - 1] >> 63 : (periodic ? (row[words - 1] >> last_bit) & 1u : 0);
+            return (row[w] << 1) | carry_in;
+        }
+
+        Word East(int w) const
+        {
+            if (w < words - 1)
+                return (row[w] >> 1) | (row[w + 1] << 63);
+            Word wrap = periodic ? (row[0] & 1u) : 0;
+            return (row[w] >> 1) | (wrap << last_bit);
+        }
+    };
+} // namespace
+
+// Constructor
+// allocates both packed buffers, every cell starts in state 0.
+BitGrid2D::BitGrid2D(int rows, int cols, BoundaryCondition bc, NeighborhoodType nt)
+    : rows_(rows), cols_(cols), words_per_row_((cols + BITS_PER_WORD - 1) / BITS_PER_WORD),
+      boundary_condition_(bc), neighborhood_type_(nt)
+{
+    if (rows <= 0 || cols <= 0)
+        throw std::invalid_argument("BitGrid2D dimensions must be positive");
+    cells_.assign(static_cast<std::size_t>(rows) * words_per_row_, 0);
+    next_.assign(cells_.size(), 0);
+}
+
+BitGrid2D::Word BitGrid2D::LastWordMask() const
+{
+    int used = cols_ - (words_per_row_ - 1) * BITS_PER_WORD;
+    return used == BITS_PER_WORD ? ~Word(0) : ((Word(1) << used) - 1);
+}
+
+void BitGrid2D::Set(int i, int j, int value)
+{
+    Word bit = Word(1) << (j % BITS_PER_WORD);
+    Word &word = Row(i)[j / BITS_PER_WORD];
+    word = value ? (word | bit) : (word & ~bit);
+}
+
+// FromGrid
+// packs an int grid of the same shape (cells must be 0 or 1).
+void BitGrid2D::FromGrid(const FlatGrid2D &grid)
+{
+    if (grid.rows() != rows_ || grid.cols() != cols_)
+        throw std::invalid_argument("BitGrid2D::FromGrid called with a grid of a different shape");
+    for (int i = 0; i < rows_; ++i)
+    {
+        FlatGrid2D::ConstRow row = grid[i];
+        Word *out = Row(i);
+        for (int w = 0; w < words_per_row_; ++w)
+        {
+            Word word = 0;
+            int end = std::min(BITS_PER_WORD, cols_ - w * BITS_PER_WORD);
+            for (int b = 0; b < end; ++b)
+            {
+                int value = row[w * BITS_PER_WORD + b];
+                if (value != 0 && value != 1)
+                    throw std::invalid_argument("BitGrid2D only stores states 0 and 1");
+                word |= static_cast<Word>(value) << b;
+            }
+            out[w] = word;
+        }
+    }
+}
+
+// ToGrid
+// unpacks into an int grid (resized to rows x cols if needed).
+void BitGrid2D::ToGrid(FlatGrid2D &grid) const
+{
+    if (grid.rows() != rows_ || grid.cols() != cols_)
+        grid = FlatGrid2D(rows_, cols_);
+    for (int i = 0; i < rows_; ++i)
+    {
+        FlatGrid2D::Row row = grid[i];
+        const Word *in = Row(i);
+        for (int j = 0; j < cols_; ++j)
+            row[j] = static_cast<int>((in[j / BITS_PER_WORD] >> (j % BITS_PER_WORD)) & 1u);
+    }
+}
+
+// Step
+// one generation, 64 cells per word operation:
+//  1. the neighbor words (shifted copies of the rows above, at and below) go through a carry-save adder tree,
+//     giving the neighbor count of every cell as bit planes b0..b3 (count = b0 + 2 b1 + 4 b2 + 8 b3);
+//  2. the rule is evaluated as a boolean function of those planes and the current state: for every count k
+//     that turns a cell on, the cells whose planes spell k are selected.
+void BitGrid2D::Step(const RuleTable &table)
+{
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    const int max_count = moore ? 8 : 4;
+    if (table.numStates() != 2 || !table.Covers(neighborhood_type_))
+        throw std::invalid_argument("BitGrid2D needs a two-state rule table covering its neighborhood");
+
+    // birth: counts that turn a 0 cell into 1; survive: counts that keep a 1 cell at 1
+    unsigned birth = 0, survive = 0;
+    for (int k = 0; k <= max_count; ++k)
+    {
+        int from_dead = table.Get(0, k), from_live = table.Get(1, k);
+        if ((from_dead & ~1) != 0 || (from_live & ~1) != 0)
+            throw std::invalid_argument("BitGrid2D rule tables must produce only 0 and 1");
+        birth |= static_cast<unsigned>(from_dead) << k;
+        survive |= static_cast<unsigned>(from_live) << k;
+    }
+
+    // counts that can switch a cell on, each with the states it applies to (all ones = the current state)
+    int on_counts[9], num_on = 0;
+    Word from_dead_mask[9], from_live_mask[9];
+    for (int k = 0; k <= max_count; ++k)
+    {
+        if (((birth | survive) >> k) & 1u)
+        {
+            on_counts[num_on] = k;
+            from_dead_mask[num_on] = ((birth >> k) & 1u) ? ~Word(0) : 0;
+            from_live_mask[num_on] = ((survive >> k) & 1u) ? ~Word(0) : 0;
+            ++num_on;
+        }
+    }
+
+    const bool periodic = (boundary_condition_ == BoundaryCondition::Periodic);
+    const int last_bit = (cols_ - 1) % BITS_PER_WORD;
+    const Word last_mask = LastWordMask();
+    const std::vector<Word> zero_row(words_per_row_, 0);
+
+    for (int i = 0; i < rows_; ++i)
+    {
+        const Word *above = (i > 0) ? Row(i - 1) : (periodic ? Row(rows_ - 1) : zero_row.data());
+        const Word *below = (i < rows_ - 1) ? Row(i + 1) : (periodic ? Row(0) : zero_row.data());
+        ShiftedRow up = {above, words_per_row_, last_bit, periodic};
+        ShiftedRow mid = {Row(i), words_per_row_, last_bit, periodic};
+        ShiftedRow down = {below, words_per_row_, last_bit, periodic};
+        Word *out = next_.data() + static_cast<std::size_t>(i) * words_per_row_;
+
+        for (int w = 0; w < words_per_row_; ++w)
+        {
+            Word b0, b1, b2, b3 = 0;
+            if (moore)
+            {
+                Word s1, c1, s2, c2, s3, c3, c4, t, c5, c6;
+                FullAdd(up.West(w), above[w], up.East(w), s1, c1);
+                FullAdd(mid.West(w), mid.East(w), below[w], s2, c2);
+                HalfAdd(down.West(w), down.East(w), s3, c3);
+                FullAdd(s1, s2, s3, b0, c4); // ones
+                FullAdd(c1, c2, c3, t, c5);  // twos from the first three adders, fours carried out
+                HalfAdd(t, c4, b1, c6);
+                HalfAdd(c5, c6, b2, b3);
+            }
+            else
+            {
+                Word s1, c1, c2;
+                FullAdd(above[w], mid.West(w), mid.East(w), s1, c1);
+                HalfAdd(s1, below[w], b0, c2);
+                HalfAdd(c1, c2, b1, b2);
+            }
+
+            const Word state = mid.row[w];
+            Word result = 0;
+            for (int n = 0; n < num_on; ++n)
+            {
+                const int k = on_counts[n];
+                Word select = (from_dead_mask[n] & ~state) | (from_live_mask[n] & state);
+                Word count_is_k = ((k & 1) ? b0 : ~b0) & ((k & 2) ? b1 : ~b1) & ((k & 4) ? b2 : ~b2) & ((k & 8) ? b3 : ~b3);
+                result |= count_is_k & select;
+            }
+            out[w] = result;
+        }
+        out[words_per_row_ - 1] &= last_mask; // keep the padding bits at 0
+    }
+    cells_.swap(next_);
+}
+
+// Population
+// counts the cells in state 1 (padding bits are always 0).
+std::size_t BitGrid2D::Population() const
+{
+    std::size_t population = 0;
+    for (Word word : cells_)
+        population += std::bitset<64>(word).count();
+    return population;
+}
@@ -3,23 +3,62 @@
 #include <random>
 #include <sstream> // print to a string stream and use your -ostream and pipe to a text file.
 #include <fstream> // read from a file.
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
 #include "../Include/CellularAutomata.h"
+#include "../Include/ThreadPool.h"
+#include "../Include/Hashlife.h"
 using namespace std; // allows the use of std namespace without prefixing (i.e std::vector -> vector)
 
-// Constructor
-// initilizes the class members (size_, dimension,boundary conditions as bc, neighbortype as nt)
+// Constructors
+// the public constructors only work out the shape of the grid and delegate to the one below.
 CellularAutomata::CellularAutomata(int size, GridDimension dimension, BoundaryCondition bc, NeighborhoodType nt)
-    : size_(size), dimension_(dimension), boundary_condition_(bc), neighborhood_type_(nt)
+    : CellularAutomata(dimension, dimension == GridDimension::ThreeD ? size : 1, dimension == GridDimension::OneD ? 1 : size, size, bc, nt)
+{
+}
+
+CellularAutomata::CellularAutomata(int rows, int cols, BoundaryCondition bc, NeighborhoodType nt)
+    : CellularAutomata(GridDimension::TwoD, 1, rows, cols, bc, nt)
+{
+}
+
+CellularAutomata::CellularAutomata(int layers, int rows, int cols, BoundaryCondition bc, NeighborhoodType nt)
+    : CellularAutomata(GridDimension::ThreeD, layers, rows, cols, bc, nt)
+{
+}
+
+// initilizes the class members (size_, dimension,boundary conditions as bc, neighbortype as nt)
+CellularAutomata::CellularAutomata(GridDimension dimension, int layers, int rows, int cols, BoundaryCondition bc, NeighborhoodType nt)
+    : size_(dimension == GridDimension::OneD ? cols : rows), rows_(rows), cols_(cols), layers_(layers),
+      dimension_(dimension), boundary_condition_(bc), neighborhood_type_(nt),
+      step_2d_(SelectStepFunction2D(bc, nt)), simd_level_(DetectSimdLevel()), convolution_method_(ConvolutionMethod::Auto),
+      temporal_tile_rows_(DEFAULT_TEMPORAL_TILE_ROWS), temporal_tile_cols_(DEFAULT_TEMPORAL_TILE_COLS),
+      temporal_depth_(DEFAULT_TEMPORAL_DEPTH), active_tracking_(false), active_tile_(DEFAULT_ACTIVE_TILE),
+      active_all_dirty_(true), tiles_processed_(0), cycle_detection_(false), cycle_history_(DEFAULT_CYCLE_HISTORY),
+      cycle_action_(CycleAction::FastForward), grid_hash_(0), cycle_candidate_(-1), cycle_candidate_period_(0),
+      instrumented_(false), count_cells_(false), step_open_(false), pending_io_seconds_(0.0)
 // below are conditional statements to set the grid_1d_ and grid_2d_ to the correct size
 // depending on the dimension of the CA inputted by the application/user.
 {
+    if (layers < 0 || rows < 0 || cols < 0)
+    {
+        throw std::invalid_argument("Grid dimensions must be non-negative");
+    }
     if (dimension == GridDimension::OneD)
     {
-        grid_1d_.resize(size, 0); // resize method used to resize grid as specified and initilize to 0.
+        grid_1d_.resize(cols, 0); // resize method used to resize grid as specified and initilize to 0.
+    }
+    else if (dimension == GridDimension::TwoD)
+    {
+        grid_2d_ = Grid2D(rows, cols, 0, 1);      // allocate a rows X cols grid as one contiguous buffer with a one-cell halo.
+        next_grid_2d_ = Grid2D(rows, cols, 0, 1); // back buffer of the same shape, reused by every ApplyRule2D call.
     }
     else
     {
-        grid_2d_.resize(size, std::vector<int>(size, 0)); // resize two a square grid size X size using vector of vector.
+        grid_3d_ = Grid3D(layers, rows, cols, 0, 1);      // layers X rows X cols, one contiguous buffer with a one-cell halo shell.
+        next_grid_3d_ = Grid3D(layers, rows, cols, 0, 1); // back buffer of the same shape.
     }
 }
 
@@ -45,6 +84,18 @@ void CellularAutomata::Initialize2D(const InitializationFunction2D &init_func)
         throw std::runtime_error("Initialization function for 2D grid called on a non-2D automaton");
     }
     init_func(grid_2d_);
+    active_all_dirty_ = true; // any cell may have changed
+}
+
+// Initialize3D
+// same thing for the 3D volume.
+void CellularAutomata::Initialize3D(const InitializationFunction3D &init_func)
+{
+    if (dimension_ != GridDimension::ThreeD)
+    {
+        throw std::runtime_error("Initialization function for 3D grid called on a non-3D automaton");
+    }
+    init_func(grid_3d_);
 }
 
 // getGrid2D implementation of memberfunction within class CellularAutomata.
@@ -69,13 +120,60 @@ void CellularAutomata::ApplyRule1D(const RuleFunction1D &rule_func)
     {
         throw std::runtime_error("Rule function for 1D grid called on a non-1D automaton");
     }
-    Grid1D new_grid = grid_1d_;     // create a new grid to grid_1d and initilize it to the current state of grid_1d_
-    for (int i = 0; i < size_; ++i) // loop through each cell in the grid_1d_
+    StepScope scope(*this);
+    next_grid_1d_.resize(grid_1d_.size()); // back buffer, allocated once and reused by every step
+    // the cells are split into contiguous index ranges, one per thread when SetThreadCount was used
+    RunRowBands(size_, 1, [this, &rule_func](int begin, int end) {
+        for (int i = begin; i < end; ++i) // loop through each cell in the grid_1d_
+        {
+            int neighbors = CalculateNeighbors1D(i);                  // calculate the number of active neighbors
+            next_grid_1d_[i] = rule_func(neighbors, grid_1d_[i]); // apply the rule_func (fxn pointer) to each cell which takes current state and number of neighbors
+        }
+    });
+    EndPhase(&StepStats::rule_seconds);
+    grid_1d_.swap(next_grid_1d_); // make the new generation current, only the vector buffers are exchanged
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
+}
+
+// ApplyRule1D (table-driven)
+// same as above with the rule looked up in a table instead of called through std::function.
+void CellularAutomata::ApplyRule1D(const RuleTable &table)
+{
+    if (dimension_ != GridDimension::OneD)
+    {
+        throw std::runtime_error("Rule table for 1D grid called on a non-1D automaton");
+    }
+    if (!table.Covers(RuleTable::NEIGHBOR_COUNT_1D))
     {
-        int neighbors = CalculateNeighbors1D(i);         // calculate the number of active neighbors
-        new_grid[i] = rule_func(neighbors, grid_1d_[i]); // apply the rule_func (fxn pointer) to each cell which takes current state and number of neighbors
+        throw std::invalid_argument("Rule table does not cover every neighbor sum of the 1D neighborhood");
     }
-    grid_1d_ = std::move(new_grid); // assign the new grid to gird_1d and transfer ownership of data from new_grid to grid_1d_
+    StepScope scope(*this);
+    next_grid_1d_.resize(grid_1d_.size());
+    const int num_states = table.numStates(), max_sum = table.maxSum();
+    std::atomic<bool> valid(true);
+    RunRowBands(size_, 1, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            int state = grid_1d_[i];
+            int neighbors = CalculateNeighbors1D(i);
+            // a bad neighbor can push the sum out of the table before its own cell is checked
+            if (state < 0 || state >= num_states || neighbors < 0 || neighbors > max_sum)
+            {
+                valid = false;
+                return;
+            }
+            next_grid_1d_[i] = table.Get(state, neighbors);
+        }
+    });
+    if (!valid)
+    {
+        throw std::out_of_range("Grid holds a state that is not covered by the rule table");
+    }
+    EndPhase(&StepStats::rule_seconds);
+    grid_1d_.swap(next_grid_1d_);
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
 }
 
 // ApplyRule2D
@@ -86,43 +184,795 @@ void CellularAutomata::ApplyRule2D(const RuleFunction2D &rule_func)
     {
         throw std::runtime_error("Rule function for 2D grid called on a non-2D automaton"); // standard lib error handeling if not 2D CA.
     }
-    Grid2D new_grid = grid_2d_;     // create a new grid to grid_2d and initilize it to the current state of grid_2d_ and update cell states simulatenousely.
-    for (int i = 0; i < size_; ++i) // iterate through the loop to access each cell in the grid_2d_
+    // the next generation is written into the back buffer so every cell sees the old state (simultaneous update),
+    // then front and back buffers are swapped. step_2d_ is the loop specialized for this automaton's boundary
+    // condition and neighborhood type (see StepEngine.h), selected once in the constructor.
+    StepScope scope(*this);
+    (this->*step_2d_)(rule_func);
+    scope.Finish(1);
+}
+
+// ApplyRule3D
+// the 3D counterpart of ApplyRule2D: halo fill for the boundary condition, specialized sweep, buffer swap.
+void CellularAutomata::ApplyRule3D(const RuleFunction3D &rule_func)
+{
+    if (dimension_ != GridDimension::ThreeD)
+    {
+        throw std::runtime_error("Rule function for 3D grid called on a non-3D automaton");
+    }
+    Step(rule_func);
+}
+
+// ApplyRule3D (table-driven)
+// the table is looked up per cell; the back buffer is only swapped in when every state was covered.
+void CellularAutomata::ApplyRule3D(const RuleTable &table)
+{
+    if (dimension_ != GridDimension::ThreeD)
+    {
+        throw std::runtime_error("Rule table for 3D grid called on a non-3D automaton");
+    }
+    if (!table.Covers(RuleTable::NeighborCount3D(neighborhood_type_)))
     {
-        for (int j = 0; j < size_; ++j) // iterate through the nested loop to access each cell in the grid_2d_
+        throw std::invalid_argument("Rule table does not cover every neighbor sum of this 3D neighborhood type");
+    }
+    StepScope scope(*this);
+    const int num_states = table.numStates(), max_sum = table.maxSum();
+    std::atomic<bool> valid(true);
+    auto lookup = [&](int sum, int state) {
+        if (state < 0 || state >= num_states || sum < 0 || sum > max_sum)
         {
-            int neighbors = CalculateNeighbors2D(i, j);            // calculate the number of active neighbors for the current cell
-            new_grid[i][j] = rule_func(neighbors, grid_2d_[i][j]); // Apply the rule_func (fxn pointer) to each cell which takes current state and number of neighbors
+            valid = false;
+            return 0;
         }
+        return table.Get(state, sum);
+    };
+    Sweep3D(lookup);
+    if (!valid)
+    {
+        throw std::out_of_range("Grid holds a state that is not covered by the rule table");
     }
-    grid_2d_ = std::move(new_grid); // assign the new grid to gird_2d and transfer ownership of data from new_grid to grid_2d_
+    grid_3d_.swap(next_grid_3d_);
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
 }
 
-// Print
-string CellularAutomata::Print() const // this is the display method, const prevent this method from changing the state of the CA.
+// ApplyRule2D (table-driven)
+// same simultaneous update as above, but the rule is a lookup table so whole row segments are updated at once
+// by the vectorized kernel selected with SetSimdLevel.
+void CellularAutomata::ApplyRule2D(const RuleTable &table)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("Rule table for 2D grid called on a non-2D automaton");
+    }
+    if (!table.Covers(neighborhood_type_))
+    {
+        throw std::invalid_argument("Rule table does not cover every neighbor sum of this neighborhood type");
+    }
+    StepScope scope(*this);
+    if (active_tracking_)
+    {
+        const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+        const SimdLevel level = simd_level_;
+        auto rect_sweep = [&](const int *current, int *next, std::ptrdiff_t stride, int cols, int row_begin, int row_end) {
+            ca_detail::TableSweep2D rect;
+            rect.current = current;
+            rect.next = next;
+            rect.stride = stride;
+            rect.cols = cols;
+            rect.moore = moore;
+            rect.table = table.table();
+            rect.num_states = table.numStates();
+            rect.sums_per_state = table.sumsPerState();
+            return ca_detail::SweepTable2D(rect, level, row_begin, row_end);
+        };
+        if (!StepActiveTiles(rect_sweep))
+        {
+            throw std::out_of_range("Grid holds a state that is not covered by the rule table");
+        }
+        scope.Finish(1);
+        return;
+    }
+    FillHalo2D();
+    EndPhase(&StepStats::neighbor_seconds);
+    ca_detail::TableSweep2D sweep;
+    sweep.current = grid_2d_.data();
+    sweep.next = next_grid_2d_.data();
+    sweep.stride = grid_2d_.stride();
+    sweep.cols = grid_2d_.cols();
+    sweep.moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    sweep.table = table.table();
+    sweep.num_states = table.numStates();
+    sweep.sums_per_state = table.sumsPerState();
+    std::atomic<bool> valid(true);
+    RunRowBands(grid_2d_.rows(), grid_2d_.cols(), [&](int begin, int end) {
+        if (!ca_detail::SweepTable2D(sweep, simd_level_, begin, end))
+            valid = false;
+    });
+    if (!valid)
+    {
+        throw std::out_of_range("Grid holds a state that is not covered by the rule table");
+    }
+    EndPhase(&StepStats::rule_seconds);
+    grid_2d_.swap(next_grid_2d_); // flip front and back buffers, only the buffer pointers are exchanged
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
+}
+
+// RunRule (table-driven)
+// temporal blocking with the vectorized table kernels applied to each tile rectangle.
+void CellularAutomata::RunRule(int steps, const RuleTable &table, std::true_type)
+{
+    if (!table.Covers(neighborhood_type_))
+    {
+        throw std::invalid_argument("Rule table does not cover every neighbor sum of this neighborhood type");
+    }
+    const bool single_tile = grid_2d_.rows() <= temporal_tile_rows_ && grid_2d_.cols() <= temporal_tile_cols_;
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    const SimdLevel level = simd_level_;
+    auto sweep = [&](const int *current, int *next, std::ptrdiff_t stride, int cols, int row_begin, int row_end) {
+        ca_detail::TableSweep2D rect;
+        rect.current = current;
+        rect.next = next;
+        rect.stride = stride;
+        rect.cols = cols;
+        rect.moore = moore;
+        rect.table = table.table();
+        rect.num_states = table.numStates();
+        rect.sums_per_state = table.sumsPerState();
+        return ca_detail::SweepTable2D(rect, level, row_begin, row_end);
+    };
+    while (steps > 0)
+    {
+        int depth = std::min(steps, temporal_depth_);
+        bool valid = true;
+        if (depth < 2 || single_tile)
+        {
+            ApplyRule2D(table);
+            depth = 1;
+        }
+        else if (boundary_condition_ == BoundaryCondition::Periodic)
+        {
+            valid = RunTemporalBlock<BoundaryCondition::Periodic>(depth, sweep);
+        }
+        else
+        {
+            // Fixed and NoBoundary both see zeros beyond the edges in 2D
+            valid = RunTemporalBlock<BoundaryCondition::Fixed>(depth, sweep);
+        }
+        if (!valid)
+        {
+            throw std::out_of_range("Grid holds a state that is not covered by the rule table");
+        }
+        steps -= depth;
+    }
+}
+
+// SetTemporalBlocking
+// tile shape and depth used by Run; all must be positive.
+void CellularAutomata::SetTemporalBlocking(int tile_rows, int tile_cols, int depth)
+{
+    if (tile_rows < 1 || tile_cols < 1 || depth < 1)
+    {
+        throw std::invalid_argument("Temporal blocking needs a positive tile size and depth");
+    }
+    temporal_tile_rows_ = tile_rows;
+    temporal_tile_cols_ = tile_cols;
+    temporal_depth_ = depth;
+}
+
+void CellularAutomata::SetCycleDetection(bool enabled, int history, CycleAction action)
+{
+    if (history < 1)
+    {
+        throw std::invalid_argument("Cycle detection needs a history of at least one generation");
+    }
+    cycle_detection_ = enabled;
+    cycle_history_ = history;
+    cycle_action_ = action;
+}
+
+namespace
+{
+    // HashKey
+    // the splitmix64 finalizer, forced odd: the key of row i is HashKey(2 i) and the key of column j is
+    // HashKey(2 j + 1), and cell (i, j) in state s adds s * row key * column key to the grid hash.
+    inline std::uint64_t HashKey(std::uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return (z ^ (z >> 31)) | 1;
+    }
+
+    // RowHash
+    // sum of (cells[j] - previous[j]) * keys[j] over a row (previous may be null for a hash from scratch).
+    // Branchless, so a grid in which half of the cells flip costs no more than one that barely changes.
+    inline std::uint64_t RowHash(const int *cells, const int *previous, const std::uint64_t *keys, int cols)
+    {
+        std::uint64_t sum = 0;
+        if (previous)
+            for (int j = 0; j < cols; ++j)
+                sum += static_cast<std::uint64_t>(static_cast<std::int64_t>(cells[j]) - previous[j]) * keys[j];
+        else
+            for (int j = 0; j < cols; ++j)
+                sum += static_cast<std::uint64_t>(static_cast<std::int64_t>(cells[j])) * keys[j];
+        return sum;
+    }
+} // namespace
+
+// HashGrid2D
+// the sum (modulo 2^64) of the cell values; a sum can be updated from the differences between two
+// generations, which UpdateGridHash2D uses.
+std::uint64_t CellularAutomata::HashGrid2D()
+{
+    std::atomic<std::uint64_t> hash(0);
+    const int cols = grid_2d_.cols();
+    RunRowBands(grid_2d_.rows(), cols, [&](int begin, int end) {
+        std::uint64_t local = 0;
+        for (int i = begin; i < end; ++i)
+            local += HashKey(2 * static_cast<std::uint64_t>(i)) * RowHash(grid_2d_[i].data(), nullptr, cycle_column_keys_.data(), cols);
+        hash += local;
+    });
+    return hash;
+}
+
+// UpdateGridHash2D
+// after a single step the back buffer holds the previous generation, so the hash moves by the differences
+// between the two buffers (zero for every unchanged cell). When the step went through the sparse activity
+// tiles (active_all_dirty_ is only clear right after one), the differences are confined to the tiles it
+// flagged as changed and only those are read, so a settling grid costs in proportion to its activity.
+void CellularAutomata::UpdateGridHash2D()
+{
+    std::atomic<std::uint64_t> delta(0);
+    const int rows = grid_2d_.rows(), cols = grid_2d_.cols();
+    if (active_tracking_ && !active_all_dirty_)
+    {
+        const int tile = active_tile_, tile_rows = (rows + tile - 1) / tile, tile_cols = (cols + tile - 1) / tile;
+        RunRowBands(tile_rows, tile * cols, [&](int band_begin, int band_end) {
+            std::uint64_t local = 0;
+            for (int tr = band_begin; tr < band_end; ++tr)
+            {
+                const int i0 = tr * tile, i1 = std::min(rows, i0 + tile);
+                for (int tc = 0; tc < tile_cols; ++tc)
+                {
+                    if (!changed_tiles_[static_cast<std::size_t>(tr) * tile_cols + tc])
+                        continue;
+                    const int j0 = tc * tile, width = std::min(cols, j0 + tile) - j0;
+                    for (int i = i0; i < i1; ++i)
+                        local += HashKey(2 * static_cast<std::uint64_t>(i)) *
+                                 RowHash(grid_2d_[i].data() + j0, next_grid_2d_[i].data() + j0, cycle_column_keys_.data() + j0, width);
+                }
+            }
+            delta += local;
+        });
+        grid_hash_ += delta;
+        return;
+    }
+    RunRowBands(rows, cols, [&](int begin, int end) {
+        std::uint64_t local = 0;
+        for (int i = begin; i < end; ++i)
+            local += HashKey(2 * static_cast<std::uint64_t>(i)) *
+                     RowHash(grid_2d_[i].data(), next_grid_2d_[i].data(), cycle_column_keys_.data(), cols);
+        delta += local;
+    });
+    grid_hash_ += delta;
+}
+
+void CellularAutomata::BeginCycleSearch()
+{
+    cycle_info_ = CycleInfo();
+    cycle_candidate_ = -1;
+    cycle_hashes_.assign(cycle_history_, 0);
+    cycle_column_keys_.resize(grid_2d_.cols());
+    for (int j = 0; j < grid_2d_.cols(); ++j)
+        cycle_column_keys_[j] = HashKey(2 * static_cast<std::uint64_t>(j) + 1);
+    grid_hash_ = HashGrid2D();
+    cycle_hashes_[0] = grid_hash_;
+}
+
+// RecordCycleGeneration
+// updates the hash, settles a pending candidate (its grid must come back exactly one period later, otherwise
+// the match was a hash collision) and looks the hash up in the ring, latest generation first, so the first
+// match gives the shortest period. While a candidate is pending the ring is not searched, so a cycle entered
+// meanwhile is only found later; once a cycle is confirmed its transient is therefore walked back through the
+// ring to the first generation g whose hash equals the hash of g + period. The hashing is timed as counting work.
+bool CellularAutomata::RecordCycleGeneration(long long generation)
+{
+    UpdateGridHash2D();
+    bool confirmed = false;
+    if (cycle_candidate_ >= 0 && generation == cycle_candidate_ + cycle_candidate_period_)
+    {
+        confirmed = (grid_2d_ == cycle_grid_);
+        if (confirmed)
+        {
+            const long long period = cycle_candidate_period_, oldest = std::max(0LL, generation - cycle_history_);
+            long long transient = cycle_candidate_ - period;
+            while (transient - 1 >= oldest &&
+                   cycle_hashes_[(transient - 1) % cycle_history_] == cycle_hashes_[(transient - 1 + period) % cycle_history_])
+                --transient;
+            cycle_info_.detected = true;
+            cycle_info_.period = period;
+            cycle_info_.transient = transient;
+        }
+        cycle_candidate_ = -1;
+    }
+    if (!confirmed && cycle_candidate_ < 0)
+    {
+        const long long oldest = std::max(0LL, generation - cycle_history_);
+        for (long long g = generation - 1; g >= oldest; --g)
+        {
+            if (cycle_hashes_[g % cycle_history_] == grid_hash_)
+            {
+                cycle_candidate_ = generation;
+                cycle_candidate_period_ = generation - g;
+                cycle_grid_.assign(grid_2d_);
+                break;
+            }
+        }
+    }
+    cycle_hashes_[generation % cycle_history_] = grid_hash_;
+    EndPhase(&StepStats::count_seconds);
+    return confirmed;
+}
+
+// RunHashlife
+// loads the grid into the quadtree engine (reused while the rule stays the same), jumps and copies it back.
+void CellularAutomata::RunHashlife(long long steps, const RuleTable &table)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("RunHashlife called on a non-2D automaton");
+    }
+    if (steps < 0)
+    {
+        throw std::invalid_argument("RunHashlife needs a non-negative number of steps");
+    }
+    if (boundary_condition_ != BoundaryCondition::Periodic || rows_ != cols_ || rows_ <= 0 || (rows_ & (rows_ - 1)) != 0)
+    {
+        throw std::invalid_argument("RunHashlife needs a periodic square grid whose size is a power of two");
+    }
+    StepScope scope(*this);
+    if (!hashlife_ || hashlife_.use_count() > 1 || hashlife_->table() != table || hashlife_->neighborhoodType() != neighborhood_type_)
+    {
+        hashlife_ = std::make_shared<Hashlife>(table, neighborhood_type_, rows_);
+    }
+    hashlife_->LoadGrid(grid_2d_);
+    hashlife_->Advance(steps);
+    hashlife_->StoreGrid(grid_2d_);
+    active_all_dirty_ = true;
+    EndPhase(&StepStats::rule_seconds); // loading, jumping and storing the quadtree
+    scope.Finish(steps, false); // the back buffer still holds whatever an earlier engine left there
+}
+
+// SetActiveRegionTracking
+// switching the mode (or the tile size) always starts with a full sweep.
+void CellularAutomata::SetActiveRegionTracking(bool enabled, int tile)
+{
+    if (tile < 1)
+    {
+        throw std::invalid_argument("Active region tiles must be at least one cell wide");
+    }
+    active_tracking_ = enabled;
+    active_tile_ = tile;
+    active_tiles_.clear();
+    changed_tiles_.clear();
+    active_all_dirty_ = true;
+    tiles_processed_ = 0;
+}
+
+long long CellularAutomata::GetActiveTileCount() const
+{
+    long long tile_rows = (grid_2d_.rows() + active_tile_ - 1) / active_tile_;
+    long long tile_cols = (grid_2d_.cols() + active_tile_ - 1) / active_tile_;
+    return tile_rows * tile_cols;
+}
+
+// UpdateActiveTiles
+// a changed cell can only affect cells one step away, so it can only make its own tile and the eight tiles
+// around it dirty. On a periodic grid the tiles along opposite edges are neighbors.
+void CellularAutomata::UpdateActiveTiles(int tile_rows, int tile_cols)
+{
+    const bool periodic = (boundary_condition_ == BoundaryCondition::Periodic);
+    std::fill(active_tiles_.begin(), active_tiles_.end(), 0);
+    for (int tr = 0; tr < tile_rows; ++tr)
+    {
+        for (int tc = 0; tc < tile_cols; ++tc)
+        {
+            if (!changed_tiles_[static_cast<std::size_t>(tr) * tile_cols + tc])
+                continue;
+            for (int dr = -1; dr <= 1; ++dr)
+            {
+                for (int dc = -1; dc <= 1; ++dc)
+                {
+                    int r = tr + dr, c = tc + dc;
+                    if (periodic)
+                    {
+                        r = (r + tile_rows) % tile_rows;
+                        c = (c + tile_cols) % tile_cols;
+                    }
+                    else if (r < 0 || r >= tile_rows || c < 0 || c >= tile_cols)
+                    {
+                        continue;
+                    }
+                    active_tiles_[static_cast<std::size_t>(r) * tile_cols + c] = 1;
+                }
+            }
+        }
+    }
+}
+
+// SetSimdLevel
+// never selects an instruction set the CPU cannot run.
+void CellularAutomata::SetSimdLevel(SimdLevel level)
+{
+    simd_level_ = std::min(level, DetectSimdLevel());
+}
+
+// SetThreadCount
+// (re)creates the thread pool; the pool is only kept when more than one thread is requested.
+void CellularAutomata::SetThreadCount(int threads)
+{
+    if (threads < 0)
+    {
+        throw std::invalid_argument("Thread count must be non-negative");
+    }
+    if (threads == 0)
+    {
+        threads = ThreadPool::HardwareThreads();
+    }
+    if (threads == GetThreadCount())
+    {
+        return;
+    }
+    pool_.reset();
+    if (threads > 1)
+    {
+        pool_ = std::make_shared<ThreadPool>(threads);
+    }
+}
+
+int CellularAutomata::GetThreadCount() const
+{
+    return pool_ ? pool_->size() : 1;
+}
+
+// RunRowBands
+// the only place where stepping decides between serial and parallel execution.
+void CellularAutomata::RunRowBands(int rows, int cols, const std::function<void(int, int)> &body)
+{
+    if (pool_ && static_cast<long long>(rows) * cols >= PARALLEL_MIN_CELLS && rows > 1)
+    {
+        if (pool_.use_count() > 1)
+        {
+            pool_ = std::make_shared<ThreadPool>(pool_->size()); // copied automaton: stop sharing the workers
+        }
+        pool_->ParallelFor(rows, body);
+    }
+    else
+    {
+        body(0, rows);
+    }
+}
+
+// SetInstrumentation
+// enabling (or switching counting) starts new totals; the step callback is kept.
+void CellularAutomata::SetInstrumentation(bool enabled, bool count_cells)
+{
+    instrumented_ = enabled;
+    count_cells_ = count_cells;
+    ResetStats();
+}
+
+void CellularAutomata::ResetStats()
+{
+    step_stats_ = StepStats();
+    total_stats_ = StepStats();
+    total_stats_.cells_changed = 0;
+    pending_io_seconds_ = 0.0;
+}
+
+void CellularAutomata::AddIOTime(double seconds) const
+{
+    if (instrumented_)
+        pending_io_seconds_ += seconds;
+}
+
+// OpenStepStats / RecordPhase / CloseStepStats
+// a record is built in step_stats_ while the call runs: every phase adds the time since the previous mark.
+void CellularAutomata::OpenStepStats()
+{
+    step_stats_ = StepStats();
+    step_open_ = true;
+    step_start_ = phase_start_ = StepClock::now();
+}
+
+void CellularAutomata::RecordPhase(double StepStats::*phase)
+{
+    const StepClock::time_point now = StepClock::now();
+    step_stats_.*phase += std::chrono::duration<double>(now - phase_start_).count();
+    phase_start_ = now;
+}
+
+void CellularAutomata::EndSplitPhase(long long neighbor_nanoseconds, long long rule_nanoseconds)
+{
+    if (!step_open_)
+        return;
+    const StepClock::time_point now = StepClock::now();
+    const double wall = std::chrono::duration<double>(now - phase_start_).count();
+    const long long measured = neighbor_nanoseconds + rule_nanoseconds;
+    const double neighbor_share = measured > 0 ? static_cast<double>(neighbor_nanoseconds) / measured : 0.0;
+    step_stats_.neighbor_seconds += wall * neighbor_share;
+    step_stats_.rule_seconds += wall * (1.0 - neighbor_share);
+    phase_start_ = now;
+}
+
+void CellularAutomata::CloseStepStats(long long generations, bool previous_kept)
 {
-    stringstream ss; // stringstream used to print the grid in a specific format depending on the dimension.
-    // Print the grid in a specific format depending on the dimension.
-    if (dimension_ == GridDimension::OneD) // if dimension is 1D, print the grid_1d_ in a specific format.
+    step_stats_.calls = 1;
+    step_stats_.generations = generations;
+    if (count_cells_)
     {
-        for (int cell : grid_1d_) // iterate through the grid_1d_ and print each cell
+        CountCells(generations == 1 && previous_kept);
+        RecordPhase(&StepStats::count_seconds);
+    }
+    step_stats_.total_seconds = std::chrono::duration<double>(StepClock::now() - step_start_).count();
+    step_stats_.io_seconds = pending_io_seconds_;
+    pending_io_seconds_ = 0.0;
+    step_open_ = false;
+
+    total_stats_.calls += 1;
+    total_stats_.generations += generations;
+    total_stats_.neighbor_seconds += step_stats_.neighbor_seconds;
+    total_stats_.rule_seconds += step_stats_.rule_seconds;
+    total_stats_.swap_seconds += step_stats_.swap_seconds;
+    total_stats_.count_seconds += step_stats_.count_seconds;
+    total_stats_.io_seconds += step_stats_.io_seconds;
+    total_stats_.total_seconds += step_stats_.total_seconds;
+    if (step_stats_.cells_changed > 0)
+        total_stats_.cells_changed += step_stats_.cells_changed;
+    total_stats_.population = step_stats_.population;
+    total_stats_.other_states = step_stats_.other_states;
+    total_stats_.histogram = step_stats_.histogram;
+    if (step_callback_)
+        step_callback_(step_stats_);
+}
+
+// CountCells
+// one pass over the front buffer (and the back buffer, which holds the previous generation after a single
+// step) in row bands; every band counts into its own histogram and merges it at the end.
+void CellularAutomata::CountCells(bool compare_previous)
+{
+    const int bins = StepStats::HISTOGRAM_STATES;
+    std::vector<long long> histogram(bins, 0);
+    long long changed = 0, other = 0;
+    std::mutex merge;
+    auto count_row = [&](const int *cells, const int *previous, int count, long long *local, long long &local_changed,
+                         long long &local_other) {
+        for (int j = 0; j < count; ++j)
         {
-            std::cout << cell << " "; // print each cell with a space after it
+            const int state = cells[j];
+            if (static_cast<unsigned>(state) < static_cast<unsigned>(bins))
+                ++local[state];
+            else
+                ++local_other;
         }
-        std::cout << "\n"; // print a new line after the grid is printed.
+        if (compare_previous)
+            for (int j = 0; j < count; ++j)
+                local_changed += (cells[j] != previous[j]);
+    };
+    auto merge_band = [&](const std::vector<long long> &local, long long local_changed, long long local_other) {
+        std::lock_guard<std::mutex> lock(merge);
+        for (int s = 0; s < bins; ++s)
+            histogram[s] += local[s];
+        changed += local_changed;
+        other += local_other;
+    };
+    if (dimension_ == GridDimension::OneD)
+    {
+        std::vector<long long> local(bins, 0);
+        long long local_changed = 0, local_other = 0;
+        count_row(grid_1d_.data(), next_grid_1d_.data(), static_cast<int>(grid_1d_.size()), local.data(), local_changed,
+                  local_other);
+        merge_band(local, local_changed, local_other);
+    }
+    else if (dimension_ == GridDimension::TwoD)
+    {
+        RunRowBands(grid_2d_.rows(), grid_2d_.cols(), [&](int begin, int end) {
+            std::vector<long long> local(bins, 0);
+            long long local_changed = 0, local_other = 0;
+            for (int i = begin; i < end; ++i)
+                count_row(grid_2d_[i].data(), next_grid_2d_[i].data(), grid_2d_.cols(), local.data(), local_changed, local_other);
+            merge_band(local, local_changed, local_other);
+        });
+    }
+    else
+    {
+        RunRowBands(grid_3d_.layers(), grid_3d_.rows() * grid_3d_.cols(), [&](int begin, int end) {
+            std::vector<long long> local(bins, 0);
+            long long local_changed = 0, local_other = 0;
+            for (int k = begin; k < end; ++k)
+                for (int i = 0; i < grid_3d_.rows(); ++i)
+                    count_row(grid_3d_.row(k, i).data(), next_grid_3d_.row(k, i).data(), grid_3d_.cols(), local.data(),
+                              local_changed, local_other);
+            merge_band(local, local_changed, local_other);
+        });
+    }
+    int used = bins;
+    while (used > 0 && histogram[used - 1] == 0)
+        --used;
+    step_stats_.histogram.assign(histogram.begin(), histogram.begin() + used);
+    step_stats_.other_states = other;
+    step_stats_.population = static_cast<long long>(layers_) * rows_ * cols_ - histogram[0];
+    step_stats_.cells_changed = compare_previous ? changed : -1;
+}
+
+// FillCountHalo2D
+// Periodic and Fixed halos are the usual ones (state 0 beyond a fixed edge); NoBoundary gets -1, which
+// ca_detail::CountNeighborStates2D counts in no state.
+void CellularAutomata::FillCountHalo2D()
+{
+    if (boundary_condition_ == BoundaryCondition::NoBoundary)
+        ca_detail::ZeroHalo2D::FillHaloWith(grid_2d_, -1);
+    else
+        FillHalo2D();
+}
+
+// FillHalo2D
+// runtime counterpart of ca_detail::Boundary2D<BC>::FillHalo for the non-template entry points.
+void CellularAutomata::FillHalo2D()
+{
+    switch (boundary_condition_)
+    {
+    case BoundaryCondition::Periodic:
+        ca_detail::Boundary2D<BoundaryCondition::Periodic>::FillHalo(grid_2d_);
+        break;
+    case BoundaryCondition::Fixed:
+        ca_detail::Boundary2D<BoundaryCondition::Fixed>::FillHalo(grid_2d_);
+        break;
+    case BoundaryCondition::NoBoundary:
+        ca_detail::Boundary2D<BoundaryCondition::NoBoundary>::FillHalo(grid_2d_);
+        break;
     }
-    else // if dimension is 2D, print the grid_2d_ in a specific 2D format.
+}
+
+// SelectStepFunction2D
+// maps the runtime boundary condition and neighborhood type onto the matching compile-time instantiation.
+CellularAutomata::StepFunction2D CellularAutomata::SelectStepFunction2D(BoundaryCondition bc, NeighborhoodType nt)
+{
+    bool moore = (nt == NeighborhoodType::Moore);
+    switch (bc)
     {
-        for (const auto &row : grid_2d_) // iterate through the grid_2d_ and print each row
+    case BoundaryCondition::Periodic:
+        return moore ? &CellularAutomata::StepRuleFunction<BoundaryCondition::Periodic, NeighborhoodType::Moore>
+                     : &CellularAutomata::StepRuleFunction<BoundaryCondition::Periodic, NeighborhoodType::VonNeumann>;
+    case BoundaryCondition::Fixed:
+        return moore ? &CellularAutomata::StepRuleFunction<BoundaryCondition::Fixed, NeighborhoodType::Moore>
+                     : &CellularAutomata::StepRuleFunction<BoundaryCondition::Fixed, NeighborhoodType::VonNeumann>;
+    case BoundaryCondition::NoBoundary:
+        break;
+    }
+    return moore ? &CellularAutomata::StepRuleFunction<BoundaryCondition::NoBoundary, NeighborhoodType::Moore>
+                 : &CellularAutomata::StepRuleFunction<BoundaryCondition::NoBoundary, NeighborhoodType::VonNeumann>;
+}
+
+// Print
+namespace
+{
+    // "00" to "99": two digits per table lookup instead of one division per digit
+    struct DigitPairs
+    {
+        char digits[200];
+        DigitPairs()
         {
-            for (int cell : row) // iterate through each cell in the row
+            for (int n = 0; n < 100; ++n)
             {
-                std::cout << cell << " "; // print each cell with a space after it
+                digits[2 * n] = static_cast<char>('0' + n / 10);
+                digits[2 * n + 1] = static_cast<char>('0' + n % 10);
             }
-            std::cout << "\n"; // print a new line after the row is printed.
         }
+    };
+    const DigitPairs digit_pairs;
+
+    const std::size_t MAX_CELL_CHARS = 12; // "-2147483648 "
+    const std::size_t TEXT_BLOCK_BYTES = std::size_t(1) << 20;
+
+    // FormatRow
+    // writes "c c c ... \n" for `count` cells starting at `out` and returns the end of the text.
+    char *FormatRow(const int *cells, int count, char *out)
+    {
+        for (int j = 0; j < count; ++j)
+        {
+            int value = cells[j];
+            if (value >= 0 && value < 10) // the usual case for automaton states
+            {
+                *out++ = static_cast<char>('0' + value);
+                *out++ = ' ';
+                continue;
+            }
+            unsigned magnitude = static_cast<unsigned>(value);
+            if (value < 0)
+            {
+                *out++ = '-';
+                magnitude = 0u - magnitude;
+            }
+            char digits[10];
+            char *end = digits + sizeof(digits), *first = end;
+            while (magnitude >= 100)
+            {
+                const char *pair = digit_pairs.digits + 2 * (magnitude % 100);
+                magnitude /= 100;
+                *--first = pair[1];
+                *--first = pair[0];
+            }
+            if (magnitude >= 10)
+            {
+                *--first = digit_pairs.digits[2 * magnitude + 1];
+                *--first = digit_pairs.digits[2 * magnitude];
+            }
+            else
+            {
+                *--first = static_cast<char>('0' + magnitude);
+            }
+            while (first != end)
+                *out++ = *first++;
+            *out++ = ' ';
+        }
+        *out++ = '\n';
+        return out;
+    }
+} // namespace
+
+// FormatText
+// every row is formatted into a scratch buffer sized for the worst case and appended to `text` in one go.
+void CellularAutomata::FormatText(std::string &text, std::ostream *out) const
+{
+    std::vector<char> line;
+    auto append_row = [&](const int *cells, int count) {
+        line.resize(static_cast<std::size_t>(count) * MAX_CELL_CHARS + 1);
+        text.append(line.data(), FormatRow(cells, count, line.data()));
+        if (out && text.size() >= TEXT_BLOCK_BYTES)
+        {
+            out->write(text.data(), static_cast<std::streamsize>(text.size()));
+            text.clear();
+        }
+    };
+    if (dimension_ == GridDimension::OneD) // 1D: one line
+    {
+        append_row(grid_1d_.data(), static_cast<int>(grid_1d_.size()));
+    }
+    else if (dimension_ == GridDimension::ThreeD) // 3D: one block of rows per layer, separated by an empty line
+    {
+        for (int k = 0; k < grid_3d_.layers(); ++k)
+        {
+            for (int i = 0; i < grid_3d_.rows(); ++i)
+                append_row(grid_3d_.row(k, i).data(), grid_3d_.cols());
+            text += '\n';
+        }
+    }
+    else // 2D: one line per row
+    {
+        for (int i = 0; i < grid_2d_.rows(); ++i)
+            append_row(grid_2d_[i].data(), grid_2d_.cols());
     }
-    return ss.str(); // return the stringstream as a string
+}
+
+string CellularAutomata::Print() const // this is the display method, const prevent this method from changing the state of the CA.
+{
+    IOTimer timer(*this);
+    string text;
+    // about two characters per cell (single digit states) and one per row: usually a single allocation
+    text.reserve(static_cast<std::size_t>(layers_) * rows_ * (2 * static_cast<std::size_t>(cols_) + 1) + layers_);
+    FormatText(text, nullptr);
+    return text;
+}
+
+void CellularAutomata::Print(std::ostream &out) const
+{
+    IOTimer timer(*this);
+    string text;
+    text.reserve(TEXT_BLOCK_BYTES + static_cast<std::size_t>(cols_) * MAX_CELL_CHARS + 1);
+    FormatText(text, &out);
+    out.write(text.data(), static_cast<std::streamsize>(text.size()));
 }
 
 // CalculateNeighbors1D // update for Moore's neighborhood
@@ -195,7 +1045,6 @@ int CellularAutomata::CalculateNeighbors1D(int index) const
 int CellularAutomata::CalculateNeighbors2D(int i, int j) const
 {
     int neighbors = 0;               // used to keep track of neighbor count around int index
-    double avg = 0.0;
     for (int di = -1; di <= 1; ++di) // loop through each cell in the grid_1d_
     {
         for (int dj = -1; dj <= 1; ++dj) // loop through each cell in the grid_1d_
@@ -227,33 +1076,170 @@ int CellularAutomata::CalculateNeighbors2D(int i, int j) const
             // if no boundary is specified, cells outside the grid are ignored.
             switch (boundary_condition_)
             {
-            case BoundaryCondition::Periodic: // (ni + size_) % size  and (nj + size_)%size_
+            case BoundaryCondition::Periodic: // (ni + rows_) % rows_  and (nj + cols_) % cols_
                                               // are used to adjust coordinates
-                ni = (ni + size_) % size_;    // this takes current value of ni add size_ and takes the
-                                              // remainder or modulo of size_. The result is if ni becomes
-                                              // greater or equal  size_ it wraps ariubd to a valid coordinate within the grid
-                nj = (nj + size_) % size_;    // this takes current value of nj and does the same as ni to wrap around the cells
+                ni = (ni + rows_) % rows_;    // this takes current value of ni add rows_ and takes the
+                                              // remainder or modulo of rows_. The result is if ni becomes
+                                              // greater or equal  rows_ it wraps ariubd to a valid coordinate within the grid
+                nj = (nj + cols_) % cols_;    // this takes current value of nj and does the same as ni to wrap around the cells
                                               // at the bottom edge of the grid and wrap around the top.
                 break;
             case BoundaryCondition::Fixed:                          // this case handles fixed boundary condition for 2D Grid CA.
-                if (ni < 0 || ni >= size_ || nj < 0 || nj >= size_) // if ni is less than 0 or greater than or equal to grid size,continue
+                if (ni < 0 || ni >= rows_ || nj < 0 || nj >= cols_) // if ni is less than 0 or greater than or equal to grid size,continue
                                                                     // and ignore the cells beyond the grid's edges which do not effect the simulation
                                                                     // these cells beyond the edges are considered constant in this simulation logic.
                     continue;                                       // if the neighbor cell is outside the grid boundaries skip the processing of the neighbor and move to the next one
                 break;                                              // exit switch statement if boundary condition is fixed and logic is applied
 
             case BoundaryCondition::NoBoundary:                     // this condition treats the boundaries as if they extend infinitely in all directions
-                if (ni < 0 || ni >= size_ || nj < 0 || nj >= size_) // if ni is less than 0 or greater than or equal to grid size, if true it neighbor cell is
+                if (ni < 0 || ni >= rows_ || nj < 0 || nj >= cols_) // if ni is less than 0 or greater than or equal to grid size, if true it neighbor cell is
                                                                     // is outside the grid boundaries, ignore them and continue to the next cell.
                     continue;                                       // continue to the next iteration without counting the neighbor.
                 break;                                              // once the logic is applied exit the switch statement.
             }
 
-            neighbors += grid_2d_[ni][nj]; // used to count the number of neighboring cells that have specific states within 2D grid with simulating CA.
-            avg += grid_2d_[ni][nj];
+            neighbors += grid_2d_.at(ni, nj); // used to count the number of neighboring cells that have specific states within 2D grid with simulating CA.
         }
     }
-    return neighbors,avg ; // return total neighbor count based on the conditions that were applied
+    return neighbors; // return the neighbor sum based on the conditions that were applied
+}
+
+// GetNeighborCounts2D
+// reference histogram of one cell: the offsets and boundary handling of CalculateNeighbors2D, except that a
+// Fixed grid counts the cells beyond its edges as state 0 while a NoBoundary grid leaves them out.
+NeighborCounts CellularAutomata::GetNeighborCounts2D(int i, int j) const
+{
+    std::uint32_t counts = 0;
+    for (int di = -1; di <= 1; ++di)
+    {
+        for (int dj = -1; dj <= 1; ++dj)
+        {
+            if ((di == 0 && dj == 0) || (neighborhood_type_ == NeighborhoodType::VonNeumann && abs(di) + abs(dj) > 1))
+                continue;
+            int ni = i + di, nj = j + dj;
+            if (boundary_condition_ == BoundaryCondition::Periodic)
+            {
+                ni = (ni + rows_) % rows_;
+                nj = (nj + cols_) % cols_;
+            }
+            else if (ni < 0 || ni >= rows_ || nj < 0 || nj >= cols_)
+            {
+                if (boundary_condition_ == BoundaryCondition::Fixed)
+                    counts += NeighborCounts::Encode(INACTIVE);
+                continue;
+            }
+            counts += NeighborCounts::Encode(grid_2d_.at(ni, nj));
+        }
+    }
+    return NeighborCounts(counts);
+}
+
+// CalculateNeighbors3D
+// straightforward reference for the 3D stencil: visits the 26 (Moore) or 6 (von Neumann) offsets and applies
+// the boundary condition to each one, the same way CalculateNeighbors2D does in 2D.
+int CellularAutomata::CalculateNeighbors3D(int k, int i, int j) const
+{
+    int neighbors = 0;
+    for (int dk = -1; dk <= 1; ++dk)
+    {
+        for (int di = -1; di <= 1; ++di)
+        {
+            for (int dj = -1; dj <= 1; ++dj)
+            {
+                if (dk == 0 && di == 0 && dj == 0)
+                    continue; // Skip the center cell
+                if (neighborhood_type_ == NeighborhoodType::VonNeumann && abs(dk) + abs(di) + abs(dj) > 1)
+                    continue; // only the six face neighbors
+                int nk = k + dk, ni = i + di, nj = j + dj;
+                if (boundary_condition_ == BoundaryCondition::Periodic)
+                {
+                    nk = (nk + layers_) % layers_;
+                    ni = (ni + rows_) % rows_;
+                    nj = (nj + cols_) % cols_;
+                }
+                else if (nk < 0 || nk >= layers_ || ni < 0 || ni >= rows_ || nj < 0 || nj >= cols_)
+                {
+                    continue; // Fixed and NoBoundary: cells beyond the faces do not count
+                }
+                neighbors += grid_3d_.at(nk, ni, nj);
+            }
+        }
+    }
+    return neighbors;
+}
+
+// StepNeuron
+// the model is folded into a NeuronRule for this step once, then the kernel sweeps row bands of the grid.
+void CellularAutomata::StepNeuron(const NeuronModel &model, std::uint64_t seed, std::uint64_t step)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("StepNeuron called on a non-2D automaton");
+    }
+    const NeuronRule rule(model, step);
+    StepScope scope(*this);
+    FillHalo2D();
+    EndPhase(&StepStats::neighbor_seconds);
+    ca_detail::NeuronSweep2D sweep;
+    sweep.current = grid_2d_.data();
+    sweep.next = next_grid_2d_.data();
+    sweep.stride = grid_2d_.stride();
+    sweep.cols = grid_2d_.cols();
+    sweep.moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    sweep.rule = &rule;
+    sweep.seed = seed;
+    sweep.step = step;
+    const SimdLevel level = simd_level_;
+    RunRowBands(grid_2d_.rows(), grid_2d_.cols(), [&](int begin, int end) {
+        ca_detail::SweepNeuron2D(sweep, level, begin, end);
+    });
+    EndPhase(&StepStats::rule_seconds);
+    grid_2d_.swap(next_grid_2d_);
+    active_all_dirty_ = true; // as in StepStochastic, activity can appear anywhere
+    EndPhase(&StepStats::swap_seconds);
+    scope.Finish(1);
+}
+
+// ComputePotential
+// runs the convolution engine over the front buffer with the row bands of the thread pool.
+void CellularAutomata::ComputePotential(const ConvolutionKernel &kernel, std::vector<double> &potential)
+{
+    if (dimension_ != GridDimension::TwoD)
+    {
+        throw std::runtime_error("Kernel neighborhoods need a 2D automaton");
+    }
+    if (!convolution_ || convolution_.use_count() > 1)
+    {
+        convolution_ = std::make_shared<KernelConvolution>();
+    }
+    convolution_->SetMethod(convolution_method_);
+    potential.resize(static_cast<std::size_t>(grid_2d_.rows()) * grid_2d_.cols());
+    convolution_->Convolve(grid_2d_, boundary_condition_ == BoundaryCondition::Periodic, kernel, potential.data(),
+                           [this](int count, int width, const std::function<void(int, int)> &body) {
+                               RunRowBands(count, width, body);
+                           });
+}
+
+void CellularAutomata::SetConvolutionMethod(ConvolutionMethod method)
+{
+    convolution_method_ = method;
+}
+
+// MajorityRule
+// static member used by the neuron application: a cell becomes active when more than half of its
+// eight Moore neighbors are active, otherwise it becomes inactive.
+int CellularAutomata::MajorityRule(int activeNeighbors)
+{
+    return (activeNeighbors > 4) ? ACTIVE_1 : INACTIVE;
+}
+
+// TotalisticRule
+// static member used by the neuron application: a cell becomes active only when exactly three of its
+// neighbors are active, otherwise it becomes inactive. (totalisticRule below is a different rule: it is
+// called with the state as its second argument and turns on exactly the cells in state 1.)
+int CellularAutomata::TotalisticRule(int activeNeighbors)
+{
+    return (activeNeighbors == 3) ? ACTIVE_1 : INACTIVE;
 }
 
 // This rule is specific for the 2D CA model
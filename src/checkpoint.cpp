@@ -0,0 +1,408 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include "../Include/Checkpoint.h"
+
+using ca_detail::BYTE_ORDER_MARK;
+using ca_detail::RoundUp;
+
+namespace
+{
+    const char MAGIC[8] = {'C', 'A', 'C', 'K', 'P', 'T', '0', '1'};
+    const std::uint32_t VERSION = 2; // version 1 checksummed the cells only
+    const std::size_t HEADER_ALIGNMENT = 64;
+    const std::size_t FIXED_HEADER_BYTES = 88; // everything before the rule table entries
+    const std::size_t CHECKSUM_OFFSET = 80;    // the last of the four 64-bit counters
+
+    std::size_t RuleEntries(const RuleTable &rule)
+    {
+        return rule.numStates() == 0 ? 0 : static_cast<std::size_t>(rule.numStates()) * rule.sumsPerState();
+    }
+
+    // a * b into product, or false when the product does not fit into 64 bits.
+    bool CheckedMultiply(std::uint64_t a, std::uint64_t b, std::uint64_t &product)
+    {
+        if (a != 0 && b > UINT64_MAX / a)
+            return false;
+        product = a * b;
+        return true;
+    }
+
+    // ChecksumBytes
+    // FNV-1a over 64-bit words (a shorter tail zero-padded into one last word): one multiply per two cells, so
+    // checking a grid costs about as much as copying it, and any torn or damaged block changes the result.
+    std::uint64_t ChecksumBytes(std::uint64_t hash, const unsigned char *data, std::size_t bytes)
+    {
+        const std::uint64_t prime = 0x100000001b3ull;
+        std::size_t k = 0;
+        for (; k + 8 <= bytes; k += 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, data + k, sizeof(word));
+            hash = (hash ^ word) * prime;
+        }
+        if (k < bytes)
+        {
+            std::uint64_t word = 0;
+            std::memcpy(&word, data + k, bytes - k);
+            hash = (hash ^ word) * prime;
+        }
+        return hash;
+    }
+
+    // Checksum
+    // covers the whole file, the header with its checksum field read as zero included, so a damaged step,
+    // seed, shape or rule entry is caught like a damaged cell. Every part starts on an 8-byte boundary.
+    std::uint64_t Checksum(const unsigned char *header, std::size_t header_bytes, const int *cells, std::size_t count)
+    {
+        const unsigned char zero[8] = {0};
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        hash = ChecksumBytes(hash, header, CHECKSUM_OFFSET);
+        hash = ChecksumBytes(hash, zero, sizeof(zero));
+        hash = ChecksumBytes(hash, header + CHECKSUM_OFFSET + 8, header_bytes - CHECKSUM_OFFSET - 8);
+        return ChecksumBytes(hash, reinterpret_cast<const unsigned char *>(cells), count * sizeof(int));
+    }
+
+    // Writes the header fields one by one (no struct padding reaches the file); the checksum field is left zero.
+    std::vector<unsigned char> EncodeHeader(const CheckpointWriter::Snapshot &s)
+    {
+        const std::size_t rule_bytes = RuleEntries(s.state.rule) * sizeof(int);
+        std::vector<unsigned char> bytes(RoundUp(FIXED_HEADER_BYTES + rule_bytes + s.state.extra.size(), HEADER_ALIGNMENT), 0);
+        unsigned char *out = bytes.data();
+        std::memcpy(out, MAGIC, 8);
+        const std::uint32_t words[6] = {BYTE_ORDER_MARK, VERSION, static_cast<std::uint32_t>(bytes.size()),
+                                        static_cast<std::uint32_t>(s.dimension), static_cast<std::uint32_t>(s.boundary),
+                                        static_cast<std::uint32_t>(s.neighborhood)};
+        std::memcpy(out + 8, words, sizeof(words));
+        const std::int32_t shape[3] = {s.layers, s.rows, s.cols};
+        std::memcpy(out + 32, shape, sizeof(shape));
+        const std::uint32_t rule_states = static_cast<std::uint32_t>(s.state.rule.numStates());
+        const std::int32_t rule_max_sum = s.state.rule.maxSum();
+        const std::uint32_t extra_length = static_cast<std::uint32_t>(s.state.extra.size());
+        std::memcpy(out + 44, &rule_states, 4);
+        std::memcpy(out + 48, &rule_max_sum, 4);
+        std::memcpy(out + 52, &extra_length, 4);
+        const std::uint64_t counters[4] = {s.state.step, s.state.seed, static_cast<std::uint64_t>(s.cells.size() * sizeof(int)), 0};
+        std::memcpy(out + 56, counters, sizeof(counters));
+        if (rule_bytes > 0)
+            std::memcpy(out + FIXED_HEADER_BYTES, s.state.rule.table(), rule_bytes);
+        std::memcpy(out + FIXED_HEADER_BYTES + rule_bytes, s.state.extra.data(), s.state.extra.size());
+        return bytes;
+    }
+
+    // Copies one row of count cells.
+    void CopyCells(const int *in, int count, int *out) { std::copy(in, in + count, out); }
+} // namespace
+
+// Snapshot
+
+// Capture
+// the configuration of `ca`, run_state and a packed copy of the grid; the buffer is reused when the shape
+// stays the same, so periodic checkpoints do not allocate.
+void CheckpointWriter::Snapshot::Capture(const CellularAutomata &ca, const CheckpointState &run_state)
+{
+    dimension = ca.GetDimension();
+    boundary = ca.GetBoundaryCondition();
+    neighborhood = ca.GetNeighborhoodType();
+    layers = ca.getLayers();
+    rows = ca.getRows();
+    cols = ca.getCols();
+    state = run_state;
+    cells.resize(static_cast<std::size_t>(layers) * rows * cols);
+    int *out = cells.data();
+    switch (dimension)
+    {
+    case GridDimension::OneD:
+        std::copy(ca.GetGrid1D().begin(), ca.GetGrid1D().end(), out);
+        break;
+    case GridDimension::TwoD:
+    {
+        const FlatGrid2D &grid = ca.GetGrid2D();
+        if (grid.isPacked())
+            std::copy(grid.data(), grid.data() + grid.cellCount(), out); // one copy for the whole grid
+        else
+            for (int i = 0; i < rows; ++i, out += cols)
+                CopyCells(grid[i].data(), cols, out);
+        break;
+    }
+    case GridDimension::ThreeD:
+    {
+        const FlatGrid3D &grid = ca.GetGrid3D();
+        for (int k = 0; k < layers; ++k)
+            for (int i = 0; i < rows; ++i, out += cols)
+                CopyCells(grid.row(k, i).data(), cols, out);
+        break;
+    }
+    }
+}
+
+// Write
+// header and cells go to path + ".tmp", which is flushed to the disk and then renamed over path: the rename
+// replaces the previous checkpoint in one step, so there is always one complete checkpoint at path.
+void CheckpointWriter::Snapshot::Write(const std::string &path) const
+{
+    std::vector<unsigned char> header = EncodeHeader(*this);
+    const std::uint64_t checksum = Checksum(header.data(), header.size(), cells.data(), cells.size());
+    std::memcpy(header.data() + CHECKSUM_OFFSET, &checksum, sizeof(checksum));
+    const std::string temporary = path + ".tmp";
+    std::FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+    {
+        throw std::runtime_error("Unable to open checkpoint file: " + temporary);
+    }
+    bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size() &&
+              std::fwrite(cells.data(), sizeof(int), cells.size(), file) == cells.size() &&
+              ca_detail::SyncFile(file); // on the disk before it replaces the previous checkpoint
+    ok = (std::fclose(file) == 0) && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temporary.c_str());
+        throw std::runtime_error("Unable to write checkpoint file: " + path);
+    }
+}
+
+void WriteCheckpoint(const std::string &path, const CellularAutomata &ca, const CheckpointState &state)
+{
+    CheckpointWriter::Snapshot snapshot;
+    snapshot.Capture(ca, state);
+    snapshot.Write(path);
+}
+
+// CheckpointWriter
+
+CheckpointWriter::CheckpointWriter(const std::string &path)
+    : path_(path), has_pending_(false), busy_(false), stopping_(false), closed_(false), written_(0), skipped_(0)
+{
+    thread_ = std::thread(&CheckpointWriter::WriterLoop, this);
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    ca_detail::CloseQuietly(*this);
+}
+
+// Save
+// the copy happens under the lock, which the writer thread only holds to swap buffers, so Save does not wait
+// for the disk; a pending snapshot the writer thread has not taken yet is overwritten.
+void CheckpointWriter::Save(const CellularAutomata &ca, const CheckpointState &state)
+{
+    CellularAutomata::IOTimer timer(ca);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            throw std::runtime_error("Checkpoint writer is closed");
+        }
+        if (error_)
+        {
+            std::rethrow_exception(error_);
+        }
+        if (has_pending_)
+        {
+            ++skipped_;
+        }
+        pending_.Capture(ca, state);
+        has_pending_ = true;
+    }
+    work_.notify_one();
+}
+
+long long CheckpointWriter::WrittenCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return written_;
+}
+
+long long CheckpointWriter::SkippedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return skipped_;
+}
+
+void CheckpointWriter::Wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return (!has_pending_ && !busy_) || error_; });
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+}
+
+void CheckpointWriter::Close()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_)
+        {
+            return;
+        }
+        closed_ = true;
+        stopping_ = true;
+    }
+    work_.notify_one();
+    thread_.join();
+    if (error_)
+    {
+        std::rethrow_exception(error_);
+    }
+}
+
+// WriterLoop
+// takes the pending snapshot by swapping buffers (the old one goes back to Save for reuse) and writes it
+// without holding the lock; returns once stopping and nothing is pending, or after the first error.
+void CheckpointWriter::WriterLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        work_.wait(lock, [this] { return has_pending_ || stopping_; });
+        if (!has_pending_)
+        {
+            return;
+        }
+        std::swap(pending_, writing_);
+        has_pending_ = false;
+        busy_ = true;
+        lock.unlock();
+        std::exception_ptr error;
+        try
+        {
+            writing_.Write(path_);
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        lock.lock();
+        busy_ = false;
+        if (error)
+        {
+            error_ = error;
+            idle_.notify_all();
+            return;
+        }
+        ++written_;
+        idle_.notify_all();
+    }
+}
+
+// CheckpointReader
+
+CheckpointReader::CheckpointReader(const std::string &path)
+    : dimension_(GridDimension::TwoD), boundary_(BoundaryCondition::Fixed), neighborhood_(NeighborhoodType::Moore),
+      layers_(0), rows_(0), cols_(0), file_(path, "checkpoint"), data_(file_.data()), size_(file_.size()), cells_(nullptr)
+{
+    Decode();
+}
+
+// Decode
+// parses and validates the header, then checks that the cells are all there and that the file matches the
+// checksum. Sizes derived from header fields are computed with overflow checks and bounded by the header and
+// file sizes before anything is allocated or read, so a damaged header is reported instead of trusted.
+void CheckpointReader::Decode()
+{
+    if (size_ < FIXED_HEADER_BYTES || std::memcmp(data_, MAGIC, 8) != 0)
+        throw std::runtime_error("Not a checkpoint file");
+    std::uint32_t words[6];
+    std::memcpy(words, data_ + 8, sizeof(words));
+    if (words[0] != BYTE_ORDER_MARK)
+        throw std::runtime_error("Checkpoint file was written on a machine with a different byte order");
+    if (words[1] != VERSION)
+        throw std::runtime_error("Unsupported checkpoint file version");
+    const std::size_t header_bytes = words[2];
+    if (words[3] > 2 || words[4] > 2 || words[5] > 1 || header_bytes % HEADER_ALIGNMENT != 0 || header_bytes > size_)
+        throw std::runtime_error("Corrupt checkpoint header");
+    dimension_ = static_cast<GridDimension>(words[3]);
+    boundary_ = static_cast<BoundaryCondition>(words[4]);
+    neighborhood_ = static_cast<NeighborhoodType>(words[5]);
+    std::int32_t shape[3];
+    std::memcpy(shape, data_ + 32, sizeof(shape));
+    layers_ = shape[0];
+    rows_ = shape[1];
+    cols_ = shape[2];
+    std::uint32_t rule_states = 0, extra_length = 0;
+    std::int32_t rule_max_sum = 0;
+    std::memcpy(&rule_states, data_ + 44, 4);
+    std::memcpy(&rule_max_sum, data_ + 48, 4);
+    std::memcpy(&extra_length, data_ + 52, 4);
+    std::uint64_t counters[4];
+    std::memcpy(counters, data_ + 56, sizeof(counters));
+    state_.step = counters[0];
+    state_.seed = counters[1];
+    if (layers_ < 0 || rows_ < 0 || cols_ < 0 || header_bytes < FIXED_HEADER_BYTES || (rule_states > 0 && rule_max_sum < 0))
+        throw std::runtime_error("Corrupt checkpoint header");
+    // the rule entries and the extra bytes must fit between the fixed fields and the cells
+    const std::uint64_t header_ints = (header_bytes - FIXED_HEADER_BYTES) / sizeof(int);
+    std::uint64_t rule_entries = 0, cell_count = 0, cell_bytes = 0;
+    if (rule_states > 0 && !(CheckedMultiply(rule_states, static_cast<std::uint64_t>(rule_max_sum) + 1, rule_entries) &&
+                             rule_entries <= header_ints))
+        throw std::runtime_error("Corrupt checkpoint header");
+    if (FIXED_HEADER_BYTES + rule_entries * sizeof(int) + extra_length > header_bytes)
+        throw std::runtime_error("Corrupt checkpoint header");
+    if (!CheckedMultiply(static_cast<std::uint64_t>(layers_), static_cast<std::uint64_t>(rows_), cell_count) ||
+        !CheckedMultiply(cell_count, static_cast<std::uint64_t>(cols_), cell_count) ||
+        !CheckedMultiply(cell_count, sizeof(int), cell_bytes) || counters[2] != cell_bytes)
+        throw std::runtime_error("Corrupt checkpoint header");
+    if (size_ - header_bytes != cell_bytes)
+        throw std::runtime_error("Checkpoint file is incomplete");
+    cells_ = reinterpret_cast<const int *>(data_ + header_bytes); // 64-byte aligned within the mapping
+    if (Checksum(data_, header_bytes, cells_, static_cast<std::size_t>(cell_count)) != counters[3])
+        throw std::runtime_error("Checkpoint file does not match its checksum");
+    if (rule_states > 0)
+    {
+        state_.rule = RuleTable(static_cast<int>(rule_states), rule_max_sum); // both below 2^30 (bounded above)
+        const unsigned char *entries = data_ + FIXED_HEADER_BYTES;
+        for (int s = 0; s < state_.rule.numStates(); ++s)
+        {
+            for (int sum = 0; sum <= rule_max_sum; ++sum, entries += sizeof(int))
+            {
+                int next;
+                std::memcpy(&next, entries, sizeof(int));
+                state_.rule.Set(s, sum, next);
+            }
+        }
+    }
+    state_.extra.assign(reinterpret_cast<const char *>(data_ + FIXED_HEADER_BYTES + rule_entries * sizeof(int)), extra_length);
+}
+
+void CheckpointReader::Restore(CellularAutomata &ca) const
+{
+    if (ca.GetDimension() != dimension_ || ca.GetBoundaryCondition() != boundary_ || ca.GetNeighborhoodType() != neighborhood_ ||
+        ca.getLayers() != layers_ || ca.getRows() != rows_ || ca.getCols() != cols_)
+    {
+        throw std::invalid_argument("Automaton does not match the checkpoint's configuration");
+    }
+    const int *in = cells_;
+    switch (dimension_)
+    {
+    case GridDimension::OneD:
+        ca.Initialize1D([in](CellularAutomata::Grid1D &grid) { std::copy(in, in + grid.size(), grid.begin()); });
+        break;
+    case GridDimension::TwoD:
+        ca.Initialize2D([in](CellularAutomata::Grid2D &grid) {
+            const int *row = in;
+            for (int i = 0; i < grid.rows(); ++i, row += grid.cols())
+                CopyCells(row, grid.cols(), grid[i].data());
+        });
+        break;
+    case GridDimension::ThreeD:
+        ca.Initialize3D([in](CellularAutomata::Grid3D &grid) {
+            const int *row = in;
+            for (int k = 0; k < grid.layers(); ++k)
+                for (int i = 0; i < grid.rows(); ++i, row += grid.cols())
+                    CopyCells(row, grid.cols(), grid.row(k, i).data());
+        });
+        break;
+    }
+}
+
+CellularAutomata CheckpointReader::CreateAutomaton() const
+{
+    CellularAutomata ca = dimension_ == GridDimension::OneD   ? CellularAutomata(cols_, GridDimension::OneD, boundary_, neighborhood_)
+                          : dimension_ == GridDimension::TwoD ? CellularAutomata(rows_, cols_, boundary_, neighborhood_)
+                                                              : CellularAutomata(layers_, rows_, cols_, boundary_, neighborhood_);
+    Restore(ca);
+    return ca;
+}
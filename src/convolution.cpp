@@ -0,0 +1,578 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "../Include/Convolution.h"
+
+namespace
+{
+const double PI = 3.14159265358979323846;
+
+// Estimated cost (in multiply-adds of the direct path, measured on x86) of the direct path per cell besides its
+// taps (padding copy, clearing), and of one point of the FFT domain per butterfly stage (forward and inverse,
+// rows and columns, on the half spectrum). With these Auto switches to the FFT at about 50 taps on 1024 x 1024.
+const double DIRECT_COST_PER_CELL = 3.0;
+const double FFT_COST_PER_STAGE = 3.0;
+
+// smallest power of two >= n, and at least 2 (the FFT path transforms rows in pairs)
+int NextPowerOfTwo(int n)
+{
+    int p = 2;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+
+bool IsPowerOfTwo(int n)
+{
+    return n >= 2 && (n & (n - 1)) == 0;
+}
+
+// complex product written out, so it vectorizes and skips the NaN/infinity recovery of operator*
+inline std::complex<double> Mul(const std::complex<double> &a, const std::complex<double> &b)
+{
+    return std::complex<double>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// Rows of the two kinds of input, and whether their values are whole numbers.
+struct GridSource
+{
+    const FlatGrid2D *grid;
+    static const bool integer = true;
+    const int *Row(int i) const { return grid->data() + i * grid->stride(); }
+};
+
+struct FieldSource
+{
+    const double *field;
+    int cols;
+    static const bool integer = false;
+    const double *Row(int i) const { return field + static_cast<std::ptrdiff_t>(i) * cols; }
+};
+
+// Copies domain row `row` of a source mapped through the two axes into values (zeros for padding);
+// returns false when the whole row is padding.
+template <typename Source, typename Axis>
+bool LoadRow(const Source &source, const Axis &rows, const Axis &cols, int row, double *values)
+{
+    const int si = rows.source[row];
+    if (si < 0)
+    {
+        std::fill(values, values + cols.n, 0.0);
+        return false;
+    }
+    const auto *cells = source.Row(si);
+    for (int j = 0; j < cols.n; ++j)
+    {
+        const int sj = cols.source[j];
+        values[j] = (sj < 0) ? 0.0 : static_cast<double>(cells[sj]);
+    }
+    return true;
+}
+
+// Serial stand-in for a missing BandRunner.
+void RunSerial(int count, int, const std::function<void(int, int)> &body)
+{
+    body(0, count);
+}
+} // namespace
+
+// ConvolutionKernel
+
+ConvolutionKernel::ConvolutionKernel(int radius, const std::vector<double> &weights) : radius_(radius), weights_(weights)
+{
+    if (radius < 0)
+    {
+        throw std::invalid_argument("Kernel radius must be non-negative");
+    }
+    if (weights.size() != static_cast<std::size_t>(width()) * width())
+    {
+        throw std::invalid_argument("Kernel needs (2 radius + 1)^2 weights");
+    }
+    for (double w : weights)
+    {
+        if (!std::isfinite(w))
+        {
+            throw std::invalid_argument("Kernel weights must be finite");
+        }
+    }
+}
+
+ConvolutionKernel ConvolutionKernel::Box(int radius, bool include_center)
+{
+    if (radius < 0)
+    {
+        throw std::invalid_argument("Kernel radius must be non-negative");
+    }
+    const int width = 2 * radius + 1;
+    std::vector<double> weights(static_cast<std::size_t>(width) * width, 1.0);
+    if (!include_center)
+        weights[static_cast<std::size_t>(radius) * width + radius] = 0.0;
+    return ConvolutionKernel(radius, weights);
+}
+
+ConvolutionKernel ConvolutionKernel::Disk(int radius)
+{
+    if (radius < 0)
+    {
+        throw std::invalid_argument("Kernel radius must be non-negative");
+    }
+    const int width = 2 * radius + 1;
+    std::vector<double> weights(static_cast<std::size_t>(width) * width, 0.0);
+    for (int di = -radius; di <= radius; ++di)
+        for (int dj = -radius; dj <= radius; ++dj)
+            if ((di != 0 || dj != 0) && di * di + dj * dj <= radius * radius)
+                weights[static_cast<std::size_t>(di + radius) * width + (dj + radius)] = 1.0;
+    return ConvolutionKernel(radius, weights);
+}
+
+ConvolutionKernel ConvolutionKernel::Gaussian(int radius, double sigma)
+{
+    if (radius < 0 || !(sigma > 0.0))
+    {
+        throw std::invalid_argument("Gaussian kernel needs a non-negative radius and a positive sigma");
+    }
+    const int width = 2 * radius + 1;
+    std::vector<double> weights(static_cast<std::size_t>(width) * width, 0.0);
+    for (int di = -radius; di <= radius; ++di)
+        for (int dj = -radius; dj <= radius; ++dj)
+        {
+            const int d2 = di * di + dj * dj;
+            if (d2 <= radius * radius)
+                weights[static_cast<std::size_t>(di + radius) * width + (dj + radius)] = std::exp(-d2 / (2.0 * sigma * sigma));
+        }
+    return ConvolutionKernel(radius, weights).Normalized();
+}
+
+ConvolutionKernel ConvolutionKernel::MexicanHat(int radius, double sigma_excite, double sigma_inhibit, double inhibition)
+{
+    if (!(sigma_inhibit > sigma_excite))
+    {
+        throw std::invalid_argument("Mexican hat kernel needs sigma_inhibit > sigma_excite");
+    }
+    const ConvolutionKernel excite = Gaussian(radius, sigma_excite);
+    const ConvolutionKernel inhibit = Gaussian(radius, sigma_inhibit);
+    std::vector<double> weights(excite.weights());
+    for (std::size_t k = 0; k < weights.size(); ++k)
+        weights[k] -= inhibition * inhibit.weights()[k];
+    return ConvolutionKernel(radius, weights);
+}
+
+ConvolutionKernel ConvolutionKernel::Lenia(int radius, const std::vector<double> &peaks)
+{
+    if (radius < 1 || peaks.empty())
+    {
+        throw std::invalid_argument("Lenia kernel needs a radius of at least 1 and at least one ring");
+    }
+    const int width = 2 * radius + 1;
+    const int rings = static_cast<int>(peaks.size());
+    std::vector<double> weights(static_cast<std::size_t>(width) * width, 0.0);
+    for (int di = -radius; di <= radius; ++di)
+        for (int dj = -radius; dj <= radius; ++dj)
+        {
+            // distance in units of the radius, then the ring it falls in and the position x across that ring
+            const double q = std::sqrt(static_cast<double>(di * di + dj * dj)) / radius * rings;
+            const int ring = static_cast<int>(q);
+            const double x = q - ring;
+            if (ring < rings && x > 0.0)
+                weights[static_cast<std::size_t>(di + radius) * width + (dj + radius)] =
+                    peaks[ring] * std::exp(4.0 - 1.0 / (x * (1.0 - x)));
+        }
+    return ConvolutionKernel(radius, weights).Normalized();
+}
+
+int ConvolutionKernel::TapCount() const
+{
+    return static_cast<int>(weights_.size() - std::count(weights_.begin(), weights_.end(), 0.0));
+}
+
+double ConvolutionKernel::Sum() const
+{
+    double sum = 0.0;
+    for (double w : weights_)
+        sum += w;
+    return sum;
+}
+
+bool ConvolutionKernel::IsInteger() const
+{
+    for (double w : weights_)
+        if (w != std::floor(w))
+            return false;
+    return true;
+}
+
+ConvolutionKernel ConvolutionKernel::Normalized() const
+{
+    const double sum = Sum();
+    if (sum == 0.0)
+    {
+        throw std::invalid_argument("Kernel weights sum to zero and cannot be normalized");
+    }
+    std::vector<double> weights(weights_);
+    for (double &w : weights)
+        w /= sum;
+    return ConvolutionKernel(radius_, weights);
+}
+
+// LeniaRule
+
+LeniaRule::LeniaRule(double mu, double sigma, double dt, int levels)
+    : mu_(mu), minus_half_over_sigma2_(0.0), step_scale_(0.0), inverse_levels_(0.0), levels_(levels)
+{
+    if (levels < 1 || !(sigma > 0.0) || !(dt > 0.0 && dt <= 1.0))
+    {
+        throw std::invalid_argument("LeniaRule needs levels >= 1, sigma > 0 and 0 < dt <= 1");
+    }
+    minus_half_over_sigma2_ = -0.5 / (sigma * sigma);
+    step_scale_ = dt * levels;
+    inverse_levels_ = 1.0 / levels;
+}
+
+// KernelConvolution
+
+KernelConvolution::KernelConvolution(ConvolutionMethod method)
+    : method_(method), last_method_(ConvolutionMethod::Direct), n1_(0), n2_(0), kernel_radius_(-1), kernel_n1_(0),
+      kernel_n2_(0)
+{
+}
+
+int KernelConvolution::FFTSize(int size, int radius, bool periodic)
+{
+    return (periodic && IsPowerOfTwo(size)) ? size : NextPowerOfTwo(size + 2 * radius);
+}
+
+// MakeAxis
+// the padded layout puts source index 0 at `radius` and fills both margins by wrapping (periodic) or with
+// zeros; a periodic power-of-two FFT axis maps every index to itself.
+KernelConvolution::Axis KernelConvolution::MakeAxis(int size, int radius, bool periodic, bool fft)
+{
+    Axis axis;
+    if (fft && periodic && IsPowerOfTwo(size))
+    {
+        axis.n = size;
+        axis.offset = 0;
+        axis.source.resize(size);
+        for (int a = 0; a < size; ++a)
+            axis.source[a] = a;
+        return axis;
+    }
+    const int padded = size + 2 * radius;
+    axis.n = fft ? NextPowerOfTwo(padded) : padded;
+    axis.offset = radius;
+    axis.source.assign(axis.n, -1);
+    for (int a = 0; a < padded; ++a)
+    {
+        const int s = a - radius;
+        if (s >= 0 && s < size)
+            axis.source[a] = s;
+        else if (periodic)
+            axis.source[a] = ((s % size) + size) % size;
+    }
+    return axis;
+}
+
+ConvolutionMethod KernelConvolution::Choose(int rows, int cols, bool periodic, const ConvolutionKernel &kernel)
+{
+    const double direct = static_cast<double>(rows) * cols * (kernel.TapCount() + DIRECT_COST_PER_CELL);
+    const int n1 = FFTSize(rows, kernel.radius(), periodic), n2 = FFTSize(cols, kernel.radius(), periodic);
+    const double stages = std::log2(static_cast<double>(n1)) + std::log2(static_cast<double>(n2));
+    const double fft = static_cast<double>(n1) * n2 * (stages + 1.0) * FFT_COST_PER_STAGE;
+    return (direct <= fft) ? ConvolutionMethod::Direct : ConvolutionMethod::FFT;
+}
+
+void KernelConvolution::Convolve(const FlatGrid2D &grid, bool periodic, const ConvolutionKernel &kernel, double *out,
+                                 const BandRunner &bands)
+{
+    GridSource source = {&grid};
+    ConvolveSource(source, grid.rows(), grid.cols(), periodic, kernel, out, bands);
+}
+
+void KernelConvolution::Convolve(const double *field, int rows, int cols, bool periodic,
+                                 const ConvolutionKernel &kernel, double *out, const BandRunner &bands)
+{
+    if (rows < 0 || cols < 0)
+    {
+        throw std::invalid_argument("Field dimensions must be non-negative");
+    }
+    FieldSource source = {field, cols};
+    ConvolveSource(source, rows, cols, periodic, kernel, out, bands);
+}
+
+template <typename Source>
+void KernelConvolution::ConvolveSource(const Source &source, int rows, int cols, bool periodic,
+                                       const ConvolutionKernel &kernel, double *out, const BandRunner &bands)
+{
+    if (rows == 0 || cols == 0)
+        return;
+    const BandRunner &run = bands ? bands : BandRunner(RunSerial);
+    ConvolutionMethod method = method_;
+    if (method == ConvolutionMethod::Auto)
+        method = Choose(rows, cols, periodic, kernel);
+    if (method == ConvolutionMethod::FFT)
+        ConvolveFFT(source, rows, cols, periodic, kernel, out, run);
+    else
+        ConvolveDirect(source, rows, cols, periodic, kernel, out, run);
+    last_method_ = method;
+}
+
+// ConvolveDirect
+// copies the grid with a margin of `radius` cells into a double buffer, then adds one shifted row of it per
+// nonzero weight to every output row; the inner loops are contiguous and vectorize.
+template <typename Source>
+void KernelConvolution::ConvolveDirect(const Source &source, int rows, int cols, bool periodic,
+                                       const ConvolutionKernel &kernel, double *out, const BandRunner &bands)
+{
+    const int r = kernel.radius();
+    const Axis row_axis = MakeAxis(rows, r, periodic, false);
+    const Axis col_axis = MakeAxis(cols, r, periodic, false);
+    const int padded_cols = col_axis.n;
+    padded_.resize(static_cast<std::size_t>(row_axis.n) * padded_cols);
+    bands(row_axis.n, padded_cols, [&](int begin, int end) {
+        for (int a = begin; a < end; ++a)
+            LoadRow(source, row_axis, col_axis, a, &padded_[static_cast<std::size_t>(a) * padded_cols]);
+    });
+
+    // nonzero weights, row by row of the kernel
+    std::vector<int> tap_rows, tap_cols;
+    std::vector<double> tap_weights;
+    for (int di = -r; di <= r; ++di)
+        for (int dj = -r; dj <= r; ++dj)
+            if (kernel.weight(di, dj) != 0.0)
+            {
+                tap_rows.push_back(di);
+                tap_cols.push_back(dj);
+                tap_weights.push_back(kernel.weight(di, dj));
+            }
+    const int taps = static_cast<int>(tap_weights.size());
+
+    bands(rows, cols * std::max(1, taps), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+        {
+            double *o = out + static_cast<std::size_t>(i) * cols;
+            std::fill(o, o + cols, 0.0);
+            for (int t = 0; t < taps; ++t)
+            {
+                const double w = tap_weights[t];
+                const double *in = &padded_[static_cast<std::size_t>(i + r + tap_rows[t]) * padded_cols + r + tap_cols[t]];
+                for (int j = 0; j < cols; ++j)
+                    o[j] += w * in[j];
+            }
+        }
+    });
+}
+
+// ConvolveFFT
+// potential = inverse FFT(FFT(grid) x FFT(h)) where h holds weight(di, dj) at (-di, -dj) modulo the domain, so
+// the circular convolution at domain index (i + offset, j + offset) reads exactly the cells (i + di, j + dj).
+template <typename Source>
+void KernelConvolution::ConvolveFFT(const Source &source, int rows, int cols, bool periodic,
+                                    const ConvolutionKernel &kernel, double *out, const BandRunner &bands)
+{
+    const int r = kernel.radius();
+    const Axis row_axis = MakeAxis(rows, r, periodic, true);
+    const Axis col_axis = MakeAxis(cols, r, periodic, true);
+    PreparePlan(row_axis.n, col_axis.n);
+    const int n1 = n1_, n2 = n2_, half = n2 / 2 + 1;
+
+    if (kernel_spectrum_.empty() || kernel_n1_ != n1 || kernel_n2_ != n2 || kernel_radius_ != r ||
+        kernel_weights_ != kernel.weights())
+    {
+        std::vector<double> h(static_cast<std::size_t>(n1) * n2, 0.0);
+        for (int di = -r; di <= r; ++di)
+            for (int dj = -r; dj <= r; ++dj)
+            {
+                const int a = ((-di) % n1 + n1) % n1, b = ((-dj) % n2 + n2) % n2; // taps beyond a periodic grid fold
+                h[static_cast<std::size_t>(a) * n2 + b] += kernel.weight(di, dj);
+            }
+        ForwardFFT([&](int row, double *values) {
+            std::copy(&h[static_cast<std::size_t>(row) * n2], &h[static_cast<std::size_t>(row + 1) * n2], values);
+            return true;
+        }, kernel_spectrum_, bands);
+        kernel_n1_ = n1;
+        kernel_n2_ = n2;
+        kernel_radius_ = r;
+        kernel_weights_ = kernel.weights();
+    }
+
+    ForwardFFT([&](int row, double *values) { return LoadRow(source, row_axis, col_axis, row, values); }, spectrum_, bands);
+
+    bands(n1, half, [&](int begin, int end) {
+        for (std::size_t k = static_cast<std::size_t>(begin) * half; k < static_cast<std::size_t>(end) * half; ++k)
+            spectrum_[k] = Mul(spectrum_[k], kernel_spectrum_[k]);
+    });
+    bands(half, n1, [&](int begin, int end) { TransformColumns(spectrum_.data(), begin, end, true); });
+
+    // Inverse row transforms, two real rows per complex FFT: z = X_a + i X_b, with the upper half of each
+    // spectrum restored from Hermitian symmetry. Only the pairs holding output rows are transformed.
+    const double scale = 1.0 / (static_cast<double>(n1) * n2);
+    const bool exact = Source::integer && kernel.IsInteger();
+    const int first = row_axis.offset, last = row_axis.offset + rows;
+    bands(n1 / 2, n2, [&](int begin, int end) {
+        std::vector<Complex> z(n2);
+        for (int p = begin; p < end; ++p)
+        {
+            const int a = 2 * p;
+            if (a + 1 < first || a >= last)
+                continue;
+            const Complex *sa = &spectrum_[static_cast<std::size_t>(a) * half];
+            const Complex *sb = sa + half;
+            for (int k = 0; k < n2; ++k)
+            {
+                Complex xa, xb;
+                if (k < half)
+                {
+                    xa = sa[k];
+                    xb = sb[k];
+                }
+                else
+                {
+                    xa = std::conj(sa[n2 - k]);
+                    xb = std::conj(sb[n2 - k]);
+                }
+                z[k] = Complex(xa.real() - xb.imag(), xa.imag() + xb.real());
+            }
+            TransformRow(z.data(), true);
+            for (int q = 0; q < 2; ++q)
+            {
+                const int row = a + q;
+                if (row < first || row >= last)
+                    continue;
+                double *o = out + static_cast<std::size_t>(row - first) * cols;
+                const Complex *src = z.data() + col_axis.offset;
+                for (int j = 0; j < cols; ++j)
+                {
+                    const double v = (q == 0 ? src[j].real() : src[j].imag()) * scale;
+                    o[j] = exact ? std::nearbyint(v) : v;
+                }
+            }
+        }
+    });
+}
+
+// ForwardFFT
+// real rows a and a + 1 go into one complex FFT as z = x_a + i x_b; their spectra separate as
+// X_a[k] = (Z[k] + conj(Z[-k])) / 2 and X_b[k] = (Z[k] - conj(Z[-k])) / 2i. Then the columns are transformed.
+void KernelConvolution::ForwardFFT(const std::function<bool(int, double *)> &load, std::vector<Complex> &spectrum,
+                                   const BandRunner &bands)
+{
+    const int n1 = n1_, n2 = n2_, half = n2 / 2 + 1;
+    spectrum.resize(static_cast<std::size_t>(n1) * half);
+    bands(n1 / 2, n2, [&](int begin, int end) {
+        std::vector<double> xa(n2), xb(n2);
+        std::vector<Complex> z(n2);
+        for (int p = begin; p < end; ++p)
+        {
+            const int a = 2 * p;
+            Complex *sa = &spectrum[static_cast<std::size_t>(a) * half];
+            Complex *sb = sa + half;
+            const bool has_a = load(a, xa.data());
+            const bool has_b = load(a + 1, xb.data());
+            if (!has_a && !has_b)
+            {
+                std::fill(sa, sb + half, Complex(0.0, 0.0));
+                continue;
+            }
+            for (int j = 0; j < n2; ++j)
+                z[j] = Complex(xa[j], xb[j]);
+            TransformRow(z.data(), false);
+            for (int k = 0; k < half; ++k)
+            {
+                const Complex zk = z[k];
+                const Complex zm = std::conj(z[(n2 - k) & (n2 - 1)]);
+                sa[k] = Complex(0.5 * (zk.real() + zm.real()), 0.5 * (zk.imag() + zm.imag()));
+                sb[k] = Complex(0.5 * (zk.imag() - zm.imag()), -0.5 * (zk.real() - zm.real()));
+            }
+        }
+    });
+    bands(half, n1, [&](int begin, int end) { TransformColumns(spectrum.data(), begin, end, false); });
+}
+
+void KernelConvolution::PreparePlan(int n1, int n2)
+{
+    if (n1 == n1_ && n2 == n2_)
+        return;
+    const auto prepare = [](int n, std::vector<Complex> &twiddles, std::vector<int> &reverse) {
+        twiddles.resize(n / 2);
+        for (int t = 0; t < n / 2; ++t)
+            twiddles[t] = Complex(std::cos(2.0 * PI * t / n), -std::sin(2.0 * PI * t / n));
+        reverse.assign(n, 0);
+        int bits = 0;
+        while ((1 << bits) < n)
+            ++bits;
+        for (int i = 0; i < n; ++i)
+        {
+            int j = 0;
+            for (int b = 0; b < bits; ++b)
+                j |= ((i >> b) & 1) << (bits - 1 - b);
+            reverse[i] = j;
+        }
+    };
+    prepare(n1, twiddles1_, reverse1_);
+    prepare(n2, twiddles2_, reverse2_);
+    n1_ = n1;
+    n2_ = n2;
+}
+
+// TransformRow
+// in-place iterative radix-2 FFT of one row of n2 points (unscaled; the inverse uses conjugate twiddles).
+void KernelConvolution::TransformRow(Complex *row, bool inverse) const
+{
+    const int n = n2_;
+    for (int i = 0; i < n; ++i)
+    {
+        const int j = reverse2_[i];
+        if (i < j)
+            std::swap(row[i], row[j]);
+    }
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        const int half = len / 2, step = n / len;
+        for (int start = 0; start < n; start += len)
+            for (int t = 0; t < half; ++t)
+            {
+                const Complex w = inverse ? std::conj(twiddles2_[t * step]) : twiddles2_[t * step];
+                const Complex u = row[start + t];
+                const Complex v = Mul(row[start + t + half], w);
+                row[start + t] = u + v;
+                row[start + t + half] = u - v;
+            }
+    }
+}
+
+// TransformColumns
+// FFT along the n1 rows of the half-spectrum columns [first, last). Every butterfly combines two whole row
+// segments, so the columns of a block are transformed together with contiguous, vectorizable inner loops.
+void KernelConvolution::TransformColumns(Complex *data, int first, int last, bool inverse) const
+{
+    static const int BLOCK = 16; // columns per block: 16 complex values are four cache lines per row
+    const int n = n1_;
+    const std::size_t stride = static_cast<std::size_t>(n2_ / 2 + 1);
+    for (int c0 = first; c0 < last; c0 += BLOCK)
+    {
+        const int c1 = std::min(last, c0 + BLOCK);
+        for (int i = 0; i < n; ++i)
+        {
+            const int j = reverse1_[i];
+            if (i < j)
+                std::swap_ranges(data + i * stride + c0, data + i * stride + c1, data + j * stride + c0);
+        }
+        for (int len = 2; len <= n; len <<= 1)
+        {
+            const int half = len / 2, step = n / len;
+            for (int start = 0; start < n; start += len)
+                for (int t = 0; t < half; ++t)
+                {
+                    const Complex w = inverse ? std::conj(twiddles1_[t * step]) : twiddles1_[t * step];
+                    Complex *p = data + (start + t) * stride;
+                    Complex *q = p + half * stride;
+                    for (int c = c0; c < c1; ++c)
+                    {
+                        const Complex u = p[c];
+                        const Complex v = Mul(q[c], w);
+                        p[c] = u + v;
+                        q[c] = u - v;
+                    }
+                }
+        }
+    }
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <stdexcept>
+#include "../Include/Ensemble.h"
+#include "../Include/ThreadPool.h"
+
+// Out-of-class definitions: both constants are bound to references (std::min).
+const int Ensemble2D::LANES;
+const long long Ensemble2D::PARALLEL_MIN_CELLS;
+
+// Constructor
+// both generations are allocated (zero, halos included) once; non-periodic halos are never written again.
+Ensemble2D::Ensemble2D(int members, int rows, int cols, BoundaryCondition bc, NeighborhoodType nt)
+    : members_(members), groups_(0), rows_(rows), cols_(cols), boundary_condition_(bc), neighborhood_type_(nt),
+      simd_level_(DetectSimdLevel()), row_stride_(0), group_stride_(0)
+{
+    if (members < 0 || rows < 0 || cols < 0)
+    {
+        throw std::invalid_argument("Ensemble member count and grid dimensions must be non-negative");
+    }
+    groups_ = (members + LANES - 1) / LANES;
+    row_stride_ = static_cast<std::ptrdiff_t>(cols + 2) * LANES;
+    group_stride_ = static_cast<std::ptrdiff_t>(rows + 2) * row_stride_;
+    cells_.assign(static_cast<std::size_t>(groups_) * group_stride_, 0);
+    next_cells_.assign(cells_.size(), 0);
+}
+
+void Ensemble2D::CheckMember(int member) const
+{
+    if (member < 0 || member >= members_)
+    {
+        throw std::out_of_range("Ensemble member index out of range");
+    }
+}
+
+// Initialize
+// one scratch grid is filled per member and scattered into the member's lane.
+void Ensemble2D::Initialize(const InitializationFunction &init_func)
+{
+    FlatGrid2D grid(rows_, cols_);
+    for (int member = 0; member < members_; ++member)
+    {
+        grid.fill(0);
+        init_func(member, grid);
+        SetMember(member, grid);
+    }
+}
+
+void Ensemble2D::SetMember(int member, const FlatGrid2D &grid)
+{
+    CheckMember(member);
+    if (grid.rows() != rows_ || grid.cols() != cols_)
+    {
+        throw std::invalid_argument("Ensemble member grid has a different shape");
+    }
+    const int group = member / LANES, lane = member % LANES;
+    for (int i = 0; i < rows_; ++i)
+    {
+        int *out = cells_.data() + CellIndex(group, i, 0) + lane;
+        for (int j = 0; j < cols_; ++j)
+            out[j * LANES] = grid.at(i, j);
+    }
+}
+
+FlatGrid2D Ensemble2D::GetMember(int member) const
+{
+    CheckMember(member);
+    FlatGrid2D grid(rows_, cols_);
+    const int group = member / LANES, lane = member % LANES;
+    for (int i = 0; i < rows_; ++i)
+    {
+        const int *in = cells_.data() + CellIndex(group, i, 0) + lane;
+        for (int j = 0; j < cols_; ++j)
+            grid.at(i, j) = in[j * LANES];
+    }
+    return grid;
+}
+
+long long Ensemble2D::Population(int member) const
+{
+    CheckMember(member);
+    const int group = member / LANES, lane = member % LANES;
+    long long population = 0;
+    for (int i = 0; i < rows_; ++i)
+    {
+        const int *in = cells_.data() + CellIndex(group, i, 0) + lane;
+        for (int j = 0; j < cols_; ++j)
+            population += (in[j * LANES] != 0);
+    }
+    return population;
+}
+
+// StepNeuron
+// the models are folded into one NeuronRule per member for this step (validating them), then the kernel sweeps
+// every (group, row) pair.
+void Ensemble2D::StepNeuron(const std::vector<NeuronModel> &models, const std::vector<std::uint64_t> &seeds, std::uint64_t step)
+{
+    if (models.size() != 1 && models.size() != static_cast<std::size_t>(members_))
+    {
+        throw std::invalid_argument("StepNeuron needs one neuron model per ensemble member, or a single shared model");
+    }
+    if (seeds.size() != static_cast<std::size_t>(members_))
+    {
+        throw std::invalid_argument("StepNeuron needs one seed per ensemble member");
+    }
+    std::vector<NeuronRule> rules;
+    rules.reserve(members_);
+    for (int member = 0; member < members_; ++member)
+        rules.push_back(NeuronRule(models[models.size() == 1 ? 0 : member], step));
+
+    FillHalo();
+    ca_detail::EnsembleNeuronSweep sweep;
+    sweep.current = cells_.data() + CellIndex(0, 0, 0);
+    sweep.next = next_cells_.data() + CellIndex(0, 0, 0);
+    sweep.row_stride = row_stride_;
+    sweep.group_stride = group_stride_;
+    sweep.rows = rows_;
+    sweep.cols = cols_;
+    sweep.members = members_;
+    sweep.moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    sweep.rules = rules.data();
+    sweep.seeds = seeds.data();
+    sweep.step = step;
+    const SimdLevel level = simd_level_;
+    RunBands(groups_ * rows_, [&](int begin, int end) {
+        ca_detail::SweepEnsembleNeuron(sweep, level, begin, end);
+    });
+    cells_.swap(next_cells_);
+}
+
+// FillHalo
+// Periodic: the last row above the first and the first below the last, then the same for the columns of every
+// row including the halo rows, which fills the corners. Whole cells (all LANES members) are copied at once.
+void Ensemble2D::FillHalo()
+{
+    if (boundary_condition_ != BoundaryCondition::Periodic || rows_ == 0 || cols_ == 0)
+    {
+        return; // Fixed and NoBoundary: the halo holds zeros from the constructor
+    }
+    RunBands(groups_, [this](int begin, int end) {
+        for (int group = begin; group < end; ++group)
+        {
+            int *base = cells_.data();
+            std::copy(base + CellIndex(group, rows_ - 1, 0), base + CellIndex(group, rows_ - 1, cols_), base + CellIndex(group, -1, 0));
+            std::copy(base + CellIndex(group, 0, 0), base + CellIndex(group, 0, cols_), base + CellIndex(group, rows_, 0));
+            for (int i = -1; i <= rows_; ++i)
+            {
+                std::copy(base + CellIndex(group, i, cols_ - 1), base + CellIndex(group, i, cols_), base + CellIndex(group, i, -1));
+                std::copy(base + CellIndex(group, i, 0), base + CellIndex(group, i, 1), base + CellIndex(group, i, cols_));
+            }
+        }
+    });
+}
+
+// RunBands
+// the same rule as CellularAutomata::RunRowBands: serial below PARALLEL_MIN_CELLS cells or without a pool.
+void Ensemble2D::RunBands(int count, const std::function<void(int, int)> &body)
+{
+    const long long cells = static_cast<long long>(groups_) * LANES * rows_ * cols_;
+    if (pool_ && cells >= PARALLEL_MIN_CELLS && count > 1)
+    {
+        if (pool_.use_count() > 1)
+        {
+            pool_ = std::make_shared<ThreadPool>(pool_->size()); // copied ensemble: stop sharing the workers
+        }
+        pool_->ParallelFor(count, body);
+    }
+    else
+    {
+        body(0, count);
+    }
+}
+
+void Ensemble2D::SetSimdLevel(SimdLevel level)
+{
+    simd_level_ = std::min(level, DetectSimdLevel());
+}
+
+void Ensemble2D::SetThreadCount(int threads)
+{
+    if (threads < 0)
+    {
+        throw std::invalid_argument("Thread count must be non-negative");
+    }
+    if (threads == 0)
+    {
+        threads = ThreadPool::HardwareThreads();
+    }
+    if (threads == GetThreadCount())
+    {
+        return;
+    }
+    pool_.reset();
+    if (threads > 1)
+    {
+        pool_ = std::make_shared<ThreadPool>(threads);
+    }
+}
+
+int Ensemble2D::GetThreadCount() const
+{
+    return pool_ ? pool_->size() : 1;
+}
@@ -0,0 +1,600 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "../Include/Hashlife.h"
+
+namespace
+{
+    // Deepest tree on the plane: coordinates of a level 62 root still fit in a long long.
+    const int MAX_PLANE_LEVEL = 62;
+
+    // Default node limit: about 500 MB of nodes, hash index and memoized results.
+    const std::size_t DEFAULT_NODE_LIMIT = std::size_t(1) << 22;
+
+    std::size_t MixPointer(const void *p)
+    {
+        std::size_t h = reinterpret_cast<std::size_t>(p);
+        h ^= h >> 17;
+        h *= static_cast<std::size_t>(0x9E3779B97F4A7C15ull);
+        return h ^ (h >> 29);
+    }
+} // namespace
+
+std::size_t Hashlife::ChildrenHash::operator()(const ChildrenKey &key) const
+{
+    std::size_t h = 0;
+    for (const Node *child : key.child)
+        h = h * 31 + MixPointer(child);
+    return h;
+}
+
+std::size_t Hashlife::StepHash::operator()(const StepKey &key) const
+{
+    return MixPointer(key.node) * 61 + static_cast<std::size_t>(key.step_log2);
+}
+
+// Constructor
+// checks the rule, tabulates the one generation result of every 4 x 4 block and starts with an empty pattern.
+Hashlife::Hashlife(const RuleTable &table, NeighborhoodType nt, int torus_size)
+    : table_(table), neighborhood_type_(nt), torus_size_(torus_size), generation_(0), node_limit_(DEFAULT_NODE_LIMIT),
+      birth_(0), survive_(0), root_(nullptr), origin_(0)
+{
+    if (table.numStates() != 2 || !table.Covers(nt))
+        throw std::invalid_argument("Hashlife needs a two-state rule table covering its neighborhood");
+    for (int state = 0; state < 2; ++state)
+        for (int sum = 0; sum <= RuleTable::NeighborCount(nt); ++sum)
+            if (table.Get(state, sum) != 0 && table.Get(state, sum) != 1)
+                throw std::invalid_argument("Hashlife rule tables must produce only 0 and 1");
+    if (torus_size < 0 || (torus_size & (torus_size - 1)) != 0)
+        throw std::invalid_argument("Hashlife torus size must be a power of two (or 0 for the unbounded plane)");
+    if (torus_size == 0 && table.Get(0, 0) != 0)
+        throw std::invalid_argument("Rules that turn empty cells on (B0) need a torus, the unbounded plane would fill up");
+
+    leaves_[0] = Node{nullptr, nullptr, nullptr, nullptr, 0, 0, nullptr, 0};
+    leaves_[1] = Node{nullptr, nullptr, nullptr, nullptr, 0, 1, nullptr, 1};
+    for (int sum = 0; sum <= RuleTable::NeighborCount(nt); ++sum)
+    {
+        birth_ |= static_cast<unsigned>(table.Get(0, sum)) << sum;
+        survive_ |= static_cast<unsigned>(table.Get(1, sum)) << sum;
+    }
+
+    // bit r * 4 + c of a block is cell (r, c); bit 2 * (r - 1) + (c - 1) of the result is center cell (r, c)
+    const bool moore = (nt == NeighborhoodType::Moore);
+    base_results_.resize(1 << 16);
+    for (int block = 0; block < (1 << 16); ++block)
+    {
+        unsigned char result = 0;
+        for (int r = 1; r <= 2; ++r)
+        {
+            for (int c = 1; c <= 2; ++c)
+            {
+                int sum = 0;
+                for (int dr = -1; dr <= 1; ++dr)
+                    for (int dc = -1; dc <= 1; ++dc)
+                        if ((dr != 0 || dc != 0) && (moore || dr == 0 || dc == 0))
+                            sum += (block >> ((r + dr) * 4 + c + dc)) & 1;
+                int state = (block >> (r * 4 + c)) & 1;
+                result |= static_cast<unsigned char>(table.Get(state, sum) << (2 * (r - 1) + (c - 1)));
+            }
+        }
+        base_results_[block] = result;
+    }
+    Clear();
+}
+
+// Join
+// the unique node with these four quadrants (hash-consing).
+const Hashlife::Node *Hashlife::Join(const Node *nw, const Node *ne, const Node *sw, const Node *se)
+{
+    ChildrenKey key = {{nw, ne, sw, se}};
+    auto found = index_.find(key);
+    if (found != index_.end())
+        return found->second;
+    const int level = nw->level + 1;
+    std::uint64_t bits = 0;
+    if (level <= 3)
+    {
+        // small nodes keep their cells as a bitmap, so the leaf kernels never have to walk the tree
+        const int half = 1 << (level - 1), side = 2 * half;
+        const Node *quadrants[4] = {nw, ne, sw, se};
+        for (int q = 0; q < 4; ++q)
+            for (int r = 0; r < half; ++r)
+                for (int c = 0; c < half; ++c)
+                    if ((quadrants[q]->bits >> (r * half + c)) & 1u)
+                        bits |= std::uint64_t(1) << ((r + (q / 2) * half) * side + c + (q % 2) * half);
+    }
+    nodes_.push_back(Node{nw, ne, sw, se, level, nw->population + ne->population + sw->population + se->population,
+                          nullptr, bits});
+    const Node *node = &nodes_.back();
+    index_.emplace(key, node);
+    return node;
+}
+
+const Hashlife::Node *Hashlife::Empty(int level)
+{
+    if (empty_.empty())
+        empty_.push_back(&leaves_[0]);
+    while (static_cast<int>(empty_.size()) <= level)
+    {
+        const Node *below = empty_.back();
+        empty_.push_back(Join(below, below, below, below));
+    }
+    return empty_[level];
+}
+
+// Center
+// the level k - 1 square in the middle of a level k node.
+const Hashlife::Node *Hashlife::Center(const Node *node)
+{
+    return Join(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}
+
+// Expand
+// the level k + 1 node with `node` in its middle and empty space around it.
+const Hashlife::Node *Hashlife::Expand(const Node *node)
+{
+    const Node *e = Empty(node->level - 1);
+    return Join(Join(e, e, e, node->nw), Join(e, e, node->ne, e), Join(e, node->sw, e, e), Join(node->se, e, e, e));
+}
+
+// BaseResult
+// a level 2 node (4 x 4 cells) one generation later, reduced to its 2 x 2 center.
+const Hashlife::Node *Hashlife::BaseResult(const Node *node)
+{
+    const int result = base_results_[static_cast<std::size_t>(node->bits)];
+    return Join(&leaves_[result & 1], &leaves_[(result >> 1) & 1], &leaves_[(result >> 2) & 1], &leaves_[(result >> 3) & 1]);
+}
+
+// FromBits
+// the node of level 1 to 3 with the given bitmap (level 2 nodes are cached by bitmap).
+const Hashlife::Node *Hashlife::FromBits(std::uint64_t bits, int level)
+{
+    if (level == 0)
+        return &leaves_[bits & 1u];
+    if (level == 2)
+    {
+        if (level2_by_bits_.empty())
+            level2_by_bits_.assign(1 << 16, nullptr);
+        if (level2_by_bits_[static_cast<std::size_t>(bits)] != nullptr)
+            return level2_by_bits_[static_cast<std::size_t>(bits)];
+    }
+    const int half = 1 << (level - 1), side = 2 * half;
+    std::uint64_t quadrants[4] = {0, 0, 0, 0};
+    for (int q = 0; q < 4; ++q)
+        for (int r = 0; r < half; ++r)
+        {
+            const std::uint64_t row = (bits >> ((r + (q / 2) * half) * side + (q % 2) * half)) & ((std::uint64_t(1) << half) - 1);
+            quadrants[q] |= row << (r * half);
+        }
+    const Node *node = Join(FromBits(quadrants[0], level - 1), FromBits(quadrants[1], level - 1),
+                            FromBits(quadrants[2], level - 1), FromBits(quadrants[3], level - 1));
+    if (level == 2)
+        level2_by_bits_[static_cast<std::size_t>(bits)] = node;
+    return node;
+}
+
+// LeafResult
+// a level 4 or 5 node (16 x 16 or 32 x 32 cells) advanced up to a quarter of its side directly on a bitmap,
+// one row per 64-bit word: the neighbor counts of a whole row are added up bit plane by bit plane (as in
+// BitGrid2D) and the rule is applied through its birth and survival masks. Cells near the edge of the block
+// miss some neighbors and become wrong, one more ring per generation, but the center half stays exact.
+const Hashlife::Node *Hashlife::LeafResult(const Node *node, int step_log2)
+{
+    const int side = 1 << node->level;
+    std::uint64_t rows[32] = {0};
+    GatherBits(node, 0, 0, rows);
+
+    const bool moore = (neighborhood_type_ == NeighborhoodType::Moore);
+    const int max_count = RuleTable::NeighborCount(neighborhood_type_);
+    const int generations = 1 << step_log2;
+    const std::uint64_t row_mask = (std::uint64_t(1) << side) - 1;
+    for (int g = 1; g <= generations; ++g)
+    {
+        std::uint64_t next[32];
+        for (int r = g; r < side - g; ++r)
+        {
+            const std::uint64_t up = rows[r - 1], mid = rows[r], down = rows[r + 1];
+            // bit planes b0..b3 of the neighbor count of every cell in the row (ripple counters)
+            std::uint64_t b0 = 0, b1 = 0, b2 = 0, b3 = 0;
+            std::uint64_t in[8] = {up, mid << 1, mid >> 1, down, up << 1, up >> 1, down << 1, down >> 1};
+            const int inputs = moore ? 8 : 4;
+            for (int n = 0; n < inputs; ++n)
+            {
+                std::uint64_t c0 = b0 & in[n];
+                b0 ^= in[n];
+                std::uint64_t c1 = b1 & c0;
+                b1 ^= c0;
+                std::uint64_t c2 = b2 & c1;
+                b2 ^= c1;
+                b3 |= c2;
+            }
+            std::uint64_t result = 0;
+            for (int k = 0; k <= max_count; ++k)
+            {
+                const bool from_dead = (birth_ >> k) & 1u, from_live = (survive_ >> k) & 1u;
+                if (!from_dead && !from_live)
+                    continue;
+                std::uint64_t count_is_k = ((k & 1) ? b0 : ~b0) & ((k & 2) ? b1 : ~b1) & ((k & 4) ? b2 : ~b2) & ((k & 8) ? b3 : ~b3);
+                std::uint64_t select = (from_dead ? ~mid : 0) | (from_live ? mid : 0);
+                result |= count_is_k & select;
+            }
+            next[r] = result & row_mask;
+        }
+        for (int r = g; r < side - g; ++r)
+            rows[r] = next[r];
+    }
+    return FromRows(rows, side / 4, side / 4, node->level - 1);
+}
+
+// GatherBits
+// copies the cells of a node of level >= 3 into rows (bit c of rows[r] is cell (r, c)) from its 8 x 8 bitmaps.
+void Hashlife::GatherBits(const Node *node, int top, int left, std::uint64_t *rows) const
+{
+    if (node->level == 3)
+    {
+        for (int r = 0; r < 8; ++r)
+            rows[top + r] |= ((node->bits >> (r * 8)) & 0xFF) << left;
+        return;
+    }
+    const int half = 1 << (node->level - 1);
+    GatherBits(node->nw, top, left, rows);
+    GatherBits(node->ne, top, left + half, rows);
+    GatherBits(node->sw, top + half, left, rows);
+    GatherBits(node->se, top + half, left + half, rows);
+}
+
+// FromRows
+// the node of the given level (>= 3) whose top left cell is (top, left) in rows.
+const Hashlife::Node *Hashlife::FromRows(const std::uint64_t *rows, int top, int left, int level)
+{
+    if (level == 3)
+    {
+        std::uint64_t bits = 0;
+        for (int r = 0; r < 8; ++r)
+            bits |= ((rows[top + r] >> left) & 0xFF) << (r * 8);
+        return FromBits(bits, 3);
+    }
+    const int half = 1 << (level - 1);
+    return Join(FromRows(rows, top, left, level - 1), FromRows(rows, top, left + half, level - 1),
+                FromRows(rows, top + half, left, level - 1), FromRows(rows, top + half, left + half, level - 1));
+}
+
+// Result
+// the center (level k - 1) of a level k node after 2^step_log2 generations, for 0 <= step_log2 <= k - 2.
+// The node is cut into nine overlapping level k - 1 squares. At full speed (step_log2 = k - 2) each square
+// is advanced 2^(k - 3) generations, the results are regrouped into four squares and advanced again. For
+// smaller steps the nine squares are advanced 2^step_log2 generations and the four groups are just centered.
+const Hashlife::Node *Hashlife::Result(const Node *node, int step_log2)
+{
+    const int level = node->level;
+    const bool full_speed = (step_log2 == level - 2);
+    if (node->population == 0 && table_.Get(0, 0) == 0)
+        return Empty(level - 1); // nothing can be born in an empty region
+    if (full_speed && node->result != nullptr)
+        return node->result;
+    StepKey key = {node, step_log2};
+    if (!full_speed)
+    {
+        auto found = slow_results_.find(key);
+        if (found != slow_results_.end())
+            return found->second;
+    }
+
+    const Node *result;
+    if (level == 2)
+    {
+        result = BaseResult(node);
+    }
+    else if (level == 4 || level == 5)
+    {
+        result = LeafResult(node, step_log2);
+    }
+    else
+    {
+        const Node *nw = node->nw, *ne = node->ne, *sw = node->sw, *se = node->se;
+        const Node *n00 = nw;
+        const Node *n01 = Join(nw->ne, ne->nw, nw->se, ne->sw);
+        const Node *n02 = ne;
+        const Node *n10 = Join(nw->sw, nw->se, sw->nw, sw->ne);
+        const Node *n11 = Join(nw->se, ne->sw, sw->ne, se->nw);
+        const Node *n12 = Join(ne->sw, ne->se, se->nw, se->ne);
+        const Node *n20 = sw;
+        const Node *n21 = Join(sw->ne, se->nw, sw->se, se->sw);
+        const Node *n22 = se;
+
+        const int first = full_speed ? step_log2 - 1 : step_log2;
+        const Node *r00 = Result(n00, first), *r01 = Result(n01, first), *r02 = Result(n02, first);
+        const Node *r10 = Result(n10, first), *r11 = Result(n11, first), *r12 = Result(n12, first);
+        const Node *r20 = Result(n20, first), *r21 = Result(n21, first), *r22 = Result(n22, first);
+
+        const Node *q_nw = Join(r00, r01, r10, r11);
+        const Node *q_ne = Join(r01, r02, r11, r12);
+        const Node *q_sw = Join(r10, r11, r20, r21);
+        const Node *q_se = Join(r11, r12, r21, r22);
+        if (full_speed)
+            result = Join(Result(q_nw, first), Result(q_ne, first), Result(q_sw, first), Result(q_se, first));
+        else
+            result = Join(Center(q_nw), Center(q_ne), Center(q_sw), Center(q_se));
+    }
+
+    if (full_speed)
+        node->result = result;
+    else
+        slow_results_.emplace(key, result);
+    return result;
+}
+
+// Clear
+// an empty plane (a level 3 root around the origin) or an empty torus.
+void Hashlife::Clear()
+{
+    if (torus_size_ > 0)
+    {
+        // the root holds one period of the torus, at least 4 x 4 cells so that it can be advanced
+        int level = 2;
+        while ((1 << level) < torus_size_)
+            ++level;
+        root_ = Empty(level);
+        origin_ = 0;
+    }
+    else
+    {
+        root_ = Empty(3);
+        origin_ = -4;
+    }
+}
+
+bool Hashlife::Contains(long long row, long long col) const
+{
+    const long long size = 1LL << root_->level;
+    return row >= origin_ && row < origin_ + size && col >= origin_ && col < origin_ + size;
+}
+
+int Hashlife::GetInNode(const Node *node, long long row, long long col) const
+{
+    while (node->level > 0)
+    {
+        if (node->population == 0)
+            return 0;
+        const long long half = 1LL << (node->level - 1);
+        if (row < half)
+            node = (col < half) ? node->nw : node->ne;
+        else
+            node = (col < half) ? node->sw : node->se;
+        row %= half;
+        col %= half;
+    }
+    return static_cast<int>(node->population);
+}
+
+const Hashlife::Node *Hashlife::SetInNode(const Node *node, long long row, long long col, int state)
+{
+    if (node->level == 0)
+        return &leaves_[state];
+    const long long half = 1LL << (node->level - 1);
+    if (row < half)
+    {
+        if (col < half)
+            return Join(SetInNode(node->nw, row, col, state), node->ne, node->sw, node->se);
+        return Join(node->nw, SetInNode(node->ne, row, col - half, state), node->sw, node->se);
+    }
+    if (col < half)
+        return Join(node->nw, node->ne, SetInNode(node->sw, row - half, col, state), node->se);
+    return Join(node->nw, node->ne, node->sw, SetInNode(node->se, row - half, col - half, state));
+}
+
+int Hashlife::GetCell(long long row, long long col) const
+{
+    if (torus_size_ > 0)
+        return GetInNode(root_, Wrap(row), Wrap(col));
+    if (!Contains(row, col))
+        return 0;
+    return GetInNode(root_, row - origin_, col - origin_);
+}
+
+void Hashlife::SetCell(long long row, long long col, int state)
+{
+    if (state != 0 && state != 1)
+        throw std::invalid_argument("Hashlife only stores states 0 and 1");
+    if (torus_size_ > 0)
+    {
+        // a torus smaller than the root is stored as several copies of itself
+        const long long size = 1LL << root_->level;
+        for (long long r = Wrap(row); r < size; r += torus_size_)
+            for (long long c = Wrap(col); c < size; c += torus_size_)
+                root_ = SetInNode(root_, r, c, state);
+        return;
+    }
+    while (!Contains(row, col))
+    {
+        if (root_->level >= MAX_PLANE_LEVEL)
+            throw std::out_of_range("Hashlife coordinates out of range");
+        origin_ -= 1LL << (root_->level - 1);
+        root_ = Expand(root_);
+    }
+    root_ = SetInNode(root_, row - origin_, col - origin_, state);
+}
+
+// Build
+// rebuilds the square `old` (top left cell at (top, left)) with the cells of `grid` placed at (row0, col0).
+// Squares that do not overlap the grid are reused as they are; on the torus the grid covers everything.
+const Hashlife::Node *Hashlife::Build(const FlatGrid2D &grid, const Node *old, long long top, long long left,
+                                      long long row0, long long col0)
+{
+    const long long size = 1LL << old->level;
+    if (torus_size_ == 0 &&
+        (top + size <= row0 || top >= row0 + grid.rows() || left + size <= col0 || left >= col0 + grid.cols()))
+        return old;
+    if (old->level == 0)
+    {
+        int value = (torus_size_ > 0) ? grid.at(static_cast<int>(Wrap(top - row0)), static_cast<int>(Wrap(left - col0)))
+                                      : grid.at(static_cast<int>(top - row0), static_cast<int>(left - col0));
+        if (value != 0 && value != 1)
+            throw std::invalid_argument("Hashlife only stores states 0 and 1");
+        return &leaves_[value];
+    }
+    const long long half = size / 2;
+    return Join(Build(grid, old->nw, top, left, row0, col0), Build(grid, old->ne, top, left + half, row0, col0),
+                Build(grid, old->sw, top + half, left, row0, col0), Build(grid, old->se, top + half, left + half, row0, col0));
+}
+
+void Hashlife::LoadGrid(const FlatGrid2D &grid, long long row0, long long col0)
+{
+    if (grid.rows() == 0 || grid.cols() == 0)
+        return;
+    if (torus_size_ > 0)
+    {
+        if (grid.rows() != torus_size_ || grid.cols() != torus_size_)
+            throw std::invalid_argument("Hashlife::LoadGrid on a torus needs a grid of the torus size");
+        root_ = Build(grid, root_, 0, 0, row0, col0);
+        return;
+    }
+    // grow the plane until it covers the grid, then rebuild the overlapping squares
+    SetCell(row0, col0, GetCell(row0, col0));
+    SetCell(row0 + grid.rows() - 1, col0 + grid.cols() - 1, GetCell(row0 + grid.rows() - 1, col0 + grid.cols() - 1));
+    root_ = Build(grid, root_, origin_, origin_, row0, col0);
+}
+
+// StoreNode
+// writes the live cells of a square into the part of `grid` it overlaps (the grid was cleared before).
+void Hashlife::StoreNode(const Node *node, long long top, long long left, FlatGrid2D &grid, long long row0, long long col0) const
+{
+    const long long size = 1LL << node->level;
+    if (node->population == 0 || top + size <= row0 || top >= row0 + grid.rows() || left + size <= col0 ||
+        left >= col0 + grid.cols())
+        return;
+    if (node->level == 0)
+    {
+        grid.at(static_cast<int>(top - row0), static_cast<int>(left - col0)) = 1;
+        return;
+    }
+    const long long half = size / 2;
+    StoreNode(node->nw, top, left, grid, row0, col0);
+    StoreNode(node->ne, top, left + half, grid, row0, col0);
+    StoreNode(node->sw, top + half, left, grid, row0, col0);
+    StoreNode(node->se, top + half, left + half, grid, row0, col0);
+}
+
+void Hashlife::StoreGrid(FlatGrid2D &grid, long long row0, long long col0) const
+{
+    grid.fill(0);
+    if (torus_size_ > 0 && (row0 % torus_size_ != 0 || col0 % torus_size_ != 0 || grid.rows() > torus_size_ || grid.cols() > torus_size_))
+    {
+        // windows that wrap around the torus are read cell by cell
+        for (int i = 0; i < grid.rows(); ++i)
+            for (int j = 0; j < grid.cols(); ++j)
+                grid.at(i, j) = GetCell(row0 + i, col0 + j);
+        return;
+    }
+    StoreNode(root_, origin_, origin_, grid, torus_size_ > 0 ? 0 : row0, torus_size_ > 0 ? 0 : col0);
+}
+
+long long Hashlife::Population() const
+{
+    if (torus_size_ == 0)
+        return root_->population;
+    const long long copies = (1LL << root_->level) / torus_size_; // copies of the torus along each side of the root
+    return root_->population / (copies * copies);
+}
+
+// AdvanceTorus
+// the torus is the periodic tiling of the root. The 2 x 2 tiling of the root advanced 2^step_log2 generations
+// gives its middle square, which is the torus shifted by half a period; centering the 2 x 2 tiling of that
+// square shifts it back.
+void Hashlife::AdvanceTorus(int step_log2)
+{
+    const Node *shifted = Result(Join(root_, root_, root_, root_), step_log2);
+    root_ = Center(Join(shifted, shifted, shifted, shifted));
+}
+
+// AdvancePlane
+// pads the root with empty space until the pattern sits in its inner quarter and the root is big enough for
+// the step, so the pattern (which grows at most one cell per generation) cannot reach the edge of the result.
+void Hashlife::AdvancePlane(int step_log2)
+{
+    while (root_->level < step_log2 + 3 || Center(Center(root_))->population != root_->population)
+    {
+        if (root_->level >= MAX_PLANE_LEVEL)
+            throw std::out_of_range("Hashlife pattern grew beyond the supported coordinate range");
+        origin_ -= 1LL << (root_->level - 1);
+        root_ = Expand(root_);
+    }
+    origin_ += 1LL << (root_->level - 2);
+    root_ = Result(root_, step_log2);
+}
+
+// Advance
+// On the torus the largest jump is half a period; after every such jump the root is looked up among the
+// previous ones, and when the pattern repeats, whole cycles are skipped without computing them.
+void Hashlife::Advance(long long generations)
+{
+    if (generations < 0)
+        throw std::invalid_argument("Hashlife::Advance needs a non-negative number of generations");
+    std::unordered_map<const Node *, long long> seen; // torus root -> generation it was seen at
+    while (generations > 0)
+    {
+        int step_log2 = 0;
+        while (step_log2 < 62 && (generations >> (step_log2 + 1)) != 0)
+            ++step_log2;
+        if (torus_size_ > 0)
+        {
+            const int max_log2 = root_->level - 1;
+            if (step_log2 >= max_log2)
+            {
+                step_log2 = max_log2;
+                auto found = seen.find(root_);
+                if (found != seen.end())
+                {
+                    const long long period = generation_ - found->second;
+                    const long long skipped = (generations / period) * period;
+                    generation_ += skipped;
+                    generations -= skipped;
+                    seen.clear();
+                    continue;
+                }
+                seen.emplace(root_, generation_);
+            }
+            AdvanceTorus(step_log2);
+        }
+        else
+        {
+            AdvancePlane(step_log2);
+        }
+        generation_ += 1LL << step_log2;
+        generations -= 1LL << step_log2;
+        if (nodes_.size() > node_limit_)
+        {
+            Collect();
+            seen.clear();
+        }
+    }
+}
+
+// CopyInto
+// copies a node (and everything below it) into the current node store.
+const Hashlife::Node *Hashlife::CopyInto(const Node *node, std::unordered_map<const Node *, const Node *> &copied)
+{
+    if (node->level == 0)
+        return node;
+    auto found = copied.find(node);
+    if (found != copied.end())
+        return found->second;
+    const Node *copy = Join(CopyInto(node->nw, copied), CopyInto(node->ne, copied), CopyInto(node->sw, copied),
+                            CopyInto(node->se, copied));
+    copied.emplace(node, copy);
+    return copy;
+}
+
+// Collect
+// drops every memoized result and every node that is not part of the current pattern.
+void Hashlife::Collect()
+{
+    std::deque<Node> old_nodes;
+    old_nodes.swap(nodes_);
+    index_.clear();
+    slow_results_.clear();
+    empty_.clear();
+    level2_by_bits_.clear();
+    std::unordered_map<const Node *, const Node *> copied;
+    root_ = CopyInto(root_, copied);
+}
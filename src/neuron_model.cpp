@@ -0,0 +1,47 @@
+#include <cmath>
+#include <stdexcept>
+#include "../Include/NeuronModel.h"
+
+NeuronModel::NeuronModel()
+    : fire_probability(0.5), relay_probability(0.5), relay_period(5), recovery_probability(0.5), spontaneous_rate(0.05),
+      spontaneous_period(3)
+{
+}
+
+void NeuronModel::Validate() const
+{
+    const double probabilities[] = {fire_probability, relay_probability, recovery_probability, spontaneous_rate};
+    for (double p : probabilities)
+    {
+        if (!(p >= 0.0 && p <= 1.0))
+        {
+            throw std::invalid_argument("Neuron model probabilities must be between 0 and 1");
+        }
+    }
+    if (relay_period < 0 || spontaneous_period < 0)
+    {
+        throw std::invalid_argument("Neuron model periods must be non-negative");
+    }
+}
+
+std::uint64_t NeuronRule::Threshold(double p)
+{
+    if (!(p > 0.0))
+        return 0;
+    if (p >= 1.0)
+        return std::uint64_t(1) << 32;
+    return static_cast<std::uint64_t>(std::ceil(std::ldexp(p, 32)));
+}
+
+// Constructor
+// the periodic parts of the model only depend on the step, so they are folded into the thresholds here.
+NeuronRule::NeuronRule(const NeuronModel &model, std::uint64_t step)
+{
+    model.Validate();
+    const bool forced_relay = model.relay_period > 0 && step % static_cast<std::uint64_t>(model.relay_period) == 0;
+    const bool spontaneous = model.spontaneous_period > 0 && step % static_cast<std::uint64_t>(model.spontaneous_period) == 0;
+    fire_ = Threshold(model.fire_probability);
+    relay_ = forced_relay ? (std::uint64_t(1) << 32) : Threshold(model.relay_probability);
+    recover_ = Threshold(model.recovery_probability);
+    spontaneous_ = spontaneous ? Threshold(model.spontaneous_rate) : 0;
+}
@@ -0,0 +1,177 @@
+#include <cctype>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include "../Include/RuleTable.h"
+
+namespace
+{
+    const char LISTING_PREFIX[] = "table:";
+
+    // Reads the neighbor counts of one half of a "B3/S23" string into a bit mask (bit k = count k).
+    unsigned ParseCounts(const std::string &digits, int neighborCount, const std::string &text)
+    {
+        unsigned mask = 0;
+        for (char c : digits)
+        {
+            if (!std::isdigit(static_cast<unsigned char>(c)))
+                throw std::invalid_argument("Unexpected character in rule string \"" + text + "\"");
+            int count = c - '0';
+            if (count > neighborCount)
+                throw std::invalid_argument("Rule string \"" + text + "\" uses a neighbor count larger than the neighborhood");
+            mask |= 1u << count;
+        }
+        return mask;
+    }
+
+    // Parses "table:<states>:<max sum>:<e0>,<e1>,..." as written by RuleTable::ToString.
+    RuleTable ParseListing(const std::string &text)
+    {
+        std::istringstream in(text.substr(sizeof(LISTING_PREFIX) - 1));
+        int num_states = 0, max_sum = 0;
+        char colon1 = 0, colon2 = 0;
+        if (!(in >> num_states >> colon1 >> max_sum >> colon2) || colon1 != ':' || colon2 != ':' || num_states < 1 || max_sum < 0)
+            throw std::invalid_argument("Malformed rule table header in \"" + text + "\"");
+
+        RuleTable table(num_states, max_sum);
+        for (int state = 0; state < num_states; ++state)
+        {
+            for (int sum = 0; sum <= max_sum; ++sum)
+            {
+                int next = 0;
+                if (state + sum > 0)
+                {
+                    char comma = 0;
+                    if (!(in >> comma) || comma != ',')
+                        throw std::invalid_argument("Rule table \"" + text + "\" has too few entries");
+                }
+                if (!(in >> next))
+                    throw std::invalid_argument("Rule table \"" + text + "\" has too few entries");
+                if (next < 0 || next >= num_states)
+                    throw std::invalid_argument("Rule table \"" + text + "\" produces a state outside of its range");
+                table.Set(state, sum, next);
+            }
+        }
+        char extra = 0;
+        if (in >> extra)
+            throw std::invalid_argument("Rule table \"" + text + "\" has too many entries");
+        return table;
+    }
+} // namespace
+
+// FromString
+// accepts "B<counts>/S<counts>" (either order, any case), the old "<survive>/<birth>" form, or a table listing.
+RuleTable RuleTable::FromString(const std::string &text, int neighborCount)
+{
+    if (neighborCount < 0)
+        throw std::invalid_argument("Neighbor count must be non-negative");
+
+    if (text.compare(0, sizeof(LISTING_PREFIX) - 1, LISTING_PREFIX) == 0)
+    {
+        RuleTable table = ParseListing(text);
+        if (!table.Covers(neighborCount))
+            throw std::invalid_argument("Rule table \"" + text + "\" does not cover every neighbor count");
+        return table;
+    }
+
+    std::string::size_type slash = text.find('/');
+    if (slash == std::string::npos || text.find('/', slash + 1) != std::string::npos)
+        throw std::invalid_argument("Rule string \"" + text + "\" must have the form B<counts>/S<counts>");
+    std::string parts[2] = {text.substr(0, slash), text.substr(slash + 1)};
+
+    unsigned birth = 0, survive = 0;
+    bool has_birth = false, has_survive = false;
+    bool lettered[2];
+    for (int p = 0; p < 2; ++p)
+    {
+        const std::string &part = parts[p];
+        char tag = part.empty() ? '\0' : static_cast<char>(std::toupper(static_cast<unsigned char>(part[0])));
+        lettered[p] = (tag == 'B' || tag == 'S');
+        if (tag == 'B' && !has_birth)
+        {
+            birth = ParseCounts(part.substr(1), neighborCount, text);
+            has_birth = true;
+        }
+        else if (tag == 'S' && !has_survive)
+        {
+            survive = ParseCounts(part.substr(1), neighborCount, text);
+            has_survive = true;
+        }
+        else if (lettered[p])
+        {
+            throw std::invalid_argument("Rule string \"" + text + "\" repeats the " + std::string(1, tag) + " part");
+        }
+    }
+    if (lettered[0] != lettered[1])
+        throw std::invalid_argument("Rule string \"" + text + "\" mixes B/S and positional notation");
+    if (!lettered[0])
+    {
+        // old notation: survival counts first, birth counts second
+        survive = ParseCounts(parts[0], neighborCount, text);
+        birth = ParseCounts(parts[1], neighborCount, text);
+    }
+
+    RuleTable table(2, neighborCount);
+    for (int count = 0; count <= neighborCount; ++count)
+    {
+        table.Set(0, count, (birth >> count) & 1u);
+        table.Set(1, count, (survive >> count) & 1u);
+    }
+    return table;
+}
+
+// ToString
+// life-like notation when the table is a two-state 0/1 table with single digit counts, a full listing otherwise.
+std::string RuleTable::ToString() const
+{
+    bool life_like = (num_states_ == 2 && max_sum_ <= 9);
+    for (std::size_t k = 0; life_like && k < table_.size(); ++k)
+        life_like = (table_[k] == 0 || table_[k] == 1);
+
+    std::ostringstream out;
+    if (life_like)
+    {
+        out << 'B';
+        for (int count = 0; count <= max_sum_; ++count)
+            if (Get(0, count) == 1)
+                out << count;
+        out << "/S";
+        for (int count = 0; count <= max_sum_; ++count)
+            if (Get(1, count) == 1)
+                out << count;
+        return out.str();
+    }
+
+    out << LISTING_PREFIX << num_states_ << ':' << max_sum_ << ':';
+    for (std::size_t k = 0; k < table_.size(); ++k)
+        out << (k > 0 ? "," : "") << table_[k];
+    return out.str();
+}
+
+// Built-in rules
+// the free rule functions of the library, tabulated once for the given neighborhood.
+RuleTable RuleTable::Parity(NeighborhoodType nt)
+{
+    return FromFunction(parityRule, 2, nt);
+}
+
+RuleTable RuleTable::Totalistic(NeighborhoodType nt)
+{
+    return FromFunction(totalisticRule, 2, nt);
+}
+
+RuleTable RuleTable::Majority2D(NeighborhoodType nt)
+{
+    // majorityRule2D only looks at the neighbor count and the second argument
+    return FromFunction([](int neighbors, int state) { return majorityRule2D(neighbors, state, 0, 0, 0); }, 2, nt);
+}
+
+RuleTable RuleTable::Majority1D()
+{
+    return FromFunction(majorityRule_1D, 2, NEIGHBOR_COUNT_1D);
+}
+
+RuleTable RuleTable::Totalistic1D()
+{
+    return FromFunction(totalisticRule_1D, 2, NEIGHBOR_COUNT_1D);
+}
@@ -0,0 +1,714 @@
+#include <algorithm>
+#include <cstddef>
+#include "../Include/SimdKernels.h"
+#include "../Include/CounterRng.h"
+#include "../Include/NeuronModel.h"
+#include "../Include/Ensemble.h"
+
+// The SSE4.1 and AVX2 kernels are compiled with per-function target attributes, so the rest of the library
+// keeps the default compiler flags and the program still starts on CPUs without those extensions.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CA_HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+// DetectSimdLevel
+// asks the CPU (once) which of the vector instruction sets it supports.
+SimdLevel DetectSimdLevel()
+{
+#ifdef CA_HAVE_X86_KERNELS
+    static const SimdLevel level = __builtin_cpu_supports("avx2")     ? SimdLevel::AVX2
+                                   : __builtin_cpu_supports("sse4.1") ? SimdLevel::SSE41
+                                                                      : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char *SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::SSE41:
+        return "sse4.1";
+    case SimdLevel::Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+namespace ca_detail
+{
+    namespace
+    {
+        // SweepScalarCells
+        // reference (and tail) path: columns [col_begin, col_end) of row i, one cell at a time.
+        // Out of range states are flagged in `bad` and the table index is clamped so the lookup stays in bounds.
+        void SweepScalarCells(const TableSweep2D &s, int i, int col_begin, int col_end, unsigned &bad)
+        {
+            const int *mid = s.current + i * s.stride;
+            const int *up = mid - s.stride;
+            const int *down = mid + s.stride;
+            int *out = s.next + i * s.stride;
+            const unsigned limit = static_cast<unsigned>(s.num_states);
+            const unsigned last = static_cast<unsigned>(s.num_states * s.sums_per_state - 1);
+            for (int j = col_begin; j < col_end; ++j)
+            {
+                int sum = up[j] + mid[j - 1] + mid[j + 1] + down[j];
+                if (s.moore)
+                    sum += up[j - 1] + up[j + 1] + down[j - 1] + down[j + 1];
+                unsigned state = static_cast<unsigned>(mid[j]);
+                bad |= (state >= limit);
+                unsigned index = std::min(state * s.sums_per_state + static_cast<unsigned>(sum), last);
+                out[j] = s.table[index];
+            }
+        }
+
+        // BinaryTableMasks
+        // packs a two-state table with 0/1 outputs into one bit mask per state (bit `sum` = new state).
+        // Returns false when the table does not have that shape.
+        bool BinaryTableMasks(const TableSweep2D &s, unsigned &mask0, unsigned &mask1)
+        {
+            if (s.num_states != 2 || s.sums_per_state > 32)
+                return false;
+            mask0 = mask1 = 0;
+            for (int sum = 0; sum < s.sums_per_state; ++sum)
+            {
+                int next0 = s.table[sum], next1 = s.table[s.sums_per_state + sum];
+                if ((next0 & ~1) != 0 || (next1 & ~1) != 0)
+                    return false;
+                mask0 |= static_cast<unsigned>(next0) << sum;
+                mask1 |= static_cast<unsigned>(next1) << sum;
+            }
+            return true;
+        }
+
+        bool SweepScalar(const TableSweep2D &s, int row_begin, int row_end)
+        {
+            unsigned bad = 0;
+            for (int i = row_begin; i < row_end; ++i)
+                SweepScalarCells(s, i, 0, s.cols, bad);
+            return bad == 0;
+        }
+
+        // NeuronCells
+        // reference (and tail) path: columns [col_begin, col_end) of row i through NeuronRule.
+        void NeuronCells(const NeuronSweep2D &s, int i, int col_begin, int col_end)
+        {
+            const int *mid = s.current + i * s.stride;
+            const int *up = mid - s.stride;
+            const int *down = mid + s.stride;
+            int *out = s.next + i * s.stride;
+            const std::uint64_t first = static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(s.cols);
+            for (int j = col_begin; j < col_end; ++j)
+            {
+                int active = (up[j] != 0) + (mid[j - 1] != 0) + (mid[j + 1] != 0) + (down[j] != 0);
+                if (s.moore)
+                    active += (up[j - 1] != 0) + (up[j + 1] != 0) + (down[j - 1] != 0) + (down[j + 1] != 0);
+                CellRandom random(s.seed, s.step, first + j);
+                out[j] = s.rule->Draw(active, mid[j], random);
+            }
+        }
+
+        // EnsembleNeuronCells
+        // reference path of SweepEnsembleNeuron: every member of the (group, row) pairs [begin, end) through
+        // NeuronRule, cell by cell.
+        void EnsembleNeuronCells(const EnsembleNeuronSweep &s, int begin, int end)
+        {
+            const int lanes = Ensemble2D::LANES;
+            for (int n = begin; n < end; ++n)
+            {
+                const int group = n / s.rows, i = n % s.rows;
+                const int first = group * lanes, count = std::min(lanes, s.members - first);
+                const std::ptrdiff_t offset = group * s.group_stride + i * s.row_stride;
+                const int *mid = s.current + offset;
+                const int *up = mid - s.row_stride;
+                const int *down = mid + s.row_stride;
+                int *out = s.next + offset;
+                for (int j = 0; j < s.cols; ++j)
+                {
+                    const int c = j * lanes;
+                    for (int l = 0; l < count; ++l)
+                    {
+                        int active = (up[c + l] != 0) + (mid[c + l - lanes] != 0) + (mid[c + l + lanes] != 0) + (down[c + l] != 0);
+                        if (s.moore)
+                            active += (up[c + l - lanes] != 0) + (up[c + l + lanes] != 0) + (down[c + l - lanes] != 0) +
+                                      (down[c + l + lanes] != 0);
+                        CellRandom random(s.seeds[first + l], s.step, static_cast<std::uint64_t>(i) * s.cols + j);
+                        out[c + l] = s.rules[first + l].Draw(active, mid[c + l], random);
+                    }
+                }
+            }
+        }
+
+        // CountCells
+        // scalar histograms of columns [col_begin, col_end); returns false for a cell outside of the histogram.
+        bool CountCells(const int *row, std::ptrdiff_t stride, int col_begin, int col_end, bool moore, std::uint32_t *out)
+        {
+            const int *up = row - stride;
+            const int *down = row + stride;
+            bool valid = true;
+            for (int j = col_begin; j < col_end; ++j)
+            {
+                std::uint32_t counts = NeighborCounts::Encode(up[j]) + NeighborCounts::Encode(row[j - 1]) +
+                                       NeighborCounts::Encode(row[j + 1]) + NeighborCounts::Encode(down[j]);
+                if (moore)
+                    counts += NeighborCounts::Encode(up[j - 1]) + NeighborCounts::Encode(up[j + 1]) +
+                              NeighborCounts::Encode(down[j - 1]) + NeighborCounts::Encode(down[j + 1]);
+                out[j] = counts;
+                valid &= static_cast<unsigned>(row[j]) < static_cast<unsigned>(NeighborCounts::MAX_STATES);
+            }
+            return valid;
+        }
+
+#ifdef CA_HAVE_X86_KERNELS
+        // SweepSSE41
+        // four cells per iteration; SSE has no gather, so the table lookups are done lane by lane.
+        __attribute__((target("sse4.1"))) bool SweepSSE41(const TableSweep2D &s, int row_begin, int row_end)
+        {
+            const __m128i sums_per_state = _mm_set1_epi32(s.sums_per_state);
+            const __m128i limit = _mm_set1_epi32(s.num_states - 1);
+            const __m128i last = _mm_set1_epi32(s.num_states * s.sums_per_state - 1);
+            __m128i bad = _mm_setzero_si128();
+            unsigned bad_tail = 0;
+            alignas(16) int index[4];
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                const int *mid = s.current + i * s.stride;
+                const int *up = mid - s.stride;
+                const int *down = mid + s.stride;
+                int *out = s.next + i * s.stride;
+                int j = 0;
+                for (; j + 4 <= s.cols; j += 4)
+                {
+                    __m128i sum = _mm_add_epi32(
+                        _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(up + j)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i *>(down + j))),
+                        _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mid + j - 1)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i *>(mid + j + 1))));
+                    if (s.moore)
+                    {
+                        sum = _mm_add_epi32(sum, _mm_add_epi32(
+                                                     _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(up + j - 1)),
+                                                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(up + j + 1))),
+                                                     _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(down + j - 1)),
+                                                                   _mm_loadu_si128(reinterpret_cast<const __m128i *>(down + j + 1)))));
+                    }
+                    __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mid + j));
+                    // unsigned state > num_states - 1 (negative states included) marks the sweep as invalid
+                    bad = _mm_or_si128(bad, _mm_xor_si128(_mm_max_epu32(state, limit), limit));
+                    __m128i idx = _mm_min_epu32(_mm_add_epi32(_mm_mullo_epi32(state, sums_per_state), sum), last);
+                    _mm_store_si128(reinterpret_cast<__m128i *>(index), idx);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + j),
+                                     _mm_set_epi32(s.table[index[3]], s.table[index[2]], s.table[index[1]], s.table[index[0]]));
+                }
+                SweepScalarCells(s, i, j, s.cols, bad_tail);
+            }
+            return _mm_testz_si128(bad, bad) && bad_tail == 0;
+        }
+
+        // NeighborSumAVX2
+        // neighbor sums of the eight cells starting at mid[j] (3 x 3 block minus the center, or the 5-point cross minus the center).
+        __attribute__((target("avx2"))) inline __m256i NeighborSumAVX2(const int *up, const int *mid, const int *down, int j, bool moore)
+        {
+            __m256i sum = _mm256_add_epi32(
+                _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(up + j)),
+                                 _mm256_loadu_si256(reinterpret_cast<const __m256i *>(down + j))),
+                _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(mid + j - 1)),
+                                 _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mid + j + 1))));
+            if (moore)
+            {
+                sum = _mm256_add_epi32(sum, _mm256_add_epi32(
+                                                _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(up + j - 1)),
+                                                                 _mm256_loadu_si256(reinterpret_cast<const __m256i *>(up + j + 1))),
+                                                _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(down + j - 1)),
+                                                                 _mm256_loadu_si256(reinterpret_cast<const __m256i *>(down + j + 1)))));
+            }
+            return sum;
+        }
+
+        // EncodeAVX2
+        // 1 << (4 * state) for eight cells; shift counts of 32 or more (states outside 0 .. 7, including -1) give 0.
+        __attribute__((target("avx2"))) inline __m256i EncodeAVX2(const int *cells)
+        {
+            const __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(cells));
+            return _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_slli_epi32(state, 2));
+        }
+
+        // CountAVX2
+        // histograms of eight cells per iteration: the same shifted loads as NeighborSumAVX2, encoded first.
+        __attribute__((target("avx2"))) bool CountAVX2(const int *row, std::ptrdiff_t stride, int cols, bool moore, std::uint32_t *out)
+        {
+            const int *up = row - stride;
+            const int *down = row + stride;
+            const __m256i limit = _mm256_set1_epi32(NeighborCounts::MAX_STATES - 1);
+            __m256i bad = _mm256_setzero_si256();
+            int j = 0;
+            for (; j + 8 <= cols; j += 8)
+            {
+                __m256i counts = _mm256_add_epi32(_mm256_add_epi32(EncodeAVX2(up + j), EncodeAVX2(down + j)),
+                                                  _mm256_add_epi32(EncodeAVX2(row + j - 1), EncodeAVX2(row + j + 1)));
+                if (moore)
+                    counts = _mm256_add_epi32(counts, _mm256_add_epi32(_mm256_add_epi32(EncodeAVX2(up + j - 1), EncodeAVX2(up + j + 1)),
+                                                                       _mm256_add_epi32(EncodeAVX2(down + j - 1), EncodeAVX2(down + j + 1))));
+                const __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + j));
+                bad = _mm256_or_si256(bad, _mm256_xor_si256(_mm256_max_epu32(state, limit), limit));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), counts);
+            }
+            const bool tail = CountCells(row, stride, j, cols, moore, out);
+            return _mm256_testz_si256(bad, bad) && tail;
+        }
+
+        // IsZeroAVX2
+        // -1 in the lanes of the eight cells starting at p that are 0, 0 elsewhere.
+        __attribute__((target("avx2"))) inline __m256i IsZeroAVX2(const int *p)
+        {
+            return _mm256_cmpeq_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)), _mm256_setzero_si256());
+        }
+
+        // ActiveCountAVX2
+        // number of nonzero neighbors of the eight cells starting at mid[j]: the size of the neighborhood plus
+        // the (-1) lanes of the comparisons with zero. `across` is the distance between horizontal neighbors
+        // (1 in a grid, Ensemble2D::LANES in an ensemble group, whose lanes are eight members of one cell).
+        __attribute__((target("avx2"))) inline __m256i ActiveCountAVX2(const int *up, const int *mid, const int *down, int j, bool moore,
+                                                                       int across = 1)
+        {
+            __m256i zeros = _mm256_add_epi32(_mm256_add_epi32(IsZeroAVX2(up + j), IsZeroAVX2(down + j)),
+                                             _mm256_add_epi32(IsZeroAVX2(mid + j - across), IsZeroAVX2(mid + j + across)));
+            if (moore)
+                zeros = _mm256_add_epi32(zeros, _mm256_add_epi32(_mm256_add_epi32(IsZeroAVX2(up + j - across), IsZeroAVX2(up + j + across)),
+                                                                 _mm256_add_epi32(IsZeroAVX2(down + j - across), IsZeroAVX2(down + j + across))));
+            return _mm256_add_epi32(_mm256_set1_epi32(moore ? 8 : 4), zeros);
+        }
+
+        // SweepBinaryAVX2
+        // fast path for two-state tables whose outputs are 0/1 (every rule in the test suite): each state's column
+        // of the table is packed into the bits of one 32-bit mask, and new_state = (mask[state] >> sum) & 1 is a
+        // single variable shift instead of a gather.
+        __attribute__((target("avx2"))) bool SweepBinaryAVX2(const TableSweep2D &s, unsigned mask0, unsigned mask1,
+                                                             int row_begin, int row_end)
+        {
+            const __m256i one = _mm256_set1_epi32(1);
+            const __m256i masks0 = _mm256_set1_epi32(static_cast<int>(mask0));
+            const __m256i masks1 = _mm256_set1_epi32(static_cast<int>(mask1));
+            __m256i bad = _mm256_setzero_si256();
+            unsigned bad_tail = 0;
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                const int *mid = s.current + i * s.stride;
+                const int *up = mid - s.stride;
+                const int *down = mid + s.stride;
+                int *out = s.next + i * s.stride;
+                int j = 0;
+                for (; j + 8 <= s.cols; j += 8)
+                {
+                    __m256i sum = NeighborSumAVX2(up, mid, down, j, s.moore);
+                    __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mid + j));
+                    bad = _mm256_or_si256(bad, _mm256_xor_si256(_mm256_max_epu32(state, one), one));
+                    __m256i mask = _mm256_blendv_epi8(masks0, masks1, _mm256_cmpeq_epi32(state, one));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j),
+                                        _mm256_and_si256(_mm256_srlv_epi32(mask, sum), one));
+                }
+                SweepScalarCells(s, i, j, s.cols, bad_tail);
+            }
+            return _mm256_testz_si256(bad, bad) && bad_tail == 0;
+        }
+
+        // SweepAVX2
+        // eight cells per iteration, table lookups with a hardware gather.
+        __attribute__((target("avx2"))) bool SweepAVX2(const TableSweep2D &s, int row_begin, int row_end)
+        {
+            const __m256i sums_per_state = _mm256_set1_epi32(s.sums_per_state);
+            const __m256i limit = _mm256_set1_epi32(s.num_states - 1);
+            const __m256i last = _mm256_set1_epi32(s.num_states * s.sums_per_state - 1);
+            __m256i bad = _mm256_setzero_si256();
+            unsigned bad_tail = 0;
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                const int *mid = s.current + i * s.stride;
+                const int *up = mid - s.stride;
+                const int *down = mid + s.stride;
+                int *out = s.next + i * s.stride;
+                int j = 0;
+                for (; j + 8 <= s.cols; j += 8)
+                {
+                    __m256i sum = NeighborSumAVX2(up, mid, down, j, s.moore);
+                    __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mid + j));
+                    bad = _mm256_or_si256(bad, _mm256_xor_si256(_mm256_max_epu32(state, limit), limit));
+                    __m256i idx = _mm256_min_epu32(_mm256_add_epi32(_mm256_mullo_epi32(state, sums_per_state), sum), last);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), _mm256_i32gather_epi32(s.table, idx, 4));
+                }
+                SweepScalarCells(s, i, j, s.cols, bad_tail);
+            }
+            return _mm256_testz_si256(bad, bad) && bad_tail == 0;
+        }
+
+        // MulHiLo
+        // the 32 x 32 -> 64-bit products of the eight lanes of a with the constant m, split into high and low
+        // words (_mm256_mul_epu32 only multiplies the even lanes, so the odd lanes take a second multiply).
+        __attribute__((target("avx2"))) inline void MulHiLo(__m256i a, __m256i m, __m256i &hi, __m256i &lo)
+        {
+            const __m256i even = _mm256_mul_epu32(a, m);
+            const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+            lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+            hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+        }
+
+        // PhiloxRoundsAVX2
+        // Philox4x32::Generate on eight counters at once, one counter word per register; every lane can have its
+        // own key (the ensemble kernel gives each member its seed).
+        __attribute__((target("avx2"))) inline void PhiloxRoundsAVX2(__m256i &c0, __m256i &c1, __m256i &c2, __m256i &c3,
+                                                                     __m256i k0, __m256i k1)
+        {
+            const __m256i m0 = _mm256_set1_epi32(static_cast<int>(0xD2511F53u));
+            const __m256i m1 = _mm256_set1_epi32(static_cast<int>(0xCD9E8D57u));
+            const __m256i w0 = _mm256_set1_epi32(static_cast<int>(0x9E3779B9u));
+            const __m256i w1 = _mm256_set1_epi32(static_cast<int>(0xBB67AE85u));
+            for (int round = 0; round < 10; ++round)
+            {
+                __m256i hi0, lo0, hi1, lo1;
+                MulHiLo(c0, m0, hi0, lo0);
+                MulHiLo(c2, m1, hi1, lo1);
+                c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1), k0);
+                c1 = lo1;
+                c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3), k1);
+                c3 = lo0;
+                k0 = _mm256_add_epi32(k0, w0);
+                k1 = _mm256_add_epi32(k1, w1);
+            }
+        }
+
+        // FirstBlocksAVX2
+        // block 0 of the streams of cells cell_lo .. cell_lo + 7 (cell_hi above them; cell_lo + 7 must not wrap).
+        __attribute__((target("avx2"))) inline void FirstBlocksAVX2(std::uint64_t seed, std::uint64_t step, std::uint32_t cell_lo,
+                                                                    std::uint32_t cell_hi, __m256i &c0, __m256i &c1, __m256i &c2, __m256i &c3)
+        {
+            c0 = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(cell_lo)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            c1 = _mm256_set1_epi32(static_cast<int>(cell_hi));
+            c2 = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(step)));
+            c3 = _mm256_setzero_si256();
+            PhiloxRoundsAVX2(c0, c1, c2, c3, _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(seed))),
+                             _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(seed >> 32))));
+        }
+
+        // PhiloxAVX2
+        // FirstBlocksAVX2, transposed on the way out so each cell's four words are adjacent.
+        __attribute__((target("avx2"))) void PhiloxAVX2(std::uint64_t seed, std::uint64_t step, std::uint32_t cell_lo,
+                                                        std::uint32_t cell_hi, std::uint32_t *out)
+        {
+            __m256i c0, c1, c2, c3;
+            FirstBlocksAVX2(seed, step, cell_lo, cell_hi, c0, c1, c2, c3);
+            const __m256i t0 = _mm256_unpacklo_epi32(c0, c1), t1 = _mm256_unpackhi_epi32(c0, c1);
+            const __m256i t2 = _mm256_unpacklo_epi32(c2, c3), t3 = _mm256_unpackhi_epi32(c2, c3);
+            const __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+            const __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+            __m256i *dst = reinterpret_cast<__m256i *>(out);
+            _mm256_storeu_si256(dst, _mm256_permute2x128_si256(u0, u1, 0x20));     // cells 0, 1
+            _mm256_storeu_si256(dst + 1, _mm256_permute2x128_si256(u2, u3, 0x20)); // cells 2, 3
+            _mm256_storeu_si256(dst + 2, _mm256_permute2x128_si256(u0, u1, 0x31)); // cells 4, 5
+            _mm256_storeu_si256(dst + 3, _mm256_permute2x128_si256(u2, u3, 0x31)); // cells 6, 7
+        }
+
+        // LessThanAVX2
+        // lanes where the unsigned word w is below threshold (0 and 2^32 are "never" and "always").
+        __attribute__((target("avx2"))) inline __m256i LessThanAVX2(__m256i w, std::uint64_t threshold)
+        {
+            if (threshold == 0)
+                return _mm256_setzero_si256();
+            if (threshold > 0xFFFFFFFFull)
+                return _mm256_set1_epi32(-1);
+            const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+            const __m256i limit = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(threshold) ^ 0x80000000u));
+            return _mm256_cmpgt_epi32(limit, _mm256_xor_si256(w, flip));
+        }
+
+        // SweepNeuronAVX2
+        // NeuronRule::Apply on eight cells at a time: the three random words come straight out of the Philox
+        // registers, and every state's transition is computed and blended in by state.
+        __attribute__((target("avx2"))) void SweepNeuronAVX2(const NeuronSweep2D &s, int row_begin, int row_end)
+        {
+            const NeuronRule &rule = *s.rule;
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i active1 = _mm256_set1_epi32(CellularAutomata::ACTIVE_1);
+            const __m256i active2 = _mm256_set1_epi32(CellularAutomata::ACTIVE_2);
+            const __m256i active3 = _mm256_set1_epi32(CellularAutomata::ACTIVE_3);
+            const __m256i four = _mm256_set1_epi32(4), three = _mm256_set1_epi32(3);
+            const bool spontaneous = rule.spontaneousThreshold() != 0;
+            for (int i = row_begin; i < row_end; ++i)
+            {
+                const int *mid = s.current + i * s.stride;
+                const int *up = mid - s.stride;
+                const int *down = mid + s.stride;
+                int *out = s.next + i * s.stride;
+                const std::uint64_t first = static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(s.cols);
+                int j = 0;
+                for (; j + 8 <= s.cols; j += 8)
+                {
+                    const std::uint64_t cell = first + j;
+                    if (static_cast<std::uint32_t>(cell) > 0xFFFFFFF8u)
+                        break; // the low counter word would wrap inside the group: finish one by one
+                    const __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mid + j));
+                    const __m256i is1 = _mm256_cmpeq_epi32(state, active1);
+                    const __m256i is2 = _mm256_cmpeq_epi32(state, active2);
+                    const __m256i is3 = _mm256_cmpeq_epi32(state, active3);
+                    if (!spontaneous)
+                    {
+                        // quiet stretches (only inactive cells) keep their states without any random numbers
+                        const __m256i changing = _mm256_or_si256(_mm256_or_si256(is1, is2), is3);
+                        if (_mm256_testz_si256(changing, changing))
+                        {
+                            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), state);
+                            continue;
+                        }
+                    }
+                    __m256i transition, spontaneous_word, choice, unused;
+                    FirstBlocksAVX2(s.seed, s.step, static_cast<std::uint32_t>(cell), static_cast<std::uint32_t>(cell >> 32),
+                                    transition, spontaneous_word, choice, unused);
+                    const __m256i active = ActiveCountAVX2(up, mid, down, j, s.moore);
+
+                    // ACTIVE_1: MajorityRule (active > 4 -> ACTIVE_1, else INACTIVE) when it fires
+                    const __m256i majority = _mm256_and_si256(_mm256_cmpgt_epi32(active, four), active1);
+                    const __m256i next1 = _mm256_blendv_epi8(active1, majority, LessThanAVX2(transition, rule.fireThreshold()));
+                    // ACTIVE_2: TotalisticRule (active == 3 -> ACTIVE_1, else INACTIVE) when it relays
+                    const __m256i totalistic = _mm256_and_si256(_mm256_cmpeq_epi32(active, three), active1);
+                    const __m256i next2 = _mm256_blendv_epi8(active2, totalistic, LessThanAVX2(transition, rule.relayThreshold()));
+                    // ACTIVE_3: INACTIVE when it recovers, else ACTIVE_2
+                    const __m256i next3 = _mm256_blendv_epi8(active2, zero, LessThanAVX2(transition, rule.recoverThreshold()));
+
+                    __m256i next = state;
+                    next = _mm256_blendv_epi8(next, next1, is1);
+                    next = _mm256_blendv_epi8(next, next2, is2);
+                    next = _mm256_blendv_epi8(next, next3, is3);
+                    if (spontaneous)
+                    {
+                        // ACTIVE_1 + (choice * 3 >> 32): the high words of the even and odd lane products
+                        const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(choice, three), 32);
+                        const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(choice, 32), three);
+                        const __m256i jump = _mm256_add_epi32(_mm256_blend_epi32(even, odd, 0xAA), active1);
+                        next = _mm256_blendv_epi8(next, jump, LessThanAVX2(spontaneous_word, rule.spontaneousThreshold()));
+                    }
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + j), next);
+                }
+                NeuronCells(s, i, j, s.cols);
+            }
+        }
+
+        // LaneLessThanAVX2
+        // LessThanAVX2 with a threshold per lane: limit holds threshold - 1 with the sign bit flipped and enabled
+        // is -1 in the lanes whose threshold is not 0, since w < threshold <=> threshold > 0 and not w > threshold - 1.
+        __attribute__((target("avx2"))) inline __m256i LaneLessThanAVX2(__m256i w, __m256i limit, __m256i enabled)
+        {
+            const __m256i flip = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+            return _mm256_andnot_si256(_mm256_cmpgt_epi32(_mm256_xor_si256(w, flip), limit), enabled);
+        }
+
+        // SweepEnsembleNeuronAVX2
+        // SweepNeuronAVX2 across the members of a group: the eight lanes share the cell, and so the Philox counter,
+        // but each draws under its own key and compares with its own thresholds. Padding lanes get thresholds of
+        // 0, so their INACTIVE cells stay INACTIVE.
+        __attribute__((target("avx2"))) void SweepEnsembleNeuronAVX2(const EnsembleNeuronSweep &s, int begin, int end)
+        {
+            const int lanes = Ensemble2D::LANES;
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i active1 = _mm256_set1_epi32(CellularAutomata::ACTIVE_1);
+            const __m256i active2 = _mm256_set1_epi32(CellularAutomata::ACTIVE_2);
+            const __m256i active3 = _mm256_set1_epi32(CellularAutomata::ACTIVE_3);
+            const __m256i four = _mm256_set1_epi32(4), three = _mm256_set1_epi32(3);
+            const __m256i step = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(s.step)));
+            int group = -1;
+            bool spontaneous = false;
+            __m256i key0 = zero, key1 = zero, limit[4] = {zero, zero, zero, zero}, enabled[4] = {zero, zero, zero, zero}; // thresholds: fire, relay, recover, spontaneous
+            for (int n = begin; n < end; ++n)
+            {
+                const int g = n / s.rows, i = n % s.rows;
+                if (g != group)
+                {
+                    group = g;
+                    spontaneous = false;
+                    std::uint32_t k0[lanes], k1[lanes], lim[4][lanes], en[4][lanes];
+                    for (int l = 0; l < lanes; ++l)
+                    {
+                        const int m = g * lanes + l;
+                        std::uint64_t thresholds[4] = {0, 0, 0, 0}, seed = 0;
+                        if (m < s.members)
+                        {
+                            const NeuronRule &rule = s.rules[m];
+                            thresholds[0] = rule.fireThreshold();
+                            thresholds[1] = rule.relayThreshold();
+                            thresholds[2] = rule.recoverThreshold();
+                            thresholds[3] = rule.spontaneousThreshold();
+                            seed = s.seeds[m];
+                        }
+                        k0[l] = static_cast<std::uint32_t>(seed);
+                        k1[l] = static_cast<std::uint32_t>(seed >> 32);
+                        for (int t = 0; t < 4; ++t)
+                        {
+                            en[t][l] = thresholds[t] != 0 ? 0xFFFFFFFFu : 0u;
+                            lim[t][l] = static_cast<std::uint32_t>(thresholds[t] != 0 ? thresholds[t] - 1 : 0) ^ 0x80000000u;
+                        }
+                        spontaneous = spontaneous || thresholds[3] != 0;
+                    }
+                    key0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(k0));
+                    key1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(k1));
+                    for (int t = 0; t < 4; ++t)
+                    {
+                        limit[t] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(lim[t]));
+                        enabled[t] = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(en[t]));
+                    }
+                }
+                const std::ptrdiff_t offset = g * s.group_stride + i * s.row_stride;
+                const int *mid = s.current + offset;
+                const int *up = mid - s.row_stride;
+                const int *down = mid + s.row_stride;
+                int *out = s.next + offset;
+                const std::uint64_t first = static_cast<std::uint64_t>(i) * static_cast<std::uint64_t>(s.cols);
+                for (int j = 0; j < s.cols; ++j)
+                {
+                    const int c = j * lanes;
+                    const __m256i state = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mid + c));
+                    const __m256i is1 = _mm256_cmpeq_epi32(state, active1);
+                    const __m256i is2 = _mm256_cmpeq_epi32(state, active2);
+                    const __m256i is3 = _mm256_cmpeq_epi32(state, active3);
+                    if (!spontaneous)
+                    {
+                        const __m256i changing = _mm256_or_si256(_mm256_or_si256(is1, is2), is3);
+                        if (_mm256_testz_si256(changing, changing))
+                        {
+                            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + c), state);
+                            continue;
+                        }
+                    }
+                    const std::uint64_t cell = first + j;
+                    __m256i transition = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(cell)));
+                    __m256i spontaneous_word = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(cell >> 32)));
+                    __m256i choice = step, unused = zero;
+                    PhiloxRoundsAVX2(transition, spontaneous_word, choice, unused, key0, key1);
+                    const __m256i active = ActiveCountAVX2(up, mid, down, c, s.moore, lanes);
+
+                    const __m256i majority = _mm256_and_si256(_mm256_cmpgt_epi32(active, four), active1);
+                    const __m256i next1 = _mm256_blendv_epi8(active1, majority, LaneLessThanAVX2(transition, limit[0], enabled[0]));
+                    const __m256i totalistic = _mm256_and_si256(_mm256_cmpeq_epi32(active, three), active1);
+                    const __m256i next2 = _mm256_blendv_epi8(active2, totalistic, LaneLessThanAVX2(transition, limit[1], enabled[1]));
+                    const __m256i next3 = _mm256_blendv_epi8(active2, zero, LaneLessThanAVX2(transition, limit[2], enabled[2]));
+
+                    __m256i next = state;
+                    next = _mm256_blendv_epi8(next, next1, is1);
+                    next = _mm256_blendv_epi8(next, next2, is2);
+                    next = _mm256_blendv_epi8(next, next3, is3);
+                    if (spontaneous)
+                    {
+                        const __m256i even = _mm256_srli_epi64(_mm256_mul_epu32(choice, three), 32);
+                        const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(choice, 32), three);
+                        const __m256i jump = _mm256_add_epi32(_mm256_blend_epi32(even, odd, 0xAA), active1);
+                        next = _mm256_blendv_epi8(next, jump, LaneLessThanAVX2(spontaneous_word, limit[3], enabled[3]));
+                    }
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + c), next);
+                }
+            }
+        }
+#endif
+    } // namespace
+
+    void SweepNeuron2D(const NeuronSweep2D &sweep, SimdLevel level, int row_begin, int row_end)
+    {
+#ifdef CA_HAVE_X86_KERNELS
+        if (level == SimdLevel::AVX2 && DetectSimdLevel() == SimdLevel::AVX2)
+        {
+            SweepNeuronAVX2(sweep, row_begin, row_end);
+            return;
+        }
+#else
+        (void)level;
+#endif
+        for (int i = row_begin; i < row_end; ++i)
+            NeuronCells(sweep, i, 0, sweep.cols);
+    }
+
+    void SweepEnsembleNeuron(const EnsembleNeuronSweep &sweep, SimdLevel level, int begin, int end)
+    {
+#ifdef CA_HAVE_X86_KERNELS
+        if (level == SimdLevel::AVX2 && DetectSimdLevel() == SimdLevel::AVX2)
+        {
+            SweepEnsembleNeuronAVX2(sweep, begin, end);
+            return;
+        }
+#else
+        (void)level;
+#endif
+        EnsembleNeuronCells(sweep, begin, end);
+    }
+
+    bool CountNeighborStates2D(const int *row, std::ptrdiff_t stride, int cols, bool moore, std::uint32_t *out,
+                               SimdLevel level)
+    {
+#ifdef CA_HAVE_X86_KERNELS
+        if (level == SimdLevel::AVX2 && DetectSimdLevel() == SimdLevel::AVX2)
+            return CountAVX2(row, stride, cols, moore, out);
+#else
+        (void)level;
+#endif
+        return CountCells(row, stride, 0, cols, moore, out);
+    }
+
+    bool PhiloxFirstBlocks(std::uint64_t seed, std::uint64_t step, std::uint64_t first_cell, int count, std::uint32_t *out,
+                           SimdLevel level)
+    {
+#ifdef CA_HAVE_X86_KERNELS
+        if (level != SimdLevel::AVX2 || DetectSimdLevel() != SimdLevel::AVX2)
+            return false;
+        const std::uint32_t seed_lo = static_cast<std::uint32_t>(seed), seed_hi = static_cast<std::uint32_t>(seed >> 32);
+        const std::uint32_t key[2] = {seed_lo, seed_hi};
+        int n = 0;
+        for (; n + 8 <= count; n += 8)
+        {
+            const std::uint64_t cell = first_cell + n;
+            if (static_cast<std::uint32_t>(cell) > 0xFFFFFFF8u)
+                break; // the low counter word would wrap inside the group: finish one by one
+            PhiloxAVX2(seed, step, static_cast<std::uint32_t>(cell), static_cast<std::uint32_t>(cell >> 32), out + 4 * n);
+        }
+        for (; n < count; ++n)
+        {
+            const std::uint64_t cell = first_cell + n;
+            std::uint32_t *block = out + 4 * n;
+            block[0] = static_cast<std::uint32_t>(cell);
+            block[1] = static_cast<std::uint32_t>(cell >> 32);
+            block[2] = static_cast<std::uint32_t>(step);
+            block[3] = 0;
+            Philox4x32::Generate(block, key);
+        }
+        return true;
+#else
+        (void)seed;
+        (void)step;
+        (void)first_cell;
+        (void)count;
+        (void)out;
+        (void)level;
+        return false;
+#endif
+    }
+
+    // SweepTable2D
+    // runs the requested kernel, falling back to a slower one when the CPU does not support it.
+    bool SweepTable2D(const TableSweep2D &sweep, SimdLevel level, int row_begin, int row_end)
+    {
+#ifdef CA_HAVE_X86_KERNELS
+        SimdLevel supported = DetectSimdLevel();
+        if (level == SimdLevel::AVX2 && supported == SimdLevel::AVX2)
+        {
+            unsigned mask0 = 0, mask1 = 0;
+            if (BinaryTableMasks(sweep, mask0, mask1))
+                return SweepBinaryAVX2(sweep, mask0, mask1, row_begin, row_end);
+            return SweepAVX2(sweep, row_begin, row_end);
+        }
+        if (level != SimdLevel::Scalar && supported != SimdLevel::Scalar)
+            return SweepSSE41(sweep, row_begin, row_end);
+#else
+        (void)level;
+#endif
+        return SweepScalar(sweep, row_begin, row_end);
+    }
+} // namespace ca_detail
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include "../Include/SparseGrid.h"
+#include "../Include/ThreadPool.h"
+
+SparseGrid2D::SparseGrid2D(NeighborhoodType nt) : neighborhood_type_(nt), generation_(0) {}
+
+std::size_t SparseGrid2D::ChunkHash::operator()(const ChunkKey &key) const
+{
+    // mix both coordinates so that rows and columns of blocks do not collide
+    unsigned long long h = static_cast<unsigned long long>(key.row) * 0x9E3779B97F4A7C15ULL;
+    h ^= static_cast<unsigned long long>(key.col) + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    return static_cast<std::size_t>(h ^ (h >> 29));
+}
+
+// AcquireChunk
+// returns a block with every cell (halo included) set to 0, reusing freed blocks when possible.
+std::unique_ptr<SparseGrid2D::Chunk> SparseGrid2D::AcquireChunk()
+{
+    std::unique_ptr<Chunk> chunk;
+    if (!free_chunks_.empty())
+    {
+        chunk = std::move(free_chunks_.back());
+        free_chunks_.pop_back();
+        std::fill(chunk->cells.begin(), chunk->cells.end(), 0);
+    }
+    else
+    {
+        chunk.reset(new Chunk);
+        chunk->cells.assign(STRIDE * STRIDE, 0);
+    }
+    chunk->population = 0;
+    return chunk;
+}
+
+void SparseGrid2D::ReleaseChunk(std::unique_ptr<Chunk> chunk)
+{
+    free_chunks_.push_back(std::move(chunk));
+}
+
+long long SparseGrid2D::CountLive(const Chunk &chunk)
+{
+    long long live = 0;
+    const int *row = chunk.origin();
+    for (int r = 0; r < CHUNK; ++r, row += STRIDE)
+        for (int c = 0; c < CHUNK; ++c)
+            live += (row[c] != 0);
+    return live;
+}
+
+int SparseGrid2D::Get(long long row, long long col) const
+{
+    ChunkKey key = {FloorDiv(row), FloorDiv(col)};
+    ChunkMap::const_iterator it = chunks_.find(key);
+    if (it == chunks_.end())
+        return 0;
+    return it->second->origin()[(row - key.row * CHUNK) * STRIDE + (col - key.col * CHUNK)];
+}
+
+// Set
+// allocates the block on the first non-zero cell and frees it when its last non-zero cell is cleared.
+void SparseGrid2D::Set(long long row, long long col, int value)
+{
+    ChunkKey key = {FloorDiv(row), FloorDiv(col)};
+    ChunkMap::iterator it = chunks_.find(key);
+    if (it == chunks_.end())
+    {
+        if (value == 0)
+            return;
+        it = chunks_.emplace(key, AcquireChunk()).first;
+    }
+    Chunk &chunk = *it->second;
+    int &cell = chunk.origin()[(row - key.row * CHUNK) * STRIDE + (col - key.col * CHUNK)];
+    chunk.population += (value != 0) - (cell != 0);
+    cell = value;
+    if (chunk.population == 0)
+    {
+        ReleaseChunk(std::move(it->second));
+        chunks_.erase(it);
+    }
+}
+
+void SparseGrid2D::LoadGrid(const FlatGrid2D &grid, long long row0, long long col0)
+{
+    for (int r = 0; r < grid.rows(); ++r)
+        for (int c = 0; c < grid.cols(); ++c)
+            Set(row0 + r, col0 + c, grid[r][c]);
+}
+
+void SparseGrid2D::StoreGrid(FlatGrid2D &grid, long long row0, long long col0) const
+{
+    for (int r = 0; r < grid.rows(); ++r)
+        for (int c = 0; c < grid.cols(); ++c)
+            grid[r][c] = Get(row0 + r, col0 + c);
+}
+
+void SparseGrid2D::Clear()
+{
+    for (ChunkMap::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+        ReleaseChunk(std::move(it->second));
+    chunks_.clear();
+}
+
+long long SparseGrid2D::Population() const
+{
+    long long population = 0;
+    for (ChunkMap::const_iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+        population += it->second->population;
+    return population;
+}
+
+bool SparseGrid2D::Bounds(long long &min_row, long long &min_col, long long &max_row, long long &max_col) const
+{
+    bool found = false;
+    for (ChunkMap::const_iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+    {
+        const int *cells = it->second->origin();
+        for (int r = 0; r < CHUNK; ++r)
+        {
+            for (int c = 0; c < CHUNK; ++c)
+            {
+                if (cells[r * STRIDE + c] == 0)
+                    continue;
+                long long row = it->first.row * CHUNK + r, col = it->first.col * CHUNK + c;
+                if (!found)
+                {
+                    min_row = max_row = row;
+                    min_col = max_col = col;
+                    found = true;
+                }
+                min_row = std::min(min_row, row);
+                max_row = std::max(max_row, row);
+                min_col = std::min(min_col, col);
+                max_col = std::max(max_col, col);
+            }
+        }
+    }
+    return found;
+}
+
+// SetThreadCount
+// same convention as CellularAutomata::SetThreadCount.
+void SparseGrid2D::SetThreadCount(int threads)
+{
+    if (threads < 0)
+    {
+        throw std::invalid_argument("Thread count must be non-negative");
+    }
+    if (threads == 0)
+    {
+        threads = ThreadPool::HardwareThreads();
+    }
+    if (threads == GetThreadCount())
+    {
+        return;
+    }
+    pool_.reset();
+    if (threads > 1)
+    {
+        pool_ = std::make_shared<ThreadPool>(threads);
+    }
+}
+
+int SparseGrid2D::GetThreadCount() const
+{
+    return pool_ ? pool_->size() : 1;
+}
+
+// PrepareStep
+// 1. a live cell on the edge (or corner) of a block can give birth in the neighboring block, so those
+//    neighbors are added as empty blocks when they are missing;
+// 2. every block's halo is filled from its neighbors (0 where there is no neighbor);
+// 3. one work item, with a fresh output block, is queued per block.
+void SparseGrid2D::PrepareStep()
+{
+    std::vector<ChunkKey> missing;
+    for (ChunkMap::const_iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+    {
+        const int *cells = it->second->origin();
+        bool top = false, bottom = false, left = false, right = false;
+        for (int k = 0; k < CHUNK; ++k)
+        {
+            top = top || cells[k] != 0;
+            bottom = bottom || cells[(CHUNK - 1) * STRIDE + k] != 0;
+            left = left || cells[k * STRIDE] != 0;
+            right = right || cells[k * STRIDE + CHUNK - 1] != 0;
+        }
+        const bool spreads[3][3] = {
+            {cells[0] != 0, top, cells[CHUNK - 1] != 0},
+            {left, false, right},
+            {cells[(CHUNK - 1) * STRIDE] != 0, bottom, cells[(CHUNK - 1) * STRIDE + CHUNK - 1] != 0}};
+        for (int dr = -1; dr <= 1; ++dr)
+        {
+            for (int dc = -1; dc <= 1; ++dc)
+            {
+                if (!spreads[dr + 1][dc + 1])
+                    continue;
+                ChunkKey key = {it->first.row + dr, it->first.col + dc};
+                if (chunks_.find(key) == chunks_.end())
+                    missing.push_back(key);
+            }
+        }
+    }
+    for (std::size_t k = 0; k < missing.size(); ++k)
+        if (chunks_.find(missing[k]) == chunks_.end())
+            chunks_.emplace(missing[k], AcquireChunk());
+
+    work_.clear();
+    for (ChunkMap::iterator it = chunks_.begin(); it != chunks_.end(); ++it)
+    {
+        int *cells = it->second->origin();
+        const int *neighbor[3][3];
+        for (int dr = -1; dr <= 1; ++dr)
+        {
+            for (int dc = -1; dc <= 1; ++dc)
+            {
+                ChunkKey key = {it->first.row + dr, it->first.col + dc};
+                ChunkMap::const_iterator found = chunks_.find(key);
+                neighbor[dr + 1][dc + 1] = (found == chunks_.end()) ? nullptr : found->second->origin();
+            }
+        }
+        // rows -1 and CHUNK, then columns -1 and CHUNK (corners included)
+        for (int k = 0; k < CHUNK; ++k)
+        {
+            cells[-STRIDE + k] = neighbor[0][1] ? neighbor[0][1][(CHUNK - 1) * STRIDE + k] : 0;
+            cells[CHUNK * STRIDE + k] = neighbor[2][1] ? neighbor[2][1][k] : 0;
+            cells[k * STRIDE - 1] = neighbor[1][0] ? neighbor[1][0][k * STRIDE + CHUNK - 1] : 0;
+            cells[k * STRIDE + CHUNK] = neighbor[1][2] ? neighbor[1][2][k * STRIDE] : 0;
+        }
+        cells[-STRIDE - 1] = neighbor[0][0] ? neighbor[0][0][(CHUNK - 1) * STRIDE + CHUNK - 1] : 0;
+        cells[-STRIDE + CHUNK] = neighbor[0][2] ? neighbor[0][2][(CHUNK - 1) * STRIDE] : 0;
+        cells[CHUNK * STRIDE - 1] = neighbor[2][0] ? neighbor[2][0][CHUNK - 1] : 0;
+        cells[CHUNK * STRIDE + CHUNK] = neighbor[2][2] ? neighbor[2][2][0] : 0;
+
+        WorkItem item;
+        item.key = it->first;
+        item.current = it->second.get();
+        item.next = AcquireChunk();
+        work_.push_back(std::move(item));
+    }
+}
+
+// RunWork
+// blocks are independent once their halos are filled, so they are split across the pool like row bands.
+void SparseGrid2D::RunWork(const std::function<void(int, int)> &body)
+{
+    const int count = static_cast<int>(work_.size());
+    if (pool_ && count > 1)
+        pool_->ParallelFor(count, body);
+    else
+        body(0, count);
+}
+
+// FinishStep
+// the computed blocks replace the old ones; blocks that came out empty are freed right away.
+void SparseGrid2D::FinishStep()
+{
+    ChunkMap next;
+    next.reserve(work_.size());
+    for (std::size_t k = 0; k < work_.size(); ++k)
+    {
+        if (work_[k].next->population > 0)
+            next.emplace(work_[k].key, std::move(work_[k].next));
+        else
+            ReleaseChunk(std::move(work_[k].next));
+    }
+    work_.clear();
+    Clear();
+    chunks_.swap(next);
+    ++generation_;
+}
@@ -0,0 +1,116 @@
+#include <stdexcept>
+#include "../Include/ThreadPool.h"
+
+// Constructor
+// starts threads - 1 workers; the thread calling ParallelFor is the last member of the team.
+ThreadPool::ThreadPool(int threads)
+    : body_(nullptr), count_(0), generation_(0), pending_(0), stopping_(false)
+{
+    if (threads < 1)
+        throw std::invalid_argument("ThreadPool needs at least one thread");
+    workers_.reserve(threads - 1);
+    for (int i = 1; i < threads; ++i)
+        workers_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+// Destructor
+// wakes every worker up with the stop flag set and waits for them to exit.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    start_.notify_all();
+    for (std::thread &worker : workers_)
+        worker.join();
+}
+
+int ThreadPool::HardwareThreads()
+{
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : static_cast<int>(n);
+}
+
+// RunBand
+// band `index` of the current job: rows [count * index / size, count * (index + 1) / size).
+void ThreadPool::RunBand(int index)
+{
+    long long threads = size();
+    int begin = static_cast<int>(count_ * index / threads);
+    int end = static_cast<int>(count_ * (index + 1) / threads);
+    if (begin >= end)
+        return;
+    try
+    {
+        (*body_)(begin, end);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!error_)
+            error_ = std::current_exception();
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const BandFunction &body)
+{
+    if (count <= 0)
+        return;
+    if (workers_.empty())
+    {
+        body(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(submit_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        body_ = &body;
+        count_ = count;
+        pending_ = static_cast<int>(workers_.size());
+        error_ = nullptr;
+        ++generation_;
+    }
+    start_.notify_all();
+
+    RunBand(0); // the caller works on the first band instead of sleeping
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this] { return pending_ == 0; });
+        body_ = nullptr;
+        error = error_;
+        error_ = nullptr;
+    }
+    if (error)
+        std::rethrow_exception(error);
+}
+
+// WorkerLoop
+// sleeps until a new job (or the stop flag) is published, runs its band and reports back.
+void ThreadPool::WorkerLoop(int index)
+{
+    unsigned long seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_.wait(lock, [this, seen] { return stopping_ || generation_ != seen; });
+            if (stopping_)
+                return;
+            seen = generation_;
+        }
+
+        RunBand(index);
+
+        bool last;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            last = (--pending_ == 0);
+        }
+        if (last)
+            done_.notify_one();
+    }
+}
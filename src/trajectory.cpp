@@ -0,0 +1,602 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "../Include/Trajectory.h"
+
+using ca_detail::BYTE_ORDER_MARK;
+using ca_detail::RoundUp;
+
+namespace
+{
+    const char MAGIC[8] = {'C', 'A', 'T', 'R', 'A', 'J', '0', '1'};
+    const std::uint32_t VERSION = 1;
+    const std::size_t HEADER_ALIGNMENT = 64;
+    const std::size_t FIXED_HEADER_BYTES = 64; // everything before the rule text
+    const std::uint32_t KEYFRAME = 0, DELTA_FRAME = 1;   // kinds of Delta records
+    const std::size_t DELTA_RECORD_HEADER = 16;          // generation, kind, payload size
+
+    // Header fields in file order (after the magic).
+    struct FixedHeader
+    {
+        std::uint32_t byte_order, version, header_bytes, dimension, boundary, neighborhood, encoding;
+        std::int32_t layers, rows, cols;
+        std::uint64_t frame_bytes;
+        std::uint32_t rule_length, keyframe_interval;
+    };
+
+    std::size_t HeaderBytes(const TrajectoryInfo &info) { return RoundUp(FIXED_HEADER_BYTES + info.rule.size(), HEADER_ALIGNMENT); }
+
+    // Writes the header fields one by one (no struct padding reaches the file).
+    std::vector<unsigned char> EncodeHeader(const TrajectoryInfo &info)
+    {
+        std::vector<unsigned char> bytes(HeaderBytes(info), 0);
+        FixedHeader h;
+        h.byte_order = BYTE_ORDER_MARK;
+        h.version = VERSION;
+        h.header_bytes = static_cast<std::uint32_t>(bytes.size());
+        h.dimension = static_cast<std::uint32_t>(info.dimension);
+        h.boundary = static_cast<std::uint32_t>(info.boundary);
+        h.neighborhood = static_cast<std::uint32_t>(info.neighborhood);
+        h.encoding = static_cast<std::uint32_t>(info.encoding);
+        h.layers = info.layers;
+        h.rows = info.rows;
+        h.cols = info.cols;
+        h.frame_bytes = info.FrameBytes();
+        h.rule_length = static_cast<std::uint32_t>(info.rule.size());
+        h.keyframe_interval = static_cast<std::uint32_t>(info.keyframe_interval);
+        unsigned char *out = bytes.data();
+        std::memcpy(out, MAGIC, 8);
+        const std::uint32_t words[7] = {h.byte_order, h.version, h.header_bytes, h.dimension, h.boundary, h.neighborhood, h.encoding};
+        std::memcpy(out + 8, words, sizeof(words));
+        const std::int32_t shape[3] = {h.layers, h.rows, h.cols};
+        std::memcpy(out + 36, shape, sizeof(shape));
+        std::memcpy(out + 48, &h.frame_bytes, 8);
+        std::memcpy(out + 56, &h.rule_length, 4);
+        std::memcpy(out + 60, &h.keyframe_interval, 4);
+        std::memcpy(out + FIXED_HEADER_BYTES, info.rule.data(), info.rule.size());
+        return bytes;
+    }
+
+    // Parses and validates a header; returns its size in bytes.
+    std::size_t DecodeHeader(const unsigned char *data, std::size_t size, TrajectoryInfo &info)
+    {
+        if (size < FIXED_HEADER_BYTES || std::memcmp(data, MAGIC, 8) != 0)
+            throw std::runtime_error("Not a trajectory file");
+        std::uint32_t words[7];
+        std::memcpy(words, data + 8, sizeof(words));
+        if (words[0] != BYTE_ORDER_MARK)
+            throw std::runtime_error("Trajectory file was written on a machine with a different byte order");
+        if (words[1] != VERSION)
+            throw std::runtime_error("Unsupported trajectory file version");
+        const std::size_t header_bytes = words[2];
+        if (words[3] > 2 || words[4] > 2 || words[5] > 1 || words[6] > 2)
+            throw std::runtime_error("Corrupt trajectory header");
+        info.dimension = static_cast<GridDimension>(words[3]);
+        info.boundary = static_cast<BoundaryCondition>(words[4]);
+        info.neighborhood = static_cast<NeighborhoodType>(words[5]);
+        info.encoding = static_cast<TrajectoryEncoding>(words[6]);
+        std::int32_t shape[3];
+        std::memcpy(shape, data + 36, sizeof(shape));
+        info.layers = shape[0];
+        info.rows = shape[1];
+        info.cols = shape[2];
+        std::uint64_t frame_bytes = 0;
+        std::uint32_t rule_length = 0, keyframe_interval = 0;
+        std::memcpy(&frame_bytes, data + 48, 8);
+        std::memcpy(&rule_length, data + 56, 4);
+        std::memcpy(&keyframe_interval, data + 60, 4);
+        info.keyframe_interval = static_cast<int>(keyframe_interval);
+        if (info.layers < 0 || info.rows < 0 || info.cols < 0 || header_bytes > size || FIXED_HEADER_BYTES + rule_length > header_bytes)
+            throw std::runtime_error("Corrupt trajectory header");
+        info.rule.assign(reinterpret_cast<const char *>(data + FIXED_HEADER_BYTES), rule_length);
+        if (frame_bytes != info.FrameBytes() || (info.encoding == TrajectoryEncoding::Delta && info.keyframe_interval < 1))
+            throw std::runtime_error("Corrupt trajectory header");
+        return header_bytes;
+    }
+
+    // LEB128: 7 bits per byte, high bit set on every byte but the last.
+    void PutVarint(std::vector<unsigned char> &out, std::uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    std::uint32_t GetVarint(const unsigned char *&in, const unsigned char *end)
+    {
+        std::uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7)
+        {
+            if (in == end)
+                throw std::runtime_error("Corrupt delta frame in trajectory file");
+            unsigned char byte = *in++;
+            value |= static_cast<std::uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Corrupt delta frame in trajectory file");
+    }
+
+    // FindChange
+    // index of the first k < count with cells[k] != base[k] (count when there is none). Equal stretches are
+    // skipped 64 cells at a time with memcmp, which the C library vectorizes, so a frame with few changes
+    // costs little more than reading it once.
+    std::size_t FindChange(const int *cells, const int *base, std::size_t count)
+    {
+        const std::size_t block = 64;
+        std::size_t k = 0;
+        while (k + block <= count && std::memcmp(cells + k, base + k, block * sizeof(int)) == 0)
+            k += block;
+        while (k < count && cells[k] == base[k])
+            ++k;
+        return k;
+    }
+
+    // DecodeRuns
+    // applies one record to cells: the literals are XORed in, and a keyframe starts from an all-zero frame.
+    void DecodeRuns(const unsigned char *in, const unsigned char *end, bool keyframe, std::vector<int> &cells)
+    {
+        if (keyframe)
+            std::fill(cells.begin(), cells.end(), 0);
+        std::size_t pos = 0;
+        while (pos < cells.size())
+        {
+            std::size_t unchanged = GetVarint(in, end);
+            std::size_t literals = GetVarint(in, end);
+            if (unchanged + literals == 0 || unchanged + literals > cells.size() - pos)
+                throw std::runtime_error("Corrupt delta frame in trajectory file");
+            pos += unchanged;
+            for (std::size_t k = 0; k < literals; ++k, ++pos)
+                cells[pos] ^= static_cast<int>(GetVarint(in, end));
+        }
+    }
+} // namespace
+
+// TrajectoryInfo
+
+TrajectoryInfo TrajectoryInfo::From(const CellularAutomata &ca, TrajectoryEncoding encoding, const std::string &rule)
+{
+    TrajectoryInfo info;
+    info.dimension = ca.GetDimension();
+    info.boundary = ca.GetBoundaryCondition();
+    info.neighborhood = ca.GetNeighborhoodType();
+    info.encoding = encoding;
+    info.layers = ca.getLayers();
+    info.rows = ca.getRows();
+    info.cols = ca.getCols();
+    info.rule = rule;
+    info.keyframe_interval = DEFAULT_KEYFRAME_INTERVAL;
+    return info;
+}
+
+std::size_t TrajectoryInfo::FrameBytes() const
+{
+    if (encoding == TrajectoryEncoding::Delta)
+        return 0;
+    const std::size_t cells = static_cast<std::size_t>(CellCount());
+    const std::size_t payload = (encoding == TrajectoryEncoding::Raw) ? cells * sizeof(std::int32_t) : (cells + 7) / 8;
+    return sizeof(std::int64_t) + RoundUp(payload, 8);
+}
+
+// TrajectoryWriter
+
+TrajectoryWriter::TrajectoryWriter(const std::string &path, const TrajectoryInfo &info, std::size_t buffer_bytes)
+    : info_(info), file_(nullptr), buffer_(std::max<std::size_t>(buffer_bytes, 64)), used_(0), frames_(0),
+      pending_bits_(0), pending_count_(0), payload_written_(0), bytes_written_(0), generation_(0), cursor_(0),
+      run_unchanged_(0)
+{
+    if (info.layers < 0 || info.rows < 0 || info.cols < 0)
+    {
+        throw std::invalid_argument("Trajectory dimensions must be non-negative");
+    }
+    if (info.encoding == TrajectoryEncoding::Delta && info.keyframe_interval < 1)
+    {
+        throw std::invalid_argument("Delta trajectories need a keyframe interval of at least 1");
+    }
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_)
+    {
+        throw std::runtime_error("Unable to open trajectory file: " + path);
+    }
+    std::setvbuf(file_, nullptr, _IONBF, 0); // buffer_ already batches the writes
+    std::vector<unsigned char> header = EncodeHeader(info_);
+    Put(header.data(), header.size());
+}
+
+TrajectoryWriter::~TrajectoryWriter()
+{
+    ca_detail::CloseQuietly(*this);
+}
+
+void TrajectoryWriter::Put(const void *data, std::size_t bytes)
+{
+    const unsigned char *in = static_cast<const unsigned char *>(data);
+    bytes_written_ += static_cast<long long>(bytes);
+    while (bytes > 0)
+    {
+        if (used_ == buffer_.size())
+            Flush();
+        std::size_t chunk = std::min(bytes, buffer_.size() - used_);
+        std::memcpy(buffer_.data() + used_, in, chunk);
+        used_ += chunk;
+        in += chunk;
+        bytes -= chunk;
+    }
+}
+
+void TrajectoryWriter::Flush()
+{
+    if (!file_)
+    {
+        throw std::runtime_error("Trajectory file is closed");
+    }
+    if (used_ > 0 && std::fwrite(buffer_.data(), 1, used_, file_) != used_)
+    {
+        throw std::runtime_error("Writing the trajectory file failed");
+    }
+    used_ = 0;
+}
+
+void TrajectoryWriter::Close()
+{
+    if (!file_)
+        return;
+    try
+    {
+        Flush();
+    }
+    catch (...)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+        throw;
+    }
+    int result = std::fclose(file_);
+    file_ = nullptr;
+    if (result != 0)
+    {
+        throw std::runtime_error("Closing the trajectory file failed");
+    }
+}
+
+void TrajectoryWriter::CheckShape(int layers, int rows, int cols) const
+{
+    if (!file_)
+    {
+        throw std::runtime_error("Trajectory file is closed");
+    }
+    if (layers != info_.layers || rows != info_.rows || cols != info_.cols)
+    {
+        throw std::invalid_argument("Frame shape does not match the trajectory header");
+    }
+}
+
+void TrajectoryWriter::BeginFrame(long long generation)
+{
+    if (info_.encoding == TrajectoryEncoding::Delta)
+    {
+        // a keyframe is coded as the change from an all-zero frame
+        generation_ = generation;
+        if (frames_ % info_.keyframe_interval == 0)
+            previous_.assign(static_cast<std::size_t>(info_.CellCount()), 0);
+        encoded_.clear();
+        cursor_ = 0;
+        run_unchanged_ = 0;
+        run_literals_.clear();
+        return;
+    }
+    const std::int64_t value = generation;
+    Put(&value, sizeof(value));
+    payload_written_ = 0;
+    pending_bits_ = 0;
+    pending_count_ = 0;
+}
+
+// PutRow
+// Raw rows are copied as they are; BitPacked rows are gathered 64 cells at a time.
+void TrajectoryWriter::PutRow(const int *cells, int count)
+{
+    if (info_.encoding == TrajectoryEncoding::Delta)
+    {
+        PutDeltaRow(cells, static_cast<std::size_t>(count));
+        return;
+    }
+    if (info_.encoding == TrajectoryEncoding::Raw)
+    {
+        Put(cells, static_cast<std::size_t>(count) * sizeof(int));
+        payload_written_ += static_cast<std::size_t>(count) * sizeof(int);
+        return;
+    }
+    for (int j = 0; j < count; ++j)
+    {
+        pending_bits_ |= static_cast<std::uint64_t>(cells[j] & 1) << pending_count_;
+        if (++pending_count_ == 64)
+        {
+            unsigned char bytes[8]; // byte b holds cells 8b to 8b + 7, whatever the byte order of the machine
+            for (int b = 0; b < 8; ++b)
+                bytes[b] = static_cast<unsigned char>(pending_bits_ >> (8 * b));
+            Put(bytes, sizeof(bytes));
+            payload_written_ += sizeof(bytes);
+            pending_bits_ = 0;
+            pending_count_ = 0;
+        }
+    }
+}
+
+void TrajectoryWriter::EndFrame()
+{
+    if (info_.encoding == TrajectoryEncoding::Delta)
+    {
+        const bool keyframe = (frames_ % info_.keyframe_interval == 0);
+        if (run_unchanged_ > 0 || !run_literals_.empty())
+            FlushRun();
+        const std::int64_t generation = generation_;
+        const std::uint32_t record[2] = {keyframe ? KEYFRAME : DELTA_FRAME, static_cast<std::uint32_t>(encoded_.size())};
+        Put(&generation, sizeof(generation));
+        Put(record, sizeof(record));
+        Put(encoded_.data(), encoded_.size());
+        payload_written_ = encoded_.size();
+    }
+    for (; pending_count_ > 0; pending_count_ -= 8)
+    {
+        unsigned char byte = static_cast<unsigned char>(pending_bits_ & 0xFF);
+        Put(&byte, 1);
+        pending_bits_ >>= 8;
+        ++payload_written_;
+    }
+    pending_count_ = 0;
+    static const unsigned char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+    Put(zeros, RoundUp(payload_written_, 8) - payload_written_);
+    ++frames_;
+}
+
+// PutDeltaRow
+// extends the current (unchanged run, literals) pair with the next cells of the frame, row boundaries
+// included. Changed cells are copied into previous_ on the way, so previous_ becomes this frame without
+// a full copy.
+void TrajectoryWriter::PutDeltaRow(const int *cells, std::size_t count)
+{
+    int *base = previous_.data() + cursor_;
+    std::size_t j = 0;
+    while (j < count)
+    {
+        if (run_literals_.empty())
+        {
+            std::size_t change = FindChange(cells + j, base + j, count - j) + j;
+            run_unchanged_ += change - j;
+            j = change;
+            if (j == count)
+                break;
+        }
+        while (j < count && cells[j] != base[j])
+        {
+            run_literals_.push_back(static_cast<std::uint32_t>(cells[j] ^ base[j]));
+            base[j] = cells[j];
+            ++j;
+        }
+        if (j < count)
+            FlushRun(); // an unchanged cell ends the literals
+    }
+    cursor_ += count;
+}
+
+void TrajectoryWriter::FlushRun()
+{
+    PutVarint(encoded_, static_cast<std::uint32_t>(run_unchanged_));
+    PutVarint(encoded_, static_cast<std::uint32_t>(run_literals_.size()));
+    for (std::size_t k = 0; k < run_literals_.size(); ++k)
+        PutVarint(encoded_, run_literals_[k]);
+    run_unchanged_ = 0;
+    run_literals_.clear();
+}
+
+namespace
+{
+    // BitPacked frames can only hold 0 and 1; checked before a frame is started.
+    void CheckBinaryRow(const int *cells, int count)
+    {
+        for (int j = 0; j < count; ++j)
+            if (cells[j] != 0 && cells[j] != 1)
+                throw std::invalid_argument("BitPacked trajectories can only store states 0 and 1");
+    }
+} // namespace
+
+void TrajectoryWriter::WriteFrame(const std::vector<int> &grid, long long generation)
+{
+    CheckShape(1, 1, static_cast<int>(grid.size()));
+    if (info_.encoding == TrajectoryEncoding::BitPacked)
+        CheckBinaryRow(grid.data(), static_cast<int>(grid.size()));
+    BeginFrame(generation);
+    PutRow(grid.data(), static_cast<int>(grid.size()));
+    EndFrame();
+}
+
+void TrajectoryWriter::WriteFrame(const FlatGrid2D &grid, long long generation)
+{
+    CheckShape(1, grid.rows(), grid.cols());
+    if (info_.encoding == TrajectoryEncoding::BitPacked)
+        for (int i = 0; i < grid.rows(); ++i)
+            CheckBinaryRow(grid[i].data(), grid.cols());
+    BeginFrame(generation);
+    if (grid.isPacked() && info_.encoding == TrajectoryEncoding::Raw)
+        PutRow(grid.data(), static_cast<int>(grid.cellCount())); // one copy for the whole frame
+    else
+        for (int i = 0; i < grid.rows(); ++i)
+            PutRow(grid[i].data(), grid.cols());
+    EndFrame();
+}
+
+void TrajectoryWriter::WriteFrame(const FlatGrid3D &grid, long long generation)
+{
+    CheckShape(grid.layers(), grid.rows(), grid.cols());
+    if (info_.encoding == TrajectoryEncoding::BitPacked)
+        for (int k = 0; k < grid.layers(); ++k)
+            for (int i = 0; i < grid.rows(); ++i)
+                CheckBinaryRow(grid.row(k, i).data(), grid.cols());
+    BeginFrame(generation);
+    for (int k = 0; k < grid.layers(); ++k)
+        for (int i = 0; i < grid.rows(); ++i)
+            PutRow(grid.row(k, i).data(), grid.cols());
+    EndFrame();
+}
+
+void TrajectoryWriter::WriteCells(const int *cells, long long generation)
+{
+    CheckShape(info_.layers, info_.rows, info_.cols);
+    const long long count = info_.CellCount();
+    if (info_.encoding == TrajectoryEncoding::BitPacked)
+        for (long long first = 0; first < count; first += info_.cols)
+            CheckBinaryRow(cells + first, info_.cols);
+    BeginFrame(generation);
+    if (info_.encoding == TrajectoryEncoding::Raw)
+        PutRow(cells, static_cast<int>(count));
+    else
+        for (long long first = 0; first < count; first += info_.cols)
+            PutRow(cells + first, info_.cols);
+    EndFrame();
+}
+
+void TrajectoryWriter::WriteFrame(const CellularAutomata &ca, long long generation)
+{
+    CellularAutomata::IOTimer timer(ca);
+    switch (ca.GetDimension())
+    {
+    case GridDimension::OneD:
+        WriteFrame(ca.GetGrid1D(), generation);
+        break;
+    case GridDimension::TwoD:
+        WriteFrame(ca.GetGrid2D(), generation);
+        break;
+    case GridDimension::ThreeD:
+        WriteFrame(ca.GetGrid3D(), generation);
+        break;
+    }
+}
+
+// TrajectoryFrame
+
+TrajectoryFrame::TrajectoryFrame(long long generation, const int *cells, const TrajectoryInfo &info)
+    : payload_(reinterpret_cast<const unsigned char *>(cells)), generation_(generation), cell_count_(info.CellCount()),
+      rows_(info.rows), cols_(info.cols), raw_(true)
+{
+}
+
+TrajectoryFrame::TrajectoryFrame(const unsigned char *record, const TrajectoryInfo &info)
+    : payload_(record + sizeof(std::int64_t)), generation_(0), cell_count_(info.CellCount()), rows_(info.rows),
+      cols_(info.cols), raw_(info.encoding == TrajectoryEncoding::Raw)
+{
+    std::int64_t generation = 0;
+    std::memcpy(&generation, record, sizeof(generation));
+    generation_ = generation;
+}
+
+// TrajectoryReader
+
+TrajectoryReader::TrajectoryReader(const std::string &path)
+    : file_(path, "trajectory"), data_(file_.data()), size_(file_.size()), header_bytes_(0), frames_(0), decoded_index_(-1)
+{
+    header_bytes_ = DecodeHeader(data_, size_, info_);
+    if (info_.encoding == TrajectoryEncoding::Delta)
+        IndexDeltaRecords();
+    else
+        frames_ = static_cast<long long>((size_ - header_bytes_) / info_.FrameBytes()); // a partly written last frame is ignored
+}
+
+// IndexDeltaRecords
+// walks the record headers once; a record cut short by an interrupted run ends the index.
+void TrajectoryReader::IndexDeltaRecords()
+{
+    std::size_t offset = header_bytes_;
+    while (size_ - offset >= DELTA_RECORD_HEADER)
+    {
+        std::uint32_t record[2];
+        std::memcpy(record, data_ + offset + sizeof(std::int64_t), sizeof(record));
+        const std::size_t bytes = DELTA_RECORD_HEADER + RoundUp(record[1], 8);
+        if (record[0] > DELTA_FRAME || bytes > size_ - offset || (offsets_.empty() && record[0] != KEYFRAME))
+            break;
+        if (record[0] == KEYFRAME)
+            keyframes_.push_back(static_cast<long long>(offsets_.size()));
+        offsets_.push_back(offset);
+        offset += bytes;
+    }
+    frames_ = static_cast<long long>(offsets_.size());
+}
+
+// DecodeFrame
+// continues from the frame decoded last when it lies between the keyframe and the wanted frame.
+void TrajectoryReader::DecodeFrame(long long index) const
+{
+    if (index == decoded_index_)
+        return;
+    long long start = *(std::upper_bound(keyframes_.begin(), keyframes_.end(), index) - 1);
+    if (decoded_index_ >= start && decoded_index_ < index)
+        start = decoded_index_ + 1;
+    decoded_.resize(static_cast<std::size_t>(info_.CellCount()));
+    decoded_index_ = -1; // stays invalid if a corrupt record throws below
+    for (long long n = start; n <= index; ++n)
+    {
+        const unsigned char *record = data_ + offsets_[static_cast<std::size_t>(n)];
+        std::uint32_t kind_and_size[2];
+        std::memcpy(kind_and_size, record + sizeof(std::int64_t), sizeof(kind_and_size));
+        const unsigned char *payload = record + DELTA_RECORD_HEADER;
+        DecodeRuns(payload, payload + kind_and_size[1], kind_and_size[0] == KEYFRAME, decoded_);
+    }
+    decoded_index_ = index;
+}
+
+TrajectoryFrame TrajectoryReader::Frame(long long index) const
+{
+    if (index < 0 || index >= frames_)
+    {
+        throw std::out_of_range("Trajectory frame index out of range");
+    }
+    if (info_.encoding == TrajectoryEncoding::Delta)
+    {
+        DecodeFrame(index);
+        std::int64_t generation = 0;
+        std::memcpy(&generation, data_ + offsets_[static_cast<std::size_t>(index)], sizeof(generation));
+        return TrajectoryFrame(generation, decoded_.data(), info_);
+    }
+    return TrajectoryFrame(data_ + header_bytes_ + static_cast<std::size_t>(index) * info_.FrameBytes(), info_);
+}
+
+void TrajectoryReader::UnpackRow(const TrajectoryFrame &frame, long long first, int count, int *out) const
+{
+    if (frame.cells())
+    {
+        std::memcpy(out, frame.cells() + first, static_cast<std::size_t>(count) * sizeof(int));
+        return;
+    }
+    for (int j = 0; j < count; ++j)
+        out[j] = frame.Get(first + j);
+}
+
+void TrajectoryReader::ReadFrame(long long index, std::vector<int> &grid) const
+{
+    TrajectoryFrame frame = Frame(index);
+    grid.resize(static_cast<std::size_t>(info_.CellCount()));
+    UnpackRow(frame, 0, static_cast<int>(grid.size()), grid.data());
+}
+
+void TrajectoryReader::ReadFrame(long long index, FlatGrid2D &grid) const
+{
+    TrajectoryFrame frame = Frame(index);
+    const int rows = info_.layers * info_.rows;
+    if (grid.rows() != rows || grid.cols() != info_.cols)
+        grid = FlatGrid2D(rows, info_.cols, 0, grid.halo());
+    for (int i = 0; i < rows; ++i)
+        UnpackRow(frame, static_cast<long long>(i) * info_.cols, info_.cols, grid[i].data());
+}
+
+void TrajectoryReader::ReadFrame(long long index, FlatGrid3D &grid) const
+{
+    TrajectoryFrame frame = Frame(index);
+    if (grid.layers() != info_.layers || grid.rows() != info_.rows || grid.cols() != info_.cols)
+        grid = FlatGrid3D(info_.layers, info_.rows, info_.cols, 0, grid.halo());
+    for (int k = 0; k < info_.layers; ++k)
+        for (int i = 0; i < info_.rows; ++i)
+            UnpackRow(frame, (static_cast<long long>(k) * info_.rows + i) * info_.cols, info_.cols, grid.row(k, i).data());
+}